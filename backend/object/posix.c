@@ -40,6 +40,11 @@ struct JBackendFile
 
 typedef struct JBackendFile JBackendFile;
 
+/**
+ * Open files, shared by all threads.
+ * Files are looked up using their path and are closed when their last reference is dropped.
+ * Handles can therefore be opened and closed by different threads.
+ */
 static GHashTable* jd_backend_file_cache = NULL;
 static gchar* jd_backend_path = NULL;
 
@@ -47,29 +52,19 @@ G_LOCK_DEFINE_STATIC(jd_backend_file_cache);
 
 static
 void
-jd_backend_files_free (gpointer data)
-{
-	GHashTable* files = data;
-
-	g_hash_table_destroy(files);
-}
-
-// FIXME not deleted?
-static GPrivate jd_backend_files = G_PRIVATE_INIT(jd_backend_files_free);
-
-static
-void
-backend_file_unref (gpointer data)
+backend_file_unref (JBackendFile* file)
 {
-	JBackendFile* file = data;
-
 	g_return_if_fail(file != NULL);
 
 	G_LOCK(jd_backend_file_cache);
 
 	if (g_atomic_int_dec_and_test(&(file->ref_count)))
 	{
-		g_hash_table_remove(jd_backend_file_cache, file->path);
+		/* The file might have been replaced after being deleted. */
+		if (g_hash_table_lookup(jd_backend_file_cache, file->path) == file)
+		{
+			g_hash_table_remove(jd_backend_file_cache, file->path);
+		}
 
 		j_trace_file_begin(file->path, J_TRACE_FILE_CLOSE);
 		close(file->fd);
@@ -82,55 +77,30 @@ backend_file_unref (gpointer data)
 	G_UNLOCK(jd_backend_file_cache);
 }
 
-static
-GHashTable*
-jd_backend_files_get_thread (void)
-{
-	GHashTable* files;
-
-	files = g_private_get(&jd_backend_files);
-
-	if (G_UNLIKELY(files == NULL))
-	{
-		files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, backend_file_unref);
-		g_private_replace(&jd_backend_files, files);
-	}
-
-	return files;
-}
-
 static
 JBackendFile*
-backend_file_get (GHashTable* files, gchar const* key)
+backend_file_get (gchar const* key)
 {
 	JBackendFile* file;
 
-	if ((file = g_hash_table_lookup(files, key)) != NULL)
-	{
-		goto end;
-	}
-
 	G_LOCK(jd_backend_file_cache);
 
 	if ((file = g_hash_table_lookup(jd_backend_file_cache, key)) != NULL)
 	{
 		g_atomic_int_inc(&(file->ref_count));
-		g_hash_table_insert(files, file->path, file);
 		G_UNLOCK(jd_backend_file_cache);
 	}
 
 	/* Attention: The caller must call backend_file_add() if NULL is returned! */
 
-end:
 	return file;
 }
 
 static
 void
-backend_file_add (GHashTable* files, JBackendFile* file)
+backend_file_add (JBackendFile* file)
 {
 	g_hash_table_insert(jd_backend_file_cache, file->path, file);
-	g_hash_table_insert(files, file->path, file);
 
 	G_UNLOCK(jd_backend_file_cache);
 }
@@ -139,8 +109,6 @@ static
 gboolean
 backend_create (gchar const* namespace, gchar const* path, gpointer* data)
 {
-	GHashTable* files = jd_backend_files_get_thread();
-
 	JBackendFile* file = NULL;
 	g_autofree gchar* parent = NULL;
 	gchar* full_path;
@@ -148,7 +116,7 @@ backend_create (gchar const* namespace, gchar const* path, gpointer* data)
 
 	full_path = g_build_filename(jd_backend_path, namespace, path, NULL);
 
-	if ((file = backend_file_get(files, full_path)) != NULL)
+	if ((file = backend_file_get(full_path)) != NULL)
 	{
 		g_free(full_path);
 
@@ -172,7 +140,7 @@ backend_create (gchar const* namespace, gchar const* path, gpointer* data)
 	file->fd = fd;
 	file->ref_count = 1;
 
-	backend_file_add(files, file);
+	backend_file_add(file);
 
 end:
 	*data = file;
@@ -184,15 +152,13 @@ static
 gboolean
 backend_open (gchar const* namespace, gchar const* path, gpointer* data)
 {
-	GHashTable* files = jd_backend_files_get_thread();
-
 	JBackendFile* file = NULL;
 	gchar* full_path;
 	gint fd;
 
 	full_path = g_build_filename(jd_backend_path, namespace, path, NULL);
 
-	if ((file = backend_file_get(files, full_path)) != NULL)
+	if ((file = backend_file_get(full_path)) != NULL)
 	{
 		g_free(full_path);
 
@@ -211,7 +177,7 @@ backend_open (gchar const* namespace, gchar const* path, gpointer* data)
 	file->fd = fd;
 	file->ref_count = 1;
 
-	backend_file_add(files, file);
+	backend_file_add(file);
 
 end:
 	*data = file;
@@ -224,14 +190,23 @@ gboolean
 backend_delete (gpointer data)
 {
 	JBackendFile* file = data;
-	GHashTable* files = jd_backend_files_get_thread();
 	gboolean ret;
 
 	j_trace_file_begin(file->path, J_TRACE_FILE_DELETE);
 	ret = (g_unlink(file->path) == 0);
 	j_trace_file_end(file->path, J_TRACE_FILE_DELETE, 0, 0);
 
-	g_hash_table_remove(files, file->path);
+	/* Make sure that the deleted file is not returned by later opens. */
+	G_LOCK(jd_backend_file_cache);
+
+	if (g_hash_table_lookup(jd_backend_file_cache, file->path) == file)
+	{
+		g_hash_table_remove(jd_backend_file_cache, file->path);
+	}
+
+	G_UNLOCK(jd_backend_file_cache);
+
+	backend_file_unref(file);
 
 	return ret;
 }
@@ -241,12 +216,10 @@ gboolean
 backend_close (gpointer data)
 {
 	JBackendFile* file = data;
-	GHashTable* files = jd_backend_files_get_thread();
-	gboolean ret;
 
-	ret = g_hash_table_remove(files, file->path);
+	backend_file_unref(file);
 
-	return ret;
+	return TRUE;
 }
 
 static
@@ -373,6 +346,17 @@ backend_write (gpointer data, gconstpointer buffer, guint64 length, guint64 offs
 	return (nbytes_total == length);
 }
 
+static
+gboolean
+backend_get_fd (gpointer data, gint* fd)
+{
+	JBackendFile* file = data;
+
+	*fd = file->fd;
+
+	return (file->fd != -1);
+}
+
 static
 gboolean
 backend_init (gchar const* path)
@@ -409,7 +393,8 @@ JBackend posix_backend = {
 		.backend_status = backend_status,
 		.backend_sync = backend_sync,
 		.backend_read = backend_read,
-		.backend_write = backend_write
+		.backend_write = backend_write,
+		.backend_get_fd = backend_get_fd
 	}
 };
 
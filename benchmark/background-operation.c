@@ -21,6 +21,7 @@
 #include <glib.h>
 
 #include <julea.h>
+#include <julea-kv.h>
 
 #include <jbackground-operation.h>
 
@@ -69,8 +70,97 @@ benchmark_background_operation_new_ref_unref (BenchmarkResult* result)
 	result->operations = n;
 }
 
+/**
+ * Keeps a number of single-operation batches in flight using a completion queue.
+ * A new batch is executed whenever one has completed.
+ */
+static
+void
+_benchmark_background_operation_in_flight (BenchmarkResult* result, guint depth)
+{
+	guint const n = 20000;
+
+	g_autoptr(JBatch) delete_batch = NULL;
+	g_autoptr(JCompletionQueue) queue = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+	JBatch* batch;
+	gdouble elapsed;
+
+	semantics = j_benchmark_get_semantics();
+	delete_batch = j_batch_new(semantics);
+	queue = j_completion_queue_new();
+
+	j_benchmark_timer_start();
+
+	for (guint i = 0; i < n; i++)
+	{
+		g_autoptr(JKV) object = NULL;
+		g_autofree gchar* name = NULL;
+
+		if (i >= depth && (batch = j_completion_queue_wait(queue, NULL)) != NULL)
+		{
+			j_batch_unref(batch);
+		}
+
+		name = g_strdup_printf("benchmark-%d", i);
+		object = j_kv_new("benchmark", name);
+
+		batch = j_batch_new(semantics);
+		j_kv_put(object, g_strdup("empty"), 6, g_free, batch);
+		j_batch_execute_queued(batch, queue);
+		j_batch_unref(batch);
+
+		j_kv_delete(object, delete_batch);
+	}
+
+	while ((batch = j_completion_queue_wait(queue, NULL)) != NULL)
+	{
+		j_batch_unref(batch);
+	}
+
+	elapsed = j_benchmark_timer_elapsed();
+
+	j_batch_execute(delete_batch);
+
+	result->elapsed_time = elapsed;
+	result->operations = n;
+}
+
+static
+void
+benchmark_background_operation_in_flight_1 (BenchmarkResult* result)
+{
+	_benchmark_background_operation_in_flight(result, 1);
+}
+
+static
+void
+benchmark_background_operation_in_flight_16 (BenchmarkResult* result)
+{
+	_benchmark_background_operation_in_flight(result, 16);
+}
+
+static
+void
+benchmark_background_operation_in_flight_256 (BenchmarkResult* result)
+{
+	_benchmark_background_operation_in_flight(result, 256);
+}
+
+static
+void
+benchmark_background_operation_in_flight_4096 (BenchmarkResult* result)
+{
+	_benchmark_background_operation_in_flight(result, 4096);
+}
+
 void
 benchmark_background_operation (void)
 {
 	j_benchmark_run("/background-operation", benchmark_background_operation_new_ref_unref);
+
+	j_benchmark_run("/background-operation/in-flight/1", benchmark_background_operation_in_flight_1);
+	j_benchmark_run("/background-operation/in-flight/16", benchmark_background_operation_in_flight_16);
+	j_benchmark_run("/background-operation/in-flight/256", benchmark_background_operation_in_flight_256);
+	j_benchmark_run("/background-operation/in-flight/4096", benchmark_background_operation_in_flight_4096);
 }
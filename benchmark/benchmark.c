@@ -83,6 +83,7 @@ j_benchmark_run (gchar const* name, BenchmarkFunc benchmark_func)
 	result.elapsed_time = 0.0;
 	result.operations = 0;
 	result.bytes = 0;
+	result.messages = 0;
 
 	if (!opt_machine_readable)
 	{
@@ -115,6 +116,11 @@ j_benchmark_run (gchar const* name, BenchmarkFunc benchmark_func)
 			g_print(" (%s/s)", size);
 		}
 
+		if (result.messages != 0)
+		{
+			g_print(" (%" G_GUINT64_FORMAT " messages)", result.messages);
+		}
+
 		g_print(" [%.3f seconds]\n", elapsed);
 	}
 	else
@@ -196,6 +202,7 @@ main (int argc, char** argv)
 	benchmark_cache();
 	benchmark_memory_chunk();
 	benchmark_message();
+	benchmark_numa();
 
 	// KV client
 	benchmark_kv();
@@ -26,6 +26,11 @@ struct BenchmarkResult
 	gdouble elapsed_time;
 	guint64 operations;
 	guint64 bytes;
+
+	/**
+	 * The number of messages sent, only reported if set.
+	 **/
+	guint64 messages;
 };
 
 typedef struct BenchmarkResult BenchmarkResult;
@@ -45,6 +50,7 @@ void benchmark_background_operation (void);
 void benchmark_cache (void);
 void benchmark_memory_chunk (void);
 void benchmark_message (void);
+void benchmark_numa (void);
 
 void benchmark_kv (void);
 
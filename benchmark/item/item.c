@@ -25,6 +25,8 @@
 #include <julea.h>
 #include <julea-item.h>
 
+#include <jmessage-internal.h>
+
 #include "benchmark.h"
 
 static
@@ -488,6 +490,78 @@ benchmark_item_unordered_create_delete_batch (BenchmarkResult* result)
 	_benchmark_item_unordered_create_delete(result, TRUE);
 }
 
+/**
+ * Creates items and writes to them in one batch, alternating between creates and writes.
+ * Under relaxed ordering, the items' metadata and objects are created using one message each, see J_SEMANTICS_ORDERING.
+ */
+static
+void
+_benchmark_item_interleaved_create_write (BenchmarkResult* result, JSemanticsOrdering ordering)
+{
+	guint const n = 5000;
+
+	g_autoptr(JCollection) collection = NULL;
+	g_autoptr(JBatch) batch = NULL;
+	g_autoptr(JBatch) delete_batch = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+	gchar dummy[1] = { 0 };
+	gdouble elapsed;
+	guint64 messages;
+	guint64 nb = 0;
+
+	semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+	j_semantics_set(semantics, J_SEMANTICS_ORDERING, ordering);
+
+	batch = j_batch_new(semantics);
+	delete_batch = j_batch_new(semantics);
+
+	collection = j_collection_create("benchmark", batch);
+	j_batch_execute(batch);
+
+	for (guint i = 0; i < n; i++)
+	{
+		g_autoptr(JItem) item = NULL;
+		g_autofree gchar* name = NULL;
+
+		name = g_strdup_printf("benchmark-%d", i);
+		item = j_item_create(collection, name, NULL, batch);
+		j_item_write(item, dummy, sizeof(dummy), 0, &nb, batch);
+
+		j_item_delete(item, delete_batch);
+	}
+
+	messages = j_message_get_sent_count();
+	j_benchmark_timer_start();
+
+	j_batch_execute(batch);
+
+	elapsed = j_benchmark_timer_elapsed();
+	messages = j_message_get_sent_count() - messages;
+
+	g_assert_cmpuint(nb, ==, n * sizeof(dummy));
+
+	j_collection_delete(collection, delete_batch);
+	j_batch_execute(delete_batch);
+
+	result->elapsed_time = elapsed;
+	result->operations = n * 2;
+	result->messages = messages;
+}
+
+static
+void
+benchmark_item_interleaved_create_write (BenchmarkResult* result)
+{
+	_benchmark_item_interleaved_create_write(result, J_SEMANTICS_ORDERING_STRICT);
+}
+
+static
+void
+benchmark_item_interleaved_create_write_relaxed (BenchmarkResult* result)
+{
+	_benchmark_item_interleaved_create_write(result, J_SEMANTICS_ORDERING_RELAXED);
+}
+
 void
 benchmark_item (void)
 {
@@ -506,4 +580,7 @@ benchmark_item (void)
 
 	j_benchmark_run("/item/item/unordered-create-delete", benchmark_item_unordered_create_delete);
 	j_benchmark_run("/item/item/unordered-create-delete-batch", benchmark_item_unordered_create_delete_batch);
+
+	j_benchmark_run("/item/item/interleaved-create-write", benchmark_item_interleaved_create_write);
+	j_benchmark_run("/item/item/interleaved-create-write-relaxed", benchmark_item_interleaved_create_write_relaxed);
 }
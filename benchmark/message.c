@@ -19,6 +19,10 @@
 #include <julea-config.h>
 
 #include <glib.h>
+#include <gio/gio.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <julea.h>
 
@@ -26,6 +30,10 @@
 
 #include "benchmark.h"
 
+/**
+ * Creates and frees messages, as done for every batch of small operations.
+ * Message buffers are recycled, so the allocator should not be involved after the first iteration.
+ */
 static
 void
 _benchmark_message_new (BenchmarkResult* result, gboolean append)
@@ -119,6 +127,89 @@ benchmark_message_add_operation_large (BenchmarkResult* result)
 	_benchmark_message_add_operation(result, TRUE);
 }
 
+static
+gpointer
+benchmark_message_drain (gpointer data)
+{
+	gint fd = GPOINTER_TO_INT(data);
+	gchar buffer[64 * 1024];
+
+	while (read(fd, buffer, sizeof(buffer)) > 0)
+	{
+	}
+
+	return NULL;
+}
+
+/**
+ * Sends messages consisting of many small buffers, as created by batches of small writes.
+ * All buffers of a message are written using few system calls, which can be verified using strace -c.
+ */
+static
+void
+_benchmark_message_send (BenchmarkResult* result, guint m)
+{
+	guint const n = 10000;
+	guint64 const dummy = 42;
+
+	g_autoptr(GSocket) socket = NULL;
+	g_autoptr(GSocketConnection) connection = NULL;
+	GThread* thread;
+	gdouble elapsed;
+	gint fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+		return;
+	}
+
+	socket = g_socket_new_from_fd(fds[0], NULL);
+	connection = g_socket_connection_factory_create_connection(socket);
+	thread = g_thread_new("benchmark-message", benchmark_message_drain, GINT_TO_POINTER(fds[1]));
+
+	j_benchmark_timer_start();
+
+	for (guint i = 0; i < n; i++)
+	{
+		g_autoptr(JMessage) message = NULL;
+
+		message = j_message_new(J_MESSAGE_NONE, 0);
+
+		for (guint j = 0; j < m; j++)
+		{
+			j_message_add_operation(message, sizeof(guint64));
+			j_message_append_8(message, &dummy);
+			j_message_add_send(message, &dummy, sizeof(dummy));
+		}
+
+		j_message_send(message, connection);
+	}
+
+	elapsed = j_benchmark_timer_elapsed();
+
+	g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
+	g_thread_join(thread);
+	close(fds[1]);
+
+	result->elapsed_time = elapsed;
+	result->operations = n;
+	result->bytes = (guint64)n * m * 2 * sizeof(dummy);
+}
+
+static
+void
+benchmark_message_send_small (BenchmarkResult* result)
+{
+	_benchmark_message_send(result, 10);
+}
+
+static
+void
+benchmark_message_send_large (BenchmarkResult* result)
+{
+	_benchmark_message_send(result, 1000);
+}
+
 void
 benchmark_message (void)
 {
@@ -126,4 +217,6 @@ benchmark_message (void)
 	j_benchmark_run("/message/new-append", benchmark_message_new_append);
 	j_benchmark_run("/message/add-operation-small", benchmark_message_add_operation_small);
 	j_benchmark_run("/message/add-operation-large", benchmark_message_add_operation_large);
+	j_benchmark_run("/message/send-small", benchmark_message_send_small);
+	j_benchmark_run("/message/send-large", benchmark_message_send_large);
 }
@@ -0,0 +1,118 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <string.h>
+
+#include <julea.h>
+
+#include "benchmark.h"
+
+struct BenchmarkNumaData
+{
+	BenchmarkResult* result;
+	guint node;
+};
+
+typedef struct BenchmarkNumaData BenchmarkNumaData;
+
+/**
+ * Copies a buffer placed on a NUMA node into a buffer on node 0, with the copying thread bound to node 0.
+ * This corresponds to the server sending data from a memory chunk that was first touched on another node.
+ * A separate thread is used, so that the binding does not affect the following benchmarks.
+ */
+static
+gpointer
+benchmark_numa_copy_thread (gpointer data)
+{
+	BenchmarkNumaData* numa_data = data;
+
+	guint const n = 200;
+	gsize const size = 8 * 1024 * 1024;
+
+	g_autofree gchar* source = NULL;
+	g_autofree gchar* destination = NULL;
+	gdouble elapsed;
+
+	/* Memory is placed on the node of the thread touching it first. */
+	j_helper_numa_bind(numa_data->node);
+	source = g_malloc(size);
+	memset(source, 1, size);
+
+	j_helper_numa_bind(0);
+	destination = g_malloc(size);
+	memset(destination, 0, size);
+
+	j_benchmark_timer_start();
+
+	for (guint i = 0; i < n; i++)
+	{
+		memcpy(destination, source, size);
+	}
+
+	elapsed = j_benchmark_timer_elapsed();
+
+	numa_data->result->elapsed_time = elapsed;
+	numa_data->result->operations = n;
+	numa_data->result->bytes = n * size;
+
+	return NULL;
+}
+
+static
+void
+_benchmark_numa_copy (BenchmarkResult* result, guint node)
+{
+	BenchmarkNumaData numa_data;
+	GThread* thread;
+
+	numa_data.result = result;
+	numa_data.node = node;
+
+	thread = g_thread_new("benchmark-numa", benchmark_numa_copy_thread, &numa_data);
+	g_thread_join(thread);
+}
+
+static
+void
+benchmark_numa_local (BenchmarkResult* result)
+{
+	_benchmark_numa_copy(result, 0);
+}
+
+static
+void
+benchmark_numa_remote (BenchmarkResult* result)
+{
+	_benchmark_numa_copy(result, 1);
+}
+
+void
+benchmark_numa (void)
+{
+	j_benchmark_run("/numa/local", benchmark_numa_local);
+
+	/* The remote benchmark only differs from the local one if there are multiple nodes. */
+	if (j_helper_numa_get_node_count() > 1)
+	{
+		j_benchmark_run("/numa/remote", benchmark_numa_remote);
+	}
+}
@@ -25,6 +25,8 @@
 #include <julea.h>
 #include <julea-object.h>
 
+#include <jmessage-internal.h>
+
 #include "benchmark.h"
 
 static
@@ -423,6 +425,74 @@ benchmark_object_unordered_create_delete_batch (BenchmarkResult* result)
 	_benchmark_object_unordered_create_delete(result, TRUE);
 }
 
+/**
+ * Creates objects and writes to them in one batch, alternating between creates and writes.
+ * Under relaxed ordering, the creates are combined into one message, see J_SEMANTICS_ORDERING.
+ */
+static
+void
+_benchmark_object_interleaved_create_write (BenchmarkResult* result, JSemanticsOrdering ordering)
+{
+	guint const n = 10000;
+
+	g_autoptr(JBatch) batch = NULL;
+	g_autoptr(JBatch) delete_batch = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+	gchar dummy[1] = { 0 };
+	gdouble elapsed;
+	guint64 messages;
+	guint64 nb = 0;
+
+	semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+	j_semantics_set(semantics, J_SEMANTICS_ORDERING, ordering);
+
+	batch = j_batch_new(semantics);
+	delete_batch = j_batch_new(semantics);
+
+	for (guint i = 0; i < n; i++)
+	{
+		g_autoptr(JObject) object = NULL;
+		g_autofree gchar* name = NULL;
+
+		name = g_strdup_printf("benchmark-%d", i);
+		object = j_object_new("benchmark", name);
+		j_object_create(object, batch);
+		j_object_write(object, dummy, sizeof(dummy), 0, &nb, batch);
+
+		j_object_delete(object, delete_batch);
+	}
+
+	messages = j_message_get_sent_count();
+	j_benchmark_timer_start();
+
+	j_batch_execute(batch);
+
+	elapsed = j_benchmark_timer_elapsed();
+	messages = j_message_get_sent_count() - messages;
+
+	g_assert_cmpuint(nb, ==, n * sizeof(dummy));
+
+	j_batch_execute(delete_batch);
+
+	result->elapsed_time = elapsed;
+	result->operations = n * 2;
+	result->messages = messages;
+}
+
+static
+void
+benchmark_object_interleaved_create_write (BenchmarkResult* result)
+{
+	_benchmark_object_interleaved_create_write(result, J_SEMANTICS_ORDERING_STRICT);
+}
+
+static
+void
+benchmark_object_interleaved_create_write_relaxed (BenchmarkResult* result)
+{
+	_benchmark_object_interleaved_create_write(result, J_SEMANTICS_ORDERING_RELAXED);
+}
+
 void
 benchmark_object (void)
 {
@@ -440,4 +510,7 @@ benchmark_object (void)
 
 	j_benchmark_run("/object/object/unordered-create-delete", benchmark_object_unordered_create_delete);
 	j_benchmark_run("/object/object/unordered-create-delete-batch", benchmark_object_unordered_create_delete_batch);
+
+	j_benchmark_run("/object/object/interleaved-create-write", benchmark_object_interleaved_create_write);
+	j_benchmark_run("/object/object/interleaved-create-write-relaxed", benchmark_object_interleaved_create_write_relaxed);
 }
@@ -141,6 +141,9 @@ struct JBackend
 
 			gboolean (*backend_read) (gpointer, gpointer, guint64, guint64, guint64*);
 			gboolean (*backend_write) (gpointer, gconstpointer, guint64, guint64, guint64*);
+
+			/* Optional, allows the server to transfer data without copying it through user space. */
+			gboolean (*backend_get_fd) (gpointer, gint*);
 		}
 		object;
 
@@ -395,6 +398,8 @@ gboolean j_backend_object_sync (JBackend*, gpointer);
 gboolean j_backend_object_read (JBackend*, gpointer, gpointer, guint64, guint64, guint64*);
 gboolean j_backend_object_write (JBackend*, gpointer, gconstpointer, guint64, guint64, guint64*);
 
+gboolean j_backend_object_get_fd (JBackend*, gpointer, gint*);
+
 gboolean j_backend_kv_init (JBackend*, gchar const*);
 void j_backend_kv_fini (JBackend*);
 
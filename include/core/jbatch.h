@@ -35,6 +35,10 @@ struct JBatch;
 
 typedef struct JBatch JBatch;
 
+struct JCompletionQueue;
+
+typedef struct JCompletionQueue JCompletionQueue;
+
 typedef void (*JOperationCompletedFunc) (JBatch*, gboolean, gpointer);
 
 G_END_DECLS
@@ -58,8 +62,19 @@ void j_batch_add (JBatch*, JOperation*);
 gboolean j_batch_execute (JBatch*);
 
 void j_batch_execute_async (JBatch*, JOperationCompletedFunc, gpointer);
+void j_batch_execute_queued (JBatch*, JCompletionQueue*);
+gboolean j_batch_is_completed (JBatch*);
 void j_batch_wait (JBatch*);
 
+JCompletionQueue* j_completion_queue_new (void);
+JCompletionQueue* j_completion_queue_ref (JCompletionQueue*);
+void j_completion_queue_unref (JCompletionQueue*);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(JCompletionQueue, j_completion_queue_unref)
+
+JBatch* j_completion_queue_poll (JCompletionQueue*, gboolean*);
+JBatch* j_completion_queue_wait (JCompletionQueue*, gboolean*);
+
 G_END_DECLS
 
 #endif
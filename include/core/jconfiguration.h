@@ -52,9 +52,22 @@ gchar const* j_configuration_get_backend (JConfiguration*, JBackendType);
 gchar const* j_configuration_get_backend_component (JConfiguration*, JBackendType);
 gchar const* j_configuration_get_backend_path (JConfiguration*, JBackendType);
 
+guint16 j_configuration_get_port (JConfiguration*);
 guint64 j_configuration_get_max_operation_size (JConfiguration*);
 guint32 j_configuration_get_max_connections (JConfiguration*);
+guint32 j_configuration_get_warm_up (JConfiguration*);
+gboolean j_configuration_get_multiplex (JConfiguration*);
 guint64 j_configuration_get_stripe_size (JConfiguration*);
+guint32 j_configuration_get_server_threads (JConfiguration*);
+gboolean j_configuration_get_splice_writes (JConfiguration*);
+gboolean j_configuration_get_io_uring (JConfiguration*);
+guint32 j_configuration_get_object_cache_size (JConfiguration*);
+guint32 j_configuration_get_group_commit_window (JConfiguration*);
+guint32 j_configuration_get_metadata_share (JConfiguration*);
+guint32 j_configuration_get_numa_node_count (JConfiguration*);
+guint32 j_configuration_get_numa_node (JConfiguration*, guint32);
+gchar const* j_configuration_get_compression (JConfiguration*);
+guint32 j_configuration_get_compression_threshold (JConfiguration*);
 
 G_END_DECLS
 
@@ -33,8 +33,6 @@
 G_BEGIN_DECLS
 
 G_GNUC_INTERNAL void j_helper_get_number_string (gchar*, guint32, guint32);
-// FIXME get rid of GSocketConnection
-G_GNUC_INTERNAL void j_helper_set_cork (GSocketConnection*, gboolean);
 
 G_END_DECLS
 
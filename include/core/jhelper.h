@@ -37,10 +37,15 @@ G_BEGIN_DECLS
 guint64 j_helper_atomic_add (guint64 volatile*, guint64);
 gboolean j_helper_execute_parallel (JBackgroundOperationFunc, gpointer*, guint);
 guint32 j_helper_hash (gchar const*);
+gconstpointer j_helper_get_namespace_key (gchar const*, guint32);
 // FIXME get rid of GSocketConnection
 void j_helper_set_nodelay (GSocketConnection*, gboolean);
+GSocketAddress* j_helper_get_local_address (guint16);
 gchar* j_helper_str_replace (gchar const*, gchar const*, gchar const*);
 
+guint j_helper_numa_get_node_count (void);
+gboolean j_helper_numa_bind (guint);
+
 G_END_DECLS
 
 #endif
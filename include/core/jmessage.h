@@ -53,15 +53,116 @@ enum JMessageType
 	J_MESSAGE_DB_INSERT,
 	J_MESSAGE_DB_UPDATE,
 	J_MESSAGE_DB_DELETE,
-	J_MESSAGE_DB_QUERY
+	J_MESSAGE_DB_QUERY,
+	_J_MESSAGE_TYPE_COUNT
 };
 
 typedef enum JMessageType JMessageType;
 
+enum JMessageCompression
+{
+	J_MESSAGE_COMPRESSION_NONE,
+	J_MESSAGE_COMPRESSION_LZ4,
+	J_MESSAGE_COMPRESSION_ZSTD
+};
+
+typedef enum JMessageCompression JMessageCompression;
+
 struct JMessage;
 
 typedef struct JMessage JMessage;
 
+struct JMessageReader;
+
+typedef struct JMessageReader JMessageReader;
+
+/**
+ * Handles a reply to a message sent with j_message_send_async().
+ * Called by the engine thread, so it must not block.
+ * Buffers added to the reply with j_message_add_receive() are filled with the data following it.
+ * Returns TRUE if the reply is the last one.
+ **/
+typedef gboolean (*JMessageReplyFunc) (JMessage*, gpointer);
+
+/**
+ * Called once a message sent with j_message_send_async() has been handled, with FALSE if the connection has failed.
+ **/
+typedef void (*JMessageDoneFunc) (gboolean, gpointer);
+
+/**
+ * Operation layouts.
+ * A layout lists the fixed-size fields of a message type's operations as F(type, name, bits), in the order they are sent.
+ **/
+#define J_MESSAGE_LAYOUT_OBJECT_READ(F) \
+	F(guint64, length, 64) \
+	F(guint64, offset, 64)
+
+#define J_MESSAGE_LAYOUT_OBJECT_READ_REPLY(F) \
+	F(guint64, bytes_read, 64)
+
+#define J_MESSAGE_LAYOUT_OBJECT_WRITE(F) \
+	F(guint64, length, 64) \
+	F(guint64, offset, 64)
+
+#define J_MESSAGE_LAYOUT_OBJECT_WRITE_REPLY(F) \
+	F(guint64, bytes_written, 64)
+
+#define J_MESSAGE_LAYOUT_OBJECT_STATUS_REPLY(F) \
+	F(gint64, modification_time, 64) \
+	F(guint64, size, 64)
+
+/**
+ * Key-value operations start with the key, values are preceded by their length.
+ **/
+#define J_MESSAGE_LAYOUT_KV_PUT(F) \
+	F(guint32, length, 32)
+
+#define J_MESSAGE_LAYOUT_KV_GET_REPLY(F) \
+	F(guint32, length, 32)
+
+/**
+ * Database operations consist of parameters, each one is preceded by its length, see j_backend_operation_to_message().
+ **/
+#define J_MESSAGE_LAYOUT_DB_PARAM(F) \
+	F(guint32, length, 32)
+
+/**
+ * All layouts as L(TypeName, function_name, LAYOUT).
+ * For each layout, a struct JMessage<TypeName> as well as j_message_append_<function_name>(), j_message_get_<function_name>() and j_message_next_<function_name>() are generated.
+ *
+ * Layouts only describe fixed-size fields.
+ * Strings are deliberately not part of them: they are of variable length and may be interned, so they have to be handled with j_message_append_string(), j_message_append_namespace() and j_message_get_string().
+ **/
+#define J_MESSAGE_LAYOUTS(L) \
+	L(ObjectRead, object_read, J_MESSAGE_LAYOUT_OBJECT_READ) \
+	L(ObjectReadReply, object_read_reply, J_MESSAGE_LAYOUT_OBJECT_READ_REPLY) \
+	L(ObjectWrite, object_write, J_MESSAGE_LAYOUT_OBJECT_WRITE) \
+	L(ObjectWriteReply, object_write_reply, J_MESSAGE_LAYOUT_OBJECT_WRITE_REPLY) \
+	L(ObjectStatusReply, object_status_reply, J_MESSAGE_LAYOUT_OBJECT_STATUS_REPLY) \
+	L(KVPut, kv_put, J_MESSAGE_LAYOUT_KV_PUT) \
+	L(KVGetReply, kv_get_reply, J_MESSAGE_LAYOUT_KV_GET_REPLY) \
+	L(DBParam, db_param, J_MESSAGE_LAYOUT_DB_PARAM)
+
+#define J_MESSAGE_LAYOUT_FIELD(type, name, bits) type name;
+#define J_MESSAGE_LAYOUT_FIELD_SIZE(type, name, bits) + (bits / 8)
+
+/**
+ * The number of bytes one operation of a layout occupies in a message.
+ **/
+#define J_MESSAGE_LAYOUT_SIZE(LAYOUT) (0 LAYOUT(J_MESSAGE_LAYOUT_FIELD_SIZE))
+
+#define J_MESSAGE_DECLARE_LAYOUT(TypeName, function_name, LAYOUT) \
+	struct JMessage##TypeName \
+	{ \
+		LAYOUT(J_MESSAGE_LAYOUT_FIELD) \
+	}; \
+	\
+	typedef struct JMessage##TypeName JMessage##TypeName; \
+	\
+	gboolean j_message_append_##function_name (JMessage*, JMessage##TypeName const*); \
+	gboolean j_message_get_##function_name (JMessage*, guint32, JMessage##TypeName**); \
+	gboolean j_message_next_##function_name (JMessage*, JMessage##TypeName*);
+
 G_END_DECLS
 
 #include <core/jsemantics.h>
@@ -83,6 +184,7 @@ gboolean j_message_append_4 (JMessage*, gconstpointer);
 gboolean j_message_append_8 (JMessage*, gconstpointer);
 gboolean j_message_append_n (JMessage*, gconstpointer, gsize);
 gboolean j_message_append_string (JMessage*, gchar const*);
+gboolean j_message_append_namespace (JMessage*, gchar const*);
 
 gchar j_message_get_1 (JMessage*);
 gint32 j_message_get_4 (JMessage*);
@@ -90,13 +192,39 @@ gint64 j_message_get_8 (JMessage*);
 gpointer j_message_get_n (JMessage*, gsize);
 gchar const* j_message_get_string (JMessage*);
 
+gboolean j_message_can_get (JMessage const*, gsize);
+
+J_MESSAGE_LAYOUTS(J_MESSAGE_DECLARE_LAYOUT)
+gpointer j_message_get_shared (JMessage*, guint64);
+
 gboolean j_message_send (JMessage*, gpointer);
 gboolean j_message_receive (JMessage*, gpointer);
+gboolean j_message_receive_data (JMessage*, gpointer);
+void j_message_send_async (JMessage*, gpointer, JMessageReplyFunc, JMessageDoneFunc, gpointer);
+
+JMessageReader* j_message_reader_new (gpointer);
+void j_message_reader_free (JMessageReader*);
+gboolean j_message_reader_read (JMessageReader*, JMessage**);
+gboolean j_message_reader_feed (JMessageReader*, gconstpointer, gsize, gsize*, JMessage**);
+
+void j_message_enable_interning (gpointer);
+
+JMessageCompression j_message_compression_from_string (gchar const*);
+void j_message_enable_compression (gpointer, JMessageCompression, guint32);
+void j_message_get_compression_statistics (guint64*, guint64*);
+
+void j_message_offer_shared_memory (gpointer, gsize);
+gboolean j_message_accept_shared_memory (gpointer, gsize);
+void j_message_enable_shared_memory (gpointer);
+
+void j_message_enable_engine (gpointer);
 
 gboolean j_message_read (JMessage*, GInputStream*);
 gboolean j_message_write (JMessage*, GOutputStream*);
 
 void j_message_add_send (JMessage*, gconstpointer, guint64);
+void j_message_add_send_fd (JMessage*, gint, guint64, guint64);
+void j_message_add_receive (JMessage*, gpointer, guint64);
 void j_message_add_operation (JMessage*, gsize);
 
 void j_message_set_semantics (JMessage*, JSemantics*);
@@ -37,15 +37,45 @@ G_BEGIN_DECLS
 typedef gboolean (*JOperationExecFunc) (JList*, JSemantics*);
 typedef void (*JOperationFreeFunc) (gpointer);
 
+/**
+ * Called once asynchronously executed operations are done, with their result.
+ **/
+typedef void (*JOperationDoneFunc) (gboolean, gpointer);
+
+/**
+ * Starts executing operations and returns without waiting for them.
+ * The done function is called exactly once, possibly before returning or from the client I/O engine's thread, see j_message_send_async().
+ * The operations and their buffers have to stay valid until then.
+ **/
+typedef void (*JOperationExecAsyncFunc) (JList*, JSemantics*, JOperationDoneFunc, gpointer);
+
 /**
  * An operation.
  **/
 struct JOperation
 {
-	gpointer key;
+	/**
+	 * Operations with the same key and exec function are executed together.
+	 * Operations on different objects may share a key if their exec function handles them in one go, for instance, if they belong to the same namespace.
+	 **/
+	gconstpointer key;
 	gpointer data;
 
+	/**
+	 * The resource the operation accesses, if known, usually the object's namespace followed by its name.
+	 * Used to keep dependent operations in order when reordering, see J_SEMANTICS_ORDERING.
+	 * Resources are treated as paths, an operation on "a/b" depends on operations on "a".
+	 **/
+	gchar const* resource;
+
 	JOperationExecFunc exec_func;
+
+	/**
+	 * Executes the operations without blocking, may be NULL.
+	 * Used instead of #exec_func when executing batches, so that the calling thread does not have to wait for each group of operations.
+	 **/
+	JOperationExecAsyncFunc exec_async_func;
+
 	JOperationFreeFunc free_func;
 };
 
@@ -53,6 +83,8 @@ typedef struct JOperation JOperation;
 
 JOperation* j_operation_new (void);
 
+gboolean j_operation_wait (JOperationExecAsyncFunc, JList*, JSemantics*);
+
 G_END_DECLS
 
 #endif
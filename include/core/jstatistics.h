@@ -40,7 +40,9 @@ enum JStatisticsType
 	J_STATISTICS_BYTES_READ,
 	J_STATISTICS_BYTES_WRITTEN,
 	J_STATISTICS_BYTES_RECEIVED,
-	J_STATISTICS_BYTES_SENT
+	J_STATISTICS_BYTES_SENT,
+	J_STATISTICS_BYTES_UNCOMPRESSED,
+	J_STATISTICS_BYTES_COMPRESSED
 };
 
 typedef enum JStatisticsType JStatisticsType;
@@ -196,8 +196,11 @@ j_backend_operation_to_message (JMessage* message, JBackendOperationParam* data,
 	j_message_add_operation(message, len);
 	for (i = 0; i < arrlen; i++)
 	{
+		JMessageDBParam param;
+
 		element = &data[i];
-		j_message_append_4(message, &element->len);
+		param.length = element->len;
+		j_message_append_db_param(message, &param);
 		if (element->len)
 		{
 			switch (element->type)
@@ -269,7 +272,15 @@ j_backend_operation_from_message (JMessage* message, JBackendOperationParam* dat
 
 	for (i = 0; i < arrlen; i++)
 	{
-		len = j_message_get_4(message);
+		JMessageDBParam param;
+
+		if (!j_message_next_db_param(message, &param) || !j_message_can_get(message, param.length))
+		{
+			ret = FALSE;
+			break;
+		}
+
+		len = param.length;
 		element = &data[i];
 		element->len = len;
 		if (len)
@@ -332,6 +343,7 @@ j_backend_operation_from_message (JMessage* message, JBackendOperationParam* dat
 /*
  * this function is called server side. This assumes 'message' is valid as long as the returned array is used
  * the return value of this function is the same as the return value of the original function call
+ * FALSE is also returned if the message is truncated or malformed, the parameters must not be used then
  */
 gboolean
 j_backend_operation_from_message_static (JMessage* message, JBackendOperationParam* data, guint arrlen)
@@ -347,17 +359,32 @@ j_backend_operation_from_message_static (JMessage* message, JBackendOperationPar
 
 	for (i = 0; i < arrlen; i++)
 	{
-		len = j_message_get_4(message);
+		JMessageDBParam param;
+
 		element = &data[i];
 		element->ptr = NULL;
+
+		if (!j_message_next_db_param(message, &param) || !j_message_can_get(message, param.length))
+		{
+			return FALSE;
+		}
+
+		len = param.length;
 		element->len = len;
 		if (len)
 		{
 			switch (element->type)
 			{
 			case J_BACKEND_OPERATION_PARAM_TYPE_BLOB:
+				element->ptr = j_message_get_n(message, len);
+				break;
 			case J_BACKEND_OPERATION_PARAM_TYPE_STR:
 				element->ptr = j_message_get_n(message, len);
+				/* Strings are passed to the backend as is, so they have to be terminated. */
+				if (((gchar const*)element->ptr)[len - 1] != '\0')
+				{
+					return FALSE;
+				}
 				break;
 			case J_BACKEND_OPERATION_PARAM_TYPE_BSON:
 				element->ptr = &element->bson;
@@ -443,6 +443,31 @@ j_backend_object_write (JBackend* backend, gpointer data, gconstpointer buffer,
 	return ret;
 }
 
+gboolean
+j_backend_object_get_fd (JBackend* backend, gpointer data, gint* fd)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gboolean ret;
+
+	g_return_val_if_fail(backend != NULL, FALSE);
+	g_return_val_if_fail(backend->type == J_BACKEND_TYPE_OBJECT, FALSE);
+	g_return_val_if_fail(data != NULL, FALSE);
+	g_return_val_if_fail(fd != NULL, FALSE);
+
+	if (backend->object.backend_get_fd == NULL)
+	{
+		return FALSE;
+	}
+
+	{
+		J_TRACE("backend_get_fd", "%p, %p", data, (gpointer)fd);
+		ret = backend->object.backend_get_fd(data, fd);
+	}
+
+	return ret;
+}
+
 gboolean
 j_backend_kv_init (JBackend* backend, gchar const* path)
 {
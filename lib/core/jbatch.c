@@ -24,10 +24,11 @@
 
 #include <glib.h>
 
+#include <string.h>
+
 #include <jbatch.h>
 #include <jbatch-internal.h>
 
-#include <jbackground-operation.h>
 #include <jcache.h>
 #include <jcommon.h>
 #include <jlist.h>
@@ -59,9 +60,21 @@ struct JBatch
 	JSemantics* semantics;
 
 	/**
-	 * The background operation used for j_batch_execute_async().
+	 * Protects #running, #completed and #result, which are used by j_batch_execute_async() and j_batch_execute_queued().
+	 **/
+	GMutex mutex[1];
+	GCond cond[1];
+
+	/**
+	 * Whether the batch is being executed in the background.
 	 **/
-	JBackgroundOperation* background_operation;
+	gboolean running;
+
+	/**
+	 * Whether the batch has been executed in the background and its result.
+	 **/
+	gboolean completed;
+	gboolean result;
 
 	/**
 	 * The reference count.
@@ -69,37 +82,34 @@ struct JBatch
 	gint ref_count;
 };
 
-struct JOperationAsync
-{
-	JBatch* batch;
-	JOperationCompletedFunc func;
-	gpointer user_data;
-};
-
-typedef struct JOperationAsync JOperationAsync;
-
-static
-gpointer
-j_batch_background_operation (gpointer data)
+/**
+ * A completion queue.
+ * Batches executed using j_batch_execute_queued() are added to their completion queue once they have been executed.
+ * Batches do not reference their completion queue, only their execution does until it is done.
+ **/
+struct JCompletionQueue
 {
-	J_TRACE_FUNCTION(NULL);
-
-	JOperationAsync* async = data;
-	gboolean ret;
+	GMutex mutex[1];
+	GCond cond[1];
 
-	ret = j_batch_execute(async->batch);
-
-	if (async->func != NULL)
-	{
-		(*async->func)(async->batch, ret, async->user_data);
-	}
+	/**
+	 * The executed batches that have not been returned yet.
+	 **/
+	GQueue completed[1];
 
-	j_batch_unref(async->batch);
+	/**
+	 * The number of batches that have not been executed yet.
+	 **/
+	guint pending;
 
-	g_slice_free(JOperationAsync, async);
+	/**
+	 * The reference count.
+	 **/
+	gint ref_count;
+};
 
-	return NULL;
-}
+static void j_batch_execute_background (JBatch*, JOperationCompletedFunc, gpointer, JCompletionQueue*);
+static void j_batch_thread (gpointer, gpointer);
 
 /**
  * Creates a new batch.
@@ -123,7 +133,11 @@ j_batch_new (JSemantics* semantics)
 	batch = g_slice_new(JBatch);
 	batch->list = j_list_new((JListFreeFunc)j_operation_free);
 	batch->semantics = j_semantics_ref(semantics);
-	batch->background_operation = NULL;
+	g_mutex_init(batch->mutex);
+	g_cond_init(batch->cond);
+	batch->running = FALSE;
+	batch->completed = FALSE;
+	batch->result = FALSE;
 	batch->ref_count = 1;
 
 	return batch;
@@ -193,11 +207,6 @@ j_batch_unref (JBatch* batch)
 
 	if (g_atomic_int_dec_and_test(&(batch->ref_count)))
 	{
-		if (batch->background_operation != NULL)
-		{
-			j_background_operation_unref(batch->background_operation);
-		}
-
 		if (batch->semantics != NULL)
 		{
 			j_semantics_unref(batch->semantics);
@@ -205,59 +214,118 @@ j_batch_unref (JBatch* batch)
 
 		j_list_unref(batch->list);
 
+		g_mutex_clear(batch->mutex);
+		g_cond_clear(batch->cond);
+
 		g_slice_free(JBatch, batch);
 	}
 }
 
 /**
- * Executes the batch parts of a given batch type.
- *
- * \private
+ * Executes the batch.
  *
  * \code
  * \endcode
  *
- * \param type An operation type.
- * \param list A list of batch parts.
+ * \param batch A batch.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
  **/
-static
 gboolean
-j_batch_execute_same (JBatch* batch, JOperationExecFunc exec_func, JList* list)
+j_batch_execute (JBatch* batch)
 {
 	J_TRACE_FUNCTION(NULL);
 
-	JOperation* operation;
-	gboolean ret = FALSE;
+	gboolean ret;
 
-	operation = j_list_get_first(list);
+	g_return_val_if_fail(batch != NULL, FALSE);
 
-	if (operation == NULL)
+	if (j_list_length(batch->list) == 0)
 	{
 		return FALSE;
 	}
 
-	if (exec_func != NULL)
+	if (j_semantics_get(batch->semantics, J_SEMANTICS_PERSISTENCY) == J_SEMANTICS_PERSISTENCY_EVENTUAL
+	    && j_operation_cache_add(batch))
 	{
-		ret = exec_func(list, batch->semantics);
+		return TRUE;
 	}
 
-	j_list_delete_all(list);
+	j_operation_cache_flush();
+
+	ret = j_batch_execute_internal(batch);
+	j_list_delete_all(batch->list);
 
 	return ret;
 }
 
 /**
- * Executes the batch.
+ * Executes the batch asynchronously.
+ * The batch is executed like one executed using j_batch_execute_queued(), #func is called once it has been executed.
+ *
+ * \code
+ * \endcode
+ *
+ * \param batch     A batch.
+ * \param func      A complete function, may be NULL.
+ * \param user_data Data to pass to #func.
+ **/
+void
+j_batch_execute_async (JBatch* batch, JOperationCompletedFunc func, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(batch != NULL);
+
+	j_batch_execute_background(batch, func, user_data, NULL);
+}
+
+/**
+ * Executes the batch asynchronously and adds it to a completion queue once it has been executed.
+ * Operations that support it are executed without blocking a thread, their replies are handled by the client I/O engine, see j_message_send_async().
+ * Therefore, the number of batches in flight is not limited by the number of threads.
+ * Other operations are executed by a fixed number of threads.
+ *
+ * \code
+ * g_autoptr(JCompletionQueue) queue = NULL;
+ * JBatch* completed;
+ * gboolean ret;
+ *
+ * queue = j_completion_queue_new();
+ * j_batch_execute_queued(batch, queue);
+ *
+ * while ((completed = j_completion_queue_wait(queue, &ret)) != NULL)
+ * {
+ *   j_batch_unref(completed);
+ * }
+ * \endcode
+ *
+ * \param batch A batch.
+ * \param queue A completion queue.
+ **/
+void
+j_batch_execute_queued (JBatch* batch, JCompletionQueue* queue)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(batch != NULL);
+	g_return_if_fail(queue != NULL);
+
+	j_batch_execute_background(batch, NULL, NULL, queue);
+}
+
+/**
+ * Returns whether a batch executed using j_batch_execute_async() or j_batch_execute_queued() has been executed.
  *
  * \code
  * \endcode
  *
  * \param batch A batch.
  *
- * \return TRUE on success, FALSE if an error occurred.
+ * \return TRUE if the batch has been executed, FALSE otherwise.
  **/
 gboolean
-j_batch_execute (JBatch* batch)
+j_batch_is_completed (JBatch* batch)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -265,67 +333,184 @@ j_batch_execute (JBatch* batch)
 
 	g_return_val_if_fail(batch != NULL, FALSE);
 
-	if (j_list_length(batch->list) == 0)
+	g_mutex_lock(batch->mutex);
+	ret = batch->completed;
+	g_mutex_unlock(batch->mutex);
+
+	return ret;
+}
+
+/**
+ * Waits until a batch executed using j_batch_execute_async() or j_batch_execute_queued() has been executed.
+ *
+ * \code
+ * \endcode
+ *
+ * \param batch A batch.
+ **/
+void
+j_batch_wait (JBatch* batch)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(batch != NULL);
+
+	g_mutex_lock(batch->mutex);
+
+	while (batch->running)
 	{
-		return FALSE;
+		g_cond_wait(batch->cond, batch->mutex);
 	}
 
-	if (j_semantics_get(batch->semantics, J_SEMANTICS_PERSISTENCY) == J_SEMANTICS_PERSISTENCY_EVENTUAL
-	    && j_operation_cache_add(batch))
+	g_mutex_unlock(batch->mutex);
+}
+
+/**
+ * Creates a new completion queue.
+ *
+ * \code
+ * \endcode
+ *
+ * \return A new completion queue. Should be freed with j_completion_queue_unref().
+ **/
+JCompletionQueue*
+j_completion_queue_new (void)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JCompletionQueue* queue;
+
+	queue = g_slice_new(JCompletionQueue);
+	g_mutex_init(queue->mutex);
+	g_cond_init(queue->cond);
+	g_queue_init(queue->completed);
+	queue->pending = 0;
+	queue->ref_count = 1;
+
+	return queue;
+}
+
+/**
+ * Increases the completion queue's reference count.
+ *
+ * \param queue A completion queue.
+ *
+ * \return The completion queue.
+ **/
+JCompletionQueue*
+j_completion_queue_ref (JCompletionQueue* queue)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(queue != NULL, NULL);
+
+	g_atomic_int_inc(&(queue->ref_count));
+
+	return queue;
+}
+
+/**
+ * Decreases the completion queue's reference count.
+ * When the reference count reaches zero, frees the memory allocated for the completion queue.
+ * Batches that are still being executed keep their completion queue alive, executed batches that have not been returned are released.
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue A completion queue.
+ **/
+void
+j_completion_queue_unref (JCompletionQueue* queue)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(queue != NULL);
+
+	if (g_atomic_int_dec_and_test(&(queue->ref_count)))
 	{
-		return TRUE;
-	}
+		JBatch* batch;
 
-	j_operation_cache_flush();
+		while ((batch = g_queue_pop_head(queue->completed)) != NULL)
+		{
+			j_batch_unref(batch);
+		}
 
-	ret = j_batch_execute_internal(batch);
-	j_list_delete_all(batch->list);
+		g_mutex_clear(queue->mutex);
+		g_cond_clear(queue->cond);
 
-	return ret;
+		g_slice_free(JCompletionQueue, queue);
+	}
 }
 
 /**
- * Executes the batch asynchronously.
+ * Returns an executed batch without blocking.
  *
  * \code
  * \endcode
  *
- * \param batch     A batch.
- * \param func      A complete function.
+ * \param queue A completion queue.
+ * \param ret   Returns the batch's result, may be NULL.
  *
- * \return TRUE on success, FALSE if an error occurred.
+ * \return An executed batch that should be freed with j_batch_unref(), or NULL if no batch has been executed.
  **/
-void
-j_batch_execute_async (JBatch* batch, JOperationCompletedFunc func, gpointer user_data)
+JBatch*
+j_completion_queue_poll (JCompletionQueue* queue, gboolean* ret)
 {
 	J_TRACE_FUNCTION(NULL);
 
-	JOperationAsync* async;
+	JBatch* batch;
 
-	g_return_if_fail(batch != NULL);
-	g_return_if_fail(batch->background_operation == NULL);
+	g_return_val_if_fail(queue != NULL, NULL);
 
-	async = g_slice_new(JOperationAsync);
-	async->batch = j_batch_ref(batch);
-	async->func = func;
-	async->user_data = user_data;
+	g_mutex_lock(queue->mutex);
+	batch = g_queue_pop_head(queue->completed);
+	g_mutex_unlock(queue->mutex);
+
+	if (batch != NULL && ret != NULL)
+	{
+		*ret = batch->result;
+	}
 
-	batch->background_operation = j_background_operation_new(j_batch_background_operation, async);
+	return batch;
 }
 
-void
-j_batch_wait (JBatch* batch)
+/**
+ * Waits until any batch has been executed and returns it.
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue A completion queue.
+ * \param ret   Returns the batch's result, may be NULL.
+ *
+ * \return An executed batch that should be freed with j_batch_unref(), or NULL if there are no more batches.
+ **/
+JBatch*
+j_completion_queue_wait (JCompletionQueue* queue, gboolean* ret)
 {
 	J_TRACE_FUNCTION(NULL);
 
-	g_return_if_fail(batch != NULL);
+	JBatch* batch;
+
+	g_return_val_if_fail(queue != NULL, NULL);
+
+	g_mutex_lock(queue->mutex);
+
+	while (g_queue_is_empty(queue->completed) && queue->pending > 0)
+	{
+		g_cond_wait(queue->cond, queue->mutex);
+	}
+
+	batch = g_queue_pop_head(queue->completed);
 
-	if (batch->background_operation != NULL)
+	g_mutex_unlock(queue->mutex);
+
+	if (batch != NULL && ret != NULL)
 	{
-		j_background_operation_wait(batch->background_operation);
-		j_background_operation_unref(batch->background_operation);
-		batch->background_operation = NULL;
+		*ret = batch->result;
 	}
+
+	return batch;
 }
 
 /* Internal */
@@ -354,7 +539,11 @@ j_batch_new_from_batch (JBatch* old_batch)
 	batch = g_slice_new(JBatch);
 	batch->list = old_batch->list;
 	batch->semantics = j_semantics_ref(old_batch->semantics);
-	batch->background_operation = NULL;
+	g_mutex_init(batch->mutex);
+	g_cond_init(batch->cond);
+	batch->running = FALSE;
+	batch->completed = FALSE;
+	batch->result = FALSE;
 	batch->ref_count = 1;
 
 	old_batch->list = j_list_new((JListFreeFunc)j_operation_free);
@@ -428,64 +617,844 @@ j_batch_add (JBatch* batch, JOperation* operation)
 	j_list_append(batch->list, operation);
 }
 
+struct JBatchRun;
+
+typedef struct JBatchRun JBatchRun;
+
 /**
- * Executes the batch.
- *
- * \private
- *
- * \code
- * \endcode
- *
- * \param batch A batch.
- *
- * \return TRUE on success, FALSE if an error occurred.
+ * Operations that are executed together when reordering.
  **/
-gboolean
-j_batch_execute_internal (JBatch* batch)
+struct JBatchGroup
 {
-	J_TRACE_FUNCTION(NULL);
+	JOperationExecFunc exec_func;
+	JOperationExecAsyncFunc exec_async_func;
+	gconstpointer key;
 
-	g_autoptr(JList) same_list = NULL;
-	g_autoptr(JListIterator) iterator = NULL;
-	JOperationExecFunc last_exec_func;
-	gpointer last_key;
-	gboolean ret = TRUE;
+	/**
+	 * The operations' data.
+	 **/
+	JList* list;
 
-	iterator = j_list_iterator_new(batch->list);
-	same_list = j_list_new(NULL);
-	last_key = NULL;
-	last_exec_func = NULL;
+	/**
+	 * The resources accessed by the operations.
+	 **/
+	GHashTable* resources;
 
-	if (j_semantics_get(batch->semantics, J_SEMANTICS_ORDERING) == J_SEMANTICS_ORDERING_RELAXED)
-	{
-		/* FIXME: perform some optimizations */
-		/**
-		 * It is important to consider dependencies:
-		 * - Operations have to be performed before their dependent ones.
-		 *   For example, a collection has to be created before items in it can be created.
-		 */
-	}
+	/**
+	 * The parents of the resources accessed by the operations, see JOperation.
+	 **/
+	GHashTable* parents;
 
 	/**
-	 * Try to combine as many operations of the same type as possible.
-	 * These are temporarily stored in same_list.
-	 */
-	while (j_list_iterator_next(iterator))
-	{
-		JOperation* operation = j_list_iterator_get(iterator);
+	 * Whether the group contains an operation with an unknown resource.
+	 **/
+	gboolean barrier;
 
-		/* We only combine operations with the same type and the same key. */
-		if ((operation->exec_func != last_exec_func || operation->key != last_key) && last_exec_func != NULL)
-		{
-			ret = j_batch_execute_same(batch, last_exec_func, same_list) && ret;
-		}
+	/**
+	 * The group has to be executed after all groups with a lower level it conflicts with.
+	 * Groups with the same level are independent of each other.
+	 **/
+	guint level;
+
+	/**
+	 * The execution the group belongs to.
+	 **/
+	JBatchRun* run;
+
+	/**
+	 * Set by the thread that executes the group synchronously.
+	 **/
+	gint claimed;
+};
+
+typedef struct JBatchGroup JBatchGroup;
+
+/**
+ * The execution of a batch.
+ * The batch's groups are executed level by level, a level is started once all groups of the previous one are done.
+ **/
+struct JBatchRun
+{
+	JBatch* batch;
+
+	/**
+	 * The groups, sorted by level.
+	 **/
+	GPtrArray* groups;
+
+	/**
+	 * The first group of the next level.
+	 **/
+	guint position;
+
+	GMutex mutex[1];
+	GCond cond[1];
 
-		last_key = operation->key;
-		last_exec_func = operation->exec_func;
-		j_list_append(same_list, operation->data);
+	/**
+	 * The number of groups of the current level that are not done yet.
+	 **/
+	guint pending;
+
+	/**
+	 * The result.
+	 **/
+	gboolean ret;
+
+	/**
+	 * Whether a thread waits for each level, see j_batch_execute_internal().
+	 * Otherwise, the next level is started by the thread pool.
+	 **/
+	gboolean wait;
+
+	/**
+	 * Where to report the result to, only used if #wait is FALSE.
+	 **/
+	JOperationCompletedFunc func;
+	gpointer user_data;
+	JCompletionQueue* queue;
+
+	/**
+	 * The reference count.
+	 * Held by the thread driving the execution, by groups that are being executed and by pending tasks.
+	 **/
+	gint ref_count;
+};
+
+/**
+ * Work for the batch thread pool.
+ **/
+struct JBatchTask
+{
+	JBatchRun* run;
+
+	/**
+	 * The group to execute, NULL to continue with the next level.
+	 **/
+	JBatchGroup* group;
+};
+
+typedef struct JBatchTask JBatchTask;
+
+/**
+ * The number of groups an operation may be moved past under relaxed ordering.
+ * Limits the cost of checking for conflicts.
+ **/
+#define J_BATCH_REORDER_WINDOW 64
+
+static
+JBatchGroup*
+j_batch_group_new (JBatchRun* run, JOperation* operation)
+{
+	JBatchGroup* group;
+
+	group = g_slice_new(JBatchGroup);
+	group->exec_func = operation->exec_func;
+	group->exec_async_func = operation->exec_async_func;
+	group->key = operation->key;
+	group->list = j_list_new(NULL);
+	group->resources = g_hash_table_new(g_str_hash, g_str_equal);
+	group->parents = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	group->barrier = FALSE;
+	group->level = 0;
+	group->run = run;
+	group->claimed = 0;
+
+	return group;
+}
+
+static
+void
+j_batch_group_free (gpointer data)
+{
+	JBatchGroup* group = data;
+
+	j_list_unref(group->list);
+	g_hash_table_unref(group->resources);
+	g_hash_table_unref(group->parents);
+
+	g_slice_free(JBatchGroup, group);
+}
+
+static
+void
+j_batch_group_add (JBatchGroup* group, JOperation* operation)
+{
+	j_list_append(group->list, operation->data);
+
+	if (operation->resource == NULL)
+	{
+		group->barrier = TRUE;
+		return;
+	}
+
+	g_hash_table_add(group->resources, (gpointer)operation->resource);
+
+	for (gchar const* separator = strchr(operation->resource, '/'); separator != NULL; separator = strchr(separator + 1, '/'))
+	{
+		g_hash_table_add(group->parents, g_strndup(operation->resource, separator - operation->resource));
+	}
+}
+
+/**
+ * Checks whether an operation depends on a group's operations or the other way around.
+ * Operations conflict if they access the same resource or if one accesses a parent of the other's resource.
+ *
+ * \private
+ *
+ * \param group    A group.
+ * \param resource The operation's resource.
+ *
+ * \return TRUE if the operation may not be moved past the group, FALSE otherwise.
+ **/
+static
+gboolean
+j_batch_group_conflicts (JBatchGroup* group, gchar const* resource)
+{
+	if (resource == NULL || group->barrier)
+	{
+		return TRUE;
+	}
+
+	if (g_hash_table_contains(group->resources, resource) || g_hash_table_contains(group->parents, resource))
+	{
+		return TRUE;
+	}
+
+	for (gchar const* separator = strchr(resource, '/'); separator != NULL; separator = strchr(separator + 1, '/'))
+	{
+		g_autofree gchar* parent = NULL;
+
+		parent = g_strndup(resource, separator - resource);
+
+		if (g_hash_table_contains(group->resources, parent))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * Checks whether two groups' operations depend on each other.
+ *
+ * \private
+ *
+ * \param group A group.
+ * \param other Another group.
+ *
+ * \return TRUE if the groups have to be executed in order, FALSE otherwise.
+ **/
+static
+gboolean
+j_batch_group_conflicts_group (JBatchGroup* group, JBatchGroup* other)
+{
+	GHashTableIter iter;
+	gpointer resource;
+
+	if (group->barrier || other->barrier)
+	{
+		return TRUE;
+	}
+
+	g_hash_table_iter_init(&iter, other->resources);
+
+	while (g_hash_table_iter_next(&iter, &resource, NULL))
+	{
+		if (j_batch_group_conflicts(group, resource))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static
+gint
+j_batch_group_compare (gconstpointer a, gconstpointer b)
+{
+	JBatchGroup const* group_a = *(JBatchGroup* const*)a;
+	JBatchGroup const* group_b = *(JBatchGroup* const*)b;
+
+	if (group_a->level == group_b->level)
+	{
+		return 0;
+	}
+
+	return (group_a->level < group_b->level) ? -1 : 1;
+}
+
+/**
+ * Combines a batch's operations into groups and assigns them levels.
+ * Each operation is added to the latest earlier group with the same type and key, as long as it does not have to be moved past a conflicting operation.
+ * For example, creating and writing two objects results in one create and one write group if #window is at least 1.
+ * A window of 0 only combines adjacent operations.
+ *
+ * If #concurrent is TRUE, groups that do not depend on each other get the same level and are executed concurrently.
+ * Otherwise, each group gets its own level.
+ *
+ * \private
+ *
+ * \param run        An execution.
+ * \param window     The number of groups an operation may be moved past.
+ * \param concurrent Whether independent groups may be executed concurrently.
+ **/
+static
+void
+j_batch_run_group (JBatchRun* run, guint window, gboolean concurrent)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_autoptr(JListIterator) iterator = NULL;
+	GPtrArray* groups = run->groups;
+
+	iterator = j_list_iterator_new(run->batch->list);
+
+	while (j_list_iterator_next(iterator))
+	{
+		JOperation* operation = j_list_iterator_get(iterator);
+		JBatchGroup* group = NULL;
+
+		for (guint i = groups->len; i > 0 && groups->len - i <= window; i--)
+		{
+			JBatchGroup* candidate = g_ptr_array_index(groups, i - 1);
+
+			if (candidate->exec_func == operation->exec_func && candidate->key == operation->key)
+			{
+				group = candidate;
+				break;
+			}
+
+			if (j_batch_group_conflicts(candidate, operation->resource))
+			{
+				break;
+			}
+		}
+
+		if (group == NULL)
+		{
+			group = j_batch_group_new(run, operation);
+			g_ptr_array_add(groups, group);
+		}
+
+		j_batch_group_add(group, operation);
+	}
+
+	if (!concurrent)
+	{
+		for (guint i = 0; i < groups->len; i++)
+		{
+			JBatchGroup* group = g_ptr_array_index(groups, i);
+
+			group->level = i;
+		}
+
+		return;
+	}
+
+	/* Groups that already have a higher level than another group do not have to be compared with it. */
+	for (guint i = 0; i < groups->len; i++)
+	{
+		JBatchGroup* group = g_ptr_array_index(groups, i);
+
+		for (guint j = 0; j < i; j++)
+		{
+			JBatchGroup* other = g_ptr_array_index(groups, j);
+
+			if (other->level >= group->level && j_batch_group_conflicts_group(group, other))
+			{
+				group->level = other->level + 1;
+			}
+		}
+	}
+
+	/* The sort is stable, groups of the same level stay in order. */
+	g_ptr_array_sort(groups, j_batch_group_compare);
+}
+
+/**
+ * Creates a new execution for a batch's operations.
+ * Under relaxed and semi-relaxed ordering, operations may be reordered to combine more of them, see j_batch_run_group().
+ * Under relaxed ordering, independent groups of operations are also executed concurrently.
+ *
+ * \private
+ *
+ * \param batch A batch.
+ * \param wait  Whether the calling thread waits for the execution.
+ *
+ * \return A new execution. Should be freed with j_batch_run_unref().
+ **/
+static
+JBatchRun*
+j_batch_run_new (JBatch* batch, gboolean wait)
+{
+	JBatchRun* run;
+
+	run = g_slice_new(JBatchRun);
+	run->batch = j_batch_ref(batch);
+	run->groups = g_ptr_array_new_with_free_func(j_batch_group_free);
+	run->position = 0;
+	g_mutex_init(run->mutex);
+	g_cond_init(run->cond);
+	run->pending = 0;
+	run->wait = wait;
+	run->func = NULL;
+	run->user_data = NULL;
+	run->queue = NULL;
+	run->ref_count = 1;
+
+	switch (j_semantics_get(batch->semantics, J_SEMANTICS_ORDERING))
+	{
+		case J_SEMANTICS_ORDERING_RELAXED:
+			j_batch_run_group(run, J_BATCH_REORDER_WINDOW, TRUE);
+			break;
+		case J_SEMANTICS_ORDERING_SEMI_RELAXED:
+			j_batch_run_group(run, 1, FALSE);
+			break;
+		case J_SEMANTICS_ORDERING_STRICT:
+		default:
+			j_batch_run_group(run, 0, FALSE);
+			break;
+	}
+
+	run->ret = (run->groups->len > 0);
+
+	return run;
+}
+
+static
+JBatchRun*
+j_batch_run_ref (JBatchRun* run)
+{
+	g_atomic_int_inc(&(run->ref_count));
+
+	return run;
+}
+
+static
+void
+j_batch_run_unref (JBatchRun* run)
+{
+	if (g_atomic_int_dec_and_test(&(run->ref_count)))
+	{
+		if (run->queue != NULL)
+		{
+			j_completion_queue_unref(run->queue);
+		}
+
+		g_ptr_array_unref(run->groups);
+		g_mutex_clear(run->mutex);
+		g_cond_clear(run->cond);
+		j_batch_unref(run->batch);
+
+		g_slice_free(JBatchRun, run);
+	}
+}
+
+/**
+ * Returns the thread pool that executes groups without asynchronous exec functions and continues executions in the background.
+ * Its threads never wait for the pool itself, see j_batch_group_execute().
+ *
+ * \private
+ *
+ * \return The thread pool.
+ **/
+static
+GThreadPool*
+j_batch_get_thread_pool (void)
+{
+	static gsize initialized = 0;
+	static GThreadPool* thread_pool = NULL;
+
+	if (g_once_init_enter(&initialized))
+	{
+		thread_pool = g_thread_pool_new(j_batch_thread, NULL, g_get_num_processors(), FALSE, NULL);
+		g_once_init_leave(&initialized, 1);
+	}
+
+	return thread_pool;
+}
+
+/**
+ * Hands work to the thread pool.
+ *
+ * \private
+ *
+ * \param run   An execution.
+ * \param group A group to execute, NULL to continue with the next level.
+ **/
+static
+void
+j_batch_run_push (JBatchRun* run, JBatchGroup* group)
+{
+	JBatchTask* task;
+
+	task = g_slice_new(JBatchTask);
+	task->run = j_batch_run_ref(run);
+	task->group = group;
+
+	g_thread_pool_push(j_batch_get_thread_pool(), task, NULL);
+}
+
+/**
+ * Counts a group of the current level as done.
+ *
+ * \private
+ *
+ * \param run An execution.
+ * \param ret The group's result.
+ *
+ * \return TRUE if the level is done, FALSE otherwise.
+ **/
+static
+gboolean
+j_batch_run_finish (JBatchRun* run, gboolean ret)
+{
+	gboolean done;
+
+	g_mutex_lock(run->mutex);
+
+	run->ret = run->ret && ret;
+	done = (--run->pending == 0);
+
+	if (done && run->wait)
+	{
+		g_cond_signal(run->cond);
+	}
+
+	g_mutex_unlock(run->mutex);
+
+	return done;
+}
+
+/**
+ * Called once a group is done.
+ * This might happen in the client I/O engine's thread, which must not block, so the next level is started by the thread pool.
+ *
+ * \private
+ *
+ * \param ret  The group's result.
+ * \param data A group.
+ **/
+static
+void
+j_batch_group_done (gboolean ret, gpointer data)
+{
+	JBatchGroup* group = data;
+	JBatchRun* run = group->run;
+
+	if (j_batch_run_finish(run, ret) && !run->wait)
+	{
+		j_batch_run_push(run, NULL);
+	}
+
+	j_batch_run_unref(run);
+}
+
+/**
+ * Executes a group synchronously unless another thread has already started it.
+ * A thread waiting for a level also executes the level's groups that have been handed to the thread pool.
+ * It therefore never waits for groups that have not been started, which would deadlock if all of the pool's threads did so.
+ *
+ * \private
+ *
+ * \param group A group.
+ **/
+static
+void
+j_batch_group_execute (JBatchGroup* group)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JBatchRun* run = group->run;
+	gboolean ret = FALSE;
+
+	if (!g_atomic_int_compare_and_exchange(&(group->claimed), 0, 1))
+	{
+		return;
+	}
+
+	j_batch_run_ref(run);
+
+	if (group->exec_func != NULL)
+	{
+		ret = group->exec_func(group->list, run->batch->semantics);
+	}
+
+	j_batch_group_done(ret, group);
+}
+
+/**
+ * Starts the next level's groups.
+ * Groups with asynchronous exec functions are started right away, the remaining ones are handed to the thread pool.
+ * If the calling thread waits for the level, it executes synchronous groups itself, see j_batch_group_execute().
+ *
+ * \private
+ *
+ * \param run An execution.
+ *
+ * \return TRUE if the level is already done, FALSE otherwise.
+ **/
+static
+gboolean
+j_batch_run_start_level (JBatchRun* run)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	guint sync_count = 0;
+	guint start;
+	guint end;
+	guint level;
+
+	start = run->position;
+	level = ((JBatchGroup*)g_ptr_array_index(run->groups, start))->level;
+
+	for (end = start; end < run->groups->len && ((JBatchGroup*)g_ptr_array_index(run->groups, end))->level == level; end++)
+	{
+	}
+
+	run->position = end;
+
+	/* The level can not be done before all groups have been started. */
+	g_mutex_lock(run->mutex);
+	run->pending = end - start + 1;
+	g_mutex_unlock(run->mutex);
+
+	for (guint i = start; i < end; i++)
+	{
+		JBatchGroup* group = g_ptr_array_index(run->groups, i);
+
+		if (group->exec_async_func != NULL)
+		{
+			continue;
+		}
+
+		/* A waiting thread keeps the first synchronous group for itself. */
+		if (!run->wait || sync_count > 0)
+		{
+			j_batch_run_push(run, group);
+		}
+
+		sync_count++;
+	}
+
+	for (guint i = start; i < end; i++)
+	{
+		JBatchGroup* group = g_ptr_array_index(run->groups, i);
+
+		if (group->exec_async_func != NULL)
+		{
+			j_batch_run_ref(run);
+			group->exec_async_func(group->list, run->batch->semantics, j_batch_group_done, group);
+		}
+	}
+
+	for (guint i = start; i < end && run->wait; i++)
+	{
+		JBatchGroup* group = g_ptr_array_index(run->groups, i);
+
+		if (group->exec_async_func == NULL)
+		{
+			j_batch_group_execute(group);
+		}
+	}
+
+	return j_batch_run_finish(run, TRUE);
+}
+
+/**
+ * Reports the result of an execution in the background.
+ *
+ * \private
+ *
+ * \param run An execution.
+ **/
+static
+void
+j_batch_run_complete (JBatchRun* run)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JBatch* batch = run->batch;
+	gboolean ret = run->ret;
+
+	j_list_delete_all(batch->list);
+
+	if (run->func != NULL)
+	{
+		(*run->func)(batch, ret, run->user_data);
+	}
+
+	g_mutex_lock(batch->mutex);
+	batch->running = FALSE;
+	batch->completed = TRUE;
+	batch->result = ret;
+	g_cond_broadcast(batch->cond);
+	g_mutex_unlock(batch->mutex);
+
+	if (run->queue != NULL)
+	{
+		JCompletionQueue* queue = run->queue;
+
+		g_mutex_lock(queue->mutex);
+		g_queue_push_tail(queue->completed, j_batch_ref(batch));
+		queue->pending--;
+		g_cond_broadcast(queue->cond);
+		g_mutex_unlock(queue->mutex);
+	}
+}
+
+/**
+ * Starts levels until one has to be waited for or the execution is complete.
+ *
+ * \private
+ *
+ * \param run An execution.
+ **/
+static
+void
+j_batch_run_continue (JBatchRun* run)
+{
+	while (run->position < run->groups->len)
+	{
+		/* Otherwise, the last group to finish hands the execution back to the thread pool. */
+		if (!j_batch_run_start_level(run))
+		{
+			return;
+		}
+	}
+
+	j_batch_run_complete(run);
+}
+
+static
+void
+j_batch_thread (gpointer data, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JBatchTask* task = data;
+
+	(void)user_data;
+
+	if (task->group != NULL)
+	{
+		j_batch_group_execute(task->group);
+	}
+	else
+	{
+		j_batch_run_continue(task->run);
+	}
+
+	j_batch_run_unref(task->run);
+	g_slice_free(JBatchTask, task);
+}
+
+/**
+ * Executes a batch in the background.
+ *
+ * \private
+ *
+ * \param batch     A batch.
+ * \param func      A complete function, may be NULL.
+ * \param user_data Data to pass to #func.
+ * \param queue     A completion queue, may be NULL.
+ **/
+static
+void
+j_batch_execute_background (JBatch* batch, JOperationCompletedFunc func, gpointer user_data, JCompletionQueue* queue)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JBatchRun* run;
+	gboolean cached = FALSE;
+
+	g_mutex_lock(batch->mutex);
+
+	if (batch->running)
+	{
+		g_mutex_unlock(batch->mutex);
+		g_critical("Batch is already being executed.");
+		return;
+	}
+
+	batch->running = TRUE;
+	batch->completed = FALSE;
+	batch->result = FALSE;
+
+	g_mutex_unlock(batch->mutex);
+
+	if (queue != NULL)
+	{
+		g_mutex_lock(queue->mutex);
+		queue->pending++;
+		g_mutex_unlock(queue->mutex);
+	}
+
+	if (j_list_length(batch->list) > 0)
+	{
+		if (j_semantics_get(batch->semantics, J_SEMANTICS_PERSISTENCY) == J_SEMANTICS_PERSISTENCY_EVENTUAL
+		    && j_operation_cache_add(batch))
+		{
+			cached = TRUE;
+		}
+		else
+		{
+			j_operation_cache_flush();
+		}
+	}
+
+	run = j_batch_run_new(batch, FALSE);
+	run->ret = run->ret || cached;
+	run->func = func;
+	run->user_data = user_data;
+	run->queue = (queue != NULL) ? j_completion_queue_ref(queue) : NULL;
+
+	j_batch_run_continue(run);
+	j_batch_run_unref(run);
+}
+
+/**
+ * Executes the batch.
+ * Independent groups of operations are executed concurrently, see j_batch_run_new().
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param batch A batch.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_batch_execute_internal (JBatch* batch)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JBatchRun* run;
+	gboolean ret;
+
+	run = j_batch_run_new(batch, TRUE);
+
+	while (run->position < run->groups->len)
+	{
+		if (!j_batch_run_start_level(run))
+		{
+			g_mutex_lock(run->mutex);
+
+			while (run->pending > 0)
+			{
+				g_cond_wait(run->cond, run->mutex);
+			}
+
+			g_mutex_unlock(run->mutex);
+		}
 	}
 
-	ret = j_batch_execute_same(batch, last_exec_func, same_list) && ret;
+	ret = run->ret;
+	j_batch_run_unref(run);
 
 	return ret;
 }
@@ -141,10 +141,72 @@ struct JConfiguration
 		gchar* path;
 	} db;
 
+	/**
+	 * The port servers listen on.
+	 */
+	guint32 port;
+
 	guint64 max_operation_size;
 	guint32 max_connections;
+
+	/**
+	 * The number of connections clients open to each server during initialization.
+	 */
+	guint32 warm_up;
+
+	/**
+	 * Whether clients share their connections among threads.
+	 */
+	gboolean multiplex;
+
 	guint64 stripe_size;
 
+	/**
+	 * The number of server worker threads.
+	 */
+	guint32 server_threads;
+
+	/**
+	 * Whether the server should splice write data into the backend.
+	 */
+	gboolean splice_writes;
+
+	/**
+	 * Whether the server should receive messages from TCP connections using io_uring.
+	 */
+	gboolean io_uring;
+
+	/**
+	 * The number of objects the server keeps open.
+	 */
+	guint32 object_cache_size;
+
+	/**
+	 * The time in microseconds the server waits for concurrent sync requests.
+	 */
+	guint32 group_commit_window;
+
+	/**
+	 * The percentage of server threads reserved for metadata requests.
+	 */
+	guint32 metadata_share;
+
+	/**
+	 * The NUMA nodes the server's threads are bound to.
+	 */
+	gint* numa_nodes;
+	gsize numa_nodes_len;
+
+	/**
+	 * The compression algorithm for message payloads, or NULL.
+	 */
+	gchar* compression;
+
+	/**
+	 * The minimum payload size in bytes to compress.
+	 */
+	guint32 compression_threshold;
+
 	/**
 	 * The reference count.
 	 */
@@ -266,14 +328,41 @@ j_configuration_new_for_data (GKeyFile* key_file)
 	gchar* db_backend;
 	gchar* db_component;
 	gchar* db_path;
+	guint32 port;
 	guint64 max_operation_size;
 	guint32 max_connections;
+	guint32 warm_up;
+	gboolean multiplex;
 	guint64 stripe_size;
+	guint32 server_threads;
+	gboolean splice_writes;
+	gboolean io_uring;
+	guint32 object_cache_size;
+	guint32 group_commit_window;
+	guint32 metadata_share;
+	gint* numa_nodes;
+	gsize numa_nodes_len = 0;
+	gchar* compression;
+	guint32 compression_threshold;
 
 	g_return_val_if_fail(key_file != NULL, FALSE);
 
+	port = g_key_file_get_integer(key_file, "core", "port", NULL);
 	max_operation_size = g_key_file_get_uint64(key_file, "core", "max-operation-size", NULL);
+	server_threads = g_key_file_get_integer(key_file, "core", "server-threads", NULL);
+	splice_writes = g_key_file_get_boolean(key_file, "core", "splice-writes", NULL);
+	io_uring = g_key_file_get_boolean(key_file, "core", "io-uring", NULL);
+	object_cache_size = g_key_file_get_integer(key_file, "core", "object-cache-size", NULL);
+	/* 0 disables group commit, so the default is only used if the key is missing. */
+	group_commit_window = (g_key_file_has_key(key_file, "core", "group-commit-window", NULL)) ? g_key_file_get_integer(key_file, "core", "group-commit-window", NULL) : 200;
+	/* 0 does not reserve any threads, so the default is only used if the key is missing. */
+	metadata_share = (g_key_file_has_key(key_file, "core", "metadata-share", NULL)) ? g_key_file_get_integer(key_file, "core", "metadata-share", NULL) : 25;
+	numa_nodes = g_key_file_get_integer_list(key_file, "core", "numa-nodes", &numa_nodes_len, NULL);
+	compression = g_key_file_get_string(key_file, "core", "compression", NULL);
+	compression_threshold = g_key_file_get_integer(key_file, "core", "compression-threshold", NULL);
 	max_connections = g_key_file_get_integer(key_file, "clients", "max-connections", NULL);
+	warm_up = g_key_file_get_integer(key_file, "clients", "warm-up", NULL);
+	multiplex = g_key_file_get_boolean(key_file, "clients", "multiplex", NULL);
 	stripe_size = g_key_file_get_uint64(key_file, "clients", "stripe-size", NULL);
 	servers_object = g_key_file_get_string_list(key_file, "servers", "object", NULL, NULL);
 	servers_kv = g_key_file_get_string_list(key_file, "servers", "kv", NULL, NULL);
@@ -313,6 +402,8 @@ j_configuration_new_for_data (GKeyFile* key_file)
 		g_strfreev(servers_object);
 		g_strfreev(servers_kv);
 		g_strfreev(servers_db);
+		g_free(numa_nodes);
+		g_free(compression);
 
 		return NULL;
 	}
@@ -333,11 +424,29 @@ j_configuration_new_for_data (GKeyFile* key_file)
 	configuration->db.backend = db_backend;
 	configuration->db.component = db_component;
 	configuration->db.path = db_path;
+	configuration->port = port;
 	configuration->max_operation_size = max_operation_size;
 	configuration->max_connections = max_connections;
+	configuration->warm_up = warm_up;
+	configuration->multiplex = multiplex;
 	configuration->stripe_size = stripe_size;
+	configuration->server_threads = server_threads;
+	configuration->splice_writes = splice_writes;
+	configuration->io_uring = io_uring;
+	configuration->object_cache_size = object_cache_size;
+	configuration->group_commit_window = group_commit_window;
+	configuration->metadata_share = metadata_share;
+	configuration->numa_nodes = numa_nodes;
+	configuration->numa_nodes_len = (numa_nodes != NULL) ? numa_nodes_len : 0;
+	configuration->compression = compression;
+	configuration->compression_threshold = compression_threshold;
 	configuration->ref_count = 1;
 
+	if (configuration->port == 0 || configuration->port > G_MAXUINT16)
+	{
+		configuration->port = 4711;
+	}
+
 	if (configuration->max_operation_size == 0)
 	{
 		configuration->max_operation_size = 8 * 1024 * 1024;
@@ -345,7 +454,8 @@ j_configuration_new_for_data (GKeyFile* key_file)
 
 	if (configuration->max_connections == 0)
 	{
-		configuration->max_connections = g_get_num_processors();
+		/* Multiplexed connections are shared by all threads, so few of them suffice. */
+		configuration->max_connections = (configuration->multiplex) ? 2 : g_get_num_processors();
 	}
 
 	if (configuration->stripe_size == 0)
@@ -353,6 +463,26 @@ j_configuration_new_for_data (GKeyFile* key_file)
 		configuration->stripe_size = 4 * 1024 * 1024;
 	}
 
+	if (configuration->server_threads == 0)
+	{
+		configuration->server_threads = g_get_num_processors();
+	}
+
+	if (configuration->object_cache_size == 0)
+	{
+		configuration->object_cache_size = 128;
+	}
+
+	if (configuration->metadata_share > 100)
+	{
+		configuration->metadata_share = 100;
+	}
+
+	if (configuration->compression_threshold == 0)
+	{
+		configuration->compression_threshold = 1024;
+	}
+
 	return configuration;
 }
 
@@ -415,6 +545,9 @@ j_configuration_unref (JConfiguration* configuration)
 		g_strfreev(configuration->servers.kv);
 		g_strfreev(configuration->servers.db);
 
+		g_free(configuration->numa_nodes);
+		g_free(configuration->compression);
+
 		g_slice_free(JConfiguration, configuration);
 	}
 }
@@ -532,6 +665,16 @@ j_configuration_get_backend_path (JConfiguration* configuration, JBackendType ba
 	return NULL;
 }
 
+guint16
+j_configuration_get_port (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->port;
+}
+
 guint64
 j_configuration_get_max_operation_size (JConfiguration* configuration)
 {
@@ -552,6 +695,26 @@ j_configuration_get_max_connections (JConfiguration* configuration)
 	return configuration->max_connections;
 }
 
+guint32
+j_configuration_get_warm_up (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->warm_up;
+}
+
+gboolean
+j_configuration_get_multiplex (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, FALSE);
+
+	return configuration->multiplex;
+}
+
 guint64
 j_configuration_get_stripe_size (JConfiguration* configuration)
 {
@@ -562,6 +725,107 @@ j_configuration_get_stripe_size (JConfiguration* configuration)
 	return configuration->stripe_size;
 }
 
+guint32
+j_configuration_get_server_threads (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->server_threads;
+}
+
+gboolean
+j_configuration_get_splice_writes (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, FALSE);
+
+	return configuration->splice_writes;
+}
+
+gboolean
+j_configuration_get_io_uring (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, FALSE);
+
+	return configuration->io_uring;
+}
+
+guint32
+j_configuration_get_object_cache_size (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->object_cache_size;
+}
+
+guint32
+j_configuration_get_group_commit_window (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->group_commit_window;
+}
+
+guint32
+j_configuration_get_metadata_share (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->metadata_share;
+}
+
+guint32
+j_configuration_get_numa_node_count (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->numa_nodes_len;
+}
+
+guint32
+j_configuration_get_numa_node (JConfiguration* configuration, guint32 index)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+	g_return_val_if_fail(index < configuration->numa_nodes_len, 0);
+
+	return configuration->numa_nodes[index];
+}
+
+gchar const*
+j_configuration_get_compression (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, NULL);
+
+	return configuration->compression;
+}
+
+guint32
+j_configuration_get_compression_threshold (JConfiguration* configuration)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(configuration != NULL, 0);
+
+	return configuration->compression_threshold;
+}
+
 /**
  * @}
  **/
@@ -26,6 +26,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include <string.h>
+
 #include <jconnection-pool.h>
 #include <jconnection-pool-internal.h>
 
@@ -33,6 +35,7 @@
 #include <jhelper.h>
 #include <jhelper-internal.h>
 #include <jmessage.h>
+#include <jsemantics.h>
 #include <jtrace.h>
 
 /**
@@ -43,14 +46,96 @@
  * @{
  **/
 
+/**
+ * A connection shared by all threads, only used if connections are multiplexed.
+ **/
+struct JConnectionPoolShared
+{
+	GSocketConnection* connection;
+
+	/**
+	 * The number of threads currently using the connection.
+	 **/
+	guint users;
+};
+
+typedef struct JConnectionPoolShared JConnectionPoolShared;
+
 struct JConnectionPoolQueue
 {
 	GAsyncQueue* queue;
 	guint count;
+
+	/**
+	 * The shared connections, see JConnectionPoolShared.
+	 * Protected by #mutex.
+	 **/
+	GPtrArray* connections;
+	GMutex mutex[1];
+
+	/**
+	 * Signalled when a shared connection has been opened.
+	 **/
+	GCond cond[1];
+
+	/**
+	 * The number of shared connections that are currently being opened.
+	 **/
+	guint opening;
+
+	/**
+	 * Whether the server's capabilities are known.
+	 * They are set once by the first connection that pinged the server.
+	 **/
+	gint probed;
+	gboolean intern;
+	gboolean compression;
+
+	/**
+	 * The slots of all threads' caches, see JConnectionPoolCache.
+	 * Protected by #mutex.
+	 **/
+	GPtrArray* slots;
+
+	/**
+	 * The number of threads waiting for a connection to be returned.
+	 * Protected by #mutex.
+	 **/
+	guint waiters;
 };
 
 typedef struct JConnectionPoolQueue JConnectionPoolQueue;
 
+/**
+ * A thread's cached connections, one slot per server.
+ * A thread returning a connection keeps it in its slot and reuses it without accessing the shared queue.
+ * Cached connections are returned to the queue when the thread exits, threads waiting for a connection may also steal them.
+ **/
+struct JConnectionPoolCache
+{
+	/**
+	 * The generation of the pool the slots belong to.
+	 **/
+	guint generation;
+
+	gpointer* object_slots;
+	gpointer* kv_slots;
+	gpointer* db_slots;
+};
+
+typedef struct JConnectionPoolCache JConnectionPoolCache;
+
+/**
+ * A connection to open during initialization.
+ **/
+struct JConnectionPoolWarmUp
+{
+	JConnectionPoolQueue* queue;
+	gchar const* server;
+};
+
+typedef struct JConnectionPoolWarmUp JConnectionPoolWarmUp;
+
 /**
  * A connection.
  **/
@@ -64,11 +149,92 @@ struct JConnectionPool
 	guint kv_len;
 	guint db_len;
 	guint max_count;
+	gboolean multiplex;
+
+	/**
+	 * Distinguishes the pool from previous ones, so that threads do not use caches of a finalized pool.
+	 **/
+	guint generation;
 };
 
 typedef struct JConnectionPool JConnectionPool;
 
 static JConnectionPool* j_connection_pool = NULL;
+static guint j_connection_pool_generation = 0;
+
+static void j_connection_pool_cache_free (gpointer);
+
+static GPrivate j_connection_pool_cache = G_PRIVATE_INIT(j_connection_pool_cache_free);
+
+static void j_connection_pool_warm_up_func (gpointer, gpointer);
+static void j_connection_pool_warm_up (GThreadPool*, JBackendType, JConnectionPoolQueue*, guint, guint);
+
+static
+void
+j_connection_pool_queue_init (JConnectionPoolQueue* queue)
+{
+	queue->queue = g_async_queue_new();
+	queue->count = 0;
+	queue->connections = g_ptr_array_new();
+	g_mutex_init(queue->mutex);
+	g_cond_init(queue->cond);
+	queue->opening = 0;
+	queue->probed = FALSE;
+	queue->intern = FALSE;
+	queue->compression = FALSE;
+	queue->slots = g_ptr_array_new();
+	queue->waiters = 0;
+}
+
+static
+void
+j_connection_pool_close (GSocketConnection* connection)
+{
+	/**
+	 * Shutting the socket down makes the engine release the connection.
+	 * The socket is closed with the last reference, closing it here could let the engine read from a reused descriptor.
+	 **/
+	g_socket_shutdown(g_socket_connection_get_socket(connection), TRUE, TRUE, NULL);
+	g_object_unref(connection);
+}
+
+static
+void
+j_connection_pool_queue_clear (JConnectionPoolQueue* queue)
+{
+	GSocketConnection* connection;
+
+	while ((connection = g_async_queue_try_pop(queue->queue)) != NULL)
+	{
+		j_connection_pool_close(connection);
+	}
+
+	for (guint i = 0; i < queue->connections->len; i++)
+	{
+		JConnectionPoolShared* shared = g_ptr_array_index(queue->connections, i);
+
+		j_connection_pool_close(shared->connection);
+		g_slice_free(JConnectionPoolShared, shared);
+	}
+
+	/* The caches of threads that are still running are discarded once they notice the new generation. */
+	for (guint i = 0; i < queue->slots->len; i++)
+	{
+		gpointer* slot = g_ptr_array_index(queue->slots, i);
+
+		if ((connection = g_atomic_pointer_get(slot)) != NULL)
+		{
+			g_atomic_pointer_set(slot, NULL);
+			j_connection_pool_close(connection);
+		}
+	}
+
+	g_async_queue_unref(queue->queue);
+	g_ptr_array_unref(queue->connections);
+	g_ptr_array_unref(queue->slots);
+	g_cond_clear(queue->cond);
+	g_mutex_clear(queue->mutex);
+}
 
 void
 j_connection_pool_init (JConfiguration* configuration)
@@ -88,26 +254,41 @@ j_connection_pool_init (JConfiguration* configuration)
 	pool->db_len = j_configuration_get_server_count(configuration, J_BACKEND_TYPE_DB);
 	pool->db_queues = g_new(JConnectionPoolQueue, pool->db_len);
 	pool->max_count = j_configuration_get_max_connections(configuration);
+	pool->multiplex = j_configuration_get_multiplex(configuration);
+	pool->generation = ++j_connection_pool_generation;
 
 	for (guint i = 0; i < pool->object_len; i++)
 	{
-		pool->object_queues[i].queue = g_async_queue_new();
-		pool->object_queues[i].count = 0;
+		j_connection_pool_queue_init(&(pool->object_queues[i]));
 	}
 
 	for (guint i = 0; i < pool->kv_len; i++)
 	{
-		pool->kv_queues[i].queue = g_async_queue_new();
-		pool->kv_queues[i].count = 0;
+		j_connection_pool_queue_init(&(pool->kv_queues[i]));
 	}
 
 	for (guint i = 0; i < pool->db_len; i++)
 	{
-		pool->db_queues[i].queue = g_async_queue_new();
-		pool->db_queues[i].count = 0;
+		j_connection_pool_queue_init(&(pool->db_queues[i]));
 	}
 
 	g_atomic_pointer_set(&j_connection_pool, pool);
+
+	/* Connections are opened in parallel, so that the first operations do not have to wait for each server one after another. */
+	if (j_configuration_get_warm_up(configuration) > 0)
+	{
+		GThreadPool* thread_pool;
+		guint count;
+
+		count = MIN(j_configuration_get_warm_up(configuration), pool->max_count);
+		thread_pool = g_thread_pool_new(j_connection_pool_warm_up_func, NULL, MIN((pool->object_len + pool->kv_len + pool->db_len) * count, 64), FALSE, NULL);
+
+		j_connection_pool_warm_up(thread_pool, J_BACKEND_TYPE_OBJECT, pool->object_queues, pool->object_len, count);
+		j_connection_pool_warm_up(thread_pool, J_BACKEND_TYPE_KV, pool->kv_queues, pool->kv_len, count);
+		j_connection_pool_warm_up(thread_pool, J_BACKEND_TYPE_DB, pool->db_queues, pool->db_len, count);
+
+		g_thread_pool_free(thread_pool, FALSE, TRUE);
+	}
 }
 
 void
@@ -124,129 +305,636 @@ j_connection_pool_fini (void)
 
 	for (guint i = 0; i < pool->object_len; i++)
 	{
-		GSocketConnection* connection;
+		j_connection_pool_queue_clear(&(pool->object_queues[i]));
+	}
+
+	for (guint i = 0; i < pool->kv_len; i++)
+	{
+		j_connection_pool_queue_clear(&(pool->kv_queues[i]));
+	}
+
+	for (guint i = 0; i < pool->db_len; i++)
+	{
+		j_connection_pool_queue_clear(&(pool->db_queues[i]));
+	}
+
+	j_configuration_unref(pool->configuration);
+
+	g_free(pool->object_queues);
+	g_free(pool->kv_queues);
+	g_free(pool->db_queues);
+
+	g_slice_free(JConnectionPool, pool);
+}
 
-		while ((connection = g_async_queue_try_pop(pool->object_queues[i].queue)) != NULL)
+/**
+ * Connects to a server.
+ * Servers on the same node are connected to locally, see j_helper_get_local_address().
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param client A socket client.
+ * \param server A server name, optionally followed by a port.
+ * \param local  Returns whether the connection is local.
+ * \param error  A return location for a GError.
+ *
+ * \return A new connection, or NULL on failure.
+ **/
+static
+GSocketConnection*
+j_connection_pool_connect (GSocketClient* client, gchar const* server, gboolean* local, GError** error)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GSocketConnection* connection;
+	g_autoptr(GSocketConnectable) connectable = NULL;
+	gchar const* hostname;
+
+	*local = FALSE;
+
+	if ((connectable = g_network_address_parse(server, j_configuration_get_port(j_connection_pool->configuration), error)) == NULL)
+	{
+		return NULL;
+	}
+
+	hostname = g_network_address_get_hostname(G_NETWORK_ADDRESS(connectable));
+
+	if (g_strcmp0(hostname, "localhost") == 0 || g_strcmp0(hostname, "127.0.0.1") == 0 || g_strcmp0(hostname, "::1") == 0 || g_strcmp0(hostname, g_get_host_name()) == 0)
+	{
+		g_autoptr(GSocketAddress) address = NULL;
+
+		address = j_helper_get_local_address(g_network_address_get_port(G_NETWORK_ADDRESS(connectable)));
+
+		/* The server might not listen locally, for instance, if it is running in another network namespace. */
+		if ((connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address), NULL, NULL)) != NULL)
 		{
-			g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
-			g_object_unref(connection);
+			*local = TRUE;
+			return connection;
 		}
+	}
+
+	return g_socket_client_connect(client, connectable, NULL, error);
+}
 
-		g_async_queue_unref(pool->object_queues[i].queue);
+/**
+ * Opens a new connection to a server and negotiates its features.
+ * The server's capabilities are cached, later connections only ping the server if they have to set up its side of the connection.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue  The server's queue.
+ * \param server A server name, optionally followed by a port.
+ *
+ * \return A new connection, or NULL on failure.
+ **/
+static
+GSocketConnection*
+j_connection_pool_open (JConnectionPoolQueue* queue, gchar const* server)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GSocketConnection* connection;
+	GError* error = NULL;
+	g_autoptr(GSocketClient) client = NULL;
+
+	g_autoptr(JMessage) message = NULL;
+	g_autoptr(JMessage) reply = NULL;
+
+	JMessageCompression algorithm;
+	gchar const* compression;
+	gboolean local;
+	gboolean probed;
+	gboolean intern = FALSE;
+	gboolean compressed = FALSE;
+	guint op_count;
+
+	client = g_socket_client_new();
+	connection = j_connection_pool_connect(client, server, &local, &error);
+
+	if (error != NULL)
+	{
+		g_critical("%s", error->message);
+		g_error_free(error);
 	}
 
-	for (guint i = 0; i < pool->kv_len; i++)
+	if (connection == NULL)
 	{
-		GSocketConnection* connection;
+		g_critical("Can not connect to %s.", server);
+		return NULL;
+	}
 
-		while ((connection = g_async_queue_try_pop(pool->kv_queues[i].queue)) != NULL)
+	j_helper_set_nodelay(connection, TRUE);
+
+	compression = j_configuration_get_compression(j_connection_pool->configuration);
+	algorithm = j_message_compression_from_string(compression);
+	probed = g_atomic_int_get(&(queue->probed));
+
+	/* Local connections have to wait for the server to map the shared memory segment, so they always ping the server. */
+	if (probed && !local)
+	{
+		if (algorithm != J_MESSAGE_COMPRESSION_NONE && queue->compression)
 		{
-			g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
-			g_object_unref(connection);
+			g_autoptr(JSemantics) semantics = NULL;
+
+			message = j_message_new(J_MESSAGE_PING, 0);
+			j_message_add_operation(message, strlen(compression) + 1);
+			j_message_append_string(message, compression);
+
+			/* The server only has to enable compression for its replies, so there is no need to wait for an answer. */
+			semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+			j_semantics_set(semantics, J_SEMANTICS_SAFETY, J_SEMANTICS_SAFETY_NONE);
+			j_message_set_semantics(message, semantics);
+
+			j_message_send(message, connection);
+			j_message_enable_compression(connection, algorithm, j_configuration_get_compression_threshold(j_connection_pool->configuration));
 		}
 
-		g_async_queue_unref(pool->kv_queues[i].queue);
+		if (queue->intern)
+		{
+			j_message_enable_interning(connection);
+		}
+
+		goto end;
 	}
 
-	for (guint i = 0; i < pool->db_len; i++)
+	message = j_message_new(J_MESSAGE_PING, 0);
+
+	/* Compression is only requested if it is supported by this build. */
+	if (algorithm != J_MESSAGE_COMPRESSION_NONE)
+	{
+		j_message_add_operation(message, strlen(compression) + 1);
+		j_message_append_string(message, compression);
+	}
+
+	/* Local connections share memory with the server, so that data does not have to be copied through the socket. */
+	if (local)
+	{
+		j_message_add_operation(message, 4);
+		j_message_append_string(message, "shm");
+	}
+
+	j_message_send(message, connection);
+
+	if (local)
+	{
+		j_message_offer_shared_memory(connection, j_configuration_get_max_operation_size(j_connection_pool->configuration));
+	}
+
+	reply = j_message_new_reply(message);
+	j_message_receive(reply, connection);
+
+	op_count = j_message_get_count(reply);
+
+	for (guint i = 0; i < op_count; i++)
+	{
+		gchar const* backend;
+
+		backend = j_message_get_string(reply);
+
+		if (g_strcmp0(backend, "object") == 0)
+		{
+			//g_print("Server has object backend.\n");
+		}
+		else if (g_strcmp0(backend, "kv") == 0)
+		{
+			//g_print("Server has kv backend.\n");
+		}
+		else if (g_strcmp0(backend, "db") == 0)
+		{
+			//g_print("Server has db backend.\n");
+		}
+		else if (g_strcmp0(backend, "intern") == 0)
+		{
+			j_message_enable_interning(connection);
+			intern = TRUE;
+		}
+		else if (g_strcmp0(backend, "shm") == 0)
+		{
+			j_message_enable_shared_memory(connection);
+		}
+		else if (g_strcmp0(backend, compression) == 0)
+		{
+			j_message_enable_compression(connection, algorithm, j_configuration_get_compression_threshold(j_connection_pool->configuration));
+			compressed = TRUE;
+		}
+	}
+
+	/* Concurrent connections might all ping the server, they report the same capabilities. */
+	if (!probed)
+	{
+		queue->intern = intern;
+		queue->compression = compressed;
+		g_atomic_int_set(&(queue->probed), TRUE);
+	}
+
+end:
+	/* The ping has been answered in blocking mode, from now on the engine drives the connection. */
+	j_message_enable_engine(connection);
+
+	return connection;
+}
+
+/**
+ * Takes the connection out of a slot.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param slot A slot.
+ *
+ * \return The connection, or NULL if the slot is empty.
+ **/
+static
+GSocketConnection*
+j_connection_pool_slot_take (gpointer* slot)
+{
+	GSocketConnection* connection;
+
+	/* Other threads might steal the connection concurrently. */
+	while ((connection = g_atomic_pointer_get(slot)) != NULL)
+	{
+		if (g_atomic_pointer_compare_and_exchange(slot, connection, NULL))
+		{
+			break;
+		}
+	}
+
+	return connection;
+}
+
+static
+gpointer*
+j_connection_pool_cache_register (JConnectionPoolQueue* queues, guint len)
+{
+	gpointer* slots;
+
+	slots = g_new0(gpointer, len);
+
+	for (guint i = 0; i < len; i++)
+	{
+		g_mutex_lock(queues[i].mutex);
+		g_ptr_array_add(queues[i].slots, &(slots[i]));
+		g_mutex_unlock(queues[i].mutex);
+	}
+
+	return slots;
+}
+
+static
+void
+j_connection_pool_cache_unregister (JConnectionPoolQueue* queues, gpointer* slots, guint len)
+{
+	for (guint i = 0; i < len; i++)
 	{
 		GSocketConnection* connection;
 
-		while ((connection = g_async_queue_try_pop(pool->db_queues[i].queue)) != NULL)
+		g_mutex_lock(queues[i].mutex);
+		g_ptr_array_remove_fast(queues[i].slots, &(slots[i]));
+		g_mutex_unlock(queues[i].mutex);
+
+		if ((connection = j_connection_pool_slot_take(&(slots[i]))) != NULL)
 		{
-			g_io_stream_close(G_IO_STREAM(connection), NULL, NULL);
-			g_object_unref(connection);
+			g_async_queue_push(queues[i].queue, connection);
 		}
+	}
+
+	g_free(slots);
+}
 
-		g_async_queue_unref(pool->db_queues[i].queue);
+static
+void
+j_connection_pool_cache_free (gpointer data)
+{
+	JConnectionPoolCache* cache = data;
+	JConnectionPool* pool;
+
+	pool = g_atomic_pointer_get(&j_connection_pool);
+
+	/* The connections of a finalized pool have already been closed. */
+	if (pool != NULL && pool->generation == cache->generation)
+	{
+		j_connection_pool_cache_unregister(pool->object_queues, cache->object_slots, pool->object_len);
+		j_connection_pool_cache_unregister(pool->kv_queues, cache->kv_slots, pool->kv_len);
+		j_connection_pool_cache_unregister(pool->db_queues, cache->db_slots, pool->db_len);
+	}
+	else
+	{
+		g_free(cache->object_slots);
+		g_free(cache->kv_slots);
+		g_free(cache->db_slots);
 	}
 
-	j_configuration_unref(pool->configuration);
+	g_slice_free(JConnectionPoolCache, cache);
+}
 
-	g_free(pool->object_queues);
-	g_free(pool->kv_queues);
-	g_free(pool->db_queues);
+/**
+ * Returns the calling thread's slot for a server.
+ * The thread's cache is created on first use.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param backend A backend type.
+ * \param index   A server index.
+ *
+ * \return The slot, or NULL if connections are multiplexed.
+ **/
+static
+gpointer*
+j_connection_pool_get_slot (JBackendType backend, guint index)
+{
+	JConnectionPoolCache* cache;
 
-	g_slice_free(JConnectionPool, pool);
+	/* Multiplexed connections are shared by all threads anyway. */
+	if (j_connection_pool->multiplex)
+	{
+		return NULL;
+	}
+
+	cache = g_private_get(&j_connection_pool_cache);
+
+	if (G_UNLIKELY(cache == NULL || cache->generation != j_connection_pool->generation))
+	{
+		cache = g_slice_new(JConnectionPoolCache);
+		cache->generation = j_connection_pool->generation;
+		cache->object_slots = j_connection_pool_cache_register(j_connection_pool->object_queues, j_connection_pool->object_len);
+		cache->kv_slots = j_connection_pool_cache_register(j_connection_pool->kv_queues, j_connection_pool->kv_len);
+		cache->db_slots = j_connection_pool_cache_register(j_connection_pool->db_queues, j_connection_pool->db_len);
+
+		g_private_replace(&j_connection_pool_cache, cache);
+	}
+
+	switch (backend)
+	{
+		case J_BACKEND_TYPE_OBJECT:
+			return &(cache->object_slots[index]);
+		case J_BACKEND_TYPE_KV:
+			return &(cache->kv_slots[index]);
+		case J_BACKEND_TYPE_DB:
+			return &(cache->db_slots[index]);
+		default:
+			g_assert_not_reached();
+	}
+
+	return NULL;
 }
 
+/**
+ * Waits until a connection is returned or can be stolen from another thread's cache.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue A queue.
+ *
+ * \return A connection.
+ **/
 static
 GSocketConnection*
-j_connection_pool_pop_internal (GAsyncQueue* queue, guint* count, gchar const* server)
+j_connection_pool_wait (JConnectionPoolQueue* queue)
 {
 	J_TRACE_FUNCTION(NULL);
 
-	GSocketConnection* connection;
+	GSocketConnection* connection = NULL;
 
-	g_return_val_if_fail(queue != NULL, NULL);
-	g_return_val_if_fail(count != NULL, NULL);
+	g_mutex_lock(queue->mutex);
 
-	connection = g_async_queue_try_pop(queue);
+	/* While there are waiters, returned connections are pushed to the queue instead of being cached, see j_connection_pool_push_internal(). */
+	queue->waiters++;
 
-	if (connection != NULL)
+	for (guint i = 0; i < queue->slots->len && connection == NULL; i++)
 	{
-		return connection;
+		connection = j_connection_pool_slot_take(g_ptr_array_index(queue->slots, i));
+	}
+
+	g_mutex_unlock(queue->mutex);
+
+	/* Connections cached before the waiter was noticed have been stolen above, all others are pushed to the queue. */
+	if (connection == NULL)
+	{
+		connection = g_async_queue_pop(queue->queue);
 	}
 
-	if ((guint)g_atomic_int_get(count) < j_connection_pool->max_count)
+	g_mutex_lock(queue->mutex);
+	queue->waiters--;
+	g_mutex_unlock(queue->mutex);
+
+	return connection;
+}
+
+/**
+ * Adds a shared connection.
+ * The queue's mutex has to be held, waiters have to be woken up by the caller.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue      A queue.
+ * \param connection A connection.
+ * \param users      The number of threads already using the connection.
+ **/
+static
+void
+j_connection_pool_shared_add (JConnectionPoolQueue* queue, GSocketConnection* connection, guint users)
+{
+	JConnectionPoolShared* shared;
+
+	shared = g_slice_new(JConnectionPoolShared);
+	shared->connection = connection;
+	shared->users = users;
+
+	g_ptr_array_add(queue->connections, shared);
+}
+
+/**
+ * Returns the least used shared connection.
+ * The queue's mutex has to be held.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue A queue.
+ *
+ * \return The connection, or NULL if there are no shared connections.
+ **/
+static
+JConnectionPoolShared*
+j_connection_pool_shared_least_used (JConnectionPoolQueue* queue)
+{
+	JConnectionPoolShared* least_used = NULL;
+
+	for (guint i = 0; i < queue->connections->len; i++)
 	{
-		if ((guint)g_atomic_int_add(count, 1) < j_connection_pool->max_count)
+		JConnectionPoolShared* shared = g_ptr_array_index(queue->connections, i);
+
+		if (least_used == NULL || shared->users < least_used->users)
 		{
-			GError* error = NULL;
-			g_autoptr(GSocketClient) client = NULL;
+			least_used = shared;
+		}
+	}
 
-			g_autoptr(JMessage) message = NULL;
-			g_autoptr(JMessage) reply = NULL;
+	return least_used;
+}
 
-			guint op_count;
+/**
+ * Returns a shared connection.
+ * An idle connection is preferred, a new one is only opened if all existing ones are in use and the limit has not been reached.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param queue  A queue.
+ * \param server A server name, optionally followed by a port.
+ *
+ * \return A connection.
+ **/
+static
+GSocketConnection*
+j_connection_pool_pop_shared (JConnectionPoolQueue* queue, gchar const* server)
+{
+	J_TRACE_FUNCTION(NULL);
 
-			client = g_socket_client_new();
-			connection = g_socket_client_connect_to_host(client, server, 4711, NULL, &error);
+	JConnectionPoolShared* shared;
+	GSocketConnection* connection = NULL;
 
-			if (error != NULL)
-			{
-				g_critical("%s", error->message);
-				g_error_free(error);
-			}
+	g_mutex_lock(queue->mutex);
+
+	while (connection == NULL)
+	{
+		gboolean saturated;
+
+		shared = j_connection_pool_shared_least_used(queue);
+		saturated = (shared == NULL || shared->users > 0);
+
+		if (saturated && queue->connections->len + queue->opening < j_connection_pool->max_count)
+		{
+			GSocketConnection* new_connection;
+
+			/* Connecting and pinging the server takes a round trip, other threads must not be blocked meanwhile. */
+			queue->opening++;
+			g_mutex_unlock(queue->mutex);
 
-			if (connection == NULL)
+			new_connection = j_connection_pool_open(queue, server);
+
+			g_mutex_lock(queue->mutex);
+			queue->opening--;
+			g_cond_broadcast(queue->cond);
+
+			if (new_connection != NULL)
 			{
-				g_critical("Can not connect to %s [%d].", server, g_atomic_int_get(count));
+				j_connection_pool_shared_add(queue, new_connection, 1);
+				connection = new_connection;
+				break;
 			}
 
-			j_helper_set_nodelay(connection, TRUE);
+			/* The existing connections might have become idle in the meantime. */
+			shared = j_connection_pool_shared_least_used(queue);
+		}
 
-			message = j_message_new(J_MESSAGE_PING, 0);
-			j_message_send(message, connection);
+		if (shared != NULL)
+		{
+			shared->users++;
+			connection = shared->connection;
+		}
+		else if (queue->opening > 0)
+		{
+			/* Wait for the connections that are currently being opened. */
+			g_cond_wait(queue->cond, queue->mutex);
+		}
+		else
+		{
+			/* The server could not be reached, retry after a while instead of returning no connection. */
+			g_cond_wait_until(queue->cond, queue->mutex, g_get_monotonic_time() + G_TIME_SPAN_SECOND);
+		}
+	}
 
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, connection);
+	g_mutex_unlock(queue->mutex);
 
-			op_count = j_message_get_count(reply);
+	return connection;
+}
+
+static
+void
+j_connection_pool_push_shared (JConnectionPoolQueue* queue, GSocketConnection* connection)
+{
+	J_TRACE_FUNCTION(NULL);
 
-			for (guint i = 0; i < op_count; i++)
+	g_mutex_lock(queue->mutex);
+
+	for (guint i = 0; i < queue->connections->len; i++)
+	{
+		JConnectionPoolShared* shared = g_ptr_array_index(queue->connections, i);
+
+		if (shared->connection == connection)
+		{
+			g_warn_if_fail(shared->users > 0);
+			shared->users--;
+			break;
+		}
+	}
+
+	g_mutex_unlock(queue->mutex);
+}
+
+static
+GSocketConnection*
+j_connection_pool_pop_internal (JConnectionPoolQueue* queue, gchar const* server, gpointer* slot)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GSocketConnection* connection;
+
+	g_return_val_if_fail(queue != NULL, NULL);
+
+	/* Multiplexed connections are shared by all threads. */
+	if (j_connection_pool->multiplex)
+	{
+		return j_connection_pool_pop_shared(queue, server);
+	}
+
+	/* The thread's cached connection does not require accessing the shared queue. */
+	if ((connection = j_connection_pool_slot_take(slot)) != NULL)
+	{
+		return connection;
+	}
+
+	connection = g_async_queue_try_pop(queue->queue);
+
+	if (connection != NULL)
+	{
+		return connection;
+	}
+
+	if ((guint)g_atomic_int_get(&(queue->count)) < j_connection_pool->max_count)
+	{
+		if ((guint)g_atomic_int_add(&(queue->count), 1) < j_connection_pool->max_count)
+		{
+			if ((connection = j_connection_pool_open(queue, server)) == NULL)
 			{
-				gchar const* backend;
-
-				backend = j_message_get_string(reply);
-
-				if (g_strcmp0(backend, "object") == 0)
-				{
-					//g_print("Server has object backend.\n");
-				}
-				else if (g_strcmp0(backend, "kv") == 0)
-				{
-					//g_print("Server has kv backend.\n");
-				}
-				else if (g_strcmp0(backend, "db") == 0)
-				{
-					//g_print("Server has db backend.\n");
-				}
+				g_atomic_int_add(&(queue->count), -1);
 			}
 		}
 		else
 		{
-			g_atomic_int_add(count, -1);
+			g_atomic_int_add(&(queue->count), -1);
 		}
 	}
 
@@ -255,21 +943,126 @@ j_connection_pool_pop_internal (GAsyncQueue* queue, guint* count, gchar const* s
 		return connection;
 	}
 
-	connection = g_async_queue_pop(queue);
-
-	return connection;
+	return j_connection_pool_wait(queue);
 }
 
 static
 void
-j_connection_pool_push_internal (GAsyncQueue* queue, GSocketConnection* connection)
+j_connection_pool_push_internal (JConnectionPoolQueue* queue, gpointer* slot, GSocketConnection* connection)
 {
 	J_TRACE_FUNCTION(NULL);
 
 	g_return_if_fail(queue != NULL);
 	g_return_if_fail(connection != NULL);
 
-	g_async_queue_push(queue, connection);
+	/* Multiplexed connections stay shared. */
+	if (j_connection_pool->multiplex)
+	{
+		j_connection_pool_push_shared(queue, connection);
+		return;
+	}
+
+	/* The connection is cached unless the thread already has one or other threads are waiting for it.
+	 * Waiters are checked under the mutex, so that they either steal the cached connection or are woken up by the queue. */
+	g_mutex_lock(queue->mutex);
+
+	if (queue->waiters == 0 && g_atomic_pointer_compare_and_exchange(slot, NULL, connection))
+	{
+		connection = NULL;
+	}
+
+	g_mutex_unlock(queue->mutex);
+
+	if (connection != NULL)
+	{
+		g_async_queue_push(queue->queue, connection);
+	}
+}
+
+static
+void
+j_connection_pool_warm_up_func (gpointer data, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JConnectionPoolWarmUp* warm_up = data;
+	JConnectionPoolQueue* queue = warm_up->queue;
+	GSocketConnection* connection;
+
+	(void)user_data;
+
+	connection = j_connection_pool_open(queue, warm_up->server);
+
+	if (j_connection_pool->multiplex)
+	{
+		g_mutex_lock(queue->mutex);
+
+		if (connection != NULL)
+		{
+			j_connection_pool_shared_add(queue, connection, 0);
+		}
+
+		queue->opening--;
+		g_cond_broadcast(queue->cond);
+		g_mutex_unlock(queue->mutex);
+	}
+	else if (connection != NULL)
+	{
+		g_async_queue_push(queue->queue, connection);
+	}
+	else
+	{
+		g_atomic_int_add(&(queue->count), -1);
+	}
+
+	g_slice_free(JConnectionPoolWarmUp, warm_up);
+}
+
+/**
+ * Opens connections to all servers of a backend type in parallel.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param thread_pool A thread pool to open the connections in.
+ * \param backend     A backend type.
+ * \param queues      The backend type's queues.
+ * \param len         The number of queues.
+ * \param count       The number of connections per server.
+ **/
+static
+void
+j_connection_pool_warm_up (GThreadPool* thread_pool, JBackendType backend, JConnectionPoolQueue* queues, guint len, guint count)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	for (guint i = 0; i < len; i++)
+	{
+		for (guint j = 0; j < count; j++)
+		{
+			JConnectionPoolWarmUp* warm_up;
+
+			warm_up = g_slice_new(JConnectionPoolWarmUp);
+			warm_up->queue = &(queues[i]);
+			warm_up->server = j_configuration_get_server(j_connection_pool->configuration, backend, i);
+
+			/* The connections count towards the limit right away, as if they had been popped. */
+			if (j_connection_pool->multiplex)
+			{
+				g_mutex_lock(queues[i].mutex);
+				queues[i].opening++;
+				g_mutex_unlock(queues[i].mutex);
+			}
+			else
+			{
+				g_atomic_int_inc(&(queues[i].count));
+			}
+
+			g_thread_pool_push(thread_pool, warm_up, NULL);
+		}
+	}
 }
 
 gpointer
@@ -283,13 +1076,13 @@ j_connection_pool_pop (JBackendType backend, guint index)
 	{
 		case J_BACKEND_TYPE_OBJECT:
 			g_return_val_if_fail(index < j_connection_pool->object_len, NULL);
-			return j_connection_pool_pop_internal(j_connection_pool->object_queues[index].queue, &(j_connection_pool->object_queues[index].count), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_OBJECT, index));
+			return j_connection_pool_pop_internal(&(j_connection_pool->object_queues[index]), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_OBJECT, index), j_connection_pool_get_slot(backend, index));
 		case J_BACKEND_TYPE_KV:
 			g_return_val_if_fail(index < j_connection_pool->kv_len, NULL);
-			return j_connection_pool_pop_internal(j_connection_pool->kv_queues[index].queue, &(j_connection_pool->kv_queues[index].count), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_KV, index));
+			return j_connection_pool_pop_internal(&(j_connection_pool->kv_queues[index]), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_KV, index), j_connection_pool_get_slot(backend, index));
 		case J_BACKEND_TYPE_DB:
 			g_return_val_if_fail(index < j_connection_pool->db_len, NULL);
-			return j_connection_pool_pop_internal(j_connection_pool->db_queues[index].queue, &(j_connection_pool->db_queues[index].count), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_DB, index));
+			return j_connection_pool_pop_internal(&(j_connection_pool->db_queues[index]), j_configuration_get_server(j_connection_pool->configuration, J_BACKEND_TYPE_DB, index), j_connection_pool_get_slot(backend, index));
 		default:
 			g_assert_not_reached();
 	}
@@ -309,15 +1102,15 @@ j_connection_pool_push (JBackendType backend, guint index, gpointer connection)
 	{
 		case J_BACKEND_TYPE_OBJECT:
 			g_return_if_fail(index < j_connection_pool->object_len);
-			j_connection_pool_push_internal(j_connection_pool->object_queues[index].queue, connection);
+			j_connection_pool_push_internal(&(j_connection_pool->object_queues[index]), j_connection_pool_get_slot(backend, index), connection);
 			break;
 		case J_BACKEND_TYPE_KV:
 			g_return_if_fail(index < j_connection_pool->kv_len);
-			j_connection_pool_push_internal(j_connection_pool->kv_queues[index].queue, connection);
+			j_connection_pool_push_internal(&(j_connection_pool->kv_queues[index]), j_connection_pool_get_slot(backend, index), connection);
 			break;
 		case J_BACKEND_TYPE_DB:
 			g_return_if_fail(index < j_connection_pool->db_len);
-			j_connection_pool_push_internal(j_connection_pool->db_queues[index].queue, connection);
+			j_connection_pool_push_internal(&(j_connection_pool->db_queues[index]), j_connection_pool_get_slot(backend, index), connection);
 			break;
 		default:
 			g_assert_not_reached();
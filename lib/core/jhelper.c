@@ -20,6 +20,8 @@
  * \file
  **/
 
+#define _GNU_SOURCE
+
 #include <julea-config.h>
 
 #include <glib.h>
@@ -27,10 +29,17 @@
 
 #include <bson.h>
 
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+
+#include <string.h>
+
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
 #include <jhelper.h>
 #include <jhelper-internal.h>
@@ -60,27 +69,44 @@ j_helper_set_nodelay (GSocketConnection* connection, gboolean enable)
 	g_return_if_fail(connection != NULL);
 
 	socket_ = g_socket_connection_get_socket(connection);
+
+	/* Local connections use UNIX sockets, see j_helper_get_local_address(). */
+	if (g_socket_get_family(socket_) == G_SOCKET_FAMILY_UNIX)
+	{
+		return;
+	}
+
 	fd = g_socket_get_fd(socket_);
 
 	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(gint));
 }
 
-void
-j_helper_set_cork (GSocketConnection* connection, gboolean enable)
+/**
+ * Returns the address a server listens on for clients on the same node.
+ * The address is an abstract UNIX socket named after the server's port, so that it does not have to be cleaned up.
+ *
+ * \code
+ * \endcode
+ *
+ * \param port The server's port.
+ *
+ * \return A new address. Should be freed with g_object_unref().
+ **/
+GSocketAddress*
+j_helper_get_local_address (guint16 port)
 {
 	J_TRACE_FUNCTION(NULL);
 
-	gint const flag = (enable) ? 1 : 0;
+	struct sockaddr_un address;
+	gint length;
 
-	GSocket* socket_;
-	gint fd;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
 
-	g_return_if_fail(connection != NULL);
+	/* The leading null byte makes the address abstract. */
+	length = g_snprintf(address.sun_path + 1, sizeof(address.sun_path) - 1, "julea-%u", port);
 
-	socket_ = g_socket_connection_get_socket(connection);
-	fd = g_socket_get_fd(socket_);
-
-	setsockopt(fd, IPPROTO_TCP, TCP_CORK, &flag, sizeof(gint));
+	return g_socket_address_new_from_native(&address, G_STRUCT_OFFSET(struct sockaddr_un, sun_path) + 1 + length);
 }
 
 void
@@ -166,6 +192,32 @@ j_helper_execute_parallel (JBackgroundOperationFunc func, gpointer* data, guint
 	return TRUE;
 }
 
+/**
+ * Returns a key for a namespace on a server.
+ * The key can be used as an operation's key to execute operations on different objects in the same namespace together.
+ *
+ * \code
+ * \endcode
+ *
+ * \param namespace A namespace.
+ * \param index     A server index.
+ *
+ * \return The key, which is equal for equal namespaces and indices.
+ **/
+gconstpointer
+j_helper_get_namespace_key (gchar const* namespace, guint32 index)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_autofree gchar* key = NULL;
+
+	g_return_val_if_fail(namespace != NULL, NULL);
+
+	key = g_strdup_printf("%u/%s", index, namespace);
+
+	return g_intern_string(key);
+}
+
 guint64
 j_helper_atomic_add (guint64 volatile* ptr, guint64 val)
 {
@@ -206,6 +258,105 @@ j_helper_hash (gchar const* str)
 	return hash;
 }
 
+/**
+ * Returns the number of NUMA nodes.
+ *
+ * \return The number of NUMA nodes, 1 if the system does not provide NUMA information.
+ **/
+guint
+j_helper_numa_get_node_count (void)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	guint count = 0;
+
+	while (TRUE)
+	{
+		g_autofree gchar* path = NULL;
+
+		path = g_strdup_printf("/sys/devices/system/node/node%u", count);
+
+		if (!g_file_test(path, G_FILE_TEST_IS_DIR))
+		{
+			break;
+		}
+
+		count++;
+	}
+
+	return MAX(count, 1);
+}
+
+/**
+ * Binds the calling thread to the processors of a NUMA node.
+ * Memory is allocated on the node the first accessing thread runs on, so buffers allocated afterwards are node-local.
+ *
+ * \code
+ * j_helper_numa_bind(0);
+ * \endcode
+ *
+ * \param node A NUMA node.
+ *
+ * \return TRUE on success, FALSE otherwise.
+ **/
+gboolean
+j_helper_numa_bind (guint node)
+{
+	J_TRACE_FUNCTION(NULL);
+
+#ifdef HAVE_SCHED_SETAFFINITY
+	g_autofree gchar* path = NULL;
+	g_autofree gchar* cpulist = NULL;
+	g_auto(GStrv) ranges = NULL;
+	cpu_set_t set;
+	guint cpus = 0;
+
+	path = g_strdup_printf("/sys/devices/system/node/node%u/cpulist", node);
+
+	if (!g_file_get_contents(path, &cpulist, NULL, NULL))
+	{
+		return FALSE;
+	}
+
+	CPU_ZERO(&set);
+
+	/* The list has the form 0-7,16-23. */
+	ranges = g_strsplit(g_strstrip(cpulist), ",", 0);
+
+	for (guint i = 0; ranges[i] != NULL; i++)
+	{
+		gchar* end;
+		guint64 first;
+		guint64 last;
+
+		if (ranges[i][0] == '\0')
+		{
+			continue;
+		}
+
+		first = g_ascii_strtoull(ranges[i], &end, 10);
+		last = (*end == '-') ? g_ascii_strtoull(end + 1, NULL, 10) : first;
+
+		for (guint64 cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+		{
+			CPU_SET(cpu, &set);
+			cpus++;
+		}
+	}
+
+	if (cpus == 0)
+	{
+		return FALSE;
+	}
+
+	return (sched_setaffinity(0, sizeof(set), &set) == 0);
+#else
+	(void)node;
+
+	return FALSE;
+#endif
+}
+
 /**
  * @}
  **/
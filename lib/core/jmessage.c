@@ -20,28 +20,67 @@
  * \file
  **/
 
+#define _GNU_SOURCE
+
 #include <julea-config.h>
 
 #include <glib.h>
 #include <gio/gio.h>
 
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 #include <jmessage.h>
+#include <jmessage-internal.h>
 
-#include <jhelper-internal.h>
+#include <jhelper.h>
 #include <jlist.h>
 #include <jlist-iterator.h>
 #include <jsemantics.h>
 #include <jtrace.h>
 
+#include "message/message.h"
+
 /**
  * \defgroup JMessage Message
  *
+ * The implementation is split into several files:
+ * - jmessage.c contains the messages themselves and how they are sent and received.
+ * - message/connection.c keeps the state of connections.
+ * - message/reader.c reads messages incrementally without blocking.
+ * - message/strings.c interns strings.
+ * - message/compression.c compresses messages.
+ * - message/shared-memory.c exchanges data via shared memory with local servers.
+ * - message/layout.c generates the functions of the operation layouts.
+ * - message/engine.c drives connections without blocking, a single thread serves all of them.
+ *
  * @{
  **/
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/**
+ * Message buffers are recycled using per-thread pools with power-of-two size classes.
+ * The smallest class holds 256 bytes, the largest one 64 KiB; larger buffers are not pooled.
+ **/
+#define J_MESSAGE_POOL_MIN_SHIFT 8
+#define J_MESSAGE_POOL_CLASSES 9
+#define J_MESSAGE_POOL_MAX_SIZE (1 << (J_MESSAGE_POOL_MIN_SHIFT + J_MESSAGE_POOL_CLASSES - 1))
+
+/**
+ * The maximum number of buffers kept per size class and thread.
+ **/
+#define J_MESSAGE_POOL_DEPTH 16
+
 enum JMessageSemantics
 {
 	J_MESSAGE_SEMANTICS_ATOMICITY_BATCH =             1 << 0,
@@ -69,150 +108,164 @@ enum JMessageSemantics
 typedef enum JMessageSemantics JMessageSemantics;
 
 /**
- * Additional message data.
+ * A thread's pool of message buffers.
  **/
-struct JMessageData
+struct JMessagePool
 {
-	/**
-	 * The data.
-	 **/
-	gconstpointer data;
-
-	/**
-	 * The data length.
-	 **/
-	guint64 length;
+	gchar* buffers[J_MESSAGE_POOL_CLASSES][J_MESSAGE_POOL_DEPTH];
+	guint count[J_MESSAGE_POOL_CLASSES];
 };
 
-typedef struct JMessageData JMessageData;
-
-/**
- * A message header.
- **/
-#pragma pack(4)
-struct JMessageHeader
-{
-	/**
-	 * The message length.
-	 **/
-	guint32 length;
-
-	/**
-	 * The message ID.
-	 **/
-	guint32 id;
-
-	/**
-	 * The semantics.
-	 **/
-	guint32 semantics;
-
-	/**
-	 * The operation type.
-	 **/
-	guint32 op_type;
+typedef struct JMessagePool JMessagePool;
 
-	/**
-	 * The operation count.
-	 **/
-	guint32 op_count;
-};
-#pragma pack()
+static void j_message_pool_free (gpointer);
 
-typedef struct JMessageHeader JMessageHeader;
+static GPrivate j_message_pool = G_PRIVATE_INIT(j_message_pool_free);
 
 /**
- * A message.
+ * The number of messages sent by this process.
  **/
-struct JMessage
+static guint64 j_message_sent = 0;
+
+static
+void
+j_message_data_free (gpointer data)
 {
-	/**
-	 * The current size.
-	 **/
-	gsize size;
+	g_slice_free(JMessageData, data);
+}
 
-	/**
-	 * The data.
-	 * This also contains a JMessageHeader.
-	 **/
-	gchar* data;
+static
+void
+j_message_pool_free (gpointer data)
+{
+	JMessagePool* pool = data;
 
-	/**
-	 * The current position within #data.
-	 **/
-	gchar* current;
+	for (guint i = 0; i < J_MESSAGE_POOL_CLASSES; i++)
+	{
+		for (guint j = 0; j < pool->count[i]; j++)
+		{
+			g_free(pool->buffers[i][j]);
+		}
+	}
 
-	/**
-	 * The list of additional data to send in j_message_write().
-	 * Contains JMessageData elements.
-	 **/
-	JList* send_list;
-
-	/**
-	 * The original message.
-	 * Set if the message is a reply, NULL otherwise.
-	 **/
-	JMessage* original_message;
-
-	/**
-	 * The reference count.
-	 **/
-	gint ref_count;
-};
+	g_slice_free(JMessagePool, pool);
+}
 
 /**
- * Returns a message's header.
+ * Returns the size class for a buffer size.
  *
  * \private
  *
  * \code
  * \endcode
  *
- * \param message A message.
+ * \param size A buffer size.
  *
- * \return The message's header.
+ * \return The size class, or J_MESSAGE_POOL_CLASSES if buffers of the size are not pooled.
  **/
 static
-JMessageHeader*
-j_message_header (JMessage const* message)
+guint
+j_message_pool_get_class (gsize size)
 {
-	return (JMessageHeader*)message->data;
+	if (size <= (1 << J_MESSAGE_POOL_MIN_SHIFT))
+	{
+		return 0;
+	}
+
+	if (size > J_MESSAGE_POOL_MAX_SIZE)
+	{
+		return J_MESSAGE_POOL_CLASSES;
+	}
+
+	return g_bit_storage(size - 1) - J_MESSAGE_POOL_MIN_SHIFT;
 }
 
 /**
- * Returns a message's length.
+ * Allocates a message buffer, reusing one from the calling thread's pool if possible.
  *
  * \private
  *
  * \code
  * \endcode
  *
- * \param message A message.
+ * \param size The requested size, which is rounded up to the buffer's actual size.
  *
- * \return The message's length.
+ * \return A new buffer. Should be freed with j_message_buffer_free().
  **/
-static
-gsize
-j_message_length (JMessage const* message)
+gchar*
+j_message_buffer_new (gsize* size)
 {
-	guint32 length;
+	JMessagePool* pool;
+	guint size_class;
+
+	size_class = j_message_pool_get_class(*size);
 
-	length = j_message_header(message)->length;
+	if (size_class == J_MESSAGE_POOL_CLASSES)
+	{
+		return g_malloc(*size);
+	}
+
+	*size = 1 << (size_class + J_MESSAGE_POOL_MIN_SHIFT);
+	pool = g_private_get(&j_message_pool);
+
+	if (pool != NULL && pool->count[size_class] > 0)
+	{
+		pool->count[size_class]--;
+
+		return pool->buffers[size_class][pool->count[size_class]];
+	}
 
-	return GUINT32_FROM_LE(length);
+	return g_malloc(*size);
 }
 
-static
+/**
+ * Frees a message buffer, returning it to the calling thread's pool if possible.
+ * Buffers may be freed by another thread than the one that allocated them.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param buffer A buffer.
+ * \param size   The buffer's size.
+ **/
 void
-j_message_data_free (gpointer data)
+j_message_buffer_free (gchar* buffer, gsize size)
 {
-	g_slice_free(JMessageData, data);
+	JMessagePool* pool;
+	guint size_class;
+
+	size_class = j_message_pool_get_class(size);
+
+	/* Only buffers with exactly a class's size can be reused. */
+	if (size_class == J_MESSAGE_POOL_CLASSES || size != (gsize)1 << (size_class + J_MESSAGE_POOL_MIN_SHIFT))
+	{
+		g_free(buffer);
+		return;
+	}
+
+	pool = g_private_get(&j_message_pool);
+
+	if (G_UNLIKELY(pool == NULL))
+	{
+		pool = g_slice_new0(JMessagePool);
+		g_private_set(&j_message_pool, pool);
+	}
+
+	if (pool->count[size_class] == J_MESSAGE_POOL_DEPTH)
+	{
+		g_free(buffer);
+		return;
+	}
+
+	pool->buffers[size_class][pool->count[size_class]] = buffer;
+	pool->count[size_class]++;
 }
 
 /**
- * Checks whether it is possible to append data to a message.
- *
- * \private
+ * Checks whether it is possible to get data from a message.
+ * Should be used before getting data whose length has been taken from the message, see j_message_get_n().
  *
  * \code
  * \endcode
@@ -222,15 +275,19 @@ j_message_data_free (gpointer data)
  *
  * \return TRUE if it is possible, FALSE otherwise.
  **/
-static
 gboolean
-j_message_can_append (JMessage const* message, gsize length)
+j_message_can_get (JMessage const* message, gsize length)
 {
-	return (message->current + length <= message->data + message->size);
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(message != NULL, FALSE);
+
+	/* The length might be taken from the message, so it is compared without forming pointers beyond the data. */
+	return (length <= (gsize)(message->data + sizeof(JMessageHeader) + j_message_length(message) - message->current));
 }
 
 /**
- * Checks whether it is possible to get data from a message.
+ * Grows a message's buffer, keeping its contents.
  *
  * \private
  *
@@ -238,15 +295,33 @@ j_message_can_append (JMessage const* message, gsize length)
  * \endcode
  *
  * \param message A message.
- * \param length  A length.
- *
- * \return TRUE if it is possible, FALSE otherwise.
+ * \param size    The new size.
  **/
 static
-gboolean
-j_message_can_get (JMessage const* message, gsize length)
+void
+j_message_resize (JMessage* message, gsize size)
 {
-	return (message->current + length <= message->data + sizeof(JMessageHeader) + j_message_length(message));
+	gsize position;
+
+	position = message->current - message->data;
+
+	if (message->size > J_MESSAGE_POOL_MAX_SIZE)
+	{
+		/* Large buffers are not pooled, so they can be grown in place. */
+		message->data = g_realloc(message->data, size);
+	}
+	else
+	{
+		gchar* data;
+
+		data = j_message_buffer_new(&size);
+		memcpy(data, message->data, message->size);
+		j_message_buffer_free(message->data, message->size);
+		message->data = data;
+	}
+
+	message->size = size;
+	message->current = message->data + position;
 }
 
 static
@@ -255,7 +330,6 @@ j_message_extend (JMessage* message, gsize length)
 {
 	gsize factor = 1;
 	gsize current_length;
-	gsize position;
 	guint32 count;
 
 	if (length == 0)
@@ -277,29 +351,73 @@ j_message_extend (JMessage* message, gsize length)
 		factor = pow(10, floor(log10(count)));
 	}
 
-	message->size += length * factor;
-
-	position = message->current - message->data;
-	message->data = g_realloc(message->data, message->size);
-	message->current = message->data + position;
+	j_message_resize(message, message->size + length * factor);
 }
 
-static
+/**
+ * Makes sure that a message can hold at least the given number of bytes, including its header.
+ *
+ * \private
+ *
+ * \param message A message.
+ * \param length  A length.
+ **/
 void
 j_message_ensure_size (JMessage* message, gsize length)
 {
-	gsize position;
-
 	if (length <= message->size)
 	{
 		return;
 	}
 
-	message->size = length;
+	j_message_resize(message, length);
+}
 
-	position = message->current - message->data;
-	message->data = g_realloc(message->data, message->size);
-	message->current = message->data + position;
+/**
+ * Moves the data received for one message to another one.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param other   Another message.
+ **/
+void
+j_message_swap_data (JMessage* message, JMessage* other)
+{
+	JMessageSegment* segment;
+	JMessageShared shared;
+	JMessageStrings* strings;
+	GByteArray* read_ahead;
+	gchar* data;
+	gchar* current;
+	gsize size;
+
+	data = message->data;
+	current = message->current;
+	size = message->size;
+	segment = message->segment;
+	shared = message->shared;
+	strings = message->strings;
+	read_ahead = message->read_ahead;
+
+	message->data = other->data;
+	message->current = other->current;
+	message->size = other->size;
+	message->segment = other->segment;
+	message->shared = other->shared;
+	message->strings = other->strings;
+	message->read_ahead = other->read_ahead;
+
+	other->data = data;
+	other->current = current;
+	other->size = size;
+	other->segment = segment;
+	other->shared = shared;
+	other->strings = strings;
+	other->read_ahead = read_ahead;
 }
 
 /**
@@ -318,23 +436,31 @@ j_message_new (JMessageType op_type, gsize length)
 {
 	J_TRACE_FUNCTION(NULL);
 
+	static gint next_id = 0;
+
 	JMessage* message;
-	guint32 rand;
+	guint32 id;
 
 	//g_return_val_if_fail(op_type != J_MESSAGE_NONE, NULL);
 
-	rand = g_random_int();
+	/* IDs have to be unique among the messages in flight on a connection, see j_message_receive(). */
+	id = g_atomic_int_add(&next_id, 1);
 
 	message = g_slice_new(JMessage);
 	message->size = sizeof(JMessageHeader) + length;
-	message->data = g_malloc(message->size);
+	message->data = j_message_buffer_new(&(message->size));
 	message->current = message->data + sizeof(JMessageHeader);
-	message->send_list = j_list_new(j_message_data_free);
+	message->send_list = NULL;
+	message->receive_list = NULL;
+	message->string_offsets = NULL;
+	message->strings = NULL;
+	message->segment = NULL;
+	message->read_ahead = NULL;
 	message->original_message = NULL;
 	message->ref_count = 1;
 
 	j_message_header(message)->length = GUINT32_TO_LE(0);
-	j_message_header(message)->id = GUINT32_TO_LE(rand);
+	j_message_header(message)->id = GUINT32_TO_LE(id);
 	j_message_header(message)->semantics = GUINT32_TO_LE(0);
 	j_message_header(message)->op_type = GUINT32_TO_LE(op_type);
 	j_message_header(message)->op_count = GUINT32_TO_LE(0);
@@ -363,16 +489,21 @@ j_message_new_reply (JMessage* message)
 
 	reply = g_slice_new(JMessage);
 	reply->size = sizeof(JMessageHeader);
-	reply->data = g_malloc(reply->size);
+	reply->data = j_message_buffer_new(&(reply->size));
 	reply->current = reply->data + sizeof(JMessageHeader);
-	reply->send_list = j_list_new(j_message_data_free);
+	reply->send_list = NULL;
+	reply->receive_list = NULL;
+	reply->string_offsets = NULL;
+	reply->strings = NULL;
+	reply->segment = NULL;
+	reply->read_ahead = NULL;
 	reply->original_message = j_message_ref(message);
 	reply->ref_count = 1;
 
 	j_message_header(reply)->length = GUINT32_TO_LE(0);
 	j_message_header(reply)->id = j_message_header(message)->id;
 	j_message_header(reply)->semantics = GUINT32_TO_LE(0);
-	j_message_header(reply)->op_type = j_message_header(message)->op_type;
+	j_message_header(reply)->op_type = GUINT32_TO_LE(j_message_get_type(message));
 	j_message_header(reply)->op_count = GUINT32_TO_LE(0);
 
 	return reply;
@@ -431,7 +562,28 @@ j_message_unref (JMessage* message)
 			j_list_unref(message->send_list);
 		}
 
-		g_free(message->data);
+		if (message->receive_list != NULL)
+		{
+			g_array_unref(message->receive_list);
+		}
+
+		if (message->string_offsets != NULL)
+		{
+			g_array_unref(message->string_offsets);
+		}
+
+		if (message->strings != NULL)
+		{
+			j_message_strings_unref(message->strings);
+		}
+
+		if (message->read_ahead != NULL)
+		{
+			g_byte_array_unref(message->read_ahead);
+		}
+
+		j_message_release_shared(message);
+		j_message_buffer_free(message->data, message->size);
 
 		g_slice_free(JMessage, message);
 	}
@@ -457,7 +609,7 @@ j_message_get_type (JMessage const* message)
 	g_return_val_if_fail(message != NULL, J_MESSAGE_NONE);
 
 	op_type = j_message_header(message)->op_type;
-	op_type = GUINT32_FROM_LE(op_type);
+	op_type = GUINT32_FROM_LE(op_type) & ~J_MESSAGE_FLAGS;
 
 	return op_type;
 }
@@ -621,6 +773,31 @@ j_message_append_n (JMessage* message, gconstpointer data, gsize length)
 	return TRUE;
 }
 
+static
+gboolean
+j_message_append_string_internal (JMessage* message, gchar const* str, gboolean intern)
+{
+	JMessageString string;
+
+	string.offset = message->current - message->data;
+	string.intern = intern;
+
+	if (!j_message_append_n(message, str, strlen(str) + 1))
+	{
+		return FALSE;
+	}
+
+	/* Remember the string, so that it can be interned or escaped when the message is sent. */
+	if (message->string_offsets == NULL)
+	{
+		message->string_offsets = g_array_new(FALSE, FALSE, sizeof(JMessageString));
+	}
+
+	g_array_append_val(message->string_offsets, string);
+
+	return TRUE;
+}
+
 /**
  * Appends a string to a message.
  *
@@ -643,7 +820,32 @@ j_message_append_string (JMessage* message, gchar const* str)
 	g_return_val_if_fail(message != NULL, FALSE);
 	g_return_val_if_fail(str != NULL, FALSE);
 
-	return j_message_append_n(message, str, strlen(str) + 1);
+	return j_message_append_string_internal(message, str, FALSE);
+}
+
+/**
+ * Appends a namespace to a message.
+ * Namespaces are interned if interning is enabled for the connection, see j_message_enable_interning().
+ * Use j_message_get_string() to get it from a received message.
+ *
+ * \code
+ * j_message_append_namespace(message, "files");
+ * \endcode
+ *
+ * \param message A message.
+ * \param str     Namespace to append.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_append_namespace (JMessage* message, gchar const* str)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(message != NULL, FALSE);
+	g_return_val_if_fail(str != NULL, FALSE);
+
+	return j_message_append_string_internal(message, str, TRUE);
 }
 
 /**
@@ -770,121 +972,331 @@ j_message_get_string (JMessage* message)
 	J_TRACE_FUNCTION(NULL);
 
 	gchar const* ret;
+	gchar const* end;
 
 	g_return_val_if_fail(message != NULL, NULL);
+	g_return_val_if_fail(j_message_can_get(message, 1), NULL);
 
 	ret = message->current;
-	message->current += strlen(ret) + 1;
+
+	if (message->strings != NULL)
+	{
+		guchar first = ret[0];
+
+		if (first == J_MESSAGE_STRING_REFERENCE)
+		{
+			guint32 id;
+
+			g_return_val_if_fail(j_message_can_get(message, 1 + sizeof(guint32)), NULL);
+
+			memcpy(&id, message->current + 1, sizeof(guint32));
+			id = GUINT32_FROM_LE(id);
+			message->current += 1 + sizeof(guint32);
+
+			return j_message_strings_get(message->strings, id);
+		}
+		else if (first == J_MESSAGE_STRING_ESCAPE)
+		{
+			ret++;
+		}
+	}
+
+	/* The string has to be terminated within the message. */
+	end = memchr(ret, '\0', message->data + sizeof(JMessageHeader) + j_message_length(message) - ret);
+	g_return_val_if_fail(end != NULL, NULL);
+
+	message->current = (gchar*)end + 1;
 
 	return ret;
 }
 
 /**
- * Reads a message from the network.
+ * Writes data from a file descriptor to a stream.
+ * If #socket is not NULL and sendfile() is available, the data is transferred without copying it through user space.
+ *
+ * \private
  *
  * \code
  * \endcode
  *
- * \param message A message.
- * \parem stream  A network stream.
+ * \param message_data Message data with a file descriptor.
+ * \param stream       A stream.
+ * \param socket       The stream's socket, or NULL.
+ * \param error        A return location for an error.
  *
  * \return TRUE on success, FALSE if an error occurred.
  **/
+static
 gboolean
-j_message_receive (JMessage* message, gpointer connection)
+j_message_write_fd (JMessageData const* message_data, GOutputStream* stream, GSocket* socket, GError** error)
 {
-	J_TRACE_FUNCTION(NULL);
+	g_autofree gchar* buffer = NULL;
+	gsize buffer_size;
+	guint64 offset = message_data->offset;
+	guint64 remaining = message_data->length;
 
-	GInputStream* stream;
+#ifdef HAVE_SENDFILE
+	if (socket != NULL)
+	{
+		gint socket_fd;
 
-	g_return_val_if_fail(message != NULL, FALSE);
-	g_return_val_if_fail(connection != NULL, FALSE);
+		socket_fd = g_socket_get_fd(socket);
 
-	stream = g_io_stream_get_input_stream(G_IO_STREAM(connection));
-	return j_message_read(message, stream);
+		while (remaining > 0)
+		{
+			off_t file_offset = offset;
+			gssize nbytes;
+
+			nbytes = sendfile(socket_fd, message_data->fd, &file_offset, MIN(remaining, G_MAXINT32));
+
+			if (nbytes > 0)
+			{
+				offset += nbytes;
+				remaining -= nbytes;
+			}
+			else if (nbytes == 0)
+			{
+				/* The file has been truncated, this is detected below. */
+				break;
+			}
+			else if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				if (!g_socket_condition_wait(socket, G_IO_OUT, NULL, error))
+				{
+					return FALSE;
+				}
+			}
+			else if (errno == EINVAL || errno == ENOSYS)
+			{
+				/* The file does not support sendfile(), fall back to copying. */
+				break;
+			}
+			else if (errno != EINTR)
+			{
+				g_set_error_literal(error, G_IO_ERROR, g_io_error_from_errno(errno), g_strerror(errno));
+				return FALSE;
+			}
+		}
+	}
+#else
+	(void)socket;
+#endif
+
+	if (remaining == 0)
+	{
+		return TRUE;
+	}
+
+	buffer_size = MIN(remaining, 1024 * 1024);
+	buffer = g_malloc(buffer_size);
+
+	while (remaining > 0)
+	{
+		gssize nbytes;
+
+		nbytes = pread(message_data->fd, buffer, MIN(remaining, buffer_size), offset);
+
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			g_set_error_literal(error, G_IO_ERROR, g_io_error_from_errno(errno), g_strerror(errno));
+			return FALSE;
+		}
+		else if (nbytes == 0)
+		{
+			/* The receiver expects exactly length bytes, which a truncated file can not provide. */
+			g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED, "File has been truncated while sending it.");
+			return FALSE;
+		}
+
+		if (!g_output_stream_write_all(stream, buffer, nbytes, NULL, NULL, error))
+		{
+			return FALSE;
+		}
+
+		offset += nbytes;
+		remaining -= nbytes;
+	}
+
+	return TRUE;
 }
 
 /**
- * Writes a message to the network.
+ * Writes a list of buffers.
+ * Sockets are written to using vectored I/O, so that many small buffers only need few system calls.
+ *
+ * \private
  *
  * \code
  * \endcode
  *
- * \param message A message.
- * \parem stream  A network stream.
+ * \param vectors A list of buffers, modified while writing.
+ * \param stream  A stream.
+ * \param socket  The stream's socket, or NULL.
+ * \param error   A return location for an error.
  *
  * \return TRUE on success, FALSE if an error occurred.
  **/
+static
 gboolean
-j_message_send (JMessage* message, gpointer connection)
+j_message_write_vectors (GArray* vectors, GOutputStream* stream, GSocket* socket, GError** error)
 {
-	J_TRACE_FUNCTION(NULL);
+	GOutputVector* vector = (GOutputVector*)(gpointer)vectors->data;
+	guint count = vectors->len;
 
-	gboolean ret;
+	if (socket == NULL)
+	{
+		for (guint i = 0; i < count; i++)
+		{
+			if (!g_output_stream_write_all(stream, vector[i].buffer, vector[i].size, NULL, NULL, error))
+			{
+				return FALSE;
+			}
+		}
 
-	GOutputStream* stream;
+		g_array_set_size(vectors, 0);
 
-	g_return_val_if_fail(message != NULL, FALSE);
-	g_return_val_if_fail(connection != NULL, FALSE);
+		return TRUE;
+	}
 
-	j_helper_set_cork(connection, TRUE);
+	while (count > 0)
+	{
+		gssize nbytes;
 
-	stream = g_io_stream_get_output_stream(G_IO_STREAM(connection));
-	ret = j_message_write(message, stream);
+		/* sendmsg() fails for more than IOV_MAX buffers. */
+		nbytes = g_socket_send_message(socket, NULL, vector, MIN(count, IOV_MAX), NULL, 0, 0, NULL, error);
 
-	j_helper_set_cork(connection, FALSE);
+		if (nbytes <= 0)
+		{
+			return FALSE;
+		}
 
-	return ret;
+		/* Skip the buffers that have been written completely and adjust a partially written one. */
+		while (count > 0 && (gsize)nbytes >= vector->size)
+		{
+			nbytes -= vector->size;
+			vector++;
+			count--;
+		}
+
+		if (count > 0 && nbytes > 0)
+		{
+			vector->buffer = (gchar const*)vector->buffer + nbytes;
+			vector->size -= nbytes;
+		}
+	}
+
+	g_array_set_size(vectors, 0);
+
+	return TRUE;
 }
 
 /**
- * Reads a message from the network.
+ * Writes a message to a stream.
+ * The header, the data and all buffers to send are gathered and written together.
+ *
+ * \private
  *
  * \code
  * \endcode
  *
  * \param message A message.
- * \parem stream  A network stream.
+ * \param stream  A stream.
+ * \param socket  The stream's socket, or NULL.
+ * \param encoded The message's header and data with interned strings, or NULL.
+ * \param shared  The description of the message's additional data if it has been placed in a shared memory segment, or NULL.
  *
  * \return TRUE on success, FALSE if an error occurred.
  **/
+static
 gboolean
-j_message_read (JMessage* message, GInputStream* stream)
+j_message_write_internal (JMessage* message, GOutputStream* stream, GSocket* socket, GByteArray const* encoded, JMessageShared const* shared)
 {
-	J_TRACE_FUNCTION(NULL);
-
 	gboolean ret = FALSE;
 
+	g_autoptr(JListIterator) iterator = NULL;
+	g_autoptr(GArray) vectors = NULL;
+	GOutputVector vector;
 	GError* error = NULL;
-	gsize bytes_read;
+	JMessageHeader header;
+	JMessageShared shared_le;
 
-	g_return_val_if_fail(message != NULL, FALSE);
-	g_return_val_if_fail(stream != NULL, FALSE);
+	vectors = g_array_sized_new(FALSE, FALSE, sizeof(GOutputVector), (message->send_list != NULL) ? j_list_length(message->send_list) + 1 : 1);
 
-	if (!g_input_stream_read_all(stream, message->data, sizeof(JMessageHeader), &bytes_read, NULL, &error))
+	if (encoded != NULL)
 	{
-		goto end;
+		vector.buffer = encoded->data;
+		vector.size = encoded->len;
+	}
+	else
+	{
+		vector.buffer = message->data;
+		vector.size = sizeof(JMessageHeader) + j_message_length(message);
 	}
 
-	if (bytes_read == 0)
+	if (shared != NULL)
 	{
-		goto end;
+		GOutputVector shared_vector;
+
+		/* The flag is only set in a copy of the header, the message might be sent again via another connection. */
+		memcpy(&header, vector.buffer, sizeof(JMessageHeader));
+		header.op_type = GUINT32_TO_LE(GUINT32_FROM_LE(header.op_type) | J_MESSAGE_FLAG_SHARED);
+
+		shared_le.position = GUINT64_TO_LE(shared->position);
+		shared_le.end = GUINT64_TO_LE(shared->end);
+		shared_le.length = GUINT64_TO_LE(shared->length);
+
+		shared_vector.buffer = &header;
+		shared_vector.size = sizeof(JMessageHeader);
+		g_array_append_val(vectors, shared_vector);
+
+		shared_vector.buffer = &shared_le;
+		shared_vector.size = sizeof(JMessageShared);
+		g_array_append_val(vectors, shared_vector);
+
+		vector.buffer = (gchar const*)vector.buffer + sizeof(JMessageHeader);
+		vector.size -= sizeof(JMessageHeader);
 	}
 
-	j_message_ensure_size(message, sizeof(JMessageHeader) + j_message_length(message));
+	g_array_append_val(vectors, vector);
 
-	if (!g_input_stream_read_all(stream, message->data + sizeof(JMessageHeader), j_message_length(message), &bytes_read, NULL, &error))
+	if (message->send_list != NULL && shared == NULL)
 	{
-		goto end;
-	}
+		iterator = j_list_iterator_new(message->send_list);
 
-	message->current = message->data + sizeof(JMessageHeader);
+		while (j_list_iterator_next(iterator))
+		{
+			JMessageData* message_data = j_list_iterator_get(iterator);
 
-	if (message->original_message != NULL)
+			if (message_data->fd != -1)
+			{
+				/* Data from file descriptors is sent separately, so everything before it has to be written first. */
+				if (!j_message_write_vectors(vectors, stream, socket, &error)
+				    || !j_message_write_fd(message_data, stream, socket, &error))
+				{
+					goto end;
+				}
+
+				continue;
+			}
+
+			vector.buffer = message_data->data;
+			vector.size = message_data->length;
+			g_array_append_val(vectors, vector);
+		}
+	}
+
+	if (!j_message_write_vectors(vectors, stream, socket, &error))
 	{
-		g_assert(j_message_header(message)->id == j_message_header(message->original_message)->id);
+		goto end;
 	}
 
+	g_output_stream_flush(stream, NULL, NULL);
+
 	ret = TRUE;
 
 end:
@@ -897,6 +1309,226 @@ end:
 	return ret;
 }
 
+/**
+ * Reads the additional data following a reply, so that the reply can be kept while waiting for another one.
+ * The data is handed out by j_message_receive_data() later.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A reply.
+ * \param stream  A network stream.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_read_ahead (JMessage* message, GInputStream* stream)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_autofree JMessageObjectReadReply* operations = NULL;
+	GError* error = NULL;
+	gchar* current;
+	guint32 count;
+	guint64 length = 0;
+	guint64 shared_length = 0;
+
+	/* Only replies to reads are followed by additional data. */
+	if (j_message_get_type(message) != J_MESSAGE_OBJECT_READ)
+	{
+		return TRUE;
+	}
+
+	count = j_message_get_count(message);
+	current = message->current;
+
+	if (!j_message_get_object_read_reply(message, count, &operations))
+	{
+		return FALSE;
+	}
+
+	message->current = current;
+
+	for (guint32 i = 0; i < count; i++)
+	{
+		length += operations[i].bytes_read;
+	}
+
+	/* Data placed in a shared memory segment is not sent over the connection, see j_message_receive_data(). */
+	if (message->segment != NULL)
+	{
+		shared_length = message->shared.length;
+	}
+
+	if (length <= shared_length)
+	{
+		return TRUE;
+	}
+
+	length -= shared_length;
+
+	/* Replies to reads are limited to the maximum operation size per operation, which is much smaller. */
+	if (length > G_MAXUINT32)
+	{
+		return FALSE;
+	}
+
+	message->read_ahead = g_byte_array_sized_new(length);
+	g_byte_array_set_size(message->read_ahead, length);
+
+	if (!g_input_stream_read_all(stream, message->read_ahead->data, length, NULL, NULL, &error))
+	{
+		g_critical("%s", error->message);
+		g_error_free(error);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Prepares a message that has been read completely for being handled.
+ * Its shared data is attached and its interned strings are resolved.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message that is not a reply.
+ * \param state   The state of the connection the message has been read from.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_receive_finish (JMessage* message, JMessageConnection* state)
+{
+	if (!j_message_attach_shared(message, state))
+	{
+		return FALSE;
+	}
+
+	if (GUINT32_FROM_LE(j_message_header(message)->op_type) & J_MESSAGE_FLAG_STRINGS)
+	{
+		return j_message_decode_strings(message, state);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Reads a message from the network.
+ *
+ * If #message is a reply, replies are matched with their original messages using the message ID.
+ * Replies to other messages that arrive in the meantime are kept until they are requested.
+ * On connections driven by the engine, replies are read by the engine thread instead, see j_message_enable_engine().
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \parem stream  A network stream.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_receive (JMessage* message, gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GInputStream* stream;
+	JMessageConnection* state;
+	guint32 id;
+
+	g_return_val_if_fail(message != NULL, FALSE);
+	g_return_val_if_fail(connection != NULL, FALSE);
+
+	stream = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+	state = j_message_connection_get(connection);
+
+	/* Messages might be reused, the previous message's shared data is not needed anymore. */
+	j_message_release_shared(message);
+
+	if (message->read_ahead != NULL)
+	{
+		g_byte_array_unref(message->read_ahead);
+		message->read_ahead = NULL;
+	}
+
+	if (message->strings != NULL)
+	{
+		j_message_strings_unref(message->strings);
+		message->strings = NULL;
+	}
+
+	if (message->original_message == NULL)
+	{
+		return (j_message_read(message, stream) && j_message_receive_finish(message, state));
+	}
+
+	id = j_message_header(message->original_message)->id;
+
+	if (state->channel != NULL)
+	{
+		return j_message_channel_receive(state->channel, message, id);
+	}
+
+	if (state->pending != NULL)
+	{
+		JMessage* reply;
+
+		reply = g_hash_table_lookup(state->pending, GUINT_TO_POINTER(id));
+
+		if (reply != NULL)
+		{
+			g_hash_table_steal(state->pending, GUINT_TO_POINTER(id));
+
+			j_message_swap_data(message, reply);
+			j_message_unref(reply);
+
+			return TRUE;
+		}
+	}
+
+	while (j_message_read(message, stream))
+	{
+		JMessage* reply;
+
+		if (!j_message_attach_shared(message, state))
+		{
+			return FALSE;
+		}
+
+		if (j_message_header(message)->id == id)
+		{
+			return TRUE;
+		}
+
+		reply = j_message_new(J_MESSAGE_NONE, 0);
+		j_message_swap_data(message, reply);
+
+		/* The data following the kept reply has to be read, it would otherwise be mistaken for the next reply. */
+		if (!j_message_read_ahead(reply, stream))
+		{
+			j_message_unref(reply);
+			return FALSE;
+		}
+
+		if (state->pending == NULL)
+		{
+			state->pending = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)j_message_unref);
+		}
+
+		g_hash_table_insert(state->pending, GUINT_TO_POINTER(j_message_header(reply)->id), reply);
+	}
+
+	return FALSE;
+}
+
 /**
  * Writes a message to the network.
  *
@@ -909,47 +1541,206 @@ end:
  * \return TRUE on success, FALSE if an error occurred.
  **/
 gboolean
-j_message_write (JMessage* message, GOutputStream* stream)
+j_message_send (JMessage* message, gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gboolean ret;
+
+	g_autoptr(GByteArray) encoded = NULL;
+	GByteArray* compressed;
+	GOutputStream* stream;
+	JMessageConnection* state;
+	JMessageSegment* segment;
+	JMessageShared shared;
+	JMessageStrings* strings;
+	gboolean have_shared = FALSE;
+
+	g_return_val_if_fail(message != NULL, FALSE);
+	g_return_val_if_fail(connection != NULL, FALSE);
+
+	j_helper_atomic_add(&j_message_sent, 1);
+
+	state = j_message_connection_get(connection);
+
+	if (state->channel != NULL)
+	{
+		return j_message_channel_send(state->channel, state, message);
+	}
+
+	stream = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	strings = state->strings_send;
+	segment = state->segment;
+
+	if (segment != NULL && (!j_message_segment_is_active(segment) || message->send_list == NULL))
+	{
+		segment = NULL;
+	}
+
+	if (strings == NULL && state->compressor.algorithm == J_MESSAGE_COMPRESSION_NONE && segment == NULL)
+	{
+		return j_message_write_internal(message, stream, g_socket_connection_get_socket(connection), NULL, NULL);
+	}
+
+	/* IDs have to arrive in the order they are assigned in, so the dictionary stays locked until the message has been written. */
+	if (strings != NULL)
+	{
+		j_message_strings_lock(strings);
+		encoded = j_message_encode_strings(message, strings);
+	}
+
+	compressed = j_message_compress(message, (encoded != NULL) ? (gchar const*)encoded->data : message->data, &(state->compressor));
+
+	if (compressed != NULL)
+	{
+		g_clear_pointer(&encoded, g_byte_array_unref);
+		encoded = compressed;
+	}
+
+	/* The data has to arrive in the order it is placed in the segment, so the segment stays locked until the message has been written. */
+	if (segment != NULL)
+	{
+		j_message_segment_lock(segment);
+
+		/* Data that does not fit into the segment is sent via the connection. */
+		have_shared = j_message_segment_write(segment, message, &shared);
+	}
+
+	ret = j_message_write_internal(message, stream, g_socket_connection_get_socket(connection), encoded, (have_shared) ? &shared : NULL);
+
+	if (segment != NULL)
+	{
+		j_message_segment_unlock(segment);
+	}
+
+	if (strings != NULL)
+	{
+		j_message_strings_unlock(strings);
+	}
+
+	return ret;
+}
+
+/**
+ * Sends a message without waiting for it to be written or answered.
+ * On connections driven by the engine, the message is queued and its replies are handed to #reply_func by the engine thread, see j_message_enable_engine().
+ * Otherwise, the message is sent and its replies are received in the calling thread before this function returns.
+ *
+ * #done_func is called exactly once, after the last reply's data has been received or, if #reply_func is NULL, after the message has been written.
+ * The message's data and the buffers added to the replies have to stay valid until then.
+ * If #reply_func is not NULL, the message's semantics have to make the server reply.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message    A message.
+ * \param connection A connection.
+ * \param reply_func A function to handle the replies, or NULL.
+ * \param done_func  A function to call once the message has been handled.
+ * \param data       Data to pass to #reply_func and #done_func.
+ **/
+void
+j_message_send_async (JMessage* message, gpointer connection, JMessageReplyFunc reply_func, JMessageDoneFunc done_func, gpointer data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_autoptr(JMessage) reply = NULL;
+	JMessageConnection* state;
+	gboolean ret;
+
+	g_return_if_fail(message != NULL);
+	g_return_if_fail(connection != NULL);
+	g_return_if_fail(done_func != NULL);
+
+	state = j_message_connection_get(connection);
+
+	if (state->channel != NULL)
+	{
+		j_helper_atomic_add(&j_message_sent, 1);
+		j_message_channel_submit(state->channel, state, message, reply_func, done_func, data);
+
+		return;
+	}
+
+	ret = j_message_send(message, connection);
+
+	if (ret && reply_func != NULL)
+	{
+		gboolean last = FALSE;
+
+		reply = j_message_new_reply(message);
+
+		while (ret && !last)
+		{
+			ret = j_message_receive(reply, connection);
+
+			if (ret)
+			{
+				last = reply_func(reply, data);
+				ret = j_message_receive_data(reply, connection);
+			}
+		}
+	}
+
+	done_func(ret, data);
+}
+
+/**
+ * Reads a message from the network.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \parem stream  A network stream.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_read (JMessage* message, GInputStream* stream)
 {
 	J_TRACE_FUNCTION(NULL);
 
 	gboolean ret = FALSE;
 
-	g_autoptr(JListIterator) iterator = NULL;
 	GError* error = NULL;
-	gsize bytes_written;
+	gsize bytes_read;
 
 	g_return_val_if_fail(message != NULL, FALSE);
 	g_return_val_if_fail(stream != NULL, FALSE);
 
-	if (!g_output_stream_write_all(stream, message->data, sizeof(JMessageHeader) + j_message_length(message), &bytes_written, NULL, &error))
+	if (!g_input_stream_read_all(stream, message->data, sizeof(JMessageHeader), &bytes_read, NULL, &error))
 	{
 		goto end;
 	}
 
-	if (bytes_written == 0)
+	if (bytes_read == 0)
 	{
 		goto end;
 	}
 
-	if (message->send_list != NULL)
+	if (GUINT32_FROM_LE(j_message_header(message)->op_type) & J_MESSAGE_FLAG_SHARED)
 	{
-		iterator = j_list_iterator_new(message->send_list);
-
-		while (j_list_iterator_next(iterator))
+		if (!g_input_stream_read_all(stream, &(message->shared), sizeof(JMessageShared), &bytes_read, NULL, &error))
 		{
-			JMessageData* message_data = j_list_iterator_get(iterator);
-
-			if (!g_output_stream_write_all(stream, message_data->data, message_data->length, &bytes_written, NULL, &error))
-			{
-				goto end;
-			}
+			goto end;
 		}
+
+		message->shared.position = GUINT64_FROM_LE(message->shared.position);
+		message->shared.end = GUINT64_FROM_LE(message->shared.end);
+		message->shared.length = GUINT64_FROM_LE(message->shared.length);
 	}
 
-	g_output_stream_flush(stream, NULL, NULL);
+	j_message_ensure_size(message, sizeof(JMessageHeader) + j_message_length(message));
 
-	ret = TRUE;
+	if (!g_input_stream_read_all(stream, message->data + sizeof(JMessageHeader), j_message_length(message), &bytes_read, NULL, &error))
+	{
+		goto end;
+	}
+
+	message->current = message->data + sizeof(JMessageHeader);
+
+	ret = j_message_decompress(message);
 
 end:
 	if (error != NULL)
@@ -961,6 +1752,45 @@ end:
 	return ret;
 }
 
+/**
+ * Writes a message to the network.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \parem stream  A network stream.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_write (JMessage* message, GOutputStream* stream)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(message != NULL, FALSE);
+	g_return_val_if_fail(stream != NULL, FALSE);
+
+	return j_message_write_internal(message, stream, NULL, NULL, NULL);
+}
+
+/**
+ * Returns the number of messages sent by this process.
+ * Allows measuring how many messages batches are split into.
+ *
+ * \code
+ * \endcode
+ *
+ * \return The number of messages.
+ **/
+guint64
+j_message_get_sent_count (void)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	return j_helper_atomic_add(&j_message_sent, 0);
+}
+
 /**
  * Adds new data to send to a message.
  *
@@ -985,10 +1815,230 @@ j_message_add_send (JMessage* message, gconstpointer data, guint64 length)
 	message_data = g_slice_new(JMessageData);
 	message_data->data = data;
 	message_data->length = length;
+	message_data->fd = -1;
+	message_data->offset = 0;
+
+	if (message->send_list == NULL)
+	{
+		message->send_list = j_list_new(j_message_data_free);
+	}
+
+	j_list_append(message->send_list, message_data);
+}
+
+/**
+ * Adds new data to send to a message.
+ * The data is read from a file descriptor when the message is sent.
+ * The file descriptor has to stay valid until then.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param fd      A file descriptor.
+ * \param offset  An offset within #fd.
+ * \param length  A length.
+ **/
+void
+j_message_add_send_fd (JMessage* message, gint fd, guint64 offset, guint64 length)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageData* message_data;
+
+	g_return_if_fail(message != NULL);
+	g_return_if_fail(fd >= 0);
+	g_return_if_fail(length > 0);
+
+	message_data = g_slice_new(JMessageData);
+	message_data->data = NULL;
+	message_data->length = length;
+	message_data->fd = fd;
+	message_data->offset = offset;
+
+	if (message->send_list == NULL)
+	{
+		message->send_list = j_list_new(j_message_data_free);
+	}
 
 	j_list_append(message->send_list, message_data);
 }
 
+/**
+ * Adds a buffer to receive data into.
+ * Used for data following a reply, such as the results of object reads.
+ * All buffers are filled in the order they were added by j_message_receive_data().
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param data    A buffer.
+ * \param length  The number of bytes to receive into #data.
+ **/
+void
+j_message_add_receive (JMessage* message, gpointer data, guint64 length)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GInputVector vector;
+
+	g_return_if_fail(message != NULL);
+	g_return_if_fail(data != NULL);
+	g_return_if_fail(length > 0);
+
+	if (message->receive_list == NULL)
+	{
+		message->receive_list = g_array_new(FALSE, FALSE, sizeof(GInputVector));
+	}
+
+	vector.buffer = data;
+	vector.size = length;
+
+	g_array_append_val(message->receive_list, vector);
+}
+
+/**
+ * Receives the data following a message into the buffers added with j_message_add_receive().
+ * The data is read directly into the buffers, using vectored I/O for sockets.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message    A message.
+ * \param connection A connection.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_receive_data (JMessage* message, gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gboolean ret = FALSE;
+
+	JMessageConnection* state;
+	GError* error = NULL;
+	GInputVector* vector;
+	guint count;
+
+	g_return_val_if_fail(message != NULL, FALSE);
+	g_return_val_if_fail(connection != NULL, FALSE);
+
+	if (message->receive_list == NULL || message->receive_list->len == 0)
+	{
+		return TRUE;
+	}
+
+	vector = (GInputVector*)(gpointer)message->receive_list->data;
+	count = message->receive_list->len;
+
+	if (message->segment != NULL)
+	{
+		guint64 remaining = message->shared.length;
+
+		/* Buffers are filled from the segment first, the remaining ones are received from the connection. */
+		while (count > 0 && vector->size <= remaining)
+		{
+			memcpy(vector->buffer, j_message_get_shared(message, vector->size), vector->size);
+			remaining -= vector->size;
+			vector++;
+			count--;
+		}
+
+		j_message_release_shared(message);
+	}
+
+	/* The data of kept replies has already been read, see j_message_read_ahead(). */
+	if (message->read_ahead != NULL)
+	{
+		gsize position = 0;
+
+		for (guint i = 0; i < count; i++)
+		{
+			if (vector[i].size > message->read_ahead->len - position)
+			{
+				goto end;
+			}
+
+			memcpy(vector[i].buffer, message->read_ahead->data + position, vector[i].size);
+			position += vector[i].size;
+		}
+
+		g_byte_array_unref(message->read_ahead);
+		message->read_ahead = NULL;
+
+		count = 0;
+	}
+
+	/* Only the engine thread reads from connections driven by the engine, it has read the data of all replies it kept. */
+	if (count > 0 && (state = j_message_connection_lookup(connection)) != NULL && state->channel != NULL)
+	{
+		g_critical("Reply data has to be received via j_message_send_async() on connections driven by the engine.");
+		goto end;
+	}
+
+	if (!G_IS_SOCKET_CONNECTION(connection))
+	{
+		GInputStream* stream;
+
+		stream = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+
+		for (guint i = 0; i < count; i++)
+		{
+			if (!g_input_stream_read_all(stream, vector[i].buffer, vector[i].size, NULL, NULL, &error))
+			{
+				goto end;
+			}
+		}
+
+		count = 0;
+	}
+
+	while (count > 0)
+	{
+		GSocket* socket;
+		gssize nbytes;
+
+		socket = g_socket_connection_get_socket(connection);
+
+		/* recvmsg() fails for more than IOV_MAX buffers. */
+		nbytes = g_socket_receive_message(socket, NULL, vector, MIN(count, IOV_MAX), NULL, NULL, NULL, NULL, &error);
+
+		if (nbytes <= 0)
+		{
+			goto end;
+		}
+
+		/* Skip the buffers that have been filled completely and adjust a partially filled one. */
+		while (count > 0 && (gsize)nbytes >= vector->size)
+		{
+			nbytes -= vector->size;
+			vector++;
+			count--;
+		}
+
+		if (count > 0 && nbytes > 0)
+		{
+			vector->buffer = (gchar*)vector->buffer + nbytes;
+			vector->size -= nbytes;
+		}
+	}
+
+	ret = TRUE;
+
+end:
+	g_array_set_size(message->receive_list, 0);
+
+	if (error != NULL)
+	{
+		g_critical("%s", error->message);
+		g_error_free(error);
+	}
+
+	return ret;
+}
+
 /**
  * Adds a new operation to a message.
  *
@@ -52,12 +52,89 @@ j_operation_new (void)
 	operation = g_slice_new(JOperation);
 	operation->key = NULL;
 	operation->data = NULL;
+	operation->resource = NULL;
 	operation->exec_func = NULL;
+	operation->exec_async_func = NULL;
 	operation->free_func = NULL;
 
 	return operation;
 }
 
+/**
+ * Waits for asynchronously executed operations.
+ **/
+struct JOperationWait
+{
+	GMutex mutex[1];
+	GCond cond[1];
+	gboolean done;
+	gboolean ret;
+};
+
+typedef struct JOperationWait JOperationWait;
+
+static
+void
+j_operation_wait_done (gboolean ret, gpointer data)
+{
+	JOperationWait* wait = data;
+
+	g_mutex_lock(wait->mutex);
+	wait->ret = ret;
+	wait->done = TRUE;
+	g_cond_signal(wait->cond);
+	g_mutex_unlock(wait->mutex);
+}
+
+/**
+ * Executes operations asynchronously and waits until they are done.
+ * Allows exec functions to be implemented once for both synchronous and asynchronous execution.
+ *
+ * \code
+ * static gboolean
+ * j_object_create_exec (JList* operations, JSemantics* semantics)
+ * {
+ *   return j_operation_wait(j_object_create_exec_async, operations, semantics);
+ * }
+ * \endcode
+ *
+ * \param func       An asynchronous exec function.
+ * \param operations The operations' data.
+ * \param semantics  The semantics.
+ *
+ * \return The operations' result.
+ **/
+gboolean
+j_operation_wait (JOperationExecAsyncFunc func, JList* operations, JSemantics* semantics)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JOperationWait wait[1];
+
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	g_mutex_init(wait->mutex);
+	g_cond_init(wait->cond);
+	wait->done = FALSE;
+	wait->ret = FALSE;
+
+	func(operations, semantics, j_operation_wait_done, wait);
+
+	g_mutex_lock(wait->mutex);
+
+	while (!wait->done)
+	{
+		g_cond_wait(wait->cond, wait->mutex);
+	}
+
+	g_mutex_unlock(wait->mutex);
+
+	g_cond_clear(wait->cond);
+	g_mutex_clear(wait->mutex);
+
+	return wait->ret;
+}
+
 /**
  * Frees the memory allocated by an operation.
  *
@@ -25,6 +25,7 @@
 #include <glib.h>
 
 #include <jstatistics.h>
+#include <jhelper.h>
 #include <jtrace.h>
 
 /**
@@ -82,6 +83,16 @@ struct JStatistics
 	 * The number of sent bytes.
 	 **/
 	guint64 bytes_sent;
+
+	/**
+	 * The number of message bytes before compression.
+	 **/
+	guint64 bytes_uncompressed;
+
+	/**
+	 * The number of message bytes after compression.
+	 **/
+	guint64 bytes_compressed;
 };
 
 static
@@ -106,6 +117,10 @@ j_statistics_get_type_name (JStatisticsType type)
 			return "bytes_received";
 		case J_STATISTICS_BYTES_SENT:
 			return "bytes_sent";
+		case J_STATISTICS_BYTES_UNCOMPRESSED:
+			return "bytes_uncompressed";
+		case J_STATISTICS_BYTES_COMPRESSED:
+			return "bytes_compressed";
 		default:
 			g_warn_if_reached();
 			return NULL;
@@ -142,6 +157,8 @@ j_statistics_new (gboolean trace)
 	statistics->bytes_written = 0;
 	statistics->bytes_received = 0;
 	statistics->bytes_sent = 0;
+	statistics->bytes_uncompressed = 0;
+	statistics->bytes_compressed = 0;
 
 	return statistics;
 }
@@ -201,6 +218,12 @@ j_statistics_get (JStatistics* statistics, JStatisticsType type)
 		case J_STATISTICS_BYTES_SENT:
 			value = statistics->bytes_sent;
 			break;
+		case J_STATISTICS_BYTES_UNCOMPRESSED:
+			value = statistics->bytes_uncompressed;
+			break;
+		case J_STATISTICS_BYTES_COMPRESSED:
+			value = statistics->bytes_compressed;
+			break;
 		default:
 			g_warn_if_reached();
 			break;
@@ -209,6 +232,17 @@ j_statistics_get (JStatistics* statistics, JStatisticsType type)
 	return value;
 }
 
+/**
+ * Adds a value to a statistics counter.
+ * Counters are updated atomically, so the same statistics can be shared by multiple threads.
+ *
+ * \code
+ * \endcode
+ *
+ * \param statistics A statistics object.
+ * \param type       A statistics type.
+ * \param value      A value.
+ **/
 void
 j_statistics_add (JStatistics* statistics, JStatisticsType type, guint64 value)
 {
@@ -219,28 +253,34 @@ j_statistics_add (JStatistics* statistics, JStatisticsType type, guint64 value)
 	switch (type)
 	{
 		case J_STATISTICS_FILES_CREATED:
-			statistics->files_created += value;
+			j_helper_atomic_add(&(statistics->files_created), value);
 			break;
 		case J_STATISTICS_FILES_DELETED:
-			statistics->files_deleted += value;
+			j_helper_atomic_add(&(statistics->files_deleted), value);
 			break;
 		case J_STATISTICS_FILES_STATED:
-			statistics->files_stated += value;
+			j_helper_atomic_add(&(statistics->files_stated), value);
 			break;
 		case J_STATISTICS_SYNC:
-			statistics->sync_count += value;
+			j_helper_atomic_add(&(statistics->sync_count), value);
 			break;
 		case J_STATISTICS_BYTES_READ:
-			statistics->bytes_read += value;
+			j_helper_atomic_add(&(statistics->bytes_read), value);
 			break;
 		case J_STATISTICS_BYTES_WRITTEN:
-			statistics->bytes_written += value;
+			j_helper_atomic_add(&(statistics->bytes_written), value);
 			break;
 		case J_STATISTICS_BYTES_RECEIVED:
-			statistics->bytes_received += value;
+			j_helper_atomic_add(&(statistics->bytes_received), value);
 			break;
 		case J_STATISTICS_BYTES_SENT:
-			statistics->bytes_sent += value;
+			j_helper_atomic_add(&(statistics->bytes_sent), value);
+			break;
+		case J_STATISTICS_BYTES_UNCOMPRESSED:
+			j_helper_atomic_add(&(statistics->bytes_uncompressed), value);
+			break;
+		case J_STATISTICS_BYTES_COMPRESSED:
+			j_helper_atomic_add(&(statistics->bytes_compressed), value);
 			break;
 		default:
 			g_warn_if_reached();
@@ -0,0 +1,397 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <string.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <jhelper.h>
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+/**
+ * The maximum ratio between a message's uncompressed and compressed data lengths.
+ * The uncompressed length is read from the network, limiting it prevents peers from making the receiver allocate large buffers using small messages.
+ * Data that compresses better is sent uncompressed.
+ **/
+#define J_MESSAGE_COMPRESSION_RATIO_MAX 256
+
+/**
+ * The number of bytes before and after compression, counting compressed and decompressed messages.
+ **/
+static guint64 j_message_bytes_uncompressed = 0;
+static guint64 j_message_bytes_compressed = 0;
+
+/**
+ * Checks whether a message type carries payloads worth compressing.
+ * Object messages only contain metadata, their data is sent separately.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param type A message type.
+ *
+ * \return TRUE if messages of the type should be compressed, FALSE otherwise.
+ **/
+static
+gboolean
+j_message_type_is_compressible (JMessageType type)
+{
+	switch (type)
+	{
+		case J_MESSAGE_KV_PUT:
+		case J_MESSAGE_KV_GET:
+		case J_MESSAGE_KV_GET_ALL:
+		case J_MESSAGE_KV_GET_BY_PREFIX:
+		case J_MESSAGE_DB_SCHEMA_CREATE:
+		case J_MESSAGE_DB_SCHEMA_GET:
+		case J_MESSAGE_DB_INSERT:
+		case J_MESSAGE_DB_UPDATE:
+		case J_MESSAGE_DB_DELETE:
+		case J_MESSAGE_DB_QUERY:
+			return TRUE;
+		case J_MESSAGE_NONE:
+		case J_MESSAGE_PING:
+		case J_MESSAGE_STATISTICS:
+		case J_MESSAGE_OBJECT_CREATE:
+		case J_MESSAGE_OBJECT_DELETE:
+		case J_MESSAGE_OBJECT_READ:
+		case J_MESSAGE_OBJECT_STATUS:
+		case J_MESSAGE_OBJECT_WRITE:
+		case J_MESSAGE_KV_DELETE:
+		case J_MESSAGE_DB_SCHEMA_DELETE:
+		default:
+			return FALSE;
+	}
+}
+
+/**
+ * Compresses a message's data.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message    A message.
+ * \param data       The message's header and data, which might differ from the message's own if its strings have been interned.
+ * \param compressor Compression settings.
+ *
+ * \return The compressed message, or NULL if the data should be sent uncompressed.
+ **/
+GByteArray*
+j_message_compress (JMessage* message, gchar const* data, JMessageCompressor const* compressor)
+{
+	g_autoptr(GByteArray) compressed = NULL;
+	JMessageHeader header;
+	gsize length;
+	gsize bound = 0;
+	gsize compressed_length = 0;
+	guint32 flag = 0;
+	guint32 length_le;
+
+	if (compressor->algorithm == J_MESSAGE_COMPRESSION_NONE || !j_message_type_is_compressible(j_message_get_type(message)))
+	{
+		return NULL;
+	}
+
+	memcpy(&header, data, sizeof(JMessageHeader));
+	length = GUINT32_FROM_LE(header.length);
+
+	if (length < compressor->threshold || length < sizeof(guint32))
+	{
+		return NULL;
+	}
+
+	switch (compressor->algorithm)
+	{
+		case J_MESSAGE_COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+			bound = LZ4_compressBound(length);
+			flag = J_MESSAGE_FLAG_LZ4;
+#endif
+			break;
+		case J_MESSAGE_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+			bound = ZSTD_compressBound(length);
+			flag = J_MESSAGE_FLAG_ZSTD;
+#endif
+			break;
+		case J_MESSAGE_COMPRESSION_NONE:
+		default:
+			break;
+	}
+
+	if (bound == 0)
+	{
+		return NULL;
+	}
+
+	compressed = g_byte_array_sized_new(sizeof(JMessageHeader) + sizeof(guint32) + bound);
+	g_byte_array_set_size(compressed, sizeof(JMessageHeader) + sizeof(guint32) + bound);
+
+	switch (compressor->algorithm)
+	{
+		case J_MESSAGE_COMPRESSION_LZ4:
+#ifdef HAVE_LZ4
+			compressed_length = LZ4_compress_default(data + sizeof(JMessageHeader), (gchar*)compressed->data + sizeof(JMessageHeader) + sizeof(guint32), length, bound);
+#endif
+			break;
+		case J_MESSAGE_COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+			compressed_length = ZSTD_compress(compressed->data + sizeof(JMessageHeader) + sizeof(guint32), bound, data + sizeof(JMessageHeader), length, 1);
+
+			if (ZSTD_isError(compressed_length))
+			{
+				compressed_length = 0;
+			}
+#endif
+			break;
+		case J_MESSAGE_COMPRESSION_NONE:
+		default:
+			break;
+	}
+
+	/* Incompressible data is sent as is, as is data the receiver would reject, see j_message_decompress(). */
+	if (compressed_length == 0 || sizeof(guint32) + compressed_length >= length || length / J_MESSAGE_COMPRESSION_RATIO_MAX > sizeof(guint32) + compressed_length)
+	{
+		return NULL;
+	}
+
+	j_helper_atomic_add(&j_message_bytes_uncompressed, length);
+	j_helper_atomic_add(&j_message_bytes_compressed, sizeof(guint32) + compressed_length);
+
+	header.length = GUINT32_TO_LE(sizeof(guint32) + compressed_length);
+	header.op_type = GUINT32_TO_LE(GUINT32_FROM_LE(header.op_type) | flag);
+	length_le = GUINT32_TO_LE(length);
+
+	memcpy(compressed->data, &header, sizeof(JMessageHeader));
+	memcpy(compressed->data + sizeof(JMessageHeader), &length_le, sizeof(guint32));
+	g_byte_array_set_size(compressed, sizeof(JMessageHeader) + sizeof(guint32) + compressed_length);
+
+	return g_steal_pointer(&compressed);
+}
+
+/**
+ * Decompresses a received message's data in place.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_decompress (JMessage* message)
+{
+	JMessageHeader* header;
+	gchar* data;
+	gsize length;
+	gsize size;
+	gsize decompressed_length = 0;
+	guint32 op_type;
+	guint32 uncompressed_length;
+
+	header = j_message_header(message);
+	op_type = GUINT32_FROM_LE(header->op_type);
+
+	if (!(op_type & (J_MESSAGE_FLAG_LZ4 | J_MESSAGE_FLAG_ZSTD)))
+	{
+		return TRUE;
+	}
+
+	length = j_message_length(message);
+
+	if (length < sizeof(guint32))
+	{
+		goto error;
+	}
+
+	memcpy(&uncompressed_length, message->data + sizeof(JMessageHeader), sizeof(guint32));
+	uncompressed_length = GUINT32_FROM_LE(uncompressed_length);
+
+	/* The length has to be checked before allocating the buffer, see J_MESSAGE_COMPRESSION_RATIO_MAX. */
+	if (uncompressed_length / J_MESSAGE_COMPRESSION_RATIO_MAX > length)
+	{
+		goto error;
+	}
+
+	size = sizeof(JMessageHeader) + uncompressed_length;
+	data = j_message_buffer_new(&size);
+
+	if (op_type & J_MESSAGE_FLAG_LZ4)
+	{
+#ifdef HAVE_LZ4
+		gint ret;
+
+		ret = LZ4_decompress_safe(message->data + sizeof(JMessageHeader) + sizeof(guint32), data + sizeof(JMessageHeader), length - sizeof(guint32), uncompressed_length);
+		decompressed_length = (ret > 0) ? (gsize)ret : 0;
+#endif
+	}
+	else
+	{
+#ifdef HAVE_ZSTD
+		decompressed_length = ZSTD_decompress(data + sizeof(JMessageHeader), uncompressed_length, message->data + sizeof(JMessageHeader) + sizeof(guint32), length - sizeof(guint32));
+
+		if (ZSTD_isError(decompressed_length))
+		{
+			decompressed_length = 0;
+		}
+#endif
+	}
+
+	if (decompressed_length != uncompressed_length)
+	{
+		j_message_buffer_free(data, size);
+		goto error;
+	}
+
+	j_helper_atomic_add(&j_message_bytes_uncompressed, uncompressed_length);
+	j_helper_atomic_add(&j_message_bytes_compressed, length);
+
+	memcpy(data, message->data, sizeof(JMessageHeader));
+	j_message_buffer_free(message->data, message->size);
+
+	message->data = data;
+	message->size = size;
+	message->current = message->data + sizeof(JMessageHeader);
+
+	header = j_message_header(message);
+	header->length = GUINT32_TO_LE(uncompressed_length);
+	header->op_type = GUINT32_TO_LE(op_type & ~(J_MESSAGE_FLAG_LZ4 | J_MESSAGE_FLAG_ZSTD));
+
+	return TRUE;
+
+error:
+	g_critical("Can not decompress message.");
+
+	return FALSE;
+}
+
+/**
+ * Parses the name of a compression algorithm.
+ *
+ * \code
+ * \endcode
+ *
+ * \param name A name, such as "lz4" or "zstd".
+ *
+ * \return The compression algorithm, or J_MESSAGE_COMPRESSION_NONE if it is unknown or not supported by this build.
+ **/
+JMessageCompression
+j_message_compression_from_string (gchar const* name)
+{
+	J_TRACE_FUNCTION(NULL);
+
+#ifdef HAVE_LZ4
+	if (g_strcmp0(name, "lz4") == 0)
+	{
+		return J_MESSAGE_COMPRESSION_LZ4;
+	}
+#endif
+
+#ifdef HAVE_ZSTD
+	if (g_strcmp0(name, "zstd") == 0)
+	{
+		return J_MESSAGE_COMPRESSION_ZSTD;
+	}
+#endif
+
+	(void)name;
+
+	return J_MESSAGE_COMPRESSION_NONE;
+}
+
+/**
+ * Enables compression for messages sent via a connection.
+ * Only message types carrying payloads are compressed, see j_message_type_is_compressible().
+ * Compressed messages are decompressed automatically when they are read.
+ * The receiving side has to support the algorithm, see J_MESSAGE_PING.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ * \param algorithm  A compression algorithm.
+ * \param threshold  The minimum data length in bytes to compress.
+ **/
+void
+j_message_enable_compression (gpointer connection, JMessageCompression algorithm, guint32 threshold)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageConnection* state;
+
+	g_return_if_fail(connection != NULL);
+
+	state = j_message_connection_get(connection);
+	state->compressor.algorithm = algorithm;
+	state->compressor.threshold = threshold;
+}
+
+/**
+ * Returns how much message data has been compressed by this process, counting both sent and received messages.
+ *
+ * \code
+ * \endcode
+ *
+ * \param uncompressed A return location for the number of bytes before compression.
+ * \param compressed   A return location for the number of bytes after compression.
+ **/
+void
+j_message_get_compression_statistics (guint64* uncompressed, guint64* compressed)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(uncompressed != NULL);
+	g_return_if_fail(compressed != NULL);
+
+	*uncompressed = j_helper_atomic_add(&j_message_bytes_uncompressed, 0);
+	*compressed = j_helper_atomic_add(&j_message_bytes_compressed, 0);
+}
+
+/**
+ * @}
+ **/
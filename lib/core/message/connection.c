@@ -0,0 +1,138 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+static
+GQuark
+j_message_connection_quark (void)
+{
+	static GQuark quark = 0;
+
+	/* Concurrent initialization is harmless, all threads get the same quark. */
+	if (G_UNLIKELY(quark == 0))
+	{
+		quark = g_quark_from_static_string("j-message-connection");
+	}
+
+	return quark;
+}
+
+static
+void
+j_message_connection_free (gpointer data)
+{
+	JMessageConnection* state = data;
+
+	if (state->strings_send != NULL)
+	{
+		j_message_strings_unref(state->strings_send);
+	}
+
+	if (state->strings_receive != NULL)
+	{
+		j_message_strings_unref(state->strings_receive);
+	}
+
+	if (state->segment != NULL)
+	{
+		j_message_segment_unref(state->segment);
+	}
+
+	if (state->channel != NULL)
+	{
+		j_message_channel_unref(state->channel);
+	}
+
+	if (state->pending != NULL)
+	{
+		g_hash_table_unref(state->pending);
+	}
+
+	g_slice_free(JMessageConnection, state);
+}
+
+/**
+ * Returns a connection's message state, creating it if necessary.
+ *
+ * \private
+ *
+ * \param connection A connection.
+ *
+ * \return The connection's state, which lives as long as the connection.
+ **/
+JMessageConnection*
+j_message_connection_get (gpointer connection)
+{
+	JMessageConnection* state;
+
+	state = j_message_connection_lookup(connection);
+
+	if (G_LIKELY(state != NULL))
+	{
+		return state;
+	}
+
+	state = g_slice_new0(JMessageConnection);
+	state->compressor.algorithm = J_MESSAGE_COMPRESSION_NONE;
+
+	/* Another thread might have created the state in the meantime. */
+	if (!g_object_replace_qdata(G_OBJECT(connection), j_message_connection_quark(), NULL, state, j_message_connection_free, NULL))
+	{
+		j_message_connection_free(state);
+		state = j_message_connection_lookup(connection);
+	}
+
+	return state;
+}
+
+/**
+ * Returns a connection's message state without creating it.
+ *
+ * \private
+ *
+ * \param connection A connection.
+ *
+ * \return The connection's state, or NULL if it has not been used yet.
+ **/
+JMessageConnection*
+j_message_connection_lookup (gpointer connection)
+{
+	return g_object_get_qdata(G_OBJECT(connection), j_message_connection_quark());
+}
+
+/**
+ * @}
+ **/
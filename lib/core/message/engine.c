@@ -0,0 +1,1242 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+
+#include <jlist.h>
+#include <jlist-iterator.h>
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/**
+ * A message that has been sent with j_message_send_async() and is waiting for its replies.
+ **/
+struct JMessageRequest
+{
+	/**
+	 * The message ID, replies carry the same one.
+	 **/
+	guint32 id;
+
+	/**
+	 * The function handling the replies, NULL if the request is done once the message has been written.
+	 **/
+	JMessageReplyFunc reply_func;
+	JMessageDoneFunc done_func;
+	gpointer data;
+
+	/**
+	 * Whether #reply_func has handled the last reply.
+	 **/
+	gboolean complete;
+};
+
+typedef struct JMessageRequest JMessageRequest;
+
+/**
+ * A message that is being written to a connection.
+ * Everything that has to be sent is gathered when the message is queued, so the engine can write it in pieces.
+ **/
+struct JMessageOutput
+{
+	JMessage* message;
+
+	/**
+	 * The message's header and data with interned strings or compression, NULL if the message is sent as is.
+	 **/
+	GByteArray* encoded;
+
+	/**
+	 * Copies of the data to send from file descriptors.
+	 **/
+	GPtrArray* file_data;
+
+	/**
+	 * The header with #J_MESSAGE_FLAG_SHARED and the description of the data in the shared memory segment.
+	 **/
+	JMessageHeader header;
+	JMessageShared shared;
+
+	/**
+	 * The buffers to write, contains GOutputVector elements.
+	 **/
+	GArray* vectors;
+
+	/**
+	 * The first buffer that has not been written completely.
+	 **/
+	guint position;
+
+	JMessageRequest* request;
+};
+
+typedef struct JMessageOutput JMessageOutput;
+
+/**
+ * The part of a connection that is driven by the engine, see j_message_enable_engine().
+ * Messages are queued by any thread and written without blocking, the engine thread writes what the socket did not accept right away.
+ * Replies are only read by the engine thread, which hands them to their requests or keeps them for j_message_receive().
+ **/
+struct JMessageChannel
+{
+	/**
+	 * The connection, referenced until the engine has stopped watching it.
+	 **/
+	GSocketConnection* connection;
+	GSocket* socket;
+	gint fd;
+
+	/**
+	 * Protects the following members.
+	 **/
+	GMutex mutex[1];
+	GCond cond[1];
+
+	/**
+	 * The messages to write, in order.
+	 * Contains #JMessageOutput elements.
+	 **/
+	GQueue outputs[1];
+
+	/**
+	 * Whether the engine is waiting for the socket to become writable.
+	 **/
+	gboolean writable;
+
+	/**
+	 * The requests whose replies have not been handled yet, indexed by their IDs.
+	 **/
+	GHashTable* requests;
+
+	/**
+	 * Replies without a request, indexed by their IDs, until j_message_receive() asks for them.
+	 **/
+	GHashTable* replies;
+
+	/**
+	 * Whether the connection has failed or been closed.
+	 **/
+	gboolean closed;
+
+	/**
+	 * The following members are only used by the engine thread.
+	 **/
+	JMessageReader* reader;
+
+	/**
+	 * The reply whose additional data is being received, NULL if the next read starts a new reply.
+	 **/
+	JMessage* reply;
+	JMessageRequest* request;
+
+	/**
+	 * The buffers the additional data is received into, contains GInputVector elements.
+	 **/
+	GArray* vectors;
+	guint position;
+
+	gint ref_count;
+};
+
+static gint j_message_engine_fd = -1;
+
+static
+JMessageChannel*
+j_message_channel_ref (JMessageChannel* channel)
+{
+	g_atomic_int_inc(&(channel->ref_count));
+
+	return channel;
+}
+
+void
+j_message_channel_unref (JMessageChannel* channel)
+{
+	if (g_atomic_int_dec_and_test(&(channel->ref_count)))
+	{
+		g_hash_table_unref(channel->requests);
+		g_hash_table_unref(channel->replies);
+		g_array_unref(channel->vectors);
+		g_cond_clear(channel->cond);
+		g_mutex_clear(channel->mutex);
+
+		g_slice_free(JMessageChannel, channel);
+	}
+}
+
+static
+void
+j_message_output_free (JMessageOutput* output)
+{
+	if (output->encoded != NULL)
+	{
+		g_byte_array_unref(output->encoded);
+	}
+
+	if (output->file_data != NULL)
+	{
+		g_ptr_array_unref(output->file_data);
+	}
+
+	g_array_unref(output->vectors);
+	j_message_unref(output->message);
+
+	g_slice_free(JMessageOutput, output);
+}
+
+/**
+ * Reads data to send from a file descriptor into memory.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message_data Message data with a file descriptor.
+ *
+ * \return A new buffer, or NULL if the file could not be read.
+ **/
+static
+gchar*
+j_message_output_read_fd (JMessageData const* message_data)
+{
+	g_autofree gchar* buffer = NULL;
+	guint64 position = 0;
+
+	buffer = g_malloc(message_data->length);
+
+	while (position < message_data->length)
+	{
+		gssize nbytes;
+
+		nbytes = pread(message_data->fd, buffer + position, message_data->length - position, message_data->offset + position);
+
+		if (nbytes < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (nbytes <= 0)
+		{
+			g_critical("Can not read data to send: %s", (nbytes < 0) ? g_strerror(errno) : "File has been truncated.");
+			return NULL;
+		}
+
+		position += nbytes;
+	}
+
+	return g_steal_pointer(&buffer);
+}
+
+/**
+ * Gathers everything that has to be written for a message.
+ * The channel's mutex has to be held, so that string IDs and shared data are assigned in the order the messages are written.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param state   The state of the connection the message is sent via.
+ *
+ * \return A new output, or NULL if the message's data could not be read.
+ **/
+static
+JMessageOutput*
+j_message_output_new (JMessage* message, JMessageConnection* state)
+{
+	JMessageOutput* output;
+	JMessageSegment* segment;
+	JMessageShared shared;
+	GByteArray* compressed;
+	GOutputVector vector;
+	g_autoptr(GPtrArray) file_data = NULL;
+	gboolean have_shared = FALSE;
+
+	segment = state->segment;
+
+	if (segment != NULL && j_message_segment_is_active(segment) && message->send_list != NULL)
+	{
+		j_message_segment_lock(segment);
+		have_shared = j_message_segment_write(segment, message, &shared);
+		j_message_segment_unlock(segment);
+	}
+
+	/* Data that did not fit into the segment is sent via the connection. Files are read before string IDs are assigned, so a failure leaves no trace. */
+	if (message->send_list != NULL && !have_shared)
+	{
+		g_autoptr(JListIterator) iterator = NULL;
+
+		iterator = j_list_iterator_new(message->send_list);
+
+		while (j_list_iterator_next(iterator))
+		{
+			JMessageData* message_data = j_list_iterator_get(iterator);
+			gchar* buffer;
+
+			if (message_data->fd == -1)
+			{
+				continue;
+			}
+
+			if (file_data == NULL)
+			{
+				file_data = g_ptr_array_new_with_free_func(g_free);
+			}
+
+			if ((buffer = j_message_output_read_fd(message_data)) == NULL)
+			{
+				return NULL;
+			}
+
+			g_ptr_array_add(file_data, buffer);
+		}
+	}
+
+	output = g_slice_new(JMessageOutput);
+	output->message = j_message_ref(message);
+	output->encoded = NULL;
+	output->file_data = g_steal_pointer(&file_data);
+	output->vectors = g_array_new(FALSE, FALSE, sizeof(GOutputVector));
+	output->position = 0;
+	output->request = NULL;
+
+	if (state->strings_send != NULL)
+	{
+		j_message_strings_lock(state->strings_send);
+		output->encoded = j_message_encode_strings(message, state->strings_send);
+		j_message_strings_unlock(state->strings_send);
+	}
+
+	compressed = j_message_compress(message, (output->encoded != NULL) ? (gchar const*)output->encoded->data : message->data, &(state->compressor));
+
+	if (compressed != NULL)
+	{
+		g_clear_pointer(&(output->encoded), g_byte_array_unref);
+		output->encoded = compressed;
+	}
+
+	if (output->encoded != NULL)
+	{
+		vector.buffer = output->encoded->data;
+		vector.size = output->encoded->len;
+	}
+	else
+	{
+		vector.buffer = message->data;
+		vector.size = sizeof(JMessageHeader) + j_message_length(message);
+	}
+
+	if (have_shared)
+	{
+		GOutputVector shared_vector;
+
+		/* The flag is only set in a copy of the header, the message might be sent again via another connection. */
+		memcpy(&(output->header), vector.buffer, sizeof(JMessageHeader));
+		output->shared.position = GUINT64_TO_LE(shared.position);
+		output->shared.end = GUINT64_TO_LE(shared.end);
+		output->shared.length = GUINT64_TO_LE(shared.length);
+
+		output->header.op_type = GUINT32_TO_LE(GUINT32_FROM_LE(output->header.op_type) | J_MESSAGE_FLAG_SHARED);
+
+		shared_vector.buffer = &(output->header);
+		shared_vector.size = sizeof(JMessageHeader);
+		g_array_append_val(output->vectors, shared_vector);
+
+		shared_vector.buffer = &(output->shared);
+		shared_vector.size = sizeof(JMessageShared);
+		g_array_append_val(output->vectors, shared_vector);
+
+		vector.buffer = (gchar const*)vector.buffer + sizeof(JMessageHeader);
+		vector.size -= sizeof(JMessageHeader);
+	}
+
+	g_array_append_val(output->vectors, vector);
+
+	if (message->send_list != NULL && !have_shared)
+	{
+		g_autoptr(JListIterator) iterator = NULL;
+		guint file = 0;
+
+		iterator = j_list_iterator_new(message->send_list);
+
+		while (j_list_iterator_next(iterator))
+		{
+			JMessageData* message_data = j_list_iterator_get(iterator);
+
+			vector.buffer = (message_data->fd == -1) ? message_data->data : g_ptr_array_index(output->file_data, file++);
+			vector.size = message_data->length;
+			g_array_append_val(output->vectors, vector);
+		}
+	}
+
+	return output;
+}
+
+/**
+ * Lets the engine write the rest of a channel's queued messages once the socket becomes writable again.
+ * The channel's mutex has to be held.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel  A channel.
+ * \param writable Whether to wait for the socket to become writable.
+ **/
+static
+void
+j_message_channel_watch (JMessageChannel* channel, gboolean writable)
+{
+	struct epoll_event event;
+
+	if (channel->writable == writable || channel->closed)
+	{
+		return;
+	}
+
+	event.events = EPOLLIN | ((writable) ? EPOLLOUT : 0);
+	event.data.ptr = channel;
+
+	if (epoll_ctl(j_message_engine_fd, EPOLL_CTL_MOD, channel->fd, &event) == 0)
+	{
+		channel->writable = writable;
+	}
+}
+
+/**
+ * Writes as many of a channel's queued messages as the socket accepts without blocking.
+ * The channel's mutex has to be held.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ * \param done    A return location for the requests that are done now that their messages have been written.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_channel_flush (JMessageChannel* channel, GSList** done)
+{
+	JMessageOutput* output;
+
+	while ((output = g_queue_peek_head(channel->outputs)) != NULL)
+	{
+		GOutputVector* vector;
+		GError* error = NULL;
+		gssize nbytes;
+		guint count;
+
+		vector = &g_array_index(output->vectors, GOutputVector, output->position);
+		count = output->vectors->len - output->position;
+
+		/* sendmsg() fails for more than IOV_MAX buffers. */
+		nbytes = g_socket_send_message(channel->socket, NULL, vector, MIN(count, IOV_MAX), NULL, 0, 0, NULL, &error);
+
+		if (nbytes < 0)
+		{
+			if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+			{
+				g_error_free(error);
+				break;
+			}
+
+			g_critical("%s", error->message);
+			g_error_free(error);
+
+			return FALSE;
+		}
+
+		/* Skip the buffers that have been written completely and adjust a partially written one. */
+		while (count > 0 && (gsize)nbytes >= vector->size)
+		{
+			nbytes -= vector->size;
+			vector++;
+			count--;
+			output->position++;
+		}
+
+		if (count > 0 && nbytes > 0)
+		{
+			vector->buffer = (gchar const*)vector->buffer + nbytes;
+			vector->size -= nbytes;
+		}
+
+		if (count == 0)
+		{
+			JMessageRequest* request = output->request;
+
+			g_queue_pop_head(channel->outputs);
+
+			if (request->reply_func == NULL)
+			{
+				g_hash_table_steal(channel->requests, GUINT_TO_POINTER(request->id));
+				*done = g_slist_prepend(*done, request);
+			}
+
+			j_message_output_free(output);
+		}
+	}
+
+	j_message_channel_watch(channel, !g_queue_is_empty(channel->outputs));
+
+	return TRUE;
+}
+
+/**
+ * Finishes requests outside of the channel's mutex.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param requests A list of requests.
+ * \param success  Whether the requests have succeeded.
+ **/
+static
+void
+j_message_channel_complete (GSList* requests, gboolean success)
+{
+	requests = g_slist_reverse(requests);
+
+	for (GSList* link = requests; link != NULL; link = link->next)
+	{
+		JMessageRequest* request = link->data;
+
+		request->done_func(success, request->data);
+		g_slice_free(JMessageRequest, request);
+	}
+
+	g_slist_free(requests);
+}
+
+/**
+ * Stops the engine from watching a channel after the connection has failed or been closed.
+ * All outstanding requests fail and threads waiting in j_message_receive() are woken up.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ **/
+static
+void
+j_message_channel_close (JMessageChannel* channel)
+{
+	GHashTableIter iter;
+	GSList* failed = NULL;
+	JMessageOutput* output;
+	gpointer value;
+
+	epoll_ctl(j_message_engine_fd, EPOLL_CTL_DEL, channel->fd, NULL);
+
+	g_mutex_lock(channel->mutex);
+
+	channel->closed = TRUE;
+
+	while ((output = g_queue_pop_head(channel->outputs)) != NULL)
+	{
+		j_message_output_free(output);
+	}
+
+	g_hash_table_iter_init(&iter, channel->requests);
+
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		failed = g_slist_prepend(failed, value);
+		g_hash_table_iter_steal(&iter);
+	}
+
+	g_cond_broadcast(channel->cond);
+	g_mutex_unlock(channel->mutex);
+
+	if (channel->reply != NULL)
+	{
+		j_message_unref(channel->reply);
+		channel->reply = NULL;
+		channel->request = NULL;
+	}
+
+	j_message_channel_complete(failed, FALSE);
+
+	j_message_reader_free(channel->reader);
+	channel->reader = NULL;
+
+	g_clear_object(&(channel->connection));
+	j_message_channel_unref(channel);
+}
+
+/**
+ * Prepares receiving the data following a reply that is kept for j_message_receive().
+ * Replies to reads are followed by data that has to be read before the next reply, it is handed out by j_message_receive_data() later.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ * \param reply   A reply.
+ *
+ * \return TRUE on success, FALSE if the reply is invalid.
+ **/
+static
+gboolean
+j_message_channel_read_ahead (JMessageChannel* channel, JMessage* reply)
+{
+	g_autofree JMessageObjectReadReply* operations = NULL;
+	gchar* current;
+	guint32 count;
+	guint64 length = 0;
+	gsize position = 0;
+
+	if (j_message_get_type(reply) != J_MESSAGE_OBJECT_READ)
+	{
+		return TRUE;
+	}
+
+	count = j_message_get_count(reply);
+	current = reply->current;
+
+	if (!j_message_get_object_read_reply(reply, count, &operations))
+	{
+		return FALSE;
+	}
+
+	reply->current = current;
+
+	for (guint32 i = 0; i < count; i++)
+	{
+		length += operations[i].bytes_read;
+	}
+
+	/* Replies to reads are limited to the maximum operation size per operation, which is much smaller. */
+	if (length == 0 || length > G_MAXUINT32)
+	{
+		return (length == 0);
+	}
+
+	reply->read_ahead = g_byte_array_sized_new(length);
+	g_byte_array_set_size(reply->read_ahead, length);
+
+	/* Each operation's data is placed in the segment separately, so every operation gets its own buffer. */
+	for (guint32 i = 0; i < count; i++)
+	{
+		GInputVector vector;
+
+		if (operations[i].bytes_read == 0)
+		{
+			continue;
+		}
+
+		vector.buffer = reply->read_ahead->data + position;
+		vector.size = operations[i].bytes_read;
+		g_array_append_val(channel->vectors, vector);
+
+		position += vector.size;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Hands a reply to its request, or keeps it for j_message_receive() if there is none.
+ * Afterwards, the data following the reply is received.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ * \param reply   A reply.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_channel_dispatch (JMessageChannel* channel, JMessage* reply)
+{
+	JMessageRequest* request;
+
+	g_mutex_lock(channel->mutex);
+	request = g_hash_table_lookup(channel->requests, GUINT_TO_POINTER(j_message_header(reply)->id));
+	g_mutex_unlock(channel->mutex);
+
+	/* Requests without a reply function only wait for their message to be written, their replies are kept for j_message_receive(). */
+	if (request != NULL && request->reply_func != NULL)
+	{
+		request->complete = request->reply_func(reply, request->data);
+
+		if (reply->receive_list != NULL)
+		{
+			g_array_append_vals(channel->vectors, reply->receive_list->data, reply->receive_list->len);
+		}
+	}
+	else
+	{
+		request = NULL;
+
+		if (!j_message_channel_read_ahead(channel, reply))
+		{
+			j_message_unref(reply);
+			return FALSE;
+		}
+	}
+
+	channel->reply = reply;
+	channel->request = request;
+	channel->position = 0;
+
+	/* Buffers are filled from the segment first, the remaining ones are received from the connection. */
+	if (reply->segment != NULL)
+	{
+		guint64 remaining = reply->shared.length;
+
+		while (channel->position < channel->vectors->len)
+		{
+			GInputVector* vector = &g_array_index(channel->vectors, GInputVector, channel->position);
+
+			if (vector->size > remaining)
+			{
+				break;
+			}
+
+			memcpy(vector->buffer, j_message_get_shared(reply, vector->size), vector->size);
+			remaining -= vector->size;
+			channel->position++;
+		}
+
+		/* The data has been consumed in order, so the space can be reused right away. */
+		j_message_release_shared(reply);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Finishes a reply once its additional data has been received.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ **/
+static
+void
+j_message_channel_finish (JMessageChannel* channel)
+{
+	JMessage* reply = channel->reply;
+	JMessageRequest* request = channel->request;
+	guint32 id;
+
+	channel->reply = NULL;
+	channel->request = NULL;
+	g_array_set_size(channel->vectors, 0);
+
+	id = j_message_header(reply)->id;
+
+	if (request == NULL)
+	{
+		g_mutex_lock(channel->mutex);
+		g_hash_table_replace(channel->replies, GUINT_TO_POINTER(id), reply);
+		g_cond_broadcast(channel->cond);
+		g_mutex_unlock(channel->mutex);
+
+		return;
+	}
+
+	j_message_unref(reply);
+
+	if (request->complete)
+	{
+		g_mutex_lock(channel->mutex);
+		g_hash_table_steal(channel->requests, GUINT_TO_POINTER(id));
+		g_mutex_unlock(channel->mutex);
+
+		j_message_channel_complete(g_slist_prepend(NULL, request), TRUE);
+	}
+}
+
+/**
+ * Reads and handles as many replies as are available without blocking.
+ * Only called by the engine thread.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ *
+ * \return TRUE on success, FALSE if the connection has been closed or an error occurred.
+ **/
+static
+gboolean
+j_message_channel_read (JMessageChannel* channel)
+{
+	while (TRUE)
+	{
+		JMessage* reply;
+
+		while (channel->reply != NULL && channel->position < channel->vectors->len)
+		{
+			GInputVector* vector;
+			GError* error = NULL;
+			gssize nbytes;
+			guint count;
+
+			vector = &g_array_index(channel->vectors, GInputVector, channel->position);
+			count = channel->vectors->len - channel->position;
+
+			/* recvmsg() fails for more than IOV_MAX buffers. */
+			nbytes = g_socket_receive_message(channel->socket, NULL, vector, MIN(count, IOV_MAX), NULL, NULL, NULL, NULL, &error);
+
+			if (nbytes < 0)
+			{
+				if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+				{
+					g_error_free(error);
+					return TRUE;
+				}
+
+				g_critical("%s", error->message);
+				g_error_free(error);
+
+				return FALSE;
+			}
+
+			/* The connection has been closed by the other side. */
+			if (nbytes == 0)
+			{
+				return FALSE;
+			}
+
+			/* Skip the buffers that have been filled completely and adjust a partially filled one. */
+			while (count > 0 && (gsize)nbytes >= vector->size)
+			{
+				nbytes -= vector->size;
+				vector++;
+				count--;
+				channel->position++;
+			}
+
+			if (count > 0 && nbytes > 0)
+			{
+				vector->buffer = (gchar*)vector->buffer + nbytes;
+				vector->size -= nbytes;
+			}
+		}
+
+		if (channel->reply != NULL)
+		{
+			j_message_channel_finish(channel);
+		}
+
+		if (!j_message_reader_read(channel->reader, &reply))
+		{
+			return FALSE;
+		}
+
+		if (reply == NULL)
+		{
+			return TRUE;
+		}
+
+		if (!j_message_channel_dispatch(channel, reply))
+		{
+			return FALSE;
+		}
+	}
+}
+
+static
+gpointer
+j_message_engine_loop (gpointer data)
+{
+	struct epoll_event events[64];
+
+	(void)data;
+
+	while (TRUE)
+	{
+		gint nevents;
+
+		nevents = epoll_wait(j_message_engine_fd, events, G_N_ELEMENTS(events), -1);
+
+		if (nevents == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			g_critical("epoll_wait failed: %s", g_strerror(errno));
+			break;
+		}
+
+		for (gint i = 0; i < nevents; i++)
+		{
+			JMessageChannel* channel = events[i].data.ptr;
+
+			/* Errors and hang-ups are detected when reading. */
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+			{
+				if (!j_message_channel_read(channel))
+				{
+					j_message_channel_close(channel);
+					continue;
+				}
+			}
+
+			if (events[i].events & EPOLLOUT)
+			{
+				GSList* done = NULL;
+				gboolean ret;
+
+				g_mutex_lock(channel->mutex);
+				ret = j_message_channel_flush(channel, &done);
+				g_mutex_unlock(channel->mutex);
+
+				j_message_channel_complete(done, TRUE);
+
+				if (!ret)
+				{
+					j_message_channel_close(channel);
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts the engine thread.
+ * The engine serves all connections of the process and runs until the process exits, like the other thread pools.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param data Unused.
+ *
+ * \return A non-NULL pointer if the engine is running, NULL otherwise.
+ **/
+static
+gpointer
+j_message_engine_start (gpointer data)
+{
+	GThread* thread;
+
+	(void)data;
+
+	j_message_engine_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (j_message_engine_fd == -1)
+	{
+		g_critical("Can not start the message engine: %s", g_strerror(errno));
+		return NULL;
+	}
+
+	thread = g_thread_new("julea-message-engine", j_message_engine_loop, NULL);
+	g_thread_unref(thread);
+
+	return GINT_TO_POINTER(TRUE);
+}
+
+/**
+ * Queues a message on a channel and writes as much of it as possible without blocking.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel    A channel.
+ * \param state      The connection's state.
+ * \param message    A message.
+ * \param reply_func A function to handle the replies, or NULL.
+ * \param done_func  A function to call once the message has been handled.
+ * \param data       Data to pass to #reply_func and #done_func.
+ **/
+void
+j_message_channel_submit (JMessageChannel* channel, JMessageConnection* state, JMessage* message, JMessageReplyFunc reply_func, JMessageDoneFunc done_func, gpointer data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageOutput* output = NULL;
+	JMessageRequest* request;
+	GSList* done = NULL;
+
+	request = g_slice_new(JMessageRequest);
+	request->id = j_message_header(message)->id;
+	request->reply_func = reply_func;
+	request->done_func = done_func;
+	request->data = data;
+	request->complete = FALSE;
+
+	g_mutex_lock(channel->mutex);
+
+	if (!channel->closed && (output = j_message_output_new(message, state)) != NULL)
+	{
+		/* The request is registered before writing, its replies might arrive before the message has been written completely. */
+		output->request = request;
+		g_hash_table_insert(channel->requests, GUINT_TO_POINTER(request->id), request);
+		g_queue_push_tail(channel->outputs, output);
+
+		if (!j_message_channel_flush(channel, &done))
+		{
+			/* The engine notices the shutdown and fails all outstanding requests, including this one. */
+			channel->closed = TRUE;
+			g_socket_shutdown(channel->socket, TRUE, TRUE, NULL);
+		}
+	}
+
+	g_mutex_unlock(channel->mutex);
+
+	j_message_channel_complete(done, TRUE);
+
+	if (output == NULL)
+	{
+		j_message_channel_complete(g_slist_prepend(NULL, request), FALSE);
+	}
+}
+
+/**
+ * Waits for a message written via a channel.
+ **/
+struct JMessageChannelWait
+{
+	GMutex mutex[1];
+	GCond cond[1];
+	gboolean done;
+	gboolean success;
+};
+
+typedef struct JMessageChannelWait JMessageChannelWait;
+
+static
+void
+j_message_channel_wait_done (gboolean success, gpointer data)
+{
+	JMessageChannelWait* wait = data;
+
+	g_mutex_lock(wait->mutex);
+	wait->success = success;
+	wait->done = TRUE;
+	g_cond_signal(wait->cond);
+	g_mutex_unlock(wait->mutex);
+}
+
+/**
+ * Sends a message via a channel and waits until it has been written.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ * \param state   The connection's state.
+ * \param message A message.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_channel_send (JMessageChannel* channel, JMessageConnection* state, JMessage* message)
+{
+	JMessageChannelWait wait[1];
+
+	g_mutex_init(wait->mutex);
+	g_cond_init(wait->cond);
+	wait->done = FALSE;
+	wait->success = FALSE;
+
+	j_message_channel_submit(channel, state, message, NULL, j_message_channel_wait_done, wait);
+
+	g_mutex_lock(wait->mutex);
+
+	while (!wait->done)
+	{
+		g_cond_wait(wait->cond, wait->mutex);
+	}
+
+	g_mutex_unlock(wait->mutex);
+
+	g_cond_clear(wait->cond);
+	g_mutex_clear(wait->mutex);
+
+	return wait->success;
+}
+
+/**
+ * Waits for a reply that the engine keeps for j_message_receive().
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param channel A channel.
+ * \param message A reply to receive into.
+ * \param id      The ID of the original message.
+ *
+ * \return TRUE on success, FALSE if the connection has been closed.
+ **/
+gboolean
+j_message_channel_receive (JMessageChannel* channel, JMessage* message, guint32 id)
+{
+	JMessage* reply;
+
+	g_mutex_lock(channel->mutex);
+
+	while ((reply = g_hash_table_lookup(channel->replies, GUINT_TO_POINTER(id))) == NULL && !channel->closed)
+	{
+		g_cond_wait(channel->cond, channel->mutex);
+	}
+
+	if (reply != NULL)
+	{
+		g_hash_table_steal(channel->replies, GUINT_TO_POINTER(id));
+	}
+
+	g_mutex_unlock(channel->mutex);
+
+	if (reply == NULL)
+	{
+		return FALSE;
+	}
+
+	j_message_swap_data(message, reply);
+	j_message_unref(reply);
+
+	return TRUE;
+}
+
+/**
+ * Lets the engine drive a connection.
+ * Afterwards, messages can be sent with j_message_send_async() and all replies are read by the engine thread.
+ * j_message_send() and j_message_receive() keep working, they wait for the engine.
+ * Must be called after the connection has been set up, the socket is switched to non-blocking mode.
+ *
+ * The engine keeps a reference to the connection until it has been closed, see g_socket_shutdown().
+ * The engine's callbacks never block, so a single thread serves all connections of the process.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ **/
+void
+j_message_enable_engine (gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	static GOnce engine_once = G_ONCE_INIT;
+
+	JMessageConnection* state;
+	JMessageChannel* channel;
+	struct epoll_event event;
+
+	g_return_if_fail(connection != NULL);
+
+	state = j_message_connection_get(connection);
+
+	g_return_if_fail(state->channel == NULL);
+
+	/* Without the engine, the connection keeps being used in blocking mode. */
+	if (g_once(&engine_once, j_message_engine_start, NULL) == NULL)
+	{
+		return;
+	}
+
+	channel = g_slice_new(JMessageChannel);
+	channel->connection = g_object_ref(connection);
+	channel->socket = g_socket_connection_get_socket(channel->connection);
+	channel->fd = g_socket_get_fd(channel->socket);
+	g_mutex_init(channel->mutex);
+	g_cond_init(channel->cond);
+	g_queue_init(channel->outputs);
+	channel->writable = FALSE;
+	channel->requests = g_hash_table_new(NULL, NULL);
+	channel->replies = g_hash_table_new_full(NULL, NULL, NULL, (GDestroyNotify)j_message_unref);
+	channel->closed = FALSE;
+	channel->reader = j_message_reader_new(connection);
+	channel->reply = NULL;
+	channel->request = NULL;
+	channel->vectors = g_array_new(FALSE, FALSE, sizeof(GInputVector));
+	channel->position = 0;
+	channel->ref_count = 1;
+
+	g_socket_set_blocking(channel->socket, FALSE);
+
+	/* The engine's reference is released in j_message_channel_close(). */
+	state->channel = j_message_channel_ref(channel);
+
+	event.events = EPOLLIN;
+	event.data.ptr = channel;
+
+	if (epoll_ctl(j_message_engine_fd, EPOLL_CTL_ADD, channel->fd, &event) == -1)
+	{
+		g_critical("Can not watch connection: %s", g_strerror(errno));
+
+		g_socket_shutdown(channel->socket, TRUE, TRUE, NULL);
+		j_message_channel_close(channel);
+	}
+}
+
+/**
+ * @}
+ **/
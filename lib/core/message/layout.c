@@ -0,0 +1,147 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <string.h>
+
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+#define J_MESSAGE_LAYOUT_APPEND(type, name, bits) \
+	{ \
+		guint##bits value = GUINT##bits##_TO_LE((guint##bits)operation->name); \
+		memcpy(message->current, &value, sizeof(value)); \
+		message->current += sizeof(value); \
+	}
+
+#define J_MESSAGE_LAYOUT_GET(type, name, bits) \
+	{ \
+		guint##bits value; \
+		memcpy(&value, data, sizeof(value)); \
+		operation->name = (type)GUINT##bits##_FROM_LE(value); \
+		data += sizeof(value); \
+	}
+
+/**
+ * Generates the functions of a layout, see J_MESSAGE_LAYOUTS().
+ *
+ * j_message_append_<function_name>() appends one operation's fields, the operation has to be added with j_message_add_operation() before.
+ * j_message_get_<function_name>() gets the fields of a number of consecutive operations into a new array, which should be freed with g_free().
+ * The whole array is checked against the message's length once, so that truncated messages are detected before any field is used.
+ * j_message_next_<function_name>() gets the fields of the next operation, for operations whose fixed-size fields are interleaved with strings or data.
+ **/
+#define J_MESSAGE_DEFINE_LAYOUT(TypeName, function_name, LAYOUT) \
+	gboolean \
+	j_message_append_##function_name (JMessage* message, JMessage##TypeName const* operation) \
+	{ \
+		J_TRACE_FUNCTION(NULL); \
+		\
+		guint32 new_length; \
+		\
+		g_return_val_if_fail(message != NULL, FALSE); \
+		g_return_val_if_fail(operation != NULL, FALSE); \
+		g_return_val_if_fail(j_message_can_append(message, J_MESSAGE_LAYOUT_SIZE(LAYOUT)), FALSE); \
+		\
+		LAYOUT(J_MESSAGE_LAYOUT_APPEND) \
+		\
+		new_length = j_message_length(message) + J_MESSAGE_LAYOUT_SIZE(LAYOUT); \
+		j_message_header(message)->length = GUINT32_TO_LE(new_length); \
+		\
+		return TRUE; \
+	} \
+	\
+	gboolean \
+	j_message_get_##function_name (JMessage* message, guint32 count, JMessage##TypeName** operations) \
+	{ \
+		J_TRACE_FUNCTION(NULL); \
+		\
+		gchar const* data; \
+		\
+		g_return_val_if_fail(message != NULL, FALSE); \
+		g_return_val_if_fail(operations != NULL, FALSE); \
+		\
+		*operations = NULL; \
+		\
+		/* The count is checked before allocating, it might not match the message. */ \
+		if (!j_message_can_get(message, (gsize)count * J_MESSAGE_LAYOUT_SIZE(LAYOUT))) \
+		{ \
+			return FALSE; \
+		} \
+		\
+		data = message->current; \
+		*operations = g_new(JMessage##TypeName, count); \
+		\
+		for (guint32 i = 0; i < count; i++) \
+		{ \
+			JMessage##TypeName* operation = &((*operations)[i]); \
+			\
+			LAYOUT(J_MESSAGE_LAYOUT_GET) \
+		} \
+		\
+		message->current += (gsize)count * J_MESSAGE_LAYOUT_SIZE(LAYOUT); \
+		\
+		return TRUE; \
+	} \
+	\
+	gboolean \
+	j_message_next_##function_name (JMessage* message, JMessage##TypeName* operation) \
+	{ \
+		J_TRACE_FUNCTION(NULL); \
+		\
+		gchar const* data; \
+		\
+		g_return_val_if_fail(message != NULL, FALSE); \
+		g_return_val_if_fail(operation != NULL, FALSE); \
+		\
+		if (!j_message_can_get(message, J_MESSAGE_LAYOUT_SIZE(LAYOUT))) \
+		{ \
+			return FALSE; \
+		} \
+		\
+		data = message->current; \
+		\
+		LAYOUT(J_MESSAGE_LAYOUT_GET) \
+		\
+		message->current += J_MESSAGE_LAYOUT_SIZE(LAYOUT); \
+		\
+		return TRUE; \
+	}
+
+J_MESSAGE_LAYOUTS(J_MESSAGE_DEFINE_LAYOUT)
+
+#undef J_MESSAGE_DEFINE_LAYOUT
+#undef J_MESSAGE_LAYOUT_GET
+#undef J_MESSAGE_LAYOUT_APPEND
+
+/**
+ * @}
+ **/
@@ -0,0 +1,407 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#ifndef JULEA_MESSAGE_MESSAGE_H
+#define JULEA_MESSAGE_MESSAGE_H
+
+#if !defined(JULEA_H) && !defined(JULEA_COMPILATION)
+#error "Only <julea.h> can be included directly."
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <jmessage.h>
+
+#include <jlist.h>
+
+/**
+ * Set in a header's operation type if the message's strings have been interned, see j_message_enable_interning().
+ **/
+#define J_MESSAGE_FLAG_STRINGS (1U << 31)
+
+/**
+ * Set in a header's operation type if the message's data has been compressed, see j_message_enable_compression().
+ * The data starts with its uncompressed length.
+ **/
+#define J_MESSAGE_FLAG_LZ4 (1U << 30)
+#define J_MESSAGE_FLAG_ZSTD (1U << 29)
+
+/**
+ * Set in a header's operation type if the message's additional data has been placed in the connection's shared memory segment, see j_message_offer_shared_memory().
+ * The header is followed by a JMessageShared.
+ **/
+#define J_MESSAGE_FLAG_SHARED (1U << 28)
+
+#define J_MESSAGE_FLAGS (J_MESSAGE_FLAG_STRINGS | J_MESSAGE_FLAG_LZ4 | J_MESSAGE_FLAG_ZSTD | J_MESSAGE_FLAG_SHARED)
+
+/**
+ * Marks an interned string, followed by its 4-byte ID.
+ * Neither this nor #J_MESSAGE_STRING_ESCAPE can occur in UTF-8.
+ **/
+#define J_MESSAGE_STRING_REFERENCE 0xff
+
+/**
+ * Precedes a string that is not interned but starts with one of the markers.
+ **/
+#define J_MESSAGE_STRING_ESCAPE 0xfe
+
+/**
+ * Additional message data.
+ **/
+struct JMessageData
+{
+	/**
+	 * The data.
+	 **/
+	gconstpointer data;
+
+	/**
+	 * The data length.
+	 **/
+	guint64 length;
+
+	/**
+	 * The file descriptor to send the data from.
+	 * Set to -1 if #data is used.
+	 **/
+	gint fd;
+
+	/**
+	 * The offset within #fd.
+	 **/
+	guint64 offset;
+};
+
+typedef struct JMessageData JMessageData;
+
+/**
+ * A message header.
+ **/
+#pragma pack(4)
+struct JMessageHeader
+{
+	/**
+	 * The message length.
+	 **/
+	guint32 length;
+
+	/**
+	 * The message ID.
+	 **/
+	guint32 id;
+
+	/**
+	 * The semantics.
+	 **/
+	guint32 semantics;
+
+	/**
+	 * The operation type.
+	 **/
+	guint32 op_type;
+
+	/**
+	 * The operation count.
+	 **/
+	guint32 op_count;
+};
+#pragma pack()
+
+typedef struct JMessageHeader JMessageHeader;
+
+/**
+ * Describes a message's additional data in a shared memory segment.
+ **/
+#pragma pack(4)
+struct JMessageShared
+{
+	/**
+	 * The position of the first data.
+	 **/
+	guint64 position;
+
+	/**
+	 * The position after the last data, which can be released once the message has been handled.
+	 **/
+	guint64 end;
+
+	/**
+	 * The length of the data, excluding any space skipped at the ring's end.
+	 * Buffers to receive into are filled from the segment up to this length, the remainder follows on the connection.
+	 **/
+	guint64 length;
+};
+#pragma pack()
+
+typedef struct JMessageShared JMessageShared;
+
+/**
+ * A string appended to a message.
+ **/
+struct JMessageString
+{
+	/**
+	 * The string's offset within the message's data.
+	 **/
+	guint32 offset;
+
+	/**
+	 * Whether the string may be interned, see j_message_append_namespace().
+	 **/
+	gboolean intern;
+};
+
+typedef struct JMessageString JMessageString;
+
+struct JMessageStrings;
+
+typedef struct JMessageStrings JMessageStrings;
+
+struct JMessageSegment;
+
+typedef struct JMessageSegment JMessageSegment;
+
+struct JMessageChannel;
+
+typedef struct JMessageChannel JMessageChannel;
+
+/**
+ * A message.
+ **/
+struct JMessage
+{
+	/**
+	 * The current size.
+	 **/
+	gsize size;
+
+	/**
+	 * The data.
+	 * This also contains a JMessageHeader.
+	 **/
+	gchar* data;
+
+	/**
+	 * The current position within #data.
+	 **/
+	gchar* current;
+
+	/**
+	 * The list of additional data to send in j_message_write().
+	 * Contains JMessageData elements, NULL if no data has been added.
+	 **/
+	JList* send_list;
+
+	/**
+	 * The list of buffers to receive data into in j_message_receive_data().
+	 * Contains GInputVector elements, NULL if no buffers have been added.
+	 **/
+	GArray* receive_list;
+
+	/**
+	 * The strings appended with j_message_append_string() and j_message_append_namespace().
+	 * Contains JMessageString elements, NULL if no strings have been appended.
+	 **/
+	GArray* string_offsets;
+
+	/**
+	 * The dictionary to resolve interned strings with.
+	 * Set if the message has been received with interned strings, NULL otherwise.
+	 **/
+	JMessageStrings* strings;
+
+	/**
+	 * The shared memory segment containing the message's additional data.
+	 * Set if the message has been received with shared data, NULL otherwise.
+	 **/
+	JMessageSegment* segment;
+
+	/**
+	 * The message's shared data, #position is advanced as the data is consumed.
+	 **/
+	JMessageShared shared;
+
+	/**
+	 * The additional data that has been read ahead of j_message_receive_data().
+	 * Set if the message is a reply that has been kept by j_message_receive() while waiting for another one, NULL otherwise.
+	 **/
+	GByteArray* read_ahead;
+
+	/**
+	 * The original message.
+	 * Set if the message is a reply, NULL otherwise.
+	 **/
+	JMessage* original_message;
+
+	/**
+	 * The reference count.
+	 **/
+	gint ref_count;
+};
+
+/**
+ * A connection's compression settings.
+ **/
+struct JMessageCompressor
+{
+	/**
+	 * The algorithm, J_MESSAGE_COMPRESSION_NONE if compression is disabled.
+	 **/
+	JMessageCompression algorithm;
+
+	/**
+	 * The minimum data length to compress.
+	 **/
+	guint32 threshold;
+};
+
+typedef struct JMessageCompressor JMessageCompressor;
+
+/**
+ * The message state of a connection.
+ * Created when a connection is used for the first time, see j_message_connection_get().
+ * The members are set up while establishing the connection and only read afterwards.
+ **/
+struct JMessageConnection
+{
+	/**
+	 * The dictionary of strings interned by this side, NULL if interning is disabled.
+	 **/
+	JMessageStrings* strings_send;
+
+	/**
+	 * The dictionary of strings interned by the other side, NULL until the first definitions arrive.
+	 **/
+	JMessageStrings* strings_receive;
+
+	JMessageCompressor compressor;
+
+	/**
+	 * The shared memory segment, NULL if the connection is not local.
+	 **/
+	JMessageSegment* segment;
+
+	/**
+	 * The channel, NULL if the connection is not driven by the engine, see j_message_enable_engine().
+	 **/
+	JMessageChannel* channel;
+
+	/**
+	 * Replies that have arrived while waiting for another one, indexed by their IDs, NULL if there have been none.
+	 * Only used on connections that are not driven by the engine.
+	 **/
+	GHashTable* pending;
+};
+
+typedef struct JMessageConnection JMessageConnection;
+
+/**
+ * Returns a message's header.
+ *
+ * \private
+ *
+ * \param message A message.
+ *
+ * \return The message's header.
+ **/
+static inline
+JMessageHeader*
+j_message_header (JMessage const* message)
+{
+	return (JMessageHeader*)(gpointer)message->data;
+}
+
+/**
+ * Returns a message's length.
+ *
+ * \private
+ *
+ * \param message A message.
+ *
+ * \return The message's length.
+ **/
+static inline
+gsize
+j_message_length (JMessage const* message)
+{
+	return GUINT32_FROM_LE(j_message_header(message)->length);
+}
+
+/**
+ * Checks whether it is possible to append data to a message.
+ *
+ * \private
+ *
+ * \param message A message.
+ * \param length  A length.
+ *
+ * \return TRUE if it is possible, FALSE otherwise.
+ **/
+static inline
+gboolean
+j_message_can_append (JMessage const* message, gsize length)
+{
+	return (message->current + length <= message->data + message->size);
+}
+
+/* jmessage.c */
+G_GNUC_INTERNAL gchar* j_message_buffer_new (gsize*);
+G_GNUC_INTERNAL void j_message_buffer_free (gchar*, gsize);
+G_GNUC_INTERNAL void j_message_ensure_size (JMessage*, gsize);
+G_GNUC_INTERNAL void j_message_swap_data (JMessage*, JMessage*);
+G_GNUC_INTERNAL gboolean j_message_receive_finish (JMessage*, JMessageConnection*);
+
+/* connection.c */
+G_GNUC_INTERNAL JMessageConnection* j_message_connection_get (gpointer);
+G_GNUC_INTERNAL JMessageConnection* j_message_connection_lookup (gpointer);
+
+/* strings.c */
+G_GNUC_INTERNAL JMessageStrings* j_message_strings_new (void);
+G_GNUC_INTERNAL JMessageStrings* j_message_strings_ref (JMessageStrings*);
+G_GNUC_INTERNAL void j_message_strings_unref (JMessageStrings*);
+G_GNUC_INTERNAL void j_message_strings_lock (JMessageStrings*);
+G_GNUC_INTERNAL void j_message_strings_unlock (JMessageStrings*);
+G_GNUC_INTERNAL gchar const* j_message_strings_get (JMessageStrings*, guint32);
+G_GNUC_INTERNAL GByteArray* j_message_encode_strings (JMessage*, JMessageStrings*);
+G_GNUC_INTERNAL gboolean j_message_decode_strings (JMessage*, JMessageConnection*);
+
+/* compression.c */
+G_GNUC_INTERNAL GByteArray* j_message_compress (JMessage*, gchar const*, JMessageCompressor const*);
+G_GNUC_INTERNAL gboolean j_message_decompress (JMessage*);
+
+/* shared-memory.c */
+G_GNUC_INTERNAL void j_message_segment_unref (JMessageSegment*);
+G_GNUC_INTERNAL gboolean j_message_segment_is_active (JMessageSegment const*);
+G_GNUC_INTERNAL void j_message_segment_lock (JMessageSegment*);
+G_GNUC_INTERNAL void j_message_segment_unlock (JMessageSegment*);
+G_GNUC_INTERNAL gboolean j_message_segment_write (JMessageSegment*, JMessage*, JMessageShared*);
+G_GNUC_INTERNAL gboolean j_message_attach_shared (JMessage*, JMessageConnection*);
+G_GNUC_INTERNAL void j_message_release_shared (JMessage*);
+
+/* engine.c */
+G_GNUC_INTERNAL void j_message_channel_unref (JMessageChannel*);
+G_GNUC_INTERNAL void j_message_channel_submit (JMessageChannel*, JMessageConnection*, JMessage*, JMessageReplyFunc, JMessageDoneFunc, gpointer);
+G_GNUC_INTERNAL gboolean j_message_channel_send (JMessageChannel*, JMessageConnection*, JMessage*);
+G_GNUC_INTERNAL gboolean j_message_channel_receive (JMessageChannel*, JMessage*, guint32);
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <string.h>
+
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+/**
+ * The parts of a message, in the order they arrive.
+ **/
+enum JMessageReaderPart
+{
+	J_MESSAGE_READER_HEADER,
+	J_MESSAGE_READER_SHARED,
+	J_MESSAGE_READER_BODY
+};
+
+typedef enum JMessageReaderPart JMessageReaderPart;
+
+/**
+ * Reads messages from a connection without blocking.
+ * A message that has only partially arrived is kept until the rest of it can be read.
+ **/
+struct JMessageReader
+{
+	GSocketConnection* connection;
+	GSocket* socket;
+
+	/**
+	 * The message being read, NULL if the next read starts a new message.
+	 **/
+	JMessage* message;
+
+	/**
+	 * The part of #message being read.
+	 **/
+	JMessageReaderPart part;
+
+	/**
+	 * The number of bytes of #part that have already been read.
+	 **/
+	gsize position;
+};
+
+/**
+ * Creates a new reader for a connection.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ *
+ * \return A new reader. Should be freed with j_message_reader_free().
+ **/
+JMessageReader*
+j_message_reader_new (gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageReader* reader;
+
+	g_return_val_if_fail(connection != NULL, NULL);
+
+	reader = g_slice_new(JMessageReader);
+	reader->connection = g_object_ref(connection);
+	reader->socket = g_socket_connection_get_socket(reader->connection);
+	reader->message = NULL;
+	reader->part = J_MESSAGE_READER_HEADER;
+	reader->position = 0;
+
+	return reader;
+}
+
+/**
+ * Frees a reader, discarding a partially read message.
+ *
+ * \code
+ * \endcode
+ *
+ * \param reader A reader.
+ **/
+void
+j_message_reader_free (JMessageReader* reader)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(reader != NULL);
+
+	if (reader->message != NULL)
+	{
+		j_message_unref(reader->message);
+	}
+
+	g_object_unref(reader->connection);
+
+	g_slice_free(JMessageReader, reader);
+}
+
+/**
+ * Returns the buffer of the part of the message being read, starting a new message if necessary.
+ *
+ * \private
+ *
+ * \param reader A reader.
+ * \param buffer Returns the part's buffer.
+ *
+ * \return The part's length.
+ **/
+static
+gsize
+j_message_reader_get_part (JMessageReader* reader, gchar** buffer)
+{
+	JMessage* current;
+
+	if (reader->message == NULL)
+	{
+		reader->message = j_message_new(J_MESSAGE_NONE, 0);
+		reader->part = J_MESSAGE_READER_HEADER;
+		reader->position = 0;
+	}
+
+	current = reader->message;
+
+	switch (reader->part)
+	{
+		case J_MESSAGE_READER_HEADER:
+			*buffer = current->data;
+			return sizeof(JMessageHeader);
+		case J_MESSAGE_READER_SHARED:
+			*buffer = (gchar*)&(current->shared);
+			return sizeof(JMessageShared);
+		case J_MESSAGE_READER_BODY:
+			*buffer = current->data + sizeof(JMessageHeader);
+			return j_message_length(current);
+		default:
+			g_assert_not_reached();
+	}
+
+	return 0;
+}
+
+/**
+ * Moves on to the next part once the current one has been read completely.
+ *
+ * \private
+ *
+ * \param reader  A reader.
+ * \param message Returns the message if its body has been read, NULL otherwise.
+ *
+ * \return TRUE on success, FALSE if the message is invalid.
+ **/
+static
+gboolean
+j_message_reader_advance (JMessageReader* reader, JMessage** message)
+{
+	JMessage* current = reader->message;
+
+	reader->position = 0;
+
+	if (reader->part == J_MESSAGE_READER_HEADER)
+	{
+		if (GUINT32_FROM_LE(j_message_header(current)->op_type) & J_MESSAGE_FLAG_SHARED)
+		{
+			reader->part = J_MESSAGE_READER_SHARED;
+			return TRUE;
+		}
+
+		j_message_ensure_size(current, sizeof(JMessageHeader) + j_message_length(current));
+		reader->part = J_MESSAGE_READER_BODY;
+		return TRUE;
+	}
+
+	if (reader->part == J_MESSAGE_READER_SHARED)
+	{
+		current->shared.position = GUINT64_FROM_LE(current->shared.position);
+		current->shared.end = GUINT64_FROM_LE(current->shared.end);
+		current->shared.length = GUINT64_FROM_LE(current->shared.length);
+
+		j_message_ensure_size(current, sizeof(JMessageHeader) + j_message_length(current));
+		reader->part = J_MESSAGE_READER_BODY;
+		return TRUE;
+	}
+
+	/* The message is complete, the next read starts a new one. */
+	reader->message = NULL;
+	current->current = current->data + sizeof(JMessageHeader);
+
+	if (!j_message_decompress(current) || !j_message_receive_finish(current, j_message_connection_get(reader->connection)))
+	{
+		j_message_unref(current);
+
+		return FALSE;
+	}
+
+	*message = current;
+
+	return TRUE;
+}
+
+/**
+ * Reads as much of the next message as is available without blocking.
+ * Exactly the message's header and body are read, data following the message is left on the connection.
+ * Only one thread at a time may use a reader.
+ *
+ * \code
+ * JMessage* message;
+ *
+ * if (!j_message_reader_read(reader, &message))
+ * {
+ *   // Close the connection.
+ * }
+ * else if (message == NULL)
+ * {
+ *   // Wait for the connection to become readable again.
+ * }
+ * \endcode
+ *
+ * \param reader  A reader.
+ * \param message A return location for the message, set to NULL if the message has not arrived completely.
+ *
+ * \return TRUE on success, FALSE if the connection has been closed or an error occurred.
+ **/
+gboolean
+j_message_reader_read (JMessageReader* reader, JMessage** message)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_val_if_fail(reader != NULL, FALSE);
+	g_return_val_if_fail(message != NULL, FALSE);
+
+	*message = NULL;
+
+	while (*message == NULL)
+	{
+		gchar* buffer;
+		gsize length;
+
+		length = j_message_reader_get_part(reader, &buffer);
+
+		if (reader->position < length)
+		{
+			GError* error = NULL;
+			gssize nbytes;
+
+			nbytes = g_socket_receive_with_blocking(reader->socket, buffer + reader->position, length - reader->position, FALSE, NULL, &error);
+
+			if (nbytes < 0)
+			{
+				if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+				{
+					g_error_free(error);
+
+					return TRUE;
+				}
+
+				g_critical("%s", error->message);
+				g_error_free(error);
+
+				return FALSE;
+			}
+
+			/* The connection has been closed by the other side. */
+			if (nbytes == 0)
+			{
+				return FALSE;
+			}
+
+			reader->position += nbytes;
+
+			if (reader->position < length)
+			{
+				continue;
+			}
+		}
+
+		if (!j_message_reader_advance(reader, message))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Parses the next message from data that has already been received from the reader's connection, for example into an io_uring buffer.
+ * Like j_message_reader_read(), this stops directly after the message, the remaining data is left to the caller.
+ * Only one thread at a time may use a reader.
+ *
+ * \code
+ * JMessage* message;
+ * gsize consumed;
+ *
+ * while (length > 0)
+ * {
+ *   if (!j_message_reader_feed(reader, data, length, &consumed, &message))
+ *   {
+ *     // Close the connection.
+ *   }
+ *
+ *   data += consumed;
+ *   length -= consumed;
+ *
+ *   if (message != NULL)
+ *   {
+ *     // Handle the message.
+ *   }
+ * }
+ * \endcode
+ *
+ * \param reader   A reader.
+ * \param data     The received data.
+ * \param length   The length of #data.
+ * \param consumed A return location for the number of bytes that have been consumed from #data.
+ * \param message  A return location for the message, set to NULL if #data did not contain the rest of it.
+ *
+ * \return TRUE on success, FALSE if the message is invalid.
+ **/
+gboolean
+j_message_reader_feed (JMessageReader* reader, gconstpointer data, gsize length, gsize* consumed, JMessage** message)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gchar const* position = data;
+
+	g_return_val_if_fail(reader != NULL, FALSE);
+	g_return_val_if_fail(data != NULL || length == 0, FALSE);
+	g_return_val_if_fail(consumed != NULL, FALSE);
+	g_return_val_if_fail(message != NULL, FALSE);
+
+	*consumed = 0;
+	*message = NULL;
+
+	while (*message == NULL)
+	{
+		gchar* buffer;
+		gsize part_length;
+
+		part_length = j_message_reader_get_part(reader, &buffer);
+
+		if (reader->position < part_length)
+		{
+			gsize nbytes;
+
+			nbytes = MIN(part_length - reader->position, length - *consumed);
+			memcpy(buffer + reader->position, position + *consumed, nbytes);
+
+			reader->position += nbytes;
+			*consumed += nbytes;
+
+			if (reader->position < part_length)
+			{
+				return TRUE;
+			}
+		}
+
+		if (!j_message_reader_advance(reader, message))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * @}
+ **/
@@ -0,0 +1,817 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#define _GNU_SOURCE
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <jlist.h>
+#include <jlist-iterator.h>
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+/**
+ * Each ring of a shared memory segment starts with a header of this size, which contains the ring's tail.
+ * The header fills a whole cache line, so that the tail does not share it with data.
+ **/
+#define J_MESSAGE_RING_HEADER_SIZE 64
+
+/**
+ * A shared memory segment of a connection between a client and a server on the same node.
+ * The segment contains two rings, one for each direction, the first one is used by the client to send data.
+ * Data is placed in a ring contiguously, if it does not fit before the ring's end, it is placed at the ring's start.
+ * Positions increase monotonically and are only reduced modulo the capacity when accessing the ring.
+ **/
+struct JMessageSegment
+{
+	/**
+	 * Serializes senders, data has to be sent in the order it has been placed in the ring.
+	 **/
+	GMutex mutex[1];
+
+	/**
+	 * The mapping.
+	 **/
+	gchar* data;
+	gsize size;
+
+	/**
+	 * The capacity of each ring.
+	 **/
+	gsize capacity;
+
+	/**
+	 * The ring to send data with.
+	 * The head is only known to the sender, the tail is advanced by the receiving side.
+	 * The tail is a position stored in the ring's header, it is only accessed atomically, see j_message_ring_get_tail().
+	 **/
+	gchar* send_ring;
+	gsize* send_tail;
+	gsize send_head;
+
+	/**
+	 * The ring to receive data from.
+	 **/
+	gchar* receive_ring;
+	gsize* receive_tail;
+
+	/**
+	 * Whether the other side has mapped the segment.
+	 **/
+	gboolean active;
+
+	gint ref_count;
+};
+
+/**
+ * Returns the position up to which a ring's data has been released.
+ * The tail is shared with another process, so it is accessed using atomic operations instead of the segment's mutex.
+ *
+ * \private
+ *
+ * \param tail A ring's tail.
+ *
+ * \return The tail's position.
+ **/
+static
+gsize
+j_message_ring_get_tail (gsize* tail)
+{
+	return __atomic_load_n(tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Advances a ring's tail, unless another thread has already advanced it further.
+ * Messages might be released in a different order than they have been received in.
+ *
+ * \private
+ *
+ * \param tail     A ring's tail.
+ * \param position The new position.
+ **/
+static
+void
+j_message_ring_advance_tail (gsize* tail, gsize position)
+{
+	gsize current;
+
+	current = __atomic_load_n(tail, __ATOMIC_ACQUIRE);
+
+	while (current < position)
+	{
+		if (__atomic_compare_exchange_n(tail, &current, position, FALSE, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+	}
+}
+
+/**
+ * Returns the size of a shared memory segment.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param capacity The capacity of each direction's ring.
+ *
+ * \return The size.
+ **/
+static
+gsize
+j_message_segment_size (gsize capacity)
+{
+	/* Each ring's area has to be a multiple of the header size, see j_message_segment_new(). */
+	return 2 * ((J_MESSAGE_RING_HEADER_SIZE + capacity + J_MESSAGE_RING_HEADER_SIZE - 1) & ~(gsize)(J_MESSAGE_RING_HEADER_SIZE - 1));
+}
+
+/**
+ * Maps a shared memory segment.
+ * The segment is split into two rings of equal size.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param fd     A file descriptor referring to the segment.
+ * \param client TRUE if the caller is the client, FALSE if it is the server.
+ *
+ * \return A new segment, or NULL if the segment could not be mapped.
+ **/
+static
+JMessageSegment*
+j_message_segment_new (gint fd, gboolean client)
+{
+	JMessageSegment* segment;
+	struct stat buf;
+	gchar* data;
+	gchar* areas[2];
+	gsize area_size;
+
+	if (fstat(fd, &buf) != 0)
+	{
+		return NULL;
+	}
+
+	/* Both sides compute the same layout, so the tails are always aligned to the header size. */
+	area_size = ((gsize)buf.st_size / 2) & ~(gsize)(J_MESSAGE_RING_HEADER_SIZE - 1);
+
+	if (area_size <= J_MESSAGE_RING_HEADER_SIZE)
+	{
+		return NULL;
+	}
+
+	data = mmap(NULL, buf.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	if (data == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	areas[0] = data;
+	areas[1] = data + area_size;
+
+	segment = g_slice_new(JMessageSegment);
+	g_mutex_init(segment->mutex);
+	segment->data = data;
+	segment->size = buf.st_size;
+	segment->capacity = area_size - J_MESSAGE_RING_HEADER_SIZE;
+	segment->send_tail = (gsize*)(gpointer)areas[client ? 0 : 1];
+	segment->send_ring = areas[client ? 0 : 1] + J_MESSAGE_RING_HEADER_SIZE;
+	segment->send_head = j_message_ring_get_tail(segment->send_tail);
+	segment->receive_tail = (gsize*)(gpointer)areas[client ? 1 : 0];
+	segment->receive_ring = areas[client ? 1 : 0] + J_MESSAGE_RING_HEADER_SIZE;
+	/* The client has to wait for the server to map the segment, see j_message_enable_shared_memory(). */
+	segment->active = !client;
+	segment->ref_count = 1;
+
+	return segment;
+}
+
+static
+JMessageSegment*
+j_message_segment_ref (JMessageSegment* segment)
+{
+	g_atomic_int_inc(&(segment->ref_count));
+
+	return segment;
+}
+
+void
+j_message_segment_unref (JMessageSegment* segment)
+{
+	if (g_atomic_int_dec_and_test(&(segment->ref_count)))
+	{
+		munmap(segment->data, segment->size);
+		g_mutex_clear(segment->mutex);
+
+		g_slice_free(JMessageSegment, segment);
+	}
+}
+
+gboolean
+j_message_segment_is_active (JMessageSegment const* segment)
+{
+	return segment->active;
+}
+
+void
+j_message_segment_lock (JMessageSegment* segment)
+{
+	g_mutex_lock(segment->mutex);
+}
+
+void
+j_message_segment_unlock (JMessageSegment* segment)
+{
+	g_mutex_unlock(segment->mutex);
+}
+
+/**
+ * Returns the position to place data at.
+ * Data that does not fit before the ring's end is placed at the ring's start.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param segment  A segment.
+ * \param position The next free position.
+ * \param length   The data's length.
+ *
+ * \return The data's position.
+ **/
+static
+gsize
+j_message_segment_place (JMessageSegment const* segment, gsize position, guint64 length)
+{
+	gsize offset;
+
+	offset = position % segment->capacity;
+
+	if (offset + length > segment->capacity)
+	{
+		position += segment->capacity - offset;
+	}
+
+	return position;
+}
+
+/**
+ * Reads data from a file descriptor into a segment.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message_data The data.
+ * \param buffer       The data's place within the segment.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_segment_read_fd (JMessageData const* message_data, gchar* buffer)
+{
+	guint64 offset = 0;
+
+	while (offset < message_data->length)
+	{
+		gssize nbytes;
+
+		nbytes = pread(message_data->fd, buffer + offset, message_data->length - offset, message_data->offset + offset);
+
+		if (nbytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return FALSE;
+		}
+		else if (nbytes == 0)
+		{
+			/* The receiver expects exactly length bytes, so pad truncated files with zeros. */
+			memset(buffer + offset, 0, message_data->length - offset);
+			break;
+		}
+
+		offset += nbytes;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Places a message's additional data in a segment.
+ * Data from file descriptors is read into the segment directly.
+ * Must be called with the segment's mutex held, the message has to be written before the mutex is released.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param segment A segment.
+ * \param message A message.
+ * \param shared  Returns the description of the data.
+ *
+ * \return TRUE on success, FALSE if the data does not fit into the segment.
+ **/
+gboolean
+j_message_segment_write (JMessageSegment* segment, JMessage* message, JMessageShared* shared)
+{
+	g_autoptr(JListIterator) iterator = NULL;
+	gsize position;
+	gsize tail;
+
+	position = segment->send_head;
+	tail = j_message_ring_get_tail(segment->send_tail);
+
+	shared->position = position;
+	shared->length = 0;
+
+	iterator = j_list_iterator_new(message->send_list);
+
+	while (j_list_iterator_next(iterator))
+	{
+		JMessageData* message_data = j_list_iterator_get(iterator);
+
+		if (message_data->length > segment->capacity)
+		{
+			return FALSE;
+		}
+
+		position = j_message_segment_place(segment, position, message_data->length) + message_data->length;
+		shared->length += message_data->length;
+	}
+
+	/* Space is only reused once the receiving side has released it. */
+	if (position - tail > segment->capacity)
+	{
+		return FALSE;
+	}
+
+	shared->end = position;
+	position = shared->position;
+
+	g_clear_pointer(&iterator, j_list_iterator_free);
+	iterator = j_list_iterator_new(message->send_list);
+
+	while (j_list_iterator_next(iterator))
+	{
+		JMessageData* message_data = j_list_iterator_get(iterator);
+		gchar* buffer;
+
+		position = j_message_segment_place(segment, position, message_data->length);
+		buffer = segment->send_ring + position % segment->capacity;
+
+		if (message_data->fd != -1)
+		{
+			if (!j_message_segment_read_fd(message_data, buffer))
+			{
+				return FALSE;
+			}
+		}
+		else
+		{
+			memcpy(buffer, message_data->data, message_data->length);
+		}
+
+		position += message_data->length;
+	}
+
+	segment->send_head = shared->end;
+
+	return TRUE;
+}
+
+/**
+ * Attaches a connection's segment to a message that has been received with shared data.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param state   The state of the connection the message has been received from.
+ *
+ * \return TRUE on success, FALSE if the connection has no segment.
+ **/
+gboolean
+j_message_attach_shared (JMessage* message, JMessageConnection* state)
+{
+	JMessageSegment* segment;
+
+	if (!(GUINT32_FROM_LE(j_message_header(message)->op_type) & J_MESSAGE_FLAG_SHARED))
+	{
+		return TRUE;
+	}
+
+	segment = state->segment;
+
+	if (segment == NULL || !segment->active)
+	{
+		g_critical("Received shared data without a shared memory segment.");
+		return FALSE;
+	}
+
+	message->segment = j_message_segment_ref(segment);
+
+	return TRUE;
+}
+
+/**
+ * Releases a message's shared data, so that the sending side can reuse its space.
+ * Data is consumed in the order it has been sent, so the tail only has to be advanced.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ **/
+void
+j_message_release_shared (JMessage* message)
+{
+	JMessageSegment* segment = message->segment;
+
+	if (segment == NULL)
+	{
+		return;
+	}
+
+	j_message_ring_advance_tail(segment->receive_tail, message->shared.end);
+
+	j_message_segment_unref(segment);
+	message->segment = NULL;
+}
+
+/**
+ * Gets the next additional data of a message from the connection's shared memory segment.
+ * The data has to be consumed in the order it has been added with j_message_add_send() or j_message_add_send_fd().
+ * The returned pointer stays valid until the message is freed.
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param length  The data's length.
+ *
+ * \return A pointer to the data, or NULL if the message's data has not been placed in a segment and has to be read from the connection.
+ **/
+gpointer
+j_message_get_shared (JMessage* message, guint64 length)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageSegment* segment;
+	gsize position;
+
+	g_return_val_if_fail(message != NULL, NULL);
+
+	segment = message->segment;
+
+	if (segment == NULL)
+	{
+		return NULL;
+	}
+
+	g_return_val_if_fail(length <= segment->capacity, NULL);
+
+	position = j_message_segment_place(segment, message->shared.position, length);
+	message->shared.position = position + length;
+
+	return segment->receive_ring + position % segment->capacity;
+}
+
+/**
+ * Sends a marker that is followed by a shared memory segment's file descriptor, if any.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param socket A socket.
+ * \param fd     A file descriptor, or -1.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_send_marker (GSocket* socket, gint fd)
+{
+	union
+	{
+		struct cmsghdr header;
+		gchar buffer[CMSG_SPACE(sizeof(gint))];
+	}
+	control;
+
+	struct msghdr msg;
+	struct iovec iov;
+	gchar marker = 0;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+
+	iov.iov_base = &marker;
+	iov.iov_len = sizeof(marker);
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fd != -1)
+	{
+		struct cmsghdr* cmsg;
+
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(gint));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(gint));
+	}
+
+	while (sendmsg(g_socket_get_fd(socket), &msg, MSG_NOSIGNAL) < 0)
+	{
+		/* GIO makes sockets non-blocking. */
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			if (!g_socket_condition_wait(socket, G_IO_OUT, NULL, NULL))
+			{
+				return FALSE;
+			}
+		}
+		else if (errno != EINTR)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Receives a marker sent with j_message_send_marker().
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param socket A socket.
+ * \param fd     Returns the received file descriptor, or -1.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+static
+gboolean
+j_message_receive_marker (GSocket* socket, gint* fd)
+{
+	union
+	{
+		struct cmsghdr header;
+		gchar buffer[CMSG_SPACE(sizeof(gint))];
+	}
+	control;
+
+	struct cmsghdr* cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	gchar marker;
+	gssize nbytes;
+
+	*fd = -1;
+
+	memset(&msg, 0, sizeof(msg));
+
+	iov.iov_base = &marker;
+	iov.iov_len = sizeof(marker);
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buffer;
+	msg.msg_controllen = sizeof(control.buffer);
+
+	while ((nbytes = recvmsg(g_socket_get_fd(socket), &msg, MSG_CMSG_CLOEXEC)) < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			if (!g_socket_condition_wait(socket, G_IO_IN, NULL, NULL))
+			{
+				return FALSE;
+			}
+		}
+		else if (errno != EINTR)
+		{
+			return FALSE;
+		}
+	}
+
+	if (nbytes == 0)
+	{
+		return FALSE;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(gint)))
+		{
+			memcpy(fd, CMSG_DATA(cmsg), sizeof(gint));
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * Offers a shared memory segment to the server of a local connection.
+ * Must be called directly after sending a J_MESSAGE_PING containing the "shm" operation, which makes the server call j_message_accept_shared_memory().
+ * The segment is only used after the server has confirmed it, see j_message_enable_shared_memory().
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection, which has to be a UNIX socket.
+ * \param capacity   The capacity of each direction's ring.
+ **/
+void
+j_message_offer_shared_memory (gpointer connection, gsize capacity)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageSegment* segment = NULL;
+	gint fd = -1;
+
+	g_return_if_fail(connection != NULL);
+
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("julea-message", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	/* The segment's size is sealed, the server would otherwise crash when accessing it after it has been shrunk, see j_message_accept_shared_memory(). */
+	if (fd != -1
+	    && (ftruncate(fd, j_message_segment_size(capacity)) != 0
+	        || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0
+	        || (segment = j_message_segment_new(fd, TRUE)) == NULL))
+	{
+		close(fd);
+		fd = -1;
+	}
+#else
+	(void)capacity;
+#endif
+
+	/* The server expects the marker even if no segment could be created. */
+	if (!j_message_send_marker(g_socket_connection_get_socket(connection), fd))
+	{
+		g_clear_pointer(&segment, j_message_segment_unref);
+	}
+
+	if (fd != -1)
+	{
+		close(fd);
+	}
+
+	if (segment != NULL)
+	{
+		j_message_connection_get(connection)->segment = segment;
+	}
+}
+
+/**
+ * Accepts a shared memory segment offered with j_message_offer_shared_memory().
+ * Additional data of messages sent via the connection is placed in the segment from now on, if it fits.
+ * Segments are rejected if their size is not sealed or if they are larger than #capacity allows.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ * \param capacity   The maximum capacity of each direction's ring.
+ *
+ * \return TRUE if the segment has been mapped, FALSE otherwise.
+ **/
+gboolean
+j_message_accept_shared_memory (gpointer connection, gsize capacity)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageSegment* segment = NULL;
+	gint fd;
+#ifdef HAVE_MEMFD_CREATE
+	struct stat buf;
+	gint seals;
+#endif
+
+	g_return_val_if_fail(connection != NULL, FALSE);
+
+	if (!j_message_receive_marker(g_socket_connection_get_socket(connection), &fd) || fd == -1)
+	{
+		return FALSE;
+	}
+
+#ifdef HAVE_MEMFD_CREATE
+	/* The client must not be able to change the segment's size after it has been mapped, accesses beyond its end would crash the server. */
+	seals = fcntl(fd, F_GET_SEALS);
+
+	if (seals != -1
+	    && (seals & (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) == (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+	    && fstat(fd, &buf) == 0
+	    && (guint64)buf.st_size <= j_message_segment_size(capacity))
+	{
+		segment = j_message_segment_new(fd, FALSE);
+	}
+#else
+	(void)capacity;
+#endif
+
+	close(fd);
+
+	if (segment == NULL)
+	{
+		return FALSE;
+	}
+
+	j_message_connection_get(connection)->segment = segment;
+
+	return TRUE;
+}
+
+/**
+ * Starts using a shared memory segment offered with j_message_offer_shared_memory().
+ * Must only be called after the server has confirmed the segment.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ **/
+void
+j_message_enable_shared_memory (gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageConnection* state;
+
+	g_return_if_fail(connection != NULL);
+
+	state = j_message_connection_lookup(connection);
+
+	if (state != NULL && state->segment != NULL)
+	{
+		state->segment->active = TRUE;
+	}
+}
+
+/**
+ * @}
+ **/
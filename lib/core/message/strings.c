@@ -0,0 +1,408 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2010-2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ **/
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <string.h>
+
+#include <jtrace.h>
+
+#include "message.h"
+
+/**
+ * \addtogroup JMessage
+ *
+ * @{
+ **/
+
+/**
+ * Strings are only interned if they are longer than a reference.
+ **/
+#define J_MESSAGE_STRING_MIN_LENGTH (1 + sizeof(guint32))
+
+/**
+ * The maximum number of interned strings per connection.
+ * Only namespaces are interned, of which there are few, so strings are never evicted.
+ * Once the dictionary is full, further strings are sent as they are.
+ **/
+#define J_MESSAGE_STRINGS_MAX 4096
+
+/**
+ * A connection's dictionary of interned strings.
+ * Strings are assigned consecutive IDs in the order they are sent.
+ **/
+struct JMessageStrings
+{
+	GMutex mutex[1];
+
+	/**
+	 * The interned strings, indexed by their IDs.
+	 * Only used on the receiving side.
+	 **/
+	GPtrArray* strings;
+
+	/**
+	 * Maps strings to their IDs.
+	 * Only used on the sending side.
+	 **/
+	GHashTable* ids;
+
+	/**
+	 * The number of interned strings.
+	 * Only used on the sending side.
+	 **/
+	guint32 count;
+
+	gint ref_count;
+};
+
+typedef struct JMessageStrings JMessageStrings;
+
+JMessageStrings*
+j_message_strings_new (void)
+{
+	JMessageStrings* strings;
+
+	strings = g_slice_new(JMessageStrings);
+	g_mutex_init(strings->mutex);
+	strings->strings = g_ptr_array_new_with_free_func(g_free);
+	strings->ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	strings->count = 0;
+	strings->ref_count = 1;
+
+	return strings;
+}
+
+JMessageStrings*
+j_message_strings_ref (JMessageStrings* strings)
+{
+	g_atomic_int_inc(&(strings->ref_count));
+
+	return strings;
+}
+
+void
+j_message_strings_unref (JMessageStrings* strings)
+{
+	if (g_atomic_int_dec_and_test(&(strings->ref_count)))
+	{
+		g_hash_table_unref(strings->ids);
+		g_ptr_array_unref(strings->strings);
+		g_mutex_clear(strings->mutex);
+
+		g_slice_free(JMessageStrings, strings);
+	}
+}
+
+void
+j_message_strings_lock (JMessageStrings* strings)
+{
+	g_mutex_lock(strings->mutex);
+}
+
+void
+j_message_strings_unlock (JMessageStrings* strings)
+{
+	g_mutex_unlock(strings->mutex);
+}
+
+/**
+ * Resolves an interned string received from the other side.
+ *
+ * \private
+ *
+ * \param strings A dictionary.
+ * \param id      The string's ID.
+ *
+ * \return The string, or NULL if the ID has not been defined.
+ **/
+gchar const*
+j_message_strings_get (JMessageStrings* strings, guint32 id)
+{
+	gchar const* ret;
+
+	/* Interned strings are never removed, so they stay valid as long as the dictionary exists. */
+	g_mutex_lock(strings->mutex);
+	ret = (id < strings->strings->len) ? g_ptr_array_index(strings->strings, id) : NULL;
+	g_mutex_unlock(strings->mutex);
+
+	return ret;
+}
+
+/**
+ * Looks up the ID of a string to send, interning it if it is used for the first time.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param strings A dictionary, its mutex has to be locked.
+ * \param str     A string.
+ * \param id      A return location for the ID.
+ * \param defined Set to TRUE if the string has just been interned.
+ *
+ * \return TRUE if the string is interned, FALSE if the dictionary is full.
+ **/
+static
+gboolean
+j_message_strings_lookup (JMessageStrings* strings, gchar const* str, guint32* id, gboolean* defined)
+{
+	gpointer value;
+
+	*defined = FALSE;
+
+	if (g_hash_table_lookup_extended(strings->ids, str, NULL, &value))
+	{
+		*id = GPOINTER_TO_UINT(value);
+
+		return TRUE;
+	}
+
+	if (strings->count >= J_MESSAGE_STRINGS_MAX)
+	{
+		return FALSE;
+	}
+
+	*id = strings->count++;
+	*defined = TRUE;
+	g_hash_table_insert(strings->ids, g_strdup(str), GUINT_TO_POINTER(*id));
+
+	return TRUE;
+}
+
+/**
+ * Encodes a message for sending with interned strings.
+ * The header's operation type is flagged and the message body is preceded by the definitions of newly interned strings.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param strings A dictionary, its mutex has to be locked.
+ *
+ * \return The encoded message, or NULL if no strings have been interned.
+ **/
+GByteArray*
+j_message_encode_strings (JMessage* message, JMessageStrings* strings)
+{
+	g_autoptr(GByteArray) definitions = NULL;
+	g_autoptr(GByteArray) body = NULL;
+	GByteArray* encoded;
+	JMessageHeader header;
+	gboolean changed = FALSE;
+	gsize position;
+	gsize end;
+	guint32 definitions_count = 0;
+	guint32 length;
+
+	if (message->string_offsets == NULL)
+	{
+		return NULL;
+	}
+
+	definitions = g_byte_array_new();
+	body = g_byte_array_sized_new(j_message_length(message));
+
+	position = sizeof(JMessageHeader);
+	end = sizeof(JMessageHeader) + j_message_length(message);
+
+	for (guint i = 0; i < message->string_offsets->len; i++)
+	{
+		JMessageString const* string = &g_array_index(message->string_offsets, JMessageString, i);
+		guint32 offset = string->offset;
+		gchar const* str = message->data + offset;
+		guchar first = str[0];
+		gsize str_length;
+		gboolean defined;
+		guint32 id;
+
+		str_length = strlen(str) + 1;
+
+		g_byte_array_append(body, (guint8 const*)message->data + position, offset - position);
+		position = offset + str_length;
+
+		if (string->intern && str_length > J_MESSAGE_STRING_MIN_LENGTH && j_message_strings_lookup(strings, str, &id, &defined))
+		{
+			guint8 marker = J_MESSAGE_STRING_REFERENCE;
+			guint32 id_le = GUINT32_TO_LE(id);
+
+			if (defined)
+			{
+				g_byte_array_append(definitions, (guint8 const*)&id_le, sizeof(id_le));
+				g_byte_array_append(definitions, (guint8 const*)str, str_length);
+				definitions_count++;
+			}
+
+			g_byte_array_append(body, &marker, 1);
+			g_byte_array_append(body, (guint8 const*)&id_le, sizeof(id_le));
+			changed = TRUE;
+
+			continue;
+		}
+
+		if (first == J_MESSAGE_STRING_REFERENCE || first == J_MESSAGE_STRING_ESCAPE)
+		{
+			guint8 marker = J_MESSAGE_STRING_ESCAPE;
+
+			g_byte_array_append(body, &marker, 1);
+			changed = TRUE;
+		}
+
+		g_byte_array_append(body, (guint8 const*)str, str_length);
+	}
+
+	if (!changed)
+	{
+		return NULL;
+	}
+
+	g_byte_array_append(body, (guint8 const*)message->data + position, end - position);
+
+	length = sizeof(guint32) + definitions->len + body->len;
+	definitions_count = GUINT32_TO_LE(definitions_count);
+
+	memcpy(&header, message->data, sizeof(JMessageHeader));
+	header.length = GUINT32_TO_LE(length);
+	header.op_type = GUINT32_TO_LE(GUINT32_FROM_LE(header.op_type) | J_MESSAGE_FLAG_STRINGS);
+
+	encoded = g_byte_array_sized_new(sizeof(JMessageHeader) + length);
+	g_byte_array_append(encoded, (guint8 const*)&header, sizeof(JMessageHeader));
+	g_byte_array_append(encoded, (guint8 const*)&definitions_count, sizeof(definitions_count));
+	g_byte_array_append(encoded, definitions->data, definitions->len);
+	g_byte_array_append(encoded, body->data, body->len);
+
+	return encoded;
+}
+
+/**
+ * Reads the definitions of newly interned strings from a received message.
+ *
+ * \private
+ *
+ * \code
+ * \endcode
+ *
+ * \param message A message.
+ * \param state   The state of the connection the message has been received from.
+ *
+ * \return TRUE on success, FALSE if an error occurred.
+ **/
+gboolean
+j_message_decode_strings (JMessage* message, JMessageConnection* state)
+{
+	JMessageStrings* strings;
+	gboolean ret = FALSE;
+	guint32 count;
+
+	/* Only the thread receiving from the connection defines strings, so the dictionary can be created without locking. */
+	if (state->strings_receive == NULL)
+	{
+		state->strings_receive = j_message_strings_new();
+	}
+
+	strings = state->strings_receive;
+
+	g_mutex_lock(strings->mutex);
+
+	if (!j_message_can_get(message, sizeof(guint32)))
+	{
+		goto end;
+	}
+
+	count = j_message_get_4(message);
+
+	for (guint32 i = 0; i < count; i++)
+	{
+		gchar const* str;
+		gchar const* str_end;
+		guint32 id;
+
+		if (!j_message_can_get(message, sizeof(guint32)))
+		{
+			goto end;
+		}
+
+		id = j_message_get_4(message);
+		str = message->current;
+		str_end = memchr(str, '\0', message->data + sizeof(JMessageHeader) + j_message_length(message) - str);
+
+		/* Definitions have to arrive in the order the IDs have been assigned in. */
+		if (str_end == NULL || id != strings->strings->len || id >= J_MESSAGE_STRINGS_MAX)
+		{
+			goto end;
+		}
+
+		g_ptr_array_add(strings->strings, g_strndup(str, str_end - str));
+		message->current = (gchar*)str_end + 1;
+	}
+
+	message->strings = j_message_strings_ref(strings);
+
+	ret = TRUE;
+
+end:
+	g_mutex_unlock(strings->mutex);
+
+	if (!ret)
+	{
+		g_critical("Received invalid string definitions.");
+	}
+
+	return ret;
+}
+
+/**
+ * Enables string interning for messages sent via a connection.
+ * Strings appended with j_message_append_namespace() are assigned IDs when they are sent for the first time, later messages only contain the IDs.
+ * The receiving side has to support interning, see J_MESSAGE_PING.
+ *
+ * \code
+ * \endcode
+ *
+ * \param connection A connection.
+ **/
+void
+j_message_enable_interning (gpointer connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JMessageConnection* state;
+
+	g_return_if_fail(connection != NULL);
+
+	state = j_message_connection_get(connection);
+
+	if (state->strings_send == NULL)
+	{
+		state->strings_send = j_message_strings_new();
+	}
+}
+
+/**
+ * @}
+ **/
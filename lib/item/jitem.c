@@ -38,6 +38,9 @@
 #include <julea-kv.h>
 #include <julea-object.h>
 
+#include <kv/jkv-internal.h>
+#include <object/jdistributed-object-internal.h>
+
 /**
  * \defgroup JItem Item
  *
@@ -107,6 +110,25 @@ struct JItem
 	gint ref_count;
 };
 
+/**
+ * Returns the resource accessed by an item's operations, see JOperation.
+ * The item's metadata and data are stored in different namespaces, using the collection's resource as a parent keeps operations on the collection and its items in order.
+ *
+ * \private
+ *
+ * \param collection A collection.
+ * \param name       An item name.
+ *
+ * \return The resource. Should be freed with g_free().
+ **/
+static
+gchar*
+j_item_get_resource (JCollection* collection, gchar const* name)
+{
+	/* Collections are stored in the collections namespace, see j_collection_new(). */
+	return g_build_path("/", "collections", j_collection_get_name(collection), name, NULL);
+}
+
 /**
  * Increases an item's reference count.
  *
@@ -269,6 +291,7 @@ j_item_get (JCollection* collection, JItem** item, gchar const* name, JBatch* ba
 	JItemGetData* data;
 	g_autoptr(JKV) kv = NULL;
 	g_autofree gchar* path = NULL;
+	g_autofree gchar* resource = NULL;
 
 	g_return_if_fail(collection != NULL);
 	g_return_if_fail(item != NULL);
@@ -279,7 +302,9 @@ j_item_get (JCollection* collection, JItem** item, gchar const* name, JBatch* ba
 	data->item = item;
 
 	path = g_build_path("/", j_collection_get_name(collection), name, NULL);
+	resource = j_item_get_resource(collection, name);
 	kv = j_kv_new("items", path);
+	j_kv_set_resource(kv, resource);
 	j_kv_get_callback(kv, j_item_get_callback, data, batch);
 }
 
@@ -470,6 +495,7 @@ j_item_new (JCollection* collection, gchar const* name, JDistribution* distribut
 
 	JItem* item = NULL;
 	g_autofree gchar* path = NULL;
+	g_autofree gchar* resource = NULL;
 
 	g_return_val_if_fail(collection != NULL, NULL);
 	g_return_val_if_fail(name != NULL, NULL);
@@ -496,8 +522,11 @@ j_item_new (JCollection* collection, gchar const* name, JDistribution* distribut
 	item->ref_count = 1;
 
 	path = g_build_path("/", j_collection_get_name(item->collection), item->name, NULL);
+	resource = j_item_get_resource(item->collection, item->name);
 	item->kv = j_kv_new("items", path);
 	item->object = j_distributed_object_new("item", path, item->distribution);
+	j_kv_set_resource(item->kv, resource);
+	j_distributed_object_set_resource(item->object, resource);
 
 	return item;
 }
@@ -522,6 +551,7 @@ j_item_new_from_bson (JCollection* collection, bson_t const* b)
 
 	JItem* item;
 	g_autofree gchar* path = NULL;
+	g_autofree gchar* resource = NULL;
 
 	g_return_val_if_fail(collection != NULL, NULL);
 	g_return_val_if_fail(b != NULL, NULL);
@@ -539,8 +569,11 @@ j_item_new_from_bson (JCollection* collection, bson_t const* b)
 	j_item_deserialize(item, b);
 
 	path = g_build_path("/", j_collection_get_name(item->collection), item->name, NULL);
+	resource = j_item_get_resource(item->collection, item->name);
 	item->kv = j_kv_new("items", path);
 	item->object = j_distributed_object_new("item", path, item->distribution);
+	j_kv_set_resource(item->kv, resource);
+	j_distributed_object_set_resource(item->object, resource);
 
 	return item;
 }
@@ -88,11 +88,11 @@ fetch_reply (guint32 index, gchar const* namespace, gchar const* prefix)
 	}
 
 	message = j_message_new(message_type, namespace_len + prefix_len);
-	j_message_append_n(message, namespace, namespace_len);
+	j_message_append_namespace(message, namespace);
 
 	if (prefix != NULL)
 	{
-		j_message_append_n(message, prefix, prefix_len);
+		j_message_append_string(message, prefix);
 	}
 
 	kv_connection = j_connection_pool_pop(J_BACKEND_TYPE_KV, index);
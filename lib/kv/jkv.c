@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include <kv/jkv.h>
+#include <kv/jkv-internal.h>
 
 #include <julea.h>
 
@@ -85,6 +86,17 @@ struct JKV
 	 **/
 	gchar* key;
 
+	/**
+	 * The key of the key-value pair's operations, see j_helper_get_namespace_key().
+	 **/
+	gconstpointer operation_key;
+
+	/**
+	 * The resource accessed by the key-value pair's operations, see JOperation and j_kv_set_resource().
+	 * By default, it consists of the namespace and the key, so that equal keys in different namespaces do not depend on each other.
+	 **/
+	gchar* resource;
+
 	/**
 	 * The reference count.
 	 **/
@@ -127,9 +139,108 @@ j_kv_get_free (gpointer data)
 	g_slice_free(JKVOperation, operation);
 }
 
+/**
+ * A request to the server of a namespace's key-value pairs.
+ **/
+struct JKVRequest
+{
+	guint32 index;
+
+	/**
+	 * The connection the request has been sent on.
+	 **/
+	gpointer connection;
+
+	JOperationDoneFunc done_func;
+	gpointer done_data;
+};
+
+typedef struct JKVRequest JKVRequest;
+
+/**
+ * Finishes a request by returning its connection to the pool.
+ *
+ * \private
+ *
+ * \param success Whether the request has succeeded.
+ * \param data    A request.
+ **/
+static
+void
+j_kv_request_done (gboolean success, gpointer data)
+{
+	JKVRequest* request = data;
+
+	JOperationDoneFunc done_func = request->done_func;
+	gpointer done_data = request->done_data;
+
+	j_connection_pool_push(J_BACKEND_TYPE_KV, request->index, request->connection);
+	g_slice_free(JKVRequest, request);
+
+	done_func(success, done_data);
+}
+
+/**
+ * Handles the reply to a put or delete request.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE.
+ **/
 static
 gboolean
-j_kv_put_exec (JList* operations, JSemantics* semantics)
+j_kv_acknowledge_reply (JMessage* reply, gpointer data)
+{
+	(void)reply;
+	(void)data;
+
+	/* FIXME do something with reply */
+
+	return TRUE;
+}
+
+/**
+ * Sends a put or delete request without waiting for it.
+ * A reply is only requested for safe semantics.
+ *
+ * \private
+ *
+ * \param index     The server index.
+ * \param message   A message.
+ * \param semantics The semantics.
+ * \param done_func A function to call once the request is done.
+ * \param done_data Data to pass to #done_func.
+ **/
+static
+void
+j_kv_request_send (guint32 index, JMessage* message, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
+{
+	JKVRequest* request;
+	JMessageReplyFunc reply_func = NULL;
+	JSemanticsSafety safety;
+
+	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
+
+	if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
+	{
+		reply_func = j_kv_acknowledge_reply;
+	}
+
+	request = g_slice_new(JKVRequest);
+	request->index = index;
+	request->connection = j_connection_pool_pop(J_BACKEND_TYPE_KV, index);
+	request->done_func = done_func;
+	request->done_data = done_data;
+
+	j_message_send_async(message, request->connection, reply_func, j_kv_request_done, request);
+}
+
+static
+void
+j_kv_put_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -138,14 +249,13 @@ j_kv_put_exec (JList* operations, JSemantics* semantics)
 	JBackend* kv_backend;
 	g_autoptr(JListIterator) it = NULL;
 	g_autoptr(JMessage) message = NULL;
-	JSemanticsSafety safety;
 	gchar const* namespace;
 	gpointer kv_batch = NULL;
 	gsize namespace_len;
 	guint32 index;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JKVOperation* kop;
@@ -158,7 +268,6 @@ j_kv_put_exec (JList* operations, JSemantics* semantics)
 		index = kop->put.kv->index;
 	}
 
-	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
 	it = j_list_iterator_new(operations);
 	kv_backend = j_backend(J_BACKEND_TYPE_KV);
 
@@ -178,7 +287,7 @@ j_kv_put_exec (JList* operations, JSemantics* semantics)
 		 **/
 		message = j_message_new(J_MESSAGE_KV_PUT, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -191,13 +300,15 @@ j_kv_put_exec (JList* operations, JSemantics* semantics)
 		}
 		else
 		{
+			JMessageKVPut put_operation;
 			gsize key_len;
 
 			key_len = strlen(kop->put.kv->key) + 1;
+			put_operation.length = kop->put.value_len;
 
-			j_message_add_operation(message, key_len + 4 + kop->put.value_len);
-			j_message_append_n(message, kop->put.kv->key, key_len);
-			j_message_append_4(message, &(kop->put.value_len));
+			j_message_add_operation(message, key_len + J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_KV_PUT) + kop->put.value_len);
+			j_message_append_string(message, kop->put.kv->key);
+			j_message_append_kv_put(message, &put_operation);
 			j_message_append_n(message, kop->put.value, kop->put.value_len);
 		}
 	}
@@ -205,33 +316,24 @@ j_kv_put_exec (JList* operations, JSemantics* semantics)
 	if (kv_backend != NULL)
 	{
 		ret = j_backend_kv_batch_execute(kv_backend, kv_batch) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		gpointer kv_connection;
-
-		kv_connection = j_connection_pool_pop(J_BACKEND_TYPE_KV, index);
-		j_message_send(message, kv_connection);
-
-		if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
-		{
-			g_autoptr(JMessage) reply = NULL;
-
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, kv_connection);
-
-			/* FIXME do something with reply */
-		}
-
-		j_connection_pool_push(J_BACKEND_TYPE_KV, index, kv_connection);
+		j_kv_request_send(index, message, semantics, done_func, done_data);
 	}
-
-	return ret;
 }
 
 static
 gboolean
-j_kv_delete_exec (JList* operations, JSemantics* semantics)
+j_kv_put_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_kv_put_exec_async, operations, semantics);
+}
+
+static
+void
+j_kv_delete_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -240,14 +342,13 @@ j_kv_delete_exec (JList* operations, JSemantics* semantics)
 	JBackend* kv_backend;
 	g_autoptr(JListIterator) it = NULL;
 	g_autoptr(JMessage) message = NULL;
-	JSemanticsSafety safety;
 	gchar const* namespace;
 	gpointer kv_batch = NULL;
 	gsize namespace_len;
 	guint32 index;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JKV* object;
@@ -260,7 +361,6 @@ j_kv_delete_exec (JList* operations, JSemantics* semantics)
 		index = object->index;
 	}
 
-	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
 	it = j_list_iterator_new(operations);
 	kv_backend = j_backend(J_BACKEND_TYPE_KV);
 
@@ -272,7 +372,7 @@ j_kv_delete_exec (JList* operations, JSemantics* semantics)
 	{
 		message = j_message_new(J_MESSAGE_KV_DELETE, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -290,35 +390,26 @@ j_kv_delete_exec (JList* operations, JSemantics* semantics)
 			key_len = strlen(kv->key) + 1;
 
 			j_message_add_operation(message, key_len);
-			j_message_append_n(message, kv->key, key_len);
+			j_message_append_string(message, kv->key);
 		}
 	}
 
 	if (kv_backend != NULL)
 	{
 		ret = j_backend_kv_batch_execute(kv_backend, kv_batch) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		gpointer kv_connection;
-
-		kv_connection = j_connection_pool_pop(J_BACKEND_TYPE_KV, index);
-		j_message_send(message, kv_connection);
-
-		if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
-		{
-			g_autoptr(JMessage) reply = NULL;
-
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, kv_connection);
-
-			/* FIXME do something with reply */
-		}
-
-		j_connection_pool_push(J_BACKEND_TYPE_KV, index, kv_connection);
+		j_kv_request_send(index, message, semantics, done_func, done_data);
 	}
+}
 
-	return ret;
+static
+gboolean
+j_kv_delete_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_kv_delete_exec_async, operations, semantics);
 }
 
 static
@@ -370,7 +461,7 @@ j_kv_get_exec (JList* operations, JSemantics* semantics)
 		 **/
 		message = j_message_new(J_MESSAGE_KV_GET, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -404,7 +495,7 @@ j_kv_get_exec (JList* operations, JSemantics* semantics)
 			key_len = strlen(kop->get.kv->key) + 1;
 
 			j_message_add_operation(message, key_len);
-			j_message_append_n(message, kop->get.kv->key, key_len);
+			j_message_append_string(message, kop->get.kv->key);
 		}
 	}
 
@@ -429,9 +520,16 @@ j_kv_get_exec (JList* operations, JSemantics* semantics)
 		while (j_list_iterator_next(iter))
 		{
 			JKVOperation* kop = j_list_iterator_get(iter);
+			JMessageKVGetReply reply_operation;
 			guint32 len;
 
-			len = j_message_get_4(reply);
+			/* Truncated replies are treated like missing values. */
+			if (!j_message_next_kv_get_reply(reply, &reply_operation) || !j_message_can_get(reply, reply_operation.length))
+			{
+				reply_operation.length = 0;
+			}
+
+			len = reply_operation.length;
 			ret = (len > 0) && ret;
 
 			if (len > 0)
@@ -491,6 +589,8 @@ j_kv_new (gchar const* namespace, gchar const* key)
 	kv->index = j_helper_hash(key) % j_configuration_get_server_count(configuration, J_BACKEND_TYPE_KV);
 	kv->namespace = g_strdup(namespace);
 	kv->key = g_strdup(key);
+	kv->operation_key = j_helper_get_namespace_key(namespace, kv->index);
+	kv->resource = g_strconcat(namespace, "/", key, NULL);
 	kv->ref_count = 1;
 
 	return kv;
@@ -526,6 +626,8 @@ j_kv_new_for_index (guint32 index, gchar const* namespace, gchar const* key)
 	kv->index = index;
 	kv->namespace = g_strdup(namespace);
 	kv->key = g_strdup(key);
+	kv->operation_key = j_helper_get_namespace_key(namespace, kv->index);
+	kv->resource = g_strconcat(namespace, "/", key, NULL);
 	kv->ref_count = 1;
 
 	return kv;
@@ -574,6 +676,7 @@ j_kv_unref (JKV* kv)
 
 	if (g_atomic_int_dec_and_test(&(kv->ref_count)))
 	{
+		g_free(kv->resource);
 		g_free(kv->key);
 		g_free(kv->namespace);
 
@@ -581,6 +684,29 @@ j_kv_unref (JKV* kv)
 	}
 }
 
+/**
+ * Sets the resource accessed by a key-value pair's operations, see JOperation.
+ * Allows layers built on top of key-value pairs to keep dependent operations in order, even if they use different namespaces.
+ * Has to be called before the key-value pair is used in a batch.
+ *
+ * \code
+ * \endcode
+ *
+ * \param kv       A key-value pair.
+ * \param resource A resource.
+ **/
+void
+j_kv_set_resource (JKV* kv, gchar const* resource)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(kv != NULL);
+	g_return_if_fail(resource != NULL);
+
+	g_free(kv->resource);
+	kv->resource = g_strdup(resource);
+}
+
 /**
  * Creates a key-value pair.
  *
@@ -608,10 +734,11 @@ j_kv_put (JKV* kv, gpointer value, guint32 value_len, GDestroyNotify value_destr
 	kop->put.value_destroy = value_destroy;
 
 	operation = j_operation_new();
-	// FIXME key = index + namespace
-	operation->key = kv;
+	operation->key = kv->operation_key;
+	operation->resource = kv->resource;
 	operation->data = kop;
 	operation->exec_func = j_kv_put_exec;
+	operation->exec_async_func = j_kv_put_exec_async;
 	operation->free_func = j_kv_put_free;
 
 	j_batch_add(batch, operation);
@@ -636,9 +763,11 @@ j_kv_delete (JKV* kv, JBatch* batch)
 	g_return_if_fail(kv != NULL);
 
 	operation = j_operation_new();
-	operation->key = kv;
+	operation->key = kv->operation_key;
+	operation->resource = kv->resource;
 	operation->data = j_kv_ref(kv);
 	operation->exec_func = j_kv_delete_exec;
+	operation->exec_async_func = j_kv_delete_exec_async;
 	operation->free_func = j_kv_delete_free;
 
 	j_batch_add(batch, operation);
@@ -671,7 +800,8 @@ j_kv_get (JKV* kv, gpointer* value, guint32* value_len, JBatch* batch)
 	kop->get.data = NULL;
 
 	operation = j_operation_new();
-	operation->key = kv;
+	operation->key = kv->operation_key;
+	operation->resource = kv->resource;
 	operation->data = kop;
 	operation->exec_func = j_kv_get_exec;
 	operation->free_func = j_kv_get_free;
@@ -707,7 +837,8 @@ j_kv_get_callback (JKV* kv, JKVGetFunc func, gpointer data, JBatch* batch)
 	kop->get.data = data;
 
 	operation = j_operation_new();
-	operation->key = kv;
+	operation->key = kv->operation_key;
+	operation->resource = kv->resource;
 	operation->data = kop;
 	operation->exec_func = j_kv_get_exec;
 	operation->free_func = j_kv_get_free;
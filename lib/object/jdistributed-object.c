@@ -29,6 +29,7 @@
 #include <bson.h>
 
 #include <object/jdistributed-object.h>
+#include <object/jdistributed-object-internal.h>
 
 #include <julea.h>
 
@@ -41,14 +42,42 @@
  **/
 
 /**
- * Data for background operations.
+ * The requests a group of operations sends to the servers.
+ * The group is done once all requests are done.
  */
-struct JDistributedObjectBackgroundData
+struct JDistributedObjectRequests
 {
+	JOperationDoneFunc done_func;
+	gpointer done_data;
+
+	/**
+	 * The number of requests that are not done yet, plus one while requests are being sent.
+	 */
+	gint pending;
+
+	/**
+	 * Whether any request has failed.
+	 */
+	gint failed;
+};
+
+typedef struct JDistributedObjectRequests JDistributedObjectRequests;
+
+/**
+ * A request to a server.
+ */
+struct JDistributedObjectRequest
+{
+	JDistributedObjectRequests* requests;
+
 	guint32 index;
 	JMessage* message;
 	JList* operations;
-	JSemantics* semantics;
+
+	/**
+	 * The connection the request has been sent on.
+	 */
+	gpointer connection;
 
 	/**
 	 * The union for read and write parts.
@@ -65,6 +94,16 @@ struct JDistributedObjectBackgroundData
 			 * Contains #JDistributedObjectReadBuffer elements.
 			 */
 			JList* buffers;
+
+			/**
+			 * The next buffer to fill.
+			 */
+			JListIterator* iterator;
+
+			/**
+			 * The number of operations that have been answered.
+			 */
+			guint32 operations_done;
 		}
 		read;
 
@@ -79,7 +118,7 @@ struct JDistributedObjectBackgroundData
 	};
 };
 
-typedef struct JDistributedObjectBackgroundData JDistributedObjectBackgroundData;
+typedef struct JDistributedObjectRequest JDistributedObjectRequest;
 
 struct JDistributedObjectReadBuffer
 {
@@ -142,6 +181,18 @@ struct JDistributedObject
 
 	JDistribution* distribution;
 
+	/**
+	 * The key of namespace-wide operations, see j_helper_get_namespace_key().
+	 * These operations are sent to all servers, so the key does not depend on a server.
+	 **/
+	gconstpointer operation_key;
+
+	/**
+	 * The resource accessed by the object's operations, the namespace followed by the name by default.
+	 * See j_distributed_object_set_resource().
+	 **/
+	gchar* resource;
+
 	/**
 	 * The reference count.
 	 **/
@@ -200,285 +251,313 @@ j_distributed_object_write_free (gpointer data)
 }
 
 /**
- * Executes create operations in a background operation.
+ * Creates the requests of a group of operations.
  *
  * \private
  *
- * \param data Background data.
+ * \param done_func A function to call once all requests are done.
+ * \param done_data Data to pass to #done_func.
  *
- * \return #data.
+ * \return The requests.
  **/
 static
-gpointer
-j_distributed_object_create_background_operation (gpointer data)
+JDistributedObjectRequests*
+j_distributed_object_requests_new (JOperationDoneFunc done_func, gpointer done_data)
 {
-	JDistributedObjectBackgroundData* background_data = data;
-
-	JSemanticsSafety safety;
+	JDistributedObjectRequests* requests;
 
-	gpointer object_connection;
+	requests = g_slice_new(JDistributedObjectRequests);
+	requests->done_func = done_func;
+	requests->done_data = done_data;
+	requests->pending = 1;
+	requests->failed = FALSE;
 
-	safety = j_semantics_get(background_data->semantics, J_SEMANTICS_SAFETY);
-	object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, background_data->index);
-
-	j_message_send(background_data->message, object_connection);
+	return requests;
+}
 
-	if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
+/**
+ * Marks one of a group's requests as done.
+ * The last one finishes the group.
+ *
+ * \private
+ *
+ * \param requests The requests.
+ * \param success  Whether the request has succeeded.
+ **/
+static
+void
+j_distributed_object_requests_done (JDistributedObjectRequests* requests, gboolean success)
+{
+	if (!success)
 	{
-		g_autoptr(JMessage) reply = NULL;
-
-		reply = j_message_new_reply(background_data->message);
-		j_message_receive(reply, object_connection);
+		g_atomic_int_set(&(requests->failed), TRUE);
+	}
 
-		/* FIXME do something with reply */
+	if (g_atomic_int_dec_and_test(&(requests->pending)))
+	{
+		requests->done_func(!g_atomic_int_get(&(requests->failed)), requests->done_data);
+		g_slice_free(JDistributedObjectRequests, requests);
 	}
+}
 
-	j_message_unref(background_data->message);
-	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, background_data->index, object_connection);
+static
+JDistributedObjectRequest*
+j_distributed_object_request_new (JDistributedObjectRequests* requests, guint32 index, JMessage* message)
+{
+	JDistributedObjectRequest* request;
 
-	g_slice_free(JDistributedObjectBackgroundData, background_data);
+	request = g_slice_new(JDistributedObjectRequest);
+	request->requests = requests;
+	request->index = index;
+	request->message = message;
+	request->operations = NULL;
+	request->connection = NULL;
 
-	return NULL;
+	return request;
 }
 
 /**
- * Executes create operations in a background operation.
+ * Finishes a request once the server's replies have been handled.
  *
  * \private
  *
- * \param data Background data.
- *
- * \return #data.
+ * \param success Whether the request has succeeded.
+ * \param data    A request.
  **/
 static
-gpointer
-j_distributed_object_delete_background_operation (gpointer data)
+void
+j_distributed_object_request_done (gboolean success, gpointer data)
 {
-	JDistributedObjectBackgroundData* background_data = data;
+	JDistributedObjectRequest* request = data;
 
-	JSemanticsSafety safety;
+	JDistributedObjectRequests* requests = request->requests;
+	JMessageType type;
 
-	gpointer object_connection;
+	type = j_message_get_type(request->message);
 
-	safety = j_semantics_get(background_data->semantics, J_SEMANTICS_SAFETY);
-	object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, background_data->index);
-
-	j_message_send(background_data->message, object_connection);
-
-	if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
+	if (type == J_MESSAGE_OBJECT_READ)
 	{
-		g_autoptr(JMessage) reply = NULL;
-
-		reply = j_message_new_reply(background_data->message);
-		j_message_receive(reply, object_connection);
+		/* Operations left unanswered by a truncated reply still own their buffers. */
+		while (j_list_iterator_next(request->read.iterator))
+		{
+			g_slice_free(JDistributedObjectReadBuffer, j_list_iterator_get(request->read.iterator));
+		}
 
-		/* FIXME do something with reply */
+		j_list_iterator_unref(request->read.iterator);
+		j_list_unref(request->read.buffers);
+	}
+	else if (type == J_MESSAGE_OBJECT_WRITE)
+	{
+		j_list_unref(request->write.bytes_written);
 	}
 
-	j_message_unref(background_data->message);
-	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, background_data->index, object_connection);
+	j_message_unref(request->message);
+	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, request->index, request->connection);
 
-	g_slice_free(JDistributedObjectBackgroundData, background_data);
+	g_slice_free(JDistributedObjectRequest, request);
 
-	return NULL;
+	j_distributed_object_requests_done(requests, success);
 }
 
 /**
- * Executes write operations in a background operation.
+ * Sends a request to a server without waiting for it.
  *
  * \private
  *
- * \param data Background data.
- *
- * \return #data.
+ * \param request    A request.
+ * \param semantics  The semantics.
+ * \param reply_func A function to handle the replies.
  **/
 static
-gpointer
-j_distributed_object_read_background_operation (gpointer data)
+void
+j_distributed_object_request_send (JDistributedObjectRequest* request, JSemantics* semantics, JMessageReplyFunc reply_func)
 {
-	JDistributedObjectBackgroundData* background_data = data;
+	JMessageType type;
+	JSemanticsSafety safety;
 
-	g_autoptr(JListIterator) it = NULL;
-	g_autoptr(JMessage) reply = NULL;
-	gpointer object_connection;
-	guint32 operations_done;
-	guint32 operation_count;
+	type = j_message_get_type(request->message);
+	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
 
-	object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, background_data->index);
-	j_message_send(background_data->message, object_connection);
+	/* Reads and status requests are always answered. */
+	if (type != J_MESSAGE_OBJECT_READ && type != J_MESSAGE_OBJECT_STATUS && safety != J_SEMANTICS_SAFETY_NETWORK && safety != J_SEMANTICS_SAFETY_STORAGE)
+	{
+		reply_func = NULL;
+	}
 
-	reply = j_message_new_reply(background_data->message);
+	g_atomic_int_inc(&(request->requests->pending));
 
-	operations_done = 0;
-	operation_count = j_message_get_count(background_data->message);
+	request->connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, request->index);
+	j_message_send_async(request->message, request->connection, reply_func, j_distributed_object_request_done, request);
+}
 
-	it = j_list_iterator_new(background_data->read.buffers);
+/**
+ * Handles the reply to a create or delete request.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE.
+ **/
+static
+gboolean
+j_distributed_object_acknowledge_reply (JMessage* reply, gpointer data)
+{
+	(void)reply;
+	(void)data;
 
-	/**
-	 * This extra loop is necessary because the server might send multiple
-	 * replies per message. The same reply object can be used to receive
-	 * multiple times.
-	 */
-	while (operations_done < operation_count)
-	{
-		guint32 reply_operation_count;
+	/* FIXME do something with reply */
 
-		j_message_receive(reply, object_connection);
+	return TRUE;
+}
 
-		reply_operation_count = j_message_get_count(reply);
+/**
+ * Handles a reply to a read request.
+ * The server might send multiple replies per message, the data following each one is received directly into the buffers.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE if all replies have been handled, FALSE otherwise.
+ **/
+static
+gboolean
+j_distributed_object_read_reply (JMessage* reply, gpointer data)
+{
+	JDistributedObjectRequest* request = data;
 
-		for (guint i = 0; i < reply_operation_count && j_list_iterator_next(it); i++)
-		{
-			JDistributedObjectReadBuffer* buffer = j_list_iterator_get(it);
-			gchar* read_data = buffer->data;
-			guint64* bytes_read = buffer->bytes_read;
+	g_autofree JMessageObjectReadReply* reply_operations = NULL;
+	guint32 reply_operation_count;
 
-			guint64 nbytes;
+	reply_operation_count = j_message_get_count(reply);
 
-			nbytes = j_message_get_8(reply);
-			j_helper_atomic_add(bytes_read, nbytes);
+	if (!j_message_get_object_read_reply(reply, reply_operation_count, &reply_operations))
+	{
+		g_atomic_int_set(&(request->requests->failed), TRUE);
+		return TRUE;
+	}
 
-			if (nbytes > 0)
-			{
-				GInputStream* input;
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(request->read.iterator); i++)
+	{
+		JDistributedObjectReadBuffer* buffer = j_list_iterator_get(request->read.iterator);
+		gchar* read_data = buffer->data;
+		guint64* bytes_read = buffer->bytes_read;
 
-				input = g_io_stream_get_input_stream(G_IO_STREAM(object_connection));
-				g_input_stream_read_all(input, read_data, nbytes, NULL, NULL, NULL);
-			}
+		guint64 nbytes;
+
+		nbytes = reply_operations[i].bytes_read;
+		j_helper_atomic_add(bytes_read, nbytes);
 
-			g_slice_free(JDistributedObjectReadBuffer, buffer);
+		if (nbytes > 0)
+		{
+			j_message_add_receive(reply, read_data, nbytes);
 		}
 
-		operations_done += reply_operation_count;
+		g_slice_free(JDistributedObjectReadBuffer, buffer);
 	}
 
-	j_message_unref(background_data->message);
-
-	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, background_data->index, object_connection);
+	request->read.operations_done += reply_operation_count;
 
-	j_list_unref(background_data->read.buffers);
-
-	g_slice_free(JDistributedObjectBackgroundData, background_data);
-
-	return NULL;
+	return (request->read.operations_done >= j_message_get_count(request->message));
 }
 
 /**
- * Executes write operations in a background operation.
+ * Handles the reply to a write request.
  *
  * \private
  *
- * \param data Background data.
+ * \param reply A reply.
+ * \param data  A request.
  *
- * \return #data.
+ * \return TRUE.
  **/
 static
-gpointer
-j_distributed_object_write_background_operation (gpointer data)
+gboolean
+j_distributed_object_write_reply (JMessage* reply, gpointer data)
 {
-	JDistributedObjectBackgroundData* background_data = data;
+	JDistributedObjectRequest* request = data;
 
-	JSemanticsSafety safety;
-
-	gpointer object_connection;
+	g_autoptr(JListIterator) it = NULL;
+	g_autofree JMessageObjectWriteReply* reply_operations = NULL;
+	guint32 reply_operation_count;
 
-	safety = j_semantics_get(background_data->semantics, J_SEMANTICS_SAFETY);
-	object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, background_data->index);
-	j_message_send(background_data->message, object_connection);
+	reply_operation_count = j_message_get_count(reply);
 
-	if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
+	if (!j_message_get_object_write_reply(reply, reply_operation_count, &reply_operations))
 	{
-		g_autoptr(JListIterator) it = NULL;
-		g_autoptr(JMessage) reply = NULL;
-		guint64 nbytes;
-
-		reply = j_message_new_reply(background_data->message);
-		j_message_receive(reply, object_connection);
-
-		it = j_list_iterator_new(background_data->write.bytes_written);
-
-		while (j_list_iterator_next(it))
-		{
-			guint64* bytes_written = j_list_iterator_get(it);
-
-			nbytes = j_message_get_8(reply);
-			j_helper_atomic_add(bytes_written, nbytes);
-		}
+		g_atomic_int_set(&(request->requests->failed), TRUE);
+		return TRUE;
 	}
 
-	j_message_unref(background_data->message);
+	it = j_list_iterator_new(request->write.bytes_written);
 
-	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, background_data->index, object_connection);
-
-	j_list_unref(background_data->write.bytes_written);
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(it); i++)
+	{
+		guint64* bytes_written = j_list_iterator_get(it);
 
-	g_slice_free(JDistributedObjectBackgroundData, background_data);
+		j_helper_atomic_add(bytes_written, reply_operations[i].bytes_written);
+	}
 
-	return NULL;
+	return TRUE;
 }
 
 /**
- * Executes status operations in a background operation.
+ * Handles the reply to a status request.
  *
  * \private
  *
- * \param data Background data.
+ * \param reply A reply.
+ * \param data  A request.
  *
- * \return #data.
+ * \return TRUE.
  **/
 static
-gpointer
-j_distributed_object_status_background_operation (gpointer data)
+gboolean
+j_distributed_object_status_reply (JMessage* reply, gpointer data)
 {
-	JDistributedObjectBackgroundData* background_data = data;
+	JDistributedObjectRequest* request = data;
 
 	g_autoptr(JListIterator) it = NULL;
-	g_autoptr(JMessage) reply = NULL;
-	gpointer object_connection;
+	g_autofree JMessageObjectStatusReply* reply_operations = NULL;
+	guint32 reply_operation_count;
 
-	object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, background_data->index);
-	j_message_send(background_data->message, object_connection);
+	reply_operation_count = j_message_get_count(reply);
 
-	reply = j_message_new_reply(background_data->message);
-	j_message_receive(reply, object_connection);
+	if (!j_message_get_object_status_reply(reply, reply_operation_count, &reply_operations))
+	{
+		g_atomic_int_set(&(request->requests->failed), TRUE);
+		return TRUE;
+	}
 
-	it = j_list_iterator_new(background_data->operations);
+	it = j_list_iterator_new(request->operations);
 
-	while (j_list_iterator_next(it))
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(it); i++)
 	{
 		JDistributedObjectOperation* operation = j_list_iterator_get(it);
 		gint64* modification_time = operation->status.modification_time;
 		guint64* size = operation->status.size;
-		gint64 modification_time_;
-		guint64 size_;
-
-		modification_time_ = j_message_get_8(reply);
-		size_ = j_message_get_8(reply);
 
 		if (modification_time != NULL)
 		{
 			// FIXME max?
-			*modification_time = modification_time_;
+			*modification_time = reply_operations[i].modification_time;
 		}
 
 		if (size != NULL)
 		{
-			j_helper_atomic_add(size, size_);
+			j_helper_atomic_add(size, reply_operations[i].size);
 		}
 	}
 
-	j_message_unref(background_data->message);
-
-	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, background_data->index, object_connection);
-
-	g_slice_free(JDistributedObjectBackgroundData, background_data);
-
-	return NULL;
+	return TRUE;
 }
 
 static
-gboolean
-j_distributed_object_create_exec (JList* operations, JSemantics* semantics)
+void
+j_distributed_object_create_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -486,14 +565,15 @@ j_distributed_object_create_exec (JList* operations, JSemantics* semantics)
 	gboolean ret = TRUE;
 
 	JBackend* object_backend;
+	JDistributedObjectRequests* requests;
 	g_autoptr(JListIterator) it = NULL;
 	g_autofree JMessage** messages = NULL;
 	gchar const* namespace = NULL;
 	gsize namespace_len = 0;
 	guint32 server_count = 0;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JDistributedObject* object;
@@ -526,7 +606,7 @@ j_distributed_object_create_exec (JList* operations, JSemantics* semantics)
 			 **/
 			messages[i] = j_message_new(J_MESSAGE_OBJECT_CREATE, namespace_len);
 			j_message_set_semantics(messages[i], semantics);
-			j_message_append_n(messages[i], namespace, namespace_len);
+			j_message_append_namespace(messages[i], namespace);
 		}
 	}
 
@@ -551,40 +631,38 @@ j_distributed_object_create_exec (JList* operations, JSemantics* semantics)
 			for (guint i = 0; i < server_count; i++)
 			{
 				j_message_add_operation(messages[i], name_len);
-				j_message_append_n(messages[i], object->name, name_len);
+				j_message_append_string(messages[i], object->name);
 			}
 		}
 	}
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		g_autofree gpointer* background_data = NULL;
-
-		background_data = g_new(gpointer, server_count);
-
-		// FIXME use actual distribution
-		for (guint i = 0; i < server_count; i++)
-		{
-			JDistributedObjectBackgroundData* data;
-
-			data = g_slice_new(JDistributedObjectBackgroundData);
-			data->index = i;
-			data->message = messages[i];
-			data->operations = NULL;
-			data->semantics = semantics;
+		done_func(ret, done_data);
+		return;
+	}
 
-			background_data[i] = data;
-		}
+	requests = j_distributed_object_requests_new(done_func, done_data);
 
-		j_helper_execute_parallel(j_distributed_object_create_background_operation, background_data, server_count);
+	// FIXME use actual distribution
+	for (guint i = 0; i < server_count; i++)
+	{
+		j_distributed_object_request_send(j_distributed_object_request_new(requests, i, messages[i]), semantics, j_distributed_object_acknowledge_reply);
 	}
 
-	return ret;
+	j_distributed_object_requests_done(requests, ret);
 }
 
 static
 gboolean
-j_distributed_object_delete_exec (JList* operations, JSemantics* semantics)
+j_distributed_object_create_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_distributed_object_create_exec_async, operations, semantics);
+}
+
+static
+void
+j_distributed_object_delete_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -592,14 +670,15 @@ j_distributed_object_delete_exec (JList* operations, JSemantics* semantics)
 	gboolean ret = TRUE;
 
 	JBackend* object_backend;
+	JDistributedObjectRequests* requests;
 	g_autoptr(JListIterator) it = NULL;
 	g_autofree JMessage** messages = NULL;
 	gchar const* namespace = NULL;
 	gsize namespace_len = 0;
 	guint32 server_count = 0;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JDistributedObject* object;
@@ -624,7 +703,7 @@ j_distributed_object_delete_exec (JList* operations, JSemantics* semantics)
 		{
 			messages[i] = j_message_new(J_MESSAGE_OBJECT_DELETE, namespace_len);
 			j_message_set_semantics(messages[i], semantics);
-			j_message_append_n(messages[i], namespace, namespace_len);
+			j_message_append_namespace(messages[i], namespace);
 		}
 	}
 
@@ -649,40 +728,38 @@ j_distributed_object_delete_exec (JList* operations, JSemantics* semantics)
 			for (guint i = 0; i < server_count; i++)
 			{
 				j_message_add_operation(messages[i], name_len);
-				j_message_append_n(messages[i], object->name, name_len);
+				j_message_append_string(messages[i], object->name);
 			}
 		}
 	}
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		g_autofree gpointer* background_data = NULL;
-
-		background_data = g_new(gpointer, server_count);
-
-		// FIXME use actual distribution
-		for (guint i = 0; i < server_count; i++)
-		{
-			JDistributedObjectBackgroundData* data;
-
-			data = g_slice_new(JDistributedObjectBackgroundData);
-			data->index = i;
-			data->message = messages[i];
-			data->operations = NULL;
-			data->semantics = semantics;
+		done_func(ret, done_data);
+		return;
+	}
 
-			background_data[i] = data;
-		}
+	requests = j_distributed_object_requests_new(done_func, done_data);
 
-		j_helper_execute_parallel(j_distributed_object_delete_background_operation, background_data, server_count);
+	// FIXME use actual distribution
+	for (guint i = 0; i < server_count; i++)
+	{
+		j_distributed_object_request_send(j_distributed_object_request_new(requests, i, messages[i]), semantics, j_distributed_object_acknowledge_reply);
 	}
 
-	return ret;
+	j_distributed_object_requests_done(requests, ret);
 }
 
 static
 gboolean
-j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
+j_distributed_object_delete_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_distributed_object_delete_exec_async, operations, semantics);
+}
+
+static
+void
+j_distributed_object_read_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -702,8 +779,8 @@ j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
 	// FIXME
 	//JLock* lock = NULL;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JDistributedObjectOperation* operation = j_list_get_first(operations);
@@ -762,6 +839,7 @@ j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
 		}
 		else
 		{
+			JMessageObjectRead message_operation;
 			gchar* new_data;
 			guint32 index;
 			guint64 block_id;
@@ -779,15 +857,17 @@ j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
 				{
 					messages[index] = j_message_new(J_MESSAGE_OBJECT_READ, namespace_len + name_len);
 					j_message_set_semantics(messages[index], semantics);
-					j_message_append_n(messages[index], object->namespace, namespace_len);
-					j_message_append_n(messages[index], object->name, name_len);
+					j_message_append_namespace(messages[index], object->namespace);
+					j_message_append_string(messages[index], object->name);
 
 					br_lists[index] = j_list_new(NULL);
 				}
 
-				j_message_add_operation(messages[index], sizeof(guint64) + sizeof(guint64));
-				j_message_append_8(messages[index], &new_length);
-				j_message_append_8(messages[index], &new_offset);
+				message_operation.length = new_length;
+				message_operation.offset = new_offset;
+
+				j_message_add_operation(messages[index], J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ));
+				j_message_append_object_read(messages[index], &message_operation);
 
 				buffer = g_slice_new(JDistributedObjectReadBuffer);
 				buffer->data = new_data;
@@ -812,34 +892,32 @@ j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
 	if (object_backend != NULL)
 	{
 		ret = j_backend_object_close(object_backend, object_handle) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		g_autofree gpointer* background_data = NULL;
+		JDistributedObjectRequests* requests;
 
-		background_data = g_new(gpointer, server_count);
+		requests = j_distributed_object_requests_new(done_func, done_data);
 
 		for (guint i = 0; i < server_count; i++)
 		{
-			JDistributedObjectBackgroundData* data;
+			JDistributedObjectRequest* request;
 
 			if (messages[i] == NULL)
 			{
-				background_data[i] = NULL;
 				continue;
 			}
 
-			data = g_slice_new(JDistributedObjectBackgroundData);
-			data->index = i;
-			data->message = messages[i];
-			data->operations = NULL;
-			data->semantics = semantics;
-			data->read.buffers = br_lists[i];
+			request = j_distributed_object_request_new(requests, i, messages[i]);
+			request->read.buffers = br_lists[i];
+			request->read.iterator = j_list_iterator_new(br_lists[i]);
+			request->read.operations_done = 0;
 
-			background_data[i] = data;
+			j_distributed_object_request_send(request, semantics, j_distributed_object_read_reply);
 		}
 
-		j_helper_execute_parallel(j_distributed_object_read_background_operation, background_data, server_count);
+		j_distributed_object_requests_done(requests, ret);
 	}
 
 	/*
@@ -851,13 +929,18 @@ j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
 		j_lock_free(lock);
 	}
 	*/
-
-	return ret;
 }
 
 static
 gboolean
-j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
+j_distributed_object_read_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_distributed_object_read_exec_async, operations, semantics);
+}
+
+static
+void
+j_distributed_object_write_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -877,8 +960,8 @@ j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
 	// FIXME
 	//JLock* lock = NULL;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JDistributedObjectOperation* operation = j_list_get_first(operations);
@@ -937,6 +1020,7 @@ j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
 		}
 		else
 		{
+			JMessageObjectWrite message_operation;
 			gchar const* new_data;
 			guint32 index;
 			guint64 block_id;
@@ -952,15 +1036,17 @@ j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
 				{
 					messages[index] = j_message_new(J_MESSAGE_OBJECT_WRITE, namespace_len + name_len);
 					j_message_set_semantics(messages[index], semantics);
-					j_message_append_n(messages[index], object->namespace, namespace_len);
-					j_message_append_n(messages[index], object->name, name_len);
+					j_message_append_namespace(messages[index], object->namespace);
+					j_message_append_string(messages[index], object->name);
 
 					bw_lists[index] = j_list_new(NULL);
 				}
 
-				j_message_add_operation(messages[index], sizeof(guint64) + sizeof(guint64));
-				j_message_append_8(messages[index], &new_length);
-				j_message_append_8(messages[index], &new_offset);
+				message_operation.length = new_length;
+				message_operation.offset = new_offset;
+
+				j_message_add_operation(messages[index], J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_WRITE));
+				j_message_append_object_write(messages[index], &message_operation);
 				j_message_add_send(messages[index], new_data, new_length);
 
 				j_list_append(bw_lists[index], bytes_written);
@@ -988,34 +1074,31 @@ j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
 	if (object_backend != NULL)
 	{
 		ret = j_backend_object_close(object_backend, object_handle) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		g_autofree gpointer* background_data = NULL;
+		JDistributedObjectRequests* requests;
 
-		background_data = g_new(gpointer, server_count);
+		requests = j_distributed_object_requests_new(done_func, done_data);
 
+		/* The engine writes to all servers at once, so the transfers overlap without involving other threads. */
 		for (guint i = 0; i < server_count; i++)
 		{
-			JDistributedObjectBackgroundData* data;
+			JDistributedObjectRequest* request;
 
 			if (messages[i] == NULL)
 			{
-				background_data[i] = NULL;
 				continue;
 			}
 
-			data = g_slice_new(JDistributedObjectBackgroundData);
-			data->index = i;
-			data->message = messages[i];
-			data->operations = NULL;
-			data->semantics = semantics;
-			data->write.bytes_written = bw_lists[i];
+			request = j_distributed_object_request_new(requests, i, messages[i]);
+			request->write.bytes_written = bw_lists[i];
 
-			background_data[i] = data;
+			j_distributed_object_request_send(request, semantics, j_distributed_object_write_reply);
 		}
 
-		j_helper_execute_parallel(j_distributed_object_write_background_operation, background_data, server_count);
+		j_distributed_object_requests_done(requests, ret);
 	}
 
 	/*
@@ -1027,13 +1110,18 @@ j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
 		j_lock_free(lock);
 	}
 	*/
-
-	return ret;
 }
 
 static
 gboolean
-j_distributed_object_status_exec (JList* operations, JSemantics* semantics)
+j_distributed_object_write_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_distributed_object_write_exec_async, operations, semantics);
+}
+
+static
+void
+j_distributed_object_status_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -1041,14 +1129,15 @@ j_distributed_object_status_exec (JList* operations, JSemantics* semantics)
 	gboolean ret = TRUE;
 
 	JBackend* object_backend;
+	JDistributedObjectRequests* requests;
 	g_autoptr(JListIterator) it = NULL;
 	g_autofree JMessage** messages = NULL;
 	gchar const* namespace = NULL;
 	gsize namespace_len = 0;
 	guint32 server_count = 0;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JDistributedObjectOperation* operation = j_list_get_first(operations);
@@ -1074,7 +1163,7 @@ j_distributed_object_status_exec (JList* operations, JSemantics* semantics)
 		{
 			messages[i] = j_message_new(J_MESSAGE_OBJECT_STATUS, namespace_len);
 			j_message_set_semantics(messages[i], semantics);
-			j_message_append_n(messages[i], namespace, namespace_len);
+			j_message_append_namespace(messages[i], namespace);
 		}
 	}
 
@@ -1113,35 +1202,38 @@ j_distributed_object_status_exec (JList* operations, JSemantics* semantics)
 			for (guint i = 0; i < server_count; i++)
 			{
 				j_message_add_operation(messages[i], name_len);
-				j_message_append_n(messages[i], object->name, name_len);
+				j_message_append_string(messages[i], object->name);
 			}
 		}
 	}
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		g_autofree gpointer* background_data = NULL;
+		done_func(ret, done_data);
+		return;
+	}
 
-		background_data = g_new(gpointer, server_count);
+	requests = j_distributed_object_requests_new(done_func, done_data);
 
-		// FIXME use actual distribution
-		for (guint i = 0; i < server_count; i++)
-		{
-			JDistributedObjectBackgroundData* data;
-
-			data = g_slice_new(JDistributedObjectBackgroundData);
-			data->index = i;
-			data->message = messages[i];
-			data->operations = operations;
-			data->semantics = semantics;
+	// FIXME use actual distribution
+	for (guint i = 0; i < server_count; i++)
+	{
+		JDistributedObjectRequest* request;
 
-			background_data[i] = data;
-		}
+		request = j_distributed_object_request_new(requests, i, messages[i]);
+		request->operations = operations;
 
-		j_helper_execute_parallel(j_distributed_object_status_background_operation, background_data, server_count);
+		j_distributed_object_request_send(request, semantics, j_distributed_object_status_reply);
 	}
 
-	return ret;
+	j_distributed_object_requests_done(requests, ret);
+}
+
+static
+gboolean
+j_distributed_object_status_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_distributed_object_status_exec_async, operations, semantics);
 }
 
 /**
@@ -1175,6 +1267,8 @@ j_distributed_object_new (gchar const* namespace, gchar const* name, JDistributi
 	object->namespace = g_strdup(namespace);
 	object->name = g_strdup(name);
 	object->distribution = j_distribution_ref(distribution);
+	object->operation_key = j_helper_get_namespace_key(namespace, 0);
+	object->resource = g_strconcat(namespace, "/", name, NULL);
 	object->ref_count = 1;
 
 	return object;
@@ -1223,6 +1317,7 @@ j_distributed_object_unref (JDistributedObject* object)
 
 	if (g_atomic_int_dec_and_test(&(object->ref_count)))
 	{
+		g_free(object->resource);
 		g_free(object->name);
 		g_free(object->namespace);
 
@@ -1232,6 +1327,28 @@ j_distributed_object_unref (JDistributedObject* object)
 	}
 }
 
+/**
+ * Sets the resource accessed by an object's operations, see JOperation.
+ * Has to be called before the object is used in a batch.
+ *
+ * \code
+ * \endcode
+ *
+ * \param object   An object.
+ * \param resource A resource.
+ **/
+void
+j_distributed_object_set_resource (JDistributedObject* object, gchar const* resource)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(resource != NULL);
+
+	g_free(object->resource);
+	object->resource = g_strdup(resource);
+}
+
 /**
  * Creates an object.
  *
@@ -1254,10 +1371,11 @@ j_distributed_object_create (JDistributedObject* object, JBatch* batch)
 	g_return_if_fail(object != NULL);
 
 	operation = j_operation_new();
-	// FIXME key = index + namespace
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = j_distributed_object_ref(object);
 	operation->exec_func = j_distributed_object_create_exec;
+	operation->exec_async_func = j_distributed_object_create_exec_async;
 	operation->free_func = j_distributed_object_create_free;
 
 	j_batch_add(batch, operation);
@@ -1282,9 +1400,11 @@ j_distributed_object_delete (JDistributedObject* object, JBatch* batch)
 	g_return_if_fail(object != NULL);
 
 	operation = j_operation_new();
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = j_distributed_object_ref(object);
 	operation->exec_func = j_distributed_object_delete_exec;
+	operation->exec_async_func = j_distributed_object_delete_exec_async;
 	operation->free_func = j_distributed_object_delete_free;
 
 	j_batch_add(batch, operation);
@@ -1310,41 +1430,29 @@ j_distributed_object_read (JDistributedObject* object, gpointer data, guint64 le
 
 	JDistributedObjectOperation* iop;
 	JOperation* operation;
-	guint64 max_operation_size;
 
 	g_return_if_fail(object != NULL);
 	g_return_if_fail(data != NULL);
 	g_return_if_fail(length > 0);
 	g_return_if_fail(bytes_read != NULL);
 
-	max_operation_size = j_configuration_get_max_operation_size(j_configuration());
-
-	// Chunk operation if necessary
-	while (length > 0)
-	{
-		guint64 chunk_size;
-
-		chunk_size = MIN(length, max_operation_size);
-
-		iop = g_slice_new(JDistributedObjectOperation);
-		iop->read.object = j_distributed_object_ref(object);
-		iop->read.data = data;
-		iop->read.length = chunk_size;
-		iop->read.offset = offset;
-		iop->read.bytes_read = bytes_read;
-
-		operation = j_operation_new();
-		operation->key = object;
-		operation->data = iop;
-		operation->exec_func = j_distributed_object_read_exec;
-		operation->free_func = j_distributed_object_read_free;
+	/* Reads are not chunked, the server streams data exceeding its maximum operation size. */
+	iop = g_slice_new(JDistributedObjectOperation);
+	iop->read.object = j_distributed_object_ref(object);
+	iop->read.data = data;
+	iop->read.length = length;
+	iop->read.offset = offset;
+	iop->read.bytes_read = bytes_read;
 
-		j_batch_add(batch, operation);
+	operation = j_operation_new();
+	operation->key = object;
+	operation->resource = object->resource;
+	operation->data = iop;
+	operation->exec_func = j_distributed_object_read_exec;
+	operation->exec_async_func = j_distributed_object_read_exec_async;
+	operation->free_func = j_distributed_object_read_free;
 
-		data = (gchar*)data + chunk_size;
-		length -= chunk_size;
-		offset += chunk_size;
-	}
+	j_batch_add(batch, operation);
 
 	*bytes_read = 0;
 }
@@ -1397,8 +1505,10 @@ j_distributed_object_write (JDistributedObject* object, gconstpointer data, guin
 
 		operation = j_operation_new();
 		operation->key = object;
+		operation->resource = object->resource;
 		operation->data = iop;
 		operation->exec_func = j_distributed_object_write_exec;
+		operation->exec_async_func = j_distributed_object_write_exec_async;
 		operation->free_func = j_distributed_object_write_free;
 
 		j_batch_add(batch, operation);
@@ -1436,9 +1546,11 @@ j_distributed_object_status (JDistributedObject* object, gint64* modification_ti
 	iop->status.size = size;
 
 	operation = j_operation_new();
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = iop;
 	operation->exec_func = j_distributed_object_status_exec;
+	operation->exec_async_func = j_distributed_object_status_exec_async;
 	operation->free_func = j_distributed_object_status_free;
 
 	j_batch_add(batch, operation);
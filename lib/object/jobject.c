@@ -96,6 +96,16 @@ struct JObject
 	 **/
 	gchar* name;
 
+	/**
+	 * The key of namespace-wide operations, see j_helper_get_namespace_key().
+	 **/
+	gconstpointer operation_key;
+
+	/**
+	 * The resource accessed by the object's operations, that is, the namespace followed by the name.
+	 **/
+	gchar* resource;
+
 	/**
 	 * The reference count.
 	 **/
@@ -153,9 +163,273 @@ j_object_write_free (gpointer data)
 	g_slice_free(JObjectOperation, operation);
 }
 
+/**
+ * A request to the object's server.
+ **/
+struct JObjectRequest
+{
+	guint32 index;
+	JMessage* message;
+	JList* operations;
+
+	/**
+	 * The connection the request has been sent on.
+	 **/
+	gpointer connection;
+
+	/**
+	 * The next operation to handle a reply for.
+	 **/
+	JListIterator* iterator;
+
+	/**
+	 * The number of operations that have been answered.
+	 **/
+	guint32 operations_done;
+
+	/**
+	 * Whether the replies could be handled.
+	 **/
+	gboolean ret;
+
+	JOperationDoneFunc done_func;
+	gpointer done_data;
+};
+
+typedef struct JObjectRequest JObjectRequest;
+
+/**
+ * Finishes a request once the server's replies have been handled.
+ *
+ * \private
+ *
+ * \param success Whether the request has succeeded.
+ * \param data    A request.
+ **/
+static
+void
+j_object_request_done (gboolean success, gpointer data)
+{
+	JObjectRequest* request = data;
+
+	JOperationDoneFunc done_func = request->done_func;
+	gpointer done_data = request->done_data;
+
+	success = success && request->ret;
+
+	j_list_iterator_free(request->iterator);
+	j_message_unref(request->message);
+	j_connection_pool_push(J_BACKEND_TYPE_OBJECT, request->index, request->connection);
+
+	g_slice_free(JObjectRequest, request);
+
+	done_func(success, done_data);
+}
+
+/**
+ * Sends a request to the object's server without waiting for it.
+ *
+ * \private
+ *
+ * \param index      The server index.
+ * \param message    A message.
+ * \param operations The operations the message contains.
+ * \param semantics  The semantics.
+ * \param reply_func A function to handle the replies.
+ * \param done_func  A function to call once the request is done.
+ * \param done_data  Data to pass to #done_func.
+ **/
+static
+void
+j_object_request_send (guint32 index, JMessage* message, JList* operations, JSemantics* semantics, JMessageReplyFunc reply_func, JOperationDoneFunc done_func, gpointer done_data)
+{
+	JObjectRequest* request;
+	JMessageType type;
+	JSemanticsSafety safety;
+
+	type = j_message_get_type(message);
+	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
+
+	/* Reads and status requests are always answered. */
+	if (type != J_MESSAGE_OBJECT_READ && type != J_MESSAGE_OBJECT_STATUS && safety != J_SEMANTICS_SAFETY_NETWORK && safety != J_SEMANTICS_SAFETY_STORAGE)
+	{
+		reply_func = NULL;
+	}
+
+	request = g_slice_new(JObjectRequest);
+	request->index = index;
+	request->message = j_message_ref(message);
+	request->operations = operations;
+	request->connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, index);
+	request->iterator = j_list_iterator_new(operations);
+	request->operations_done = 0;
+	request->ret = TRUE;
+	request->done_func = done_func;
+	request->done_data = done_data;
+
+	j_message_send_async(message, request->connection, reply_func, j_object_request_done, request);
+}
+
+/**
+ * Handles the reply to a create or delete request.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE.
+ **/
 static
 gboolean
-j_object_create_exec (JList* operations, JSemantics* semantics)
+j_object_acknowledge_reply (JMessage* reply, gpointer data)
+{
+	(void)reply;
+	(void)data;
+
+	/* FIXME do something with reply */
+
+	return TRUE;
+}
+
+/**
+ * Handles a reply to a read request.
+ * The server might send multiple replies per message, the data of all operations of a reply is received directly into the buffers at once.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE if all replies have been handled, FALSE otherwise.
+ **/
+static
+gboolean
+j_object_read_reply (JMessage* reply, gpointer data)
+{
+	JObjectRequest* request = data;
+
+	g_autofree JMessageObjectReadReply* reply_operations = NULL;
+	guint32 reply_operation_count;
+
+	reply_operation_count = j_message_get_count(reply);
+
+	if (!j_message_get_object_read_reply(reply, reply_operation_count, &reply_operations))
+	{
+		request->ret = FALSE;
+		return TRUE;
+	}
+
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(request->iterator); i++)
+	{
+		JObjectOperation* operation = j_list_iterator_get(request->iterator);
+		gpointer read_data = operation->read.data;
+		guint64* bytes_read = operation->read.bytes_read;
+
+		guint64 nbytes;
+
+		nbytes = reply_operations[i].bytes_read;
+		j_helper_atomic_add(bytes_read, nbytes);
+
+		if (nbytes > 0)
+		{
+			j_message_add_receive(reply, read_data, nbytes);
+		}
+	}
+
+	request->operations_done += reply_operation_count;
+
+	return (request->operations_done >= j_message_get_count(request->message));
+}
+
+/**
+ * Handles the reply to a write request.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE.
+ **/
+static
+gboolean
+j_object_write_reply (JMessage* reply, gpointer data)
+{
+	JObjectRequest* request = data;
+
+	g_autofree JMessageObjectWriteReply* reply_operations = NULL;
+	guint32 reply_operation_count;
+
+	reply_operation_count = j_message_get_count(reply);
+
+	if (!j_message_get_object_write_reply(reply, reply_operation_count, &reply_operations))
+	{
+		request->ret = FALSE;
+		return TRUE;
+	}
+
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(request->iterator); i++)
+	{
+		JObjectOperation* operation = j_list_iterator_get(request->iterator);
+		guint64* bytes_written = operation->write.bytes_written;
+
+		j_helper_atomic_add(bytes_written, reply_operations[i].bytes_written);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Handles the reply to a status request.
+ *
+ * \private
+ *
+ * \param reply A reply.
+ * \param data  A request.
+ *
+ * \return TRUE.
+ **/
+static
+gboolean
+j_object_status_reply (JMessage* reply, gpointer data)
+{
+	JObjectRequest* request = data;
+
+	g_autofree JMessageObjectStatusReply* reply_operations = NULL;
+	guint32 reply_operation_count;
+
+	reply_operation_count = j_message_get_count(reply);
+
+	if (!j_message_get_object_status_reply(reply, reply_operation_count, &reply_operations))
+	{
+		request->ret = FALSE;
+		return TRUE;
+	}
+
+	for (guint i = 0; i < reply_operation_count && j_list_iterator_next(request->iterator); i++)
+	{
+		JObjectOperation* operation = j_list_iterator_get(request->iterator);
+		gint64* modification_time = operation->status.modification_time;
+		guint64* size = operation->status.size;
+
+		if (modification_time != NULL)
+		{
+			*modification_time = reply_operations[i].modification_time;
+		}
+
+		if (size != NULL)
+		{
+			*size = reply_operations[i].size;
+		}
+	}
+
+	return TRUE;
+}
+
+static
+void
+j_object_create_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -169,8 +443,8 @@ j_object_create_exec (JList* operations, JSemantics* semantics)
 	gsize namespace_len;
 	guint32 index;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JObject* object;
@@ -198,7 +472,7 @@ j_object_create_exec (JList* operations, JSemantics* semantics)
 		 **/
 		message = j_message_new(J_MESSAGE_OBJECT_CREATE, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -219,39 +493,29 @@ j_object_create_exec (JList* operations, JSemantics* semantics)
 			name_len = strlen(object->name) + 1;
 
 			j_message_add_operation(message, name_len);
-			j_message_append_n(message, object->name, name_len);
+			j_message_append_string(message, object->name);
 		}
 	}
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		JSemanticsSafety safety;
-
-		gpointer object_connection;
-
-		safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
-		object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, index);
-		j_message_send(message, object_connection);
-
-		if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
-		{
-			g_autoptr(JMessage) reply = NULL;
-
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, object_connection);
-
-			/* FIXME do something with reply */
-		}
-
-		j_connection_pool_push(J_BACKEND_TYPE_OBJECT, index, object_connection);
+		done_func(ret, done_data);
+		return;
 	}
 
-	return ret;
+	j_object_request_send(index, message, operations, semantics, j_object_acknowledge_reply, done_func, done_data);
 }
 
 static
 gboolean
-j_object_delete_exec (JList* operations, JSemantics* semantics)
+j_object_create_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_object_create_exec_async, operations, semantics);
+}
+
+static
+void
+j_object_delete_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -265,8 +529,8 @@ j_object_delete_exec (JList* operations, JSemantics* semantics)
 	gsize namespace_len;
 	guint32 index;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JObject* object;
@@ -286,7 +550,7 @@ j_object_delete_exec (JList* operations, JSemantics* semantics)
 	{
 		message = j_message_new(J_MESSAGE_OBJECT_DELETE, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -307,39 +571,29 @@ j_object_delete_exec (JList* operations, JSemantics* semantics)
 			name_len = strlen(object->name) + 1;
 
 			j_message_add_operation(message, name_len);
-			j_message_append_n(message, object->name, name_len);
+			j_message_append_string(message, object->name);
 		}
 	}
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		JSemanticsSafety safety;
-
-		gpointer object_connection;
-
-		safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
-		object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, index);
-		j_message_send(message, object_connection);
-
-		if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
-		{
-			g_autoptr(JMessage) reply = NULL;
-
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, object_connection);
-
-			/* FIXME do something with reply */
-		}
-
-		j_connection_pool_push(J_BACKEND_TYPE_OBJECT, index, object_connection);
+		done_func(ret, done_data);
+		return;
 	}
 
-	return ret;
+	j_object_request_send(index, message, operations, semantics, j_object_acknowledge_reply, done_func, done_data);
 }
 
 static
 gboolean
-j_object_read_exec (JList* operations, JSemantics* semantics)
+j_object_delete_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_object_delete_exec_async, operations, semantics);
+}
+
+static
+void
+j_object_read_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -355,8 +609,8 @@ j_object_read_exec (JList* operations, JSemantics* semantics)
 	// FIXME
 	//JLock* lock = NULL;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JObjectOperation* operation = j_list_get_first(operations);
@@ -384,8 +638,8 @@ j_object_read_exec (JList* operations, JSemantics* semantics)
 
 		message = j_message_new(J_MESSAGE_OBJECT_READ, namespace_len + name_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, object->namespace, namespace_len);
-		j_message_append_n(message, object->name, name_len);
+		j_message_append_namespace(message, object->namespace);
+		j_message_append_string(message, object->name);
 	}
 
 	/*
@@ -414,9 +668,13 @@ j_object_read_exec (JList* operations, JSemantics* semantics)
 		}
 		else
 		{
-			j_message_add_operation(message, sizeof(guint64) + sizeof(guint64));
-			j_message_append_8(message, &length);
-			j_message_append_8(message, &offset);
+			JMessageObjectRead message_operation;
+
+			message_operation.length = length;
+			message_operation.offset = offset;
+
+			j_message_add_operation(message, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ));
+			j_message_append_object_read(message, &message_operation);
 		}
 
 		j_trace_file_end(object->name, J_TRACE_FILE_READ, length, offset);
@@ -427,63 +685,11 @@ j_object_read_exec (JList* operations, JSemantics* semantics)
 	if (object_backend != NULL)
 	{
 		ret = j_backend_object_close(object_backend, object_handle) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		g_autoptr(JMessage) reply = NULL;
-		gpointer object_connection;
-		guint32 operations_done;
-		guint32 operation_count;
-
-		object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, object->index);
-		j_message_send(message, object_connection);
-
-		reply = j_message_new_reply(message);
-
-		operations_done = 0;
-		operation_count = j_message_get_count(message);
-
-		it = j_list_iterator_new(operations);
-
-		/**
-		 * This extra loop is necessary because the server might send multiple
-		 * replies per message. The same reply object can be used to receive
-		 * multiple times.
-		 */
-		while (operations_done < operation_count)
-		{
-			guint32 reply_operation_count;
-
-			j_message_receive(reply, object_connection);
-
-			reply_operation_count = j_message_get_count(reply);
-
-			for (guint i = 0; i < reply_operation_count && j_list_iterator_next(it); i++)
-			{
-				JObjectOperation* operation = j_list_iterator_get(it);
-				gpointer data = operation->read.data;
-				guint64* bytes_read = operation->read.bytes_read;
-
-				guint64 nbytes;
-
-				nbytes = j_message_get_8(reply);
-				j_helper_atomic_add(bytes_read, nbytes);
-
-				if (nbytes > 0)
-				{
-					GInputStream* input;
-
-					input = g_io_stream_get_input_stream(G_IO_STREAM(object_connection));
-					g_input_stream_read_all(input, data, nbytes, NULL, NULL, NULL);
-				}
-			}
-
-			operations_done += reply_operation_count;
-		}
-
-		j_list_iterator_free(it);
-
-		j_connection_pool_push(J_BACKEND_TYPE_OBJECT, object->index, object_connection);
+		j_object_request_send(object->index, message, operations, semantics, j_object_read_reply, done_func, done_data);
 	}
 
 	/*
@@ -495,13 +701,18 @@ j_object_read_exec (JList* operations, JSemantics* semantics)
 		j_lock_free(lock);
 	}
 	*/
-
-	return ret;
 }
 
 static
 gboolean
-j_object_write_exec (JList* operations, JSemantics* semantics)
+j_object_read_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_object_read_exec_async, operations, semantics);
+}
+
+static
+void
+j_object_write_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -517,8 +728,8 @@ j_object_write_exec (JList* operations, JSemantics* semantics)
 	// FIXME
 	//JLock* lock = NULL;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JObjectOperation* operation = j_list_get_first(operations);
@@ -546,8 +757,8 @@ j_object_write_exec (JList* operations, JSemantics* semantics)
 
 		message = j_message_new(J_MESSAGE_OBJECT_WRITE, namespace_len + name_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, object->namespace, namespace_len);
-		j_message_append_n(message, object->name, name_len);
+		j_message_append_namespace(message, object->namespace);
+		j_message_append_string(message, object->name);
 	}
 
 	/*
@@ -583,9 +794,13 @@ j_object_write_exec (JList* operations, JSemantics* semantics)
 		}
 		else
 		{
-			j_message_add_operation(message, sizeof(guint64) + sizeof(guint64));
-			j_message_append_8(message, &length);
-			j_message_append_8(message, &offset);
+			JMessageObjectWrite message_operation;
+
+			message_operation.length = length;
+			message_operation.offset = offset;
+
+			j_message_add_operation(message, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_WRITE));
+			j_message_append_object_write(message, &message_operation);
 			j_message_add_send(message, data, length);
 
 			// Fake bytes_written here instead of doing another loop further down
@@ -603,40 +818,11 @@ j_object_write_exec (JList* operations, JSemantics* semantics)
 	if (object_backend != NULL)
 	{
 		ret = j_backend_object_close(object_backend, object_handle) && ret;
+		done_func(ret, done_data);
 	}
 	else
 	{
-		JSemanticsSafety safety;
-
-		gpointer object_connection;
-
-		safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
-		object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, object->index);
-		j_message_send(message, object_connection);
-
-		if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
-		{
-			g_autoptr(JMessage) reply = NULL;
-			guint64 nbytes;
-
-			reply = j_message_new_reply(message);
-			j_message_receive(reply, object_connection);
-
-			it = j_list_iterator_new(operations);
-
-			while (j_list_iterator_next(it))
-			{
-				JObjectOperation* operation = j_list_iterator_get(it);
-				guint64* bytes_written = operation->write.bytes_written;
-
-				nbytes = j_message_get_8(reply);
-				j_helper_atomic_add(bytes_written, nbytes);
-			}
-
-			j_list_iterator_free(it);
-		}
-
-		j_connection_pool_push(J_BACKEND_TYPE_OBJECT, object->index, object_connection);
+		j_object_request_send(object->index, message, operations, semantics, j_object_write_reply, done_func, done_data);
 	}
 
 	/*
@@ -648,13 +834,18 @@ j_object_write_exec (JList* operations, JSemantics* semantics)
 		j_lock_free(lock);
 	}
 	*/
-
-	return ret;
 }
 
 static
 gboolean
-j_object_status_exec (JList* operations, JSemantics* semantics)
+j_object_write_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_object_write_exec_async, operations, semantics);
+}
+
+static
+void
+j_object_status_exec_async (JList* operations, JSemantics* semantics, JOperationDoneFunc done_func, gpointer done_data)
 {
 	J_TRACE_FUNCTION(NULL);
 
@@ -668,8 +859,8 @@ j_object_status_exec (JList* operations, JSemantics* semantics)
 	gsize namespace_len;
 	guint32 index;
 
-	g_return_val_if_fail(operations != NULL, FALSE);
-	g_return_val_if_fail(semantics != NULL, FALSE);
+	g_return_if_fail(operations != NULL);
+	g_return_if_fail(semantics != NULL);
 
 	{
 		JObjectOperation* operation = j_list_get_first(operations);
@@ -690,7 +881,7 @@ j_object_status_exec (JList* operations, JSemantics* semantics)
 	{
 		message = j_message_new(J_MESSAGE_OBJECT_STATUS, namespace_len);
 		j_message_set_semantics(message, semantics);
-		j_message_append_n(message, namespace, namespace_len);
+		j_message_append_namespace(message, namespace);
 	}
 
 	while (j_list_iterator_next(it))
@@ -715,53 +906,26 @@ j_object_status_exec (JList* operations, JSemantics* semantics)
 			name_len = strlen(object->name) + 1;
 
 			j_message_add_operation(message, name_len);
-			j_message_append_n(message, object->name, name_len);
+			j_message_append_string(message, object->name);
 		}
 	}
 
 	j_list_iterator_free(it);
 
-	if (object_backend == NULL)
+	if (object_backend != NULL)
 	{
-		g_autoptr(JMessage) reply = NULL;
-		gpointer object_connection;
-
-		object_connection = j_connection_pool_pop(J_BACKEND_TYPE_OBJECT, index);
-		j_message_send(message, object_connection);
-
-		reply = j_message_new_reply(message);
-		j_message_receive(reply, object_connection);
-
-		it = j_list_iterator_new(operations);
-
-		while (j_list_iterator_next(it))
-		{
-			JObjectOperation* operation = j_list_iterator_get(it);
-			gint64* modification_time = operation->status.modification_time;
-			guint64* size = operation->status.size;
-			gint64 modification_time_;
-			guint64 size_;
-
-			modification_time_ = j_message_get_8(reply);
-			size_ = j_message_get_8(reply);
-
-			if (modification_time != NULL)
-			{
-				*modification_time = modification_time_;
-			}
-
-			if (size != NULL)
-			{
-				*size = size_;
-			}
-		}
-
-		j_list_iterator_free(it);
-
-		j_connection_pool_push(J_BACKEND_TYPE_OBJECT, index, object_connection);
+		done_func(ret, done_data);
+		return;
 	}
 
-	return ret;
+	j_object_request_send(index, message, operations, semantics, j_object_status_reply, done_func, done_data);
+}
+
+static
+gboolean
+j_object_status_exec (JList* operations, JSemantics* semantics)
+{
+	return j_operation_wait(j_object_status_exec_async, operations, semantics);
 }
 
 /**
@@ -793,6 +957,8 @@ j_object_new (gchar const* namespace, gchar const* name)
 	object->index = j_helper_hash(name) % j_configuration_get_server_count(configuration, J_BACKEND_TYPE_OBJECT);
 	object->namespace = g_strdup(namespace);
 	object->name = g_strdup(name);
+	object->operation_key = j_helper_get_namespace_key(namespace, object->index);
+	object->resource = g_strconcat(namespace, "/", name, NULL);
 	object->ref_count = 1;
 
 	return object;
@@ -829,6 +995,8 @@ j_object_new_for_index (guint32 index, gchar const* namespace, gchar const* name
 	object->index = index;
 	object->namespace = g_strdup(namespace);
 	object->name = g_strdup(name);
+	object->operation_key = j_helper_get_namespace_key(namespace, object->index);
+	object->resource = g_strconcat(namespace, "/", name, NULL);
 	object->ref_count = 1;
 
 	return object;
@@ -877,6 +1045,7 @@ j_object_unref (JObject* object)
 
 	if (g_atomic_int_dec_and_test(&(object->ref_count)))
 	{
+		g_free(object->resource);
 		g_free(object->name);
 		g_free(object->namespace);
 
@@ -906,10 +1075,11 @@ j_object_create (JObject* object, JBatch* batch)
 	g_return_if_fail(object != NULL);
 
 	operation = j_operation_new();
-	// FIXME key = index + namespace
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = j_object_ref(object);
 	operation->exec_func = j_object_create_exec;
+	operation->exec_async_func = j_object_create_exec_async;
 	operation->free_func = j_object_create_free;
 
 	j_batch_add(batch, operation);
@@ -934,9 +1104,11 @@ j_object_delete (JObject* object, JBatch* batch)
 	g_return_if_fail(object != NULL);
 
 	operation = j_operation_new();
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = j_object_ref(object);
 	operation->exec_func = j_object_delete_exec;
+	operation->exec_async_func = j_object_delete_exec_async;
 	operation->free_func = j_object_delete_free;
 
 	j_batch_add(batch, operation);
@@ -962,41 +1134,29 @@ j_object_read (JObject* object, gpointer data, guint64 length, guint64 offset, g
 
 	JObjectOperation* iop;
 	JOperation* operation;
-	guint64 max_operation_size;
 
 	g_return_if_fail(object != NULL);
 	g_return_if_fail(data != NULL);
 	g_return_if_fail(length > 0);
 	g_return_if_fail(bytes_read != NULL);
 
-	max_operation_size = j_configuration_get_max_operation_size(j_configuration());
-
-	// Chunk operation if necessary
-	while (length > 0)
-	{
-		guint64 chunk_size;
-
-		chunk_size = MIN(length, max_operation_size);
-
-		iop = g_slice_new(JObjectOperation);
-		iop->read.object = j_object_ref(object);
-		iop->read.data = data;
-		iop->read.length = chunk_size;
-		iop->read.offset = offset;
-		iop->read.bytes_read = bytes_read;
-
-		operation = j_operation_new();
-		operation->key = object;
-		operation->data = iop;
-		operation->exec_func = j_object_read_exec;
-		operation->free_func = j_object_read_free;
+	/* Reads are not chunked, the server streams data exceeding its maximum operation size. */
+	iop = g_slice_new(JObjectOperation);
+	iop->read.object = j_object_ref(object);
+	iop->read.data = data;
+	iop->read.length = length;
+	iop->read.offset = offset;
+	iop->read.bytes_read = bytes_read;
 
-		j_batch_add(batch, operation);
+	operation = j_operation_new();
+	operation->key = object;
+	operation->resource = object->resource;
+	operation->data = iop;
+	operation->exec_func = j_object_read_exec;
+	operation->exec_async_func = j_object_read_exec_async;
+	operation->free_func = j_object_read_free;
 
-		data = (gchar*)data + chunk_size;
-		length -= chunk_size;
-		offset += chunk_size;
-	}
+	j_batch_add(batch, operation);
 
 	*bytes_read = 0;
 }
@@ -1049,8 +1209,10 @@ j_object_write (JObject* object, gconstpointer data, guint64 length, guint64 off
 
 		operation = j_operation_new();
 		operation->key = object;
+		operation->resource = object->resource;
 		operation->data = iop;
 		operation->exec_func = j_object_write_exec;
+		operation->exec_async_func = j_object_write_exec_async;
 		operation->free_func = j_object_write_free;
 
 		j_batch_add(batch, operation);
@@ -1088,9 +1250,11 @@ j_object_status (JObject* object, gint64* modification_time, guint64* size, JBat
 	iop->status.size = size;
 
 	operation = j_operation_new();
-	operation->key = object;
+	operation->key = object->operation_key;
+	operation->resource = object->resource;
 	operation->data = iop;
 	operation->exec_func = j_object_status_exec;
+	operation->exec_async_func = j_object_status_exec_async;
 	operation->free_func = j_object_status_free;
 
 	j_batch_add(batch, operation);
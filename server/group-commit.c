@@ -0,0 +1,180 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <julea.h>
+
+#include "server.h"
+
+/**
+ * Sync requests are collected into batches.
+ * The first worker that finds no active leader becomes the leader of the current batch.
+ * It waits until enough workers are waiting or the window has elapsed, syncs every object of the batch once and wakes up all waiting workers.
+ * Requests that arrive while a batch is being synced are collected into the next one.
+ * A window of 0 disables group commit, every request syncs its object on its own.
+ */
+static GMutex jd_group_commit_mutex[1];
+static GCond jd_group_commit_cond[1];
+
+/**
+ * The objects of the batch that is currently being collected.
+ */
+static GPtrArray* jd_group_commit_pending = NULL;
+
+/**
+ * The number of workers waiting for the batch that is currently being collected.
+ * Several workers can wait for the same object.
+ */
+static guint jd_group_commit_waiters = 0;
+
+/**
+ * The generation of the batch that is currently being collected.
+ */
+static guint64 jd_group_commit_generation = 1;
+
+/**
+ * The generation of the last batch that has been synced.
+ */
+static guint64 jd_group_commit_completed = 0;
+
+static gboolean jd_group_commit_leader = FALSE;
+
+/**
+ * The number of waiting workers that causes a batch to be synced before the window has elapsed.
+ * Only a limited number of workers handle object requests at the same time, see jd_scheduler_submit().
+ */
+static guint jd_group_commit_max = 0;
+static gint64 jd_group_commit_window = 0;
+
+/**
+ * Initializes group commit.
+ *
+ * \param max    The maximum number of workers that may wait for a batch.
+ * \param window The time in microseconds to wait for further requests, 0 disables group commit.
+ */
+void
+jd_group_commit_init (guint32 max, guint32 window)
+{
+	g_mutex_init(jd_group_commit_mutex);
+	g_cond_init(jd_group_commit_cond);
+
+	jd_group_commit_pending = g_ptr_array_new();
+	jd_group_commit_max = MAX(max, 1);
+	jd_group_commit_window = window;
+}
+
+void
+jd_group_commit_fini (void)
+{
+	g_assert(jd_group_commit_pending->len == 0);
+
+	g_ptr_array_free(jd_group_commit_pending, TRUE);
+	jd_group_commit_pending = NULL;
+
+	g_cond_clear(jd_group_commit_cond);
+	g_mutex_clear(jd_group_commit_mutex);
+}
+
+/**
+ * Syncs an object as part of a group commit.
+ * Returns once the object has been synced, the object must not be closed before.
+ *
+ * \param object     An object.
+ * \param statistics Statistics to update.
+ **/
+void
+jd_group_commit_sync (gpointer object, JStatistics* statistics)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	guint64 generation;
+
+	if (jd_group_commit_window == 0)
+	{
+		j_backend_object_sync(jd_object_backend, object);
+		j_statistics_add(statistics, J_STATISTICS_SYNC, 1);
+		return;
+	}
+
+	g_mutex_lock(jd_group_commit_mutex);
+
+	/* Objects are shared between handles of the same file, so each one only has to be synced once. */
+	if (!g_ptr_array_find(jd_group_commit_pending, object, NULL))
+	{
+		g_ptr_array_add(jd_group_commit_pending, object);
+	}
+
+	jd_group_commit_waiters++;
+	generation = jd_group_commit_generation;
+
+	/* Wake up the leader in case the batch is full now. */
+	g_cond_broadcast(jd_group_commit_cond);
+
+	while (jd_group_commit_completed < generation)
+	{
+		g_autoptr(GPtrArray) batch = NULL;
+		guint64 batch_generation;
+		gint64 deadline;
+
+		if (jd_group_commit_leader)
+		{
+			g_cond_wait(jd_group_commit_cond, jd_group_commit_mutex);
+			continue;
+		}
+
+		jd_group_commit_leader = TRUE;
+		deadline = g_get_monotonic_time() + jd_group_commit_window;
+
+		while (jd_group_commit_waiters < jd_group_commit_max)
+		{
+			if (!g_cond_wait_until(jd_group_commit_cond, jd_group_commit_mutex, deadline))
+			{
+				break;
+			}
+		}
+
+		batch = jd_group_commit_pending;
+		batch_generation = jd_group_commit_generation;
+
+		jd_group_commit_pending = g_ptr_array_new();
+		jd_group_commit_waiters = 0;
+		jd_group_commit_generation++;
+
+		g_mutex_unlock(jd_group_commit_mutex);
+
+		for (guint i = 0; i < batch->len; i++)
+		{
+			j_backend_object_sync(jd_object_backend, g_ptr_array_index(batch, i));
+		}
+
+		g_mutex_lock(jd_group_commit_mutex);
+
+		jd_group_commit_completed = batch_generation;
+		jd_group_commit_leader = FALSE;
+
+		g_cond_broadcast(jd_group_commit_cond);
+	}
+
+	g_mutex_unlock(jd_group_commit_mutex);
+
+	/* Every request is accounted for, even if its object was synced together with others. */
+	j_statistics_add(statistics, J_STATISTICS_SYNC, 1);
+}
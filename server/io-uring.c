@@ -0,0 +1,675 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#endif
+
+#include <julea.h>
+
+#include "server.h"
+
+/**
+ * TCP connections can be driven by io_uring instead of epoll.
+ * A single thread accepts them using a multishot accept and receives from each of them using a multishot receive, which picks its buffers from a provided buffer ring.
+ * The thread parses the received data into messages and hands them to the workers, so no system calls are needed per message once a connection's receive has been submitted.
+ *
+ * A message whose data follows it, see jd_message_is_ordered(), stops the connection's receive.
+ * The worker handling the message consumes the data that has already been received before reading from the connection itself, see jd_connection_receive().
+ * Afterwards, the remaining data is parsed and receiving continues, see jd_io_uring_resume().
+ *
+ * Local connections are still driven by epoll, the shared memory segment offered via them is passed as ancillary data, which a multishot receive would discard.
+ */
+#ifdef HAVE_LIBURING
+
+/**
+ * The number of submission queue entries.
+ * The completion queue is larger, a multishot request can produce any number of completions.
+ */
+#define JD_IO_URING_ENTRIES 256
+
+/**
+ * The number of buffers in the provided buffer ring, has to be a power of two.
+ */
+#define JD_IO_URING_BUFFER_COUNT 256
+
+/**
+ * The size of each provided buffer.
+ */
+#define JD_IO_URING_BUFFER_SIZE (16 * 1024)
+
+#define JD_IO_URING_BUFFER_GROUP 0
+
+/**
+ * The kind of a submission, stored in the lower bits of its user data.
+ * Connections are allocated with at least 8-byte alignment, so receives store the connection in the remaining bits.
+ */
+enum JdIoUringTag
+{
+	JD_IO_URING_ACCEPT,
+	JD_IO_URING_RECEIVE,
+	JD_IO_URING_CANCEL,
+	JD_IO_URING_WAKEUP
+};
+
+typedef enum JdIoUringTag JdIoUringTag;
+
+#define JD_IO_URING_TAG_MASK 0x3
+
+static struct io_uring jd_io_uring_ring;
+static struct io_uring_buf_ring* jd_io_uring_buffer_ring = NULL;
+static gchar* jd_io_uring_buffers = NULL;
+
+static GSocket* jd_io_uring_listener = NULL;
+
+static gint jd_io_uring_wakeup_fd = -1;
+static guint64 jd_io_uring_wakeup_value;
+
+/**
+ * The connections whose workers have finished handling a message, see jd_io_uring_resume().
+ */
+static GAsyncQueue* jd_io_uring_resumed = NULL;
+
+static GThreadPool* jd_io_uring_thread_pool = NULL;
+static GThread* jd_io_uring_thread = NULL;
+static gint jd_io_uring_stopping = 0;
+
+static gboolean jd_io_uring_initialized = FALSE;
+
+static
+struct io_uring_sqe*
+jd_io_uring_get_sqe (void)
+{
+	struct io_uring_sqe* sqe;
+
+	/* Submitting makes room in a full submission queue. */
+	while ((sqe = io_uring_get_sqe(&jd_io_uring_ring)) == NULL)
+	{
+		io_uring_submit(&jd_io_uring_ring);
+	}
+
+	return sqe;
+}
+
+static
+void
+jd_io_uring_accept (void)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = jd_io_uring_get_sqe();
+	io_uring_prep_multishot_accept(sqe, g_socket_get_fd(jd_io_uring_listener), NULL, NULL, SOCK_CLOEXEC);
+	io_uring_sqe_set_data64(sqe, JD_IO_URING_ACCEPT);
+}
+
+static
+void
+jd_io_uring_receive (JdConnection* connection)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = jd_io_uring_get_sqe();
+	io_uring_prep_recv_multishot(sqe, connection->fd, NULL, 0, 0);
+	io_uring_sqe_set_data64(sqe, (guintptr)connection | JD_IO_URING_RECEIVE);
+
+	/* The kernel picks a buffer from the ring for each completion. */
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = JD_IO_URING_BUFFER_GROUP;
+
+	connection->receiving = TRUE;
+}
+
+static
+void
+jd_io_uring_cancel (JdConnection* connection)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = jd_io_uring_get_sqe();
+	io_uring_prep_cancel64(sqe, (guintptr)connection | JD_IO_URING_RECEIVE, 0);
+	io_uring_sqe_set_data64(sqe, JD_IO_URING_CANCEL);
+}
+
+static
+void
+jd_io_uring_wakeup (void)
+{
+	struct io_uring_sqe* sqe;
+
+	sqe = jd_io_uring_get_sqe();
+	io_uring_prep_read(sqe, jd_io_uring_wakeup_fd, &jd_io_uring_wakeup_value, sizeof(jd_io_uring_wakeup_value), 0);
+	io_uring_sqe_set_data64(sqe, JD_IO_URING_WAKEUP);
+}
+
+/**
+ * Parses a connection's received data into messages and hands them to the workers.
+ * Receiving continues unless a message has to be handled before the next one can be read.
+ * Once a connection has been closed and all of its messages have been handed over, the event loop's reference is released.
+ */
+static
+void
+jd_io_uring_process (JdConnection* connection)
+{
+	gsize position = 0;
+
+	if (connection->busy)
+	{
+		return;
+	}
+
+	while (connection->held == NULL && position < connection->received->len)
+	{
+		g_autoptr(JMessage) message = NULL;
+		JdRequest* request;
+		gsize consumed;
+
+		if (!j_message_reader_feed(connection->reader, connection->received->data + position, connection->received->len - position, &consumed, &message))
+		{
+			/* The following messages can not be found anymore. */
+			position = connection->received->len;
+			connection->closed = TRUE;
+			jd_connection_close(connection);
+
+			if (connection->receiving)
+			{
+				jd_io_uring_cancel(connection);
+			}
+
+			break;
+		}
+
+		position += consumed;
+
+		if (message == NULL)
+		{
+			break;
+		}
+
+		request = jd_request_new(connection, message, connection->ready_time);
+
+		if (jd_message_is_ordered(message))
+		{
+			connection->held = request;
+
+			if (connection->receiving)
+			{
+				jd_io_uring_cancel(connection);
+			}
+
+			break;
+		}
+
+		/* Other workers can handle the following messages while this one is handled. */
+		jd_connection_ref(connection);
+		request->armed = TRUE;
+
+		g_thread_pool_push(jd_io_uring_thread_pool, request, NULL);
+	}
+
+	g_byte_array_remove_range(connection->received, 0, position);
+
+	if (connection->held != NULL)
+	{
+		/* The data received until the receive has stopped is left for the worker. */
+		if (!connection->receiving)
+		{
+			JdRequest* request = connection->held;
+
+			connection->held = NULL;
+			connection->busy = TRUE;
+
+			g_thread_pool_push(jd_io_uring_thread_pool, request, NULL);
+		}
+
+		return;
+	}
+
+	if (connection->closed)
+	{
+		if (!connection->receiving)
+		{
+			jd_connection_unref(connection);
+		}
+
+		return;
+	}
+
+	if (!connection->receiving)
+	{
+		jd_io_uring_receive(connection);
+	}
+}
+
+static
+void
+jd_io_uring_complete_accept (gint32 res, guint32 flags)
+{
+	if (res >= 0)
+	{
+		g_autoptr(GSocket) socket = NULL;
+		g_autoptr(GSocketConnection) socket_connection = NULL;
+		GError* error = NULL;
+
+		socket = g_socket_new_from_fd(res, &error);
+
+		if (socket != NULL)
+		{
+			JdConnection* connection;
+
+			socket_connection = g_socket_connection_factory_create_connection(socket);
+
+			connection = jd_connection_new(socket_connection);
+			connection->received = g_byte_array_new();
+
+			jd_io_uring_process(connection);
+		}
+		else
+		{
+			g_warning("Could not accept connection: %s", error->message);
+			g_error_free(error);
+			close(res);
+		}
+	}
+	else
+	{
+		g_warning("Could not accept connection: %s", g_strerror(-res));
+	}
+
+	if (!(flags & IORING_CQE_F_MORE))
+	{
+		jd_io_uring_accept();
+	}
+}
+
+static
+void
+jd_io_uring_complete_receive (JdConnection* connection, gint32 res, guint32 flags)
+{
+	if (res > 0)
+	{
+		guint16 buffer_id;
+		gchar* buffer;
+
+		buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+		buffer = jd_io_uring_buffers + (gsize)buffer_id * JD_IO_URING_BUFFER_SIZE;
+
+		/* Data following an invalid message is discarded, it can not be parsed anymore. */
+		if (!connection->closed)
+		{
+			g_byte_array_append(connection->received, (guint8*)buffer, res);
+		}
+
+		/* The buffer can be reused as soon as its data has been copied. */
+		io_uring_buf_ring_add(jd_io_uring_buffer_ring, buffer, JD_IO_URING_BUFFER_SIZE, buffer_id, io_uring_buf_ring_mask(JD_IO_URING_BUFFER_COUNT), 0);
+		io_uring_buf_ring_advance(jd_io_uring_buffer_ring, 1);
+	}
+	else if (res != -ENOBUFS && res != -ECANCELED)
+	{
+		/* The other side has closed the connection or receiving has failed. */
+		connection->closed = TRUE;
+	}
+
+	/* The receive has stopped, for example because it ran out of buffers, and is submitted again if necessary. */
+	if (!(flags & IORING_CQE_F_MORE))
+	{
+		connection->receiving = FALSE;
+	}
+
+	connection->ready_time = g_get_monotonic_time();
+
+	jd_io_uring_process(connection);
+}
+
+static
+void
+jd_io_uring_complete_wakeup (void)
+{
+	JdConnection* connection;
+
+	while ((connection = g_async_queue_try_pop(jd_io_uring_resumed)) != NULL)
+	{
+		connection->busy = FALSE;
+		connection->ready_time = g_get_monotonic_time();
+
+		jd_io_uring_process(connection);
+	}
+
+	jd_io_uring_wakeup();
+}
+
+static
+gpointer
+jd_io_uring_loop (gpointer data)
+{
+	(void)data;
+
+	jd_io_uring_accept();
+	jd_io_uring_wakeup();
+
+	while (!g_atomic_int_get(&jd_io_uring_stopping))
+	{
+		struct io_uring_cqe* cqe;
+		gint ret;
+
+		ret = io_uring_submit_and_wait(&jd_io_uring_ring, 1);
+
+		/* The kernel refuses submissions while completions are pending, which are reaped below. */
+		if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY)
+		{
+			g_critical("io_uring_submit_and_wait failed: %s", g_strerror(-ret));
+			break;
+		}
+
+		/* Completions are reaped from the shared completion queue without system calls. */
+		while (io_uring_peek_cqe(&jd_io_uring_ring, &cqe) == 0)
+		{
+			guint64 user_data = cqe->user_data;
+			gint32 res = cqe->res;
+			guint32 flags = cqe->flags;
+
+			/* Handling a completion might submit new requests, which needs room in the completion queue. */
+			io_uring_cqe_seen(&jd_io_uring_ring, cqe);
+
+			switch ((JdIoUringTag)(user_data & JD_IO_URING_TAG_MASK))
+			{
+				case JD_IO_URING_ACCEPT:
+					jd_io_uring_complete_accept(res, flags);
+					break;
+				case JD_IO_URING_RECEIVE:
+					jd_io_uring_complete_receive((JdConnection*)(guintptr)(user_data & ~(guint64)JD_IO_URING_TAG_MASK), res, flags);
+					break;
+				case JD_IO_URING_CANCEL:
+					break;
+				case JD_IO_URING_WAKEUP:
+					jd_io_uring_complete_wakeup();
+					break;
+				default:
+					g_assert_not_reached();
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static
+void
+jd_io_uring_on_request (gpointer data, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	(void)user_data;
+
+	jd_dispatch_request(data);
+}
+
+/**
+ * Creates the TCP listener, which accepts connections on all addresses like g_socket_listener_add_inet_port().
+ */
+static
+gboolean
+jd_io_uring_listen (gint port)
+{
+	g_autoptr(GInetAddress) any = NULL;
+	g_autoptr(GSocketAddress) address = NULL;
+	GError* error = NULL;
+	GSocketFamily family = G_SOCKET_FAMILY_IPV6;
+
+	jd_io_uring_listener = g_socket_new(family, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL);
+
+	if (jd_io_uring_listener == NULL)
+	{
+		family = G_SOCKET_FAMILY_IPV4;
+		jd_io_uring_listener = g_socket_new(family, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
+	}
+	else
+	{
+		/* IPv4 clients connect via mapped addresses. */
+		g_socket_set_option(jd_io_uring_listener, IPPROTO_IPV6, IPV6_V6ONLY, 0, NULL);
+	}
+
+	if (jd_io_uring_listener != NULL)
+	{
+		any = g_inet_address_new_any(family);
+		address = g_inet_socket_address_new(any, port);
+
+		g_socket_set_listen_backlog(jd_io_uring_listener, 128);
+
+		if (g_socket_bind(jd_io_uring_listener, address, TRUE, &error) && g_socket_listen(jd_io_uring_listener, &error))
+		{
+			return TRUE;
+		}
+	}
+
+	g_warning("Could not listen on port %d: %s", port, error->message);
+	g_error_free(error);
+
+	return FALSE;
+}
+#endif
+
+/**
+ * Sets up io_uring and the listener for TCP connections.
+ *
+ * \param port The port to listen on.
+ *
+ * \return TRUE on success, FALSE if io_uring is not supported by this build or the kernel, in which case TCP connections have to be accepted by the socket service.
+ */
+gboolean
+jd_io_uring_init (gint port)
+{
+#ifdef HAVE_LIBURING
+	struct io_uring_params params;
+	struct utsname name;
+	guint major = 0;
+	guint minor = 0;
+	gint ret;
+
+	/* Older kernels accept the multishot receive but fail it once a connection has been accepted, so they have to be detected up front. */
+	if (uname(&name) != 0 || sscanf(name.release, "%u.%u", &major, &minor) != 2 || major < 6)
+	{
+		g_warning("io_uring requires Linux 6.0 or later, using epoll instead.");
+		return FALSE;
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = JD_IO_URING_ENTRIES * 16;
+
+	if ((ret = io_uring_queue_init_params(JD_IO_URING_ENTRIES, &jd_io_uring_ring, &params)) < 0)
+	{
+		g_warning("Could not set up io_uring, using epoll instead: %s", g_strerror(-ret));
+		return FALSE;
+	}
+
+	jd_io_uring_initialized = TRUE;
+
+	jd_io_uring_buffer_ring = io_uring_setup_buf_ring(&jd_io_uring_ring, JD_IO_URING_BUFFER_COUNT, JD_IO_URING_BUFFER_GROUP, 0, &ret);
+
+	if (jd_io_uring_buffer_ring == NULL)
+	{
+		g_warning("Could not register buffer ring, using epoll instead: %s", g_strerror(-ret));
+		jd_io_uring_fini();
+		return FALSE;
+	}
+
+	jd_io_uring_buffers = g_malloc(JD_IO_URING_BUFFER_COUNT * JD_IO_URING_BUFFER_SIZE);
+
+	for (guint i = 0; i < JD_IO_URING_BUFFER_COUNT; i++)
+	{
+		io_uring_buf_ring_add(jd_io_uring_buffer_ring, jd_io_uring_buffers + i * JD_IO_URING_BUFFER_SIZE, JD_IO_URING_BUFFER_SIZE, i, io_uring_buf_ring_mask(JD_IO_URING_BUFFER_COUNT), i);
+	}
+
+	io_uring_buf_ring_advance(jd_io_uring_buffer_ring, JD_IO_URING_BUFFER_COUNT);
+
+	if (!jd_io_uring_listen(port))
+	{
+		jd_io_uring_fini();
+		return FALSE;
+	}
+
+	return TRUE;
+#else
+	(void)port;
+
+	g_warning("io_uring is not supported by this build, using epoll instead.");
+
+	return FALSE;
+#endif
+}
+
+/**
+ * Starts accepting and receiving, if io_uring has been set up with jd_io_uring_init().
+ *
+ * \param threads The number of worker threads.
+ *
+ * \return TRUE on success, FALSE otherwise.
+ */
+gboolean
+jd_io_uring_start (guint32 threads)
+{
+#ifdef HAVE_LIBURING
+	if (!jd_io_uring_initialized)
+	{
+		return TRUE;
+	}
+
+	jd_io_uring_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+
+	if (jd_io_uring_wakeup_fd == -1)
+	{
+		return FALSE;
+	}
+
+	jd_io_uring_resumed = g_async_queue_new();
+
+	jd_io_uring_thread_pool = g_thread_pool_new(jd_io_uring_on_request, NULL, threads, TRUE, NULL);
+	jd_io_uring_thread = g_thread_new("julea-server-io-uring", jd_io_uring_loop, NULL);
+
+	return (jd_io_uring_thread_pool != NULL);
+#else
+	(void)threads;
+
+	return TRUE;
+#endif
+}
+
+/**
+ * Stops accepting and receiving and waits for the workers to finish.
+ * Afterwards, every connection driven by io_uring is only referenced by the event loop.
+ */
+void
+jd_io_uring_stop (void)
+{
+#ifdef HAVE_LIBURING
+	guint64 value = 1;
+
+	if (jd_io_uring_thread != NULL)
+	{
+		g_atomic_int_set(&jd_io_uring_stopping, 1);
+
+		if (write(jd_io_uring_wakeup_fd, &value, sizeof(value)) == sizeof(value))
+		{
+			g_thread_join(jd_io_uring_thread);
+		}
+
+		jd_io_uring_thread = NULL;
+	}
+
+	if (jd_io_uring_thread_pool != NULL)
+	{
+		g_thread_pool_free(jd_io_uring_thread_pool, FALSE, TRUE);
+		jd_io_uring_thread_pool = NULL;
+	}
+#endif
+}
+
+/**
+ * Releases io_uring, must be called after the connections have been released.
+ */
+void
+jd_io_uring_fini (void)
+{
+#ifdef HAVE_LIBURING
+	if (!jd_io_uring_initialized)
+	{
+		return;
+	}
+
+	g_clear_object(&jd_io_uring_listener);
+
+	if (jd_io_uring_buffer_ring != NULL)
+	{
+		io_uring_free_buf_ring(&jd_io_uring_ring, jd_io_uring_buffer_ring, JD_IO_URING_BUFFER_COUNT, JD_IO_URING_BUFFER_GROUP);
+		jd_io_uring_buffer_ring = NULL;
+	}
+
+	/* Requests still in flight are cancelled, the kernel does not access the buffers afterwards. */
+	io_uring_queue_exit(&jd_io_uring_ring);
+
+	g_clear_pointer(&jd_io_uring_buffers, g_free);
+	g_clear_pointer(&jd_io_uring_resumed, g_async_queue_unref);
+
+	if (jd_io_uring_wakeup_fd != -1)
+	{
+		close(jd_io_uring_wakeup_fd);
+		jd_io_uring_wakeup_fd = -1;
+	}
+
+	jd_io_uring_initialized = FALSE;
+#endif
+}
+
+/**
+ * Resumes receiving from a connection once a worker has handled a message whose data follows it.
+ * The data that has been received in the meantime is parsed by the io_uring thread.
+ *
+ * \param connection A connection driven by io_uring.
+ */
+void
+jd_io_uring_resume (JdConnection* connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+#ifdef HAVE_LIBURING
+	guint64 value = 1;
+
+	g_async_queue_push(jd_io_uring_resumed, connection);
+
+	if (write(jd_io_uring_wakeup_fd, &value, sizeof(value)) != sizeof(value))
+	{
+		g_warning("Could not wake up io_uring thread: %s", g_strerror(errno));
+	}
+#else
+	(void)connection;
+#endif
+}
@@ -17,22 +17,310 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE
+
 #include <julea-config.h>
 
 #include <glib.h>
 #include <gio/gio.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
 #include <julea.h>
 
 #include "server.h"
 
 static guint jd_thread_num = 0;
 
+/**
+ * A key-value operation decoded from a message.
+ */
+struct JdKVOperation
+{
+	gchar const* key;
+	gconstpointer value;
+	guint32 length;
+};
+
+typedef struct JdKVOperation JdKVOperation;
+
+/**
+ * Decodes a message's key-value operations.
+ * All operations are decoded before any of them is executed, so that truncated messages are detected before touching the backend.
+ *
+ * \param message A message.
+ * \param count   The number of operations.
+ * \param values  Whether the operations contain values.
+ *
+ * \return An array of JdKVOperation elements, or NULL if the message is truncated.
+ */
+static
+GArray*
+jd_get_kv_operations (JMessage* message, guint32 count, gboolean values)
+{
+	g_autoptr(GArray) operations = NULL;
+
+	operations = g_array_new(FALSE, FALSE, sizeof(JdKVOperation));
+
+	for (guint32 i = 0; i < count; i++)
+	{
+		JdKVOperation operation = { NULL, NULL, 0 };
+
+		/* Keys take at least one byte, which also stops at the message's end if the count is wrong. */
+		if (!j_message_can_get(message, 1) || (operation.key = j_message_get_string(message)) == NULL)
+		{
+			return NULL;
+		}
+
+		if (values)
+		{
+			JMessageKVPut put;
+
+			if (!j_message_next_kv_put(message, &put) || !j_message_can_get(message, put.length))
+			{
+				return NULL;
+			}
+
+			operation.value = j_message_get_n(message, put.length);
+			operation.length = put.length;
+		}
+
+		g_array_append_val(operations, operation);
+	}
+
+	return g_steal_pointer(&operations);
+}
+
+#ifdef HAVE_SPLICE
+/**
+ * A pipe used to splice data from a connection into a file.
+ */
+struct JdPipe
+{
+	gint fds[2];
+	gsize size;
+};
+
+typedef struct JdPipe JdPipe;
+
+static
+void
+jd_pipe_free (gpointer data)
+{
+	JdPipe* splice_pipe = data;
+
+	close(splice_pipe->fds[0]);
+	close(splice_pipe->fds[1]);
+
+	g_slice_free(JdPipe, splice_pipe);
+}
+
+static GPrivate jd_pipe = G_PRIVATE_INIT(jd_pipe_free);
+
+/**
+ * Returns the calling worker's pipe.
+ */
+static
+JdPipe*
+jd_get_pipe (void)
+{
+	JdPipe* splice_pipe;
+
+	splice_pipe = g_private_get(&jd_pipe);
+
+	if (G_UNLIKELY(splice_pipe == NULL))
+	{
+		gint fds[2];
+		gint size;
+
+		if (pipe2(fds, O_CLOEXEC) == -1)
+		{
+			return NULL;
+		}
+
+		splice_pipe = g_slice_new(JdPipe);
+		splice_pipe->fds[0] = fds[0];
+		splice_pipe->fds[1] = fds[1];
+
+		/* Larger pipes need fewer splice() calls, the default size is used if this fails. */
+		size = fcntl(fds[1], F_SETPIPE_SZ, 1024 * 1024);
+		splice_pipe->size = (size > 0) ? (gsize)size : 64 * 1024;
+
+		g_private_set(&jd_pipe, splice_pipe);
+	}
+
+	return splice_pipe;
+}
+
+/**
+ * Moves data from a connection into a file without copying it through user space.
+ * Stops early if splice() is not supported, the remaining data has to be received by the caller.
+ *
+ * \param socket        A socket.
+ * \param fd            A file descriptor.
+ * \param length        The number of bytes to receive.
+ * \param offset        The offset within #fd.
+ * \param bytes_written Returns the number of bytes written.
+ *
+ * \return The number of bytes received.
+ */
+static
+guint64
+jd_splice_write (GSocket* socket, gint fd, guint64 length, guint64 offset, guint64* bytes_written)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdPipe* splice_pipe;
+	gint socket_fd;
+	guint64 received = 0;
+
+	if ((splice_pipe = jd_get_pipe()) == NULL)
+	{
+		return 0;
+	}
+
+	socket_fd = g_socket_get_fd(socket);
+
+	while (received < length)
+	{
+		gssize nbytes;
+
+		nbytes = splice(socket_fd, NULL, splice_pipe->fds[1], NULL, MIN(length - received, splice_pipe->size), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+		if (nbytes < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				if (!g_socket_condition_wait(socket, G_IO_IN, NULL, NULL))
+				{
+					break;
+				}
+
+				continue;
+			}
+			else if (errno == EINTR)
+			{
+				continue;
+			}
+
+			break;
+		}
+		else if (nbytes == 0)
+		{
+			break;
+		}
+
+		received += nbytes;
+
+		while (nbytes > 0)
+		{
+			loff_t file_offset = offset + received - nbytes;
+			gssize written;
+
+			written = splice(splice_pipe->fds[0], NULL, fd, &file_offset, nbytes, SPLICE_F_MOVE);
+
+			if (written > 0)
+			{
+				nbytes -= written;
+				*bytes_written += written;
+			}
+			else if (written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			else
+			{
+				gchar buf[4096];
+
+				/* The file does not support splice(), copy the data that is already in the pipe. */
+				while (nbytes > 0)
+				{
+					gssize nread;
+
+					nread = read(splice_pipe->fds[0], buf, MIN((gsize)nbytes, sizeof(buf)));
+
+					if (nread <= 0)
+					{
+						break;
+					}
+
+					if (pwrite(fd, buf, nread, offset + received - nbytes) == nread)
+					{
+						*bytes_written += nread;
+					}
+
+					nbytes -= nread;
+				}
+
+				return received;
+			}
+		}
+	}
+
+	return received;
+}
+#endif
+
+/**
+ * Streams data from an object to a connection in segments of the memory chunk's size.
+ * The client expects exactly #length bytes, so the connection is closed if the object has been truncated in the meantime.
+ * Must be called with the connection's send mutex held.
+ *
+ * \param connection        A connection.
+ * \param object            An object.
+ * \param memory_chunk      A memory chunk.
+ * \param memory_chunk_size The memory chunk's size.
+ * \param length            The number of bytes to send.
+ * \param offset            The offset within #object.
+ */
+static
+void
+jd_stream_read (JdConnection* connection, gpointer object, JMemoryChunk* memory_chunk, guint64 memory_chunk_size, guint64 length, guint64 offset)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gchar* buf;
+
+	j_memory_chunk_reset(memory_chunk);
+	buf = j_memory_chunk_get(memory_chunk, memory_chunk_size);
+
+	while (length > 0)
+	{
+		guint64 segment_size;
+		guint64 nbytes = 0;
+
+		segment_size = MIN(length, memory_chunk_size);
+
+		j_backend_object_read(jd_object_backend, object, buf, segment_size, offset, &nbytes);
+
+		if (nbytes < segment_size)
+		{
+			jd_connection_close(connection);
+			break;
+		}
+
+		if (!jd_connection_write_locked(connection, buf, segment_size))
+		{
+			break;
+		}
+
+		length -= segment_size;
+		offset += segment_size;
+	}
+
+	j_memory_chunk_reset(memory_chunk);
+}
+
 gboolean
-jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChunk* memory_chunk, guint64 memory_chunk_size, JStatistics* statistics)
+jd_handle_message (JMessage* message, JdConnection* connection, JMemoryChunk* memory_chunk, guint64 memory_chunk_size)
 {
 	J_TRACE_FUNCTION(NULL);
 
+	JStatistics* statistics = connection->statistics;
+
 	gchar const* key;
 	gchar const* namespace;
 	gchar const* path;
@@ -47,6 +335,10 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 	semantics = j_message_get_semantics(message);
 	safety = j_semantics_get(semantics, J_SEMANTICS_SAFETY);
 
+	/*
+	 * Truncated messages are dropped and their connection is closed.
+	 * The client would otherwise wait for a reply that never comes, and any remaining data would be interpreted as the next message.
+	 */
 	switch (j_message_get_type(message))
 	{
 		case J_MESSAGE_NONE:
@@ -61,23 +353,33 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					reply = j_message_new_reply(message);
 				}
 
-				namespace = j_message_get_string(message);
+				if ((namespace = j_message_get_string(message)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
 
 				for (i = 0; i < operation_count; i++)
 				{
-					path = j_message_get_string(message);
+					JdObjectHandle* handle;
+
+					if ((path = j_message_get_string(message)) == NULL)
+					{
+						jd_connection_close(connection);
+						g_clear_pointer(&reply, j_message_unref);
+						break;
+					}
 
-					if (j_backend_object_create(jd_object_backend, namespace, path, &object))
+					if ((handle = jd_object_cache_open(namespace, path, TRUE, &object)) != NULL)
 					{
 						j_statistics_add(statistics, J_STATISTICS_FILES_CREATED, 1);
 
 						if (safety == J_SEMANTICS_SAFETY_STORAGE)
 						{
-							j_backend_object_sync(jd_object_backend, object);
-							j_statistics_add(statistics, J_STATISTICS_SYNC, 1);
+							jd_group_commit_sync(object, statistics);
 						}
 
-						j_backend_object_close(jd_object_backend, object);
+						jd_object_cache_close(handle);
 					}
 
 					if (reply != NULL)
@@ -88,7 +390,7 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 
 				if (reply != NULL)
 				{
-					j_message_send(reply, connection);
+					jd_connection_send(connection, reply);
 				}
 			}
 			break;
@@ -102,14 +404,25 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					reply = j_message_new_reply(message);
 				}
 
-				namespace = j_message_get_string(message);
+				if ((namespace = j_message_get_string(message)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
 
 				for (i = 0; i < operation_count; i++)
 				{
-					path = j_message_get_string(message);
+					JdObjectHandle* handle;
 
-					if (j_backend_object_open(jd_object_backend, namespace, path, &object)
-					    && j_backend_object_delete(jd_object_backend, object))
+					if ((path = j_message_get_string(message)) == NULL)
+					{
+						jd_connection_close(connection);
+						g_clear_pointer(&reply, j_message_unref);
+						break;
+					}
+
+					if ((handle = jd_object_cache_open(namespace, path, FALSE, &object)) != NULL
+					    && jd_object_cache_delete(handle))
 					{
 						j_statistics_add(statistics, J_STATISTICS_FILES_DELETED, 1);
 					}
@@ -122,38 +435,109 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 
 				if (reply != NULL)
 				{
-					j_message_send(reply, connection);
+					jd_connection_send(connection, reply);
 				}
 			}
 			break;
 		case J_MESSAGE_OBJECT_READ:
 			{
+				g_autofree JMessageObjectRead* operations = NULL;
 				JMessage* reply;
-				gpointer object;
+				JdObjectHandle* handle;
+				gpointer object = NULL;
+				gint fd = -1;
+				gint64 modification_time;
+				guint64 size = 0;
+				gboolean have_size = FALSE;
 
 				namespace = j_message_get_string(message);
 				path = j_message_get_string(message);
 
+				if (namespace == NULL || path == NULL || !j_message_get_object_read(message, operation_count, &operations))
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				reply = j_message_new_reply(message);
 
-				// FIXME return value
-				j_backend_object_open(jd_object_backend, namespace, path, &object);
+				handle = jd_object_cache_open(namespace, path, FALSE, &object);
+
+				if (handle != NULL)
+				{
+					have_size = j_backend_object_status(jd_object_backend, object, &modification_time, &size);
+				}
+
+				/* If the backend provides a file descriptor, the data is sent directly from it. */
+				if (!have_size || !j_backend_object_get_fd(jd_object_backend, object, &fd))
+				{
+					fd = -1;
+				}
 
 				for (i = 0; i < operation_count; i++)
 				{
+					JMessageObjectReadReply reply_operation;
 					gchar* buf;
-					guint64 length;
-					guint64 offset;
+					guint64 length = operations[i].length;
+					guint64 offset = operations[i].offset;
 					guint64 bytes_read = 0;
 
-					length = j_message_get_8(message);
-					offset = j_message_get_8(message);
+					if (handle == NULL)
+					{
+						reply_operation.bytes_read = bytes_read;
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ_REPLY));
+						j_message_append_object_read_reply(reply, &reply_operation);
+						continue;
+					}
+
+					if (fd != -1)
+					{
+						/* If the object shrinks before the data is sent, sending fails and the connection is closed, see jd_connection_send(). */
+						if (offset < size)
+						{
+							bytes_read = MIN(length, size - offset);
+						}
+
+						j_statistics_add(statistics, J_STATISTICS_BYTES_READ, bytes_read);
+
+						reply_operation.bytes_read = bytes_read;
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ_REPLY));
+						j_message_append_object_read_reply(reply, &reply_operation);
+
+						if (bytes_read > 0)
+						{
+							j_message_add_send_fd(reply, fd, offset, bytes_read);
+						}
+
+						j_statistics_add(statistics, J_STATISTICS_BYTES_SENT, bytes_read);
+
+						continue;
+					}
 
 					if (length > memory_chunk_size)
 					{
-						// FIXME return proper error
-						j_message_add_operation(reply, sizeof(guint64));
-						j_message_append_8(reply, &bytes_read);
+						/* The number of bytes has to be sent before the data, so it is determined using the object's size. */
+						if (have_size && offset < size)
+						{
+							bytes_read = MIN(length, size - offset);
+						}
+
+						reply_operation.bytes_read = bytes_read;
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ_REPLY));
+						j_message_append_object_read_reply(reply, &reply_operation);
+
+						/* The reply is sent before streaming, which makes the memory chunk available for the segments. */
+						g_mutex_lock(connection->send_mutex);
+						jd_connection_send_locked(connection, reply);
+						jd_stream_read(connection, object, memory_chunk, memory_chunk_size, bytes_read, offset);
+						g_mutex_unlock(connection->send_mutex);
+
+						j_statistics_add(statistics, J_STATISTICS_BYTES_READ, bytes_read);
+						j_statistics_add(statistics, J_STATISTICS_BYTES_SENT, bytes_read);
+
+						j_message_unref(reply);
+						reply = j_message_new_reply(message);
+
 						continue;
 					}
 
@@ -162,7 +546,7 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					if (buf == NULL)
 					{
 						// FIXME ugly
-						j_message_send(reply, connection);
+						jd_connection_send(connection, reply);
 						j_message_unref(reply);
 
 						reply = j_message_new_reply(message);
@@ -174,8 +558,9 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					j_backend_object_read(jd_object_backend, object, buf, length, offset, &bytes_read);
 					j_statistics_add(statistics, J_STATISTICS_BYTES_READ, bytes_read);
 
-					j_message_add_operation(reply, sizeof(guint64));
-					j_message_append_8(reply, &bytes_read);
+					reply_operation.bytes_read = bytes_read;
+					j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ_REPLY));
+					j_message_append_object_read_reply(reply, &reply_operation);
 
 					if (bytes_read > 0)
 					{
@@ -185,80 +570,150 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					j_statistics_add(statistics, J_STATISTICS_BYTES_SENT, bytes_read);
 				}
 
-				j_backend_object_close(jd_object_backend, object);
+				/* The last operation might have been streamed already. */
+				if (j_message_get_count(reply) > 0)
+				{
+					jd_connection_send(connection, reply);
+				}
 
-				j_message_send(reply, connection);
 				j_message_unref(reply);
 
+				/* The object has to stay open until the reply has been sent, see above. */
+				if (handle != NULL)
+				{
+					jd_object_cache_close(handle);
+				}
+
 				j_memory_chunk_reset(memory_chunk);
 			}
 			break;
 		case J_MESSAGE_OBJECT_WRITE:
 			{
+				g_autofree JMessageObjectWrite* operations = NULL;
 				g_autoptr(JMessage) reply = NULL;
-				gpointer object;
+				JdObjectHandle* handle;
+				gpointer object = NULL;
+				gint fd = -1;
+
+				namespace = j_message_get_string(message);
+				path = j_message_get_string(message);
+
+				if (namespace == NULL || path == NULL || !j_message_get_object_write(message, operation_count, &operations))
+				{
+					jd_connection_close(connection);
+					break;
+				}
 
 				if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
 				{
 					reply = j_message_new_reply(message);
 				}
 
-				namespace = j_message_get_string(message);
-				path = j_message_get_string(message);
+				handle = jd_object_cache_open(namespace, path, FALSE, &object);
 
-				// FIXME return value
-				j_backend_object_open(jd_object_backend, namespace, path, &object);
+				if (handle == NULL || !jd_splice_writes || !j_backend_object_get_fd(jd_object_backend, object, &fd))
+				{
+					fd = -1;
+				}
 
 				for (i = 0; i < operation_count; i++)
 				{
-					GInputStream* input;
+					JMessageObjectWriteReply reply_operation;
 					gchar* buf;
-					guint64 length;
-					guint64 offset;
+					guint64 length = operations[i].length;
+					guint64 offset = operations[i].offset;
 					guint64 bytes_written = 0;
 
-					length = j_message_get_8(message);
-					offset = j_message_get_8(message);
+					/* Data in a shared memory segment is written directly from there. */
+					if ((buf = j_message_get_shared(message, length)) != NULL)
+					{
+						j_statistics_add(statistics, J_STATISTICS_BYTES_RECEIVED, length);
+
+						if (handle != NULL && length > 0)
+						{
+							j_backend_object_write(jd_object_backend, object, buf, length, offset, &bytes_written);
+						}
 
-					if (length > memory_chunk_size)
+						length = 0;
+					}
+
+#ifdef HAVE_SPLICE
+					/* Data that has already been received by io_uring can not be spliced, see jd_connection_receive(). */
+					if (fd != -1 && length > 0 && (connection->received == NULL || connection->received->len == 0))
 					{
-						// FIXME return proper error
-						j_message_add_operation(reply, sizeof(guint64));
-						j_message_append_8(reply, &bytes_written);
-						continue;
+						guint64 bytes_received;
+
+						bytes_received = jd_splice_write(g_socket_connection_get_socket(connection->connection), fd, length, offset, &bytes_written);
+						j_statistics_add(statistics, J_STATISTICS_BYTES_RECEIVED, bytes_received);
+
+						if (bytes_received < length)
+						{
+							/* Fall back to the memory chunk for the remaining data. */
+							fd = -1;
+						}
+
+						length -= bytes_received;
+						offset += bytes_received;
 					}
+#endif
 
-					// Guaranteed to work because memory_chunk is reset below
-					buf = j_memory_chunk_get(memory_chunk, length);
-					g_assert(buf != NULL);
+					/* The remaining data might be larger than the memory chunk after a partial splice, so it is received in pieces. */
+					while (length > 0)
+					{
+						guint64 chunk_length;
+						guint64 nbytes = 0;
 
-					input = g_io_stream_get_input_stream(G_IO_STREAM(connection));
-					g_input_stream_read_all(input, buf, length, NULL, NULL, NULL);
-					j_statistics_add(statistics, J_STATISTICS_BYTES_RECEIVED, length);
+						chunk_length = MIN(length, memory_chunk_size);
+
+						j_memory_chunk_reset(memory_chunk);
+						buf = j_memory_chunk_get(memory_chunk, chunk_length);
+						g_assert(buf != NULL);
+
+						/* The following messages can not be found anymore if the data is not received completely. */
+						if (!jd_connection_receive(connection, buf, chunk_length))
+						{
+							jd_connection_close(connection);
+							break;
+						}
+
+						j_statistics_add(statistics, J_STATISTICS_BYTES_RECEIVED, chunk_length);
+
+						/* The data has to be received even if the object could not be opened. */
+						if (handle != NULL)
+						{
+							j_backend_object_write(jd_object_backend, object, buf, chunk_length, offset, &nbytes);
+							bytes_written += nbytes;
+						}
+
+						length -= chunk_length;
+						offset += chunk_length;
+					}
 
-					j_backend_object_write(jd_object_backend, object, buf, length, offset, &bytes_written);
 					j_statistics_add(statistics, J_STATISTICS_BYTES_WRITTEN, bytes_written);
 
 					if (reply != NULL)
 					{
-						j_message_add_operation(reply, sizeof(guint64));
-						j_message_append_8(reply, &bytes_written);
+						reply_operation.bytes_written = bytes_written;
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_WRITE_REPLY));
+						j_message_append_object_write_reply(reply, &reply_operation);
 					}
 
 					j_memory_chunk_reset(memory_chunk);
 				}
 
-				if (safety == J_SEMANTICS_SAFETY_STORAGE)
+				if (handle != NULL)
 				{
-					j_backend_object_sync(jd_object_backend, object);
-					j_statistics_add(statistics, J_STATISTICS_SYNC, 1);
-				}
+					if (safety == J_SEMANTICS_SAFETY_STORAGE)
+					{
+						jd_group_commit_sync(object, statistics);
+					}
 
-				j_backend_object_close(jd_object_backend, object);
+					jd_object_cache_close(handle);
+				}
 
 				if (reply != NULL)
 				{
-					j_message_send(reply, connection);
+					jd_connection_send(connection, reply);
 				}
 
 				j_memory_chunk_reset(memory_chunk);
@@ -269,33 +724,44 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				g_autoptr(JMessage) reply = NULL;
 				gpointer object;
 
-				reply = j_message_new_reply(message);
+				if ((namespace = j_message_get_string(message)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
 
-				namespace = j_message_get_string(message);
+				reply = j_message_new_reply(message);
 
 				for (i = 0; i < operation_count; i++)
 				{
-					gint64 modification_time = 0;
-					guint64 size = 0;
-
-					path = j_message_get_string(message);
-
-					// FIXME return value
-					j_backend_object_open(jd_object_backend, namespace, path, &object);
+					JMessageObjectStatusReply reply_operation = { 0, 0 };
+					JdObjectHandle* handle;
 
-					if (j_backend_object_status(jd_object_backend, object, &modification_time, &size))
+					if ((path = j_message_get_string(message)) == NULL)
 					{
-						j_statistics_add(statistics, J_STATISTICS_FILES_STATED, 1);
+						jd_connection_close(connection);
+						g_clear_pointer(&reply, j_message_unref);
+						break;
 					}
 
-					j_message_add_operation(reply, sizeof(gint64) + sizeof(guint64));
-					j_message_append_8(reply, &modification_time);
-					j_message_append_8(reply, &size);
+					if ((handle = jd_object_cache_open(namespace, path, FALSE, &object)) != NULL)
+					{
+						if (j_backend_object_status(jd_object_backend, object, &(reply_operation.modification_time), &(reply_operation.size)))
+						{
+							j_statistics_add(statistics, J_STATISTICS_FILES_STATED, 1);
+						}
+
+						jd_object_cache_close(handle);
+					}
 
-					j_backend_object_close(jd_object_backend, object);
+					j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_STATUS_REPLY));
+					j_message_append_object_status_reply(reply, &reply_operation);
 				}
 
-				j_message_send(reply, connection);
+				if (reply != NULL)
+				{
+					jd_connection_send(connection, reply);
+				}
 			}
 			break;
 		case J_MESSAGE_STATISTICS:
@@ -306,16 +772,10 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				guint64 value;
 
 				get_all = j_message_get_1(message);
-				r_statistics = (get_all == 0) ? statistics : jd_statistics;
-
-				if (get_all != 0)
-				{
-					g_mutex_lock(jd_statistics_mutex);
-					/* FIXME add statistics of all threads */
-				}
+				r_statistics = (get_all == 0) ? statistics : jd_statistics_get_all();
 
 				reply = j_message_new_reply(message);
-				j_message_add_operation(reply, 8 * sizeof(guint64));
+				j_message_add_operation(reply, 10 * sizeof(guint64));
 
 				value = j_statistics_get(r_statistics, J_STATISTICS_FILES_CREATED);
 				j_message_append_8(reply, &value);
@@ -333,13 +793,19 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				j_message_append_8(reply, &value);
 				value = j_statistics_get(r_statistics, J_STATISTICS_BYTES_SENT);
 				j_message_append_8(reply, &value);
+				value = j_statistics_get(r_statistics, J_STATISTICS_BYTES_UNCOMPRESSED);
+				j_message_append_8(reply, &value);
+				value = j_statistics_get(r_statistics, J_STATISTICS_BYTES_COMPRESSED);
+				j_message_append_8(reply, &value);
 
 				if (get_all != 0)
 				{
-					g_mutex_unlock(jd_statistics_mutex);
+					/* Latencies are only recorded for the whole server. */
+					jd_statistics_append_histograms(reply);
+					j_statistics_free(r_statistics);
 				}
 
-				j_message_send(reply, connection);
+				jd_connection_send(connection, reply);
 			}
 			break;
 		case J_MESSAGE_PING:
@@ -366,32 +832,71 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					j_message_append_string(reply, "kv");
 				}
 
-				j_message_send(reply, connection);
+				/* Clients may intern strings, see j_message_enable_interning(). */
+				j_message_add_operation(reply, 7);
+				j_message_append_string(reply, "intern");
+
+				/* Clients may request a compression algorithm or offer a shared memory segment, which are confirmed if they are supported. */
+				for (i = 0; i < operation_count; i++)
+				{
+					gchar const* compression;
+					JMessageCompression algorithm;
+
+					compression = j_message_get_string(message);
+
+					if (g_strcmp0(compression, "shm") == 0)
+					{
+						if (j_message_accept_shared_memory(connection->connection, memory_chunk_size))
+						{
+							j_message_add_operation(reply, 4);
+							j_message_append_string(reply, "shm");
+						}
+
+						continue;
+					}
+
+					algorithm = j_message_compression_from_string(compression);
+
+					if (algorithm != J_MESSAGE_COMPRESSION_NONE)
+					{
+						j_message_enable_compression(connection->connection, algorithm, jd_compression_threshold);
+
+						j_message_add_operation(reply, strlen(compression) + 1);
+						j_message_append_string(reply, compression);
+					}
+				}
+
+				/* Clients that already know the server's capabilities do not wait for a reply. */
+				if (safety != J_SEMANTICS_SAFETY_NONE)
+				{
+					jd_connection_send(connection, reply);
+				}
 			}
 			break;
 		case J_MESSAGE_KV_PUT:
 			{
+				g_autoptr(GArray) operations = NULL;
 				g_autoptr(JMessage) reply = NULL;
 				gpointer batch;
 
+				if ((namespace = j_message_get_string(message)) == NULL || (operations = jd_get_kv_operations(message, operation_count, TRUE)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
 				{
 					reply = j_message_new_reply(message);
 				}
 
-				namespace = j_message_get_string(message);
 				j_backend_kv_batch_start(jd_kv_backend, namespace, semantics, &batch);
 
-				for (i = 0; i < operation_count; i++)
+				for (i = 0; i < operations->len; i++)
 				{
-					gconstpointer data;
-					guint32 len;
-
-					key = j_message_get_string(message);
-					len = j_message_get_4(message);
-					data = j_message_get_n(message, len);
+					JdKVOperation* operation = &g_array_index(operations, JdKVOperation, i);
 
-					j_backend_kv_put(jd_kv_backend, batch, key, data, len);
+					j_backend_kv_put(jd_kv_backend, batch, operation->key, operation->value, operation->length);
 
 					if (reply != NULL)
 					{
@@ -403,28 +908,34 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 
 				if (reply != NULL)
 				{
-					j_message_send(reply, connection);
+					jd_connection_send(connection, reply);
 				}
 			}
 			break;
 		case J_MESSAGE_KV_DELETE:
 			{
+				g_autoptr(GArray) operations = NULL;
 				g_autoptr(JMessage) reply = NULL;
 				gpointer batch;
 
+				if ((namespace = j_message_get_string(message)) == NULL || (operations = jd_get_kv_operations(message, operation_count, FALSE)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				if (safety == J_SEMANTICS_SAFETY_NETWORK || safety == J_SEMANTICS_SAFETY_STORAGE)
 				{
 					reply = j_message_new_reply(message);
 				}
 
-				namespace = j_message_get_string(message);
 				j_backend_kv_batch_start(jd_kv_backend, namespace, semantics, &batch);
 
-				for (i = 0; i < operation_count; i++)
+				for (i = 0; i < operations->len; i++)
 				{
-					key = j_message_get_string(message);
+					JdKVOperation* operation = &g_array_index(operations, JdKVOperation, i);
 
-					j_backend_kv_delete(jd_kv_backend, batch, key);
+					j_backend_kv_delete(jd_kv_backend, batch, operation->key);
 
 					if (reply != NULL)
 					{
@@ -436,46 +947,52 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 
 				if (reply != NULL)
 				{
-					j_message_send(reply, connection);
+					jd_connection_send(connection, reply);
 				}
 			}
 			break;
 		case J_MESSAGE_KV_GET:
 			{
+				g_autoptr(GArray) operations = NULL;
 				g_autoptr(JMessage) reply = NULL;
 				gpointer batch;
 
+				if ((namespace = j_message_get_string(message)) == NULL || (operations = jd_get_kv_operations(message, operation_count, FALSE)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				reply = j_message_new_reply(message);
-				namespace = j_message_get_string(message);
 				j_backend_kv_batch_start(jd_kv_backend, namespace, semantics, &batch);
 
-				for (i = 0; i < operation_count; i++)
+				for (i = 0; i < operations->len; i++)
 				{
+					JdKVOperation* operation = &g_array_index(operations, JdKVOperation, i);
+					JMessageKVGetReply reply_operation = { 0 };
 					gpointer value;
 					guint32 len;
 
-					key = j_message_get_string(message);
-
-					if (j_backend_kv_get(jd_kv_backend, batch, key, &value, &len))
+					if (j_backend_kv_get(jd_kv_backend, batch, operation->key, &value, &len))
 					{
-						j_message_add_operation(reply, 4 + len);
-						j_message_append_4(reply, &len);
+						reply_operation.length = len;
+
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_KV_GET_REPLY) + len);
+						j_message_append_kv_get_reply(reply, &reply_operation);
 						j_message_append_n(reply, value, len);
 
 						g_free(value);
 					}
 					else
 					{
-						guint32 zero = 0;
-
-						j_message_add_operation(reply, 4);
-						j_message_append_4(reply, &zero);
+						j_message_add_operation(reply, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_KV_GET_REPLY));
+						j_message_append_kv_get_reply(reply, &reply_operation);
 					}
 				}
 
 				j_backend_kv_batch_execute(jd_kv_backend, batch);
 
-				j_message_send(reply, connection);
+				jd_connection_send(connection, reply);
 			}
 			break;
 		case J_MESSAGE_KV_GET_ALL:
@@ -486,8 +1003,13 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				guint32 len;
 				guint32 zero = 0;
 
+				if ((namespace = j_message_get_string(message)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				reply = j_message_new_reply(message);
-				namespace = j_message_get_string(message);
 
 				j_backend_kv_get_all(jd_kv_backend, namespace, &iterator);
 
@@ -506,7 +1028,7 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				j_message_add_operation(reply, 4);
 				j_message_append_4(reply, &zero);
 
-				j_message_send(reply, connection);
+				jd_connection_send(connection, reply);
 			}
 			break;
 		case J_MESSAGE_KV_GET_BY_PREFIX:
@@ -518,9 +1040,13 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				guint32 len;
 				guint32 zero = 0;
 
+				if ((namespace = j_message_get_string(message)) == NULL || (prefix = j_message_get_string(message)) == NULL)
+				{
+					jd_connection_close(connection);
+					break;
+				}
+
 				reply = j_message_new_reply(message);
-				namespace = j_message_get_string(message);
-				prefix = j_message_get_string(message);
 
 				j_backend_kv_get_by_prefix(jd_kv_backend, namespace, prefix, &iterator);
 
@@ -539,7 +1065,7 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				j_message_add_operation(reply, 4);
 				j_message_append_4(reply, &zero);
 
-				j_message_send(reply, connection);
+				jd_connection_send(connection, reply);
 			}
 			break;
 		case J_MESSAGE_DB_SCHEMA_CREATE:
@@ -595,6 +1121,13 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				GError* error = NULL;
 				gpointer batch = NULL;
 				gboolean ret = TRUE;
+				gboolean truncated = FALSE;
+
+				if (operation_count && !j_backend_operation_from_message_static(message, backend_operation.in_param, backend_operation.in_param_count))
+				{
+					jd_connection_close(connection);
+					break;
+				}
 
 				reply = j_message_new_reply(message);
 
@@ -612,11 +1145,6 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 					}
 				}
 
-				if (operation_count)
-				{
-					j_backend_operation_from_message_static(message, backend_operation.in_param, backend_operation.in_param_count);
-				}
-
 				switch (j_semantics_get(semantics, J_SEMANTICS_ATOMICITY))
 				{
 					case J_SEMANTICS_ATOMICITY_BATCH:
@@ -633,9 +1161,11 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 				{
 					backend_operation.out_param[backend_operation.out_param_count - 1].error_ptr = NULL;
 
-					if (i)
+					/* Batches can not be aborted, so the operations decoded before a truncated one are still executed. */
+					if (i && !j_backend_operation_from_message_static(message, backend_operation.in_param, backend_operation.in_param_count))
 					{
-						j_backend_operation_from_message_static(message, backend_operation.in_param, backend_operation.in_param_count);
+						truncated = TRUE;
+						break;
 					}
 
 					switch (j_semantics_get(semantics, J_SEMANTICS_ATOMICITY))
@@ -726,7 +1256,14 @@ jd_handle_message (JMessage* message, GSocketConnection* connection, JMemoryChun
 						g_warn_if_reached();
 				}
 
-				j_message_send(reply, connection);
+				if (truncated)
+				{
+					jd_connection_close(connection);
+				}
+				else
+				{
+					jd_connection_send(connection, reply);
+				}
 			}
 			break;
 		default:
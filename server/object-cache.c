@@ -0,0 +1,353 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <string.h>
+
+#include <julea.h>
+
+#include "server.h"
+
+/**
+ * An open object.
+ *
+ * Idle objects are kept open in a least recently used list, so that messages accessing the same object do not have to open and close it every time.
+ * An object is only used by one worker at a time, because backends are not required to support concurrent accesses to the same handle.
+ */
+struct JdObjectHandle
+{
+	/**
+	 * The namespace and path, see jd_object_cache_key_new().
+	 */
+	GBytes* key;
+
+	/**
+	 * The backend's object.
+	 */
+	gpointer object;
+
+	/**
+	 * Whether the handle is part of the cache.
+	 * Handles that are opened while the cached handle is in use are closed when they are released.
+	 */
+	gboolean cached;
+
+	/**
+	 * Whether the handle is currently used.
+	 */
+	gboolean busy;
+
+	/**
+	 * The link within the least recently used list.
+	 * Only valid if the handle is idle.
+	 */
+	GList link;
+};
+
+static GHashTable* jd_object_cache = NULL;
+static GQueue jd_object_cache_lru = G_QUEUE_INIT;
+static guint32 jd_object_cache_size = 0;
+
+G_LOCK_DEFINE_STATIC(jd_object_cache);
+
+/**
+ * Returns the key of an object.
+ * The namespace and path are separated by a null byte, which can not be part of either, so that different pairs never result in the same key.
+ *
+ * \param namespace A namespace.
+ * \param path      A path.
+ *
+ * \return A new key. Should be freed with g_bytes_unref().
+ */
+static
+GBytes*
+jd_object_cache_key_new (gchar const* namespace, gchar const* path)
+{
+	gchar* key;
+	gsize namespace_length;
+	gsize path_length;
+
+	namespace_length = strlen(namespace);
+	path_length = strlen(path);
+
+	key = g_malloc(namespace_length + 1 + path_length);
+	memcpy(key, namespace, namespace_length);
+	key[namespace_length] = '\0';
+	memcpy(key + namespace_length + 1, path, path_length);
+
+	return g_bytes_new_take(key, namespace_length + 1 + path_length);
+}
+
+static
+void
+jd_object_handle_free (JdObjectHandle* handle)
+{
+	j_backend_object_close(jd_object_backend, handle->object);
+
+	g_bytes_unref(handle->key);
+	g_slice_free(JdObjectHandle, handle);
+}
+
+/**
+ * Removes idle handles from the cache until it is within its size limit.
+ * Must be called with the cache lock held.
+ *
+ * \return A list of evicted handles, which should be freed after releasing the lock.
+ */
+static
+GList*
+jd_object_cache_evict (void)
+{
+	GList* evicted = NULL;
+
+	while (g_hash_table_size(jd_object_cache) > jd_object_cache_size && jd_object_cache_lru.tail != NULL)
+	{
+		JdObjectHandle* handle = jd_object_cache_lru.tail->data;
+
+		g_queue_unlink(&jd_object_cache_lru, &(handle->link));
+		g_hash_table_remove(jd_object_cache, handle->key);
+
+		evicted = g_list_prepend(evicted, handle);
+	}
+
+	return evicted;
+}
+
+static
+void
+jd_object_cache_free_list (GList* handles)
+{
+	for (GList* l = handles; l != NULL; l = l->next)
+	{
+		jd_object_handle_free(l->data);
+	}
+
+	g_list_free(handles);
+}
+
+void
+jd_object_cache_init (guint32 size)
+{
+	jd_object_cache = g_hash_table_new(g_bytes_hash, g_bytes_equal);
+	jd_object_cache_size = size;
+}
+
+void
+jd_object_cache_fini (void)
+{
+	GList* handles;
+
+	G_LOCK(jd_object_cache);
+	jd_object_cache_size = 0;
+	handles = jd_object_cache_evict();
+	G_UNLOCK(jd_object_cache);
+
+	jd_object_cache_free_list(handles);
+
+	g_assert(g_hash_table_size(jd_object_cache) == 0);
+	g_hash_table_destroy(jd_object_cache);
+	jd_object_cache = NULL;
+}
+
+/**
+ * Opens an object, using a cached handle if possible.
+ *
+ * \param namespace A namespace.
+ * \param path      A path.
+ * \param create    Whether to create the object.
+ * \param object    Returns the backend's object.
+ *
+ * \return A handle that has to be released with jd_object_cache_close(), or NULL if the object could not be opened.
+ */
+JdObjectHandle*
+jd_object_cache_open (gchar const* namespace, gchar const* path, gboolean create, gpointer* object)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdObjectHandle* handle;
+	GList* evicted;
+	GBytes* key;
+	gboolean ret;
+
+	key = jd_object_cache_key_new(namespace, path);
+
+	G_LOCK(jd_object_cache);
+
+	handle = g_hash_table_lookup(jd_object_cache, key);
+
+	if (handle != NULL && !handle->busy)
+	{
+		handle->busy = TRUE;
+		g_queue_unlink(&jd_object_cache_lru, &(handle->link));
+
+		G_UNLOCK(jd_object_cache);
+
+		g_bytes_unref(key);
+
+		*object = handle->object;
+
+		return handle;
+	}
+
+	G_UNLOCK(jd_object_cache);
+
+	handle = g_slice_new(JdObjectHandle);
+	handle->key = key;
+	handle->object = NULL;
+	handle->cached = FALSE;
+	handle->busy = TRUE;
+	handle->link.data = handle;
+	handle->link.prev = NULL;
+	handle->link.next = NULL;
+
+	if (create)
+	{
+		ret = j_backend_object_create(jd_object_backend, namespace, path, &(handle->object));
+	}
+	else
+	{
+		ret = j_backend_object_open(jd_object_backend, namespace, path, &(handle->object));
+	}
+
+	if (!ret)
+	{
+		if (handle->object != NULL)
+		{
+			jd_object_handle_free(handle);
+		}
+		else
+		{
+			g_bytes_unref(handle->key);
+			g_slice_free(JdObjectHandle, handle);
+		}
+
+		return NULL;
+	}
+
+	G_LOCK(jd_object_cache);
+
+	/* Another worker might have cached a handle in the meantime. */
+	if (jd_object_cache_size > 0 && !g_hash_table_contains(jd_object_cache, handle->key))
+	{
+		handle->cached = TRUE;
+		g_hash_table_insert(jd_object_cache, handle->key, handle);
+	}
+
+	evicted = jd_object_cache_evict();
+
+	G_UNLOCK(jd_object_cache);
+
+	jd_object_cache_free_list(evicted);
+
+	*object = handle->object;
+
+	return handle;
+}
+
+/**
+ * Releases a handle.
+ * Cached handles stay open, others are closed.
+ *
+ * \param handle A handle.
+ */
+void
+jd_object_cache_close (JdObjectHandle* handle)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GList* evicted;
+
+	G_LOCK(jd_object_cache);
+
+	if (!handle->cached)
+	{
+		G_UNLOCK(jd_object_cache);
+
+		jd_object_handle_free(handle);
+
+		return;
+	}
+
+	handle->busy = FALSE;
+	g_queue_push_head_link(&jd_object_cache_lru, &(handle->link));
+
+	evicted = jd_object_cache_evict();
+
+	G_UNLOCK(jd_object_cache);
+
+	jd_object_cache_free_list(evicted);
+}
+
+/**
+ * Deletes an object and releases its handle.
+ * Other handles for the same object are removed from the cache.
+ *
+ * \param handle A handle.
+ *
+ * \return TRUE on success, FALSE otherwise.
+ */
+gboolean
+jd_object_cache_delete (JdObjectHandle* handle)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdObjectHandle* cached_handle;
+	gboolean ret;
+
+	G_LOCK(jd_object_cache);
+
+	cached_handle = g_hash_table_lookup(jd_object_cache, handle->key);
+
+	if (cached_handle != NULL)
+	{
+		g_hash_table_remove(jd_object_cache, cached_handle->key);
+
+		if (cached_handle == handle)
+		{
+			cached_handle = NULL;
+		}
+		else if (cached_handle->busy)
+		{
+			/* The handle is closed by its current user. */
+			cached_handle->cached = FALSE;
+			cached_handle = NULL;
+		}
+		else
+		{
+			g_queue_unlink(&jd_object_cache_lru, &(cached_handle->link));
+		}
+	}
+
+	G_UNLOCK(jd_object_cache);
+
+	if (cached_handle != NULL)
+	{
+		jd_object_handle_free(cached_handle);
+	}
+
+	/* Deleting an object also closes it. */
+	ret = j_backend_object_delete(jd_object_backend, handle->object);
+
+	g_bytes_unref(handle->key);
+	g_slice_free(JdObjectHandle, handle);
+
+	return ret;
+}
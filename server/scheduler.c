@@ -0,0 +1,256 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <julea.h>
+
+#include "server.h"
+
+/**
+ * Requests are scheduled according to their class.
+ * Metadata requests are handled immediately by the worker that received them.
+ * Bulk requests may only occupy a limited number of workers, so that a share of the workers is always available for metadata.
+ * If the limit is reached, they are queued and handled by the next worker finishing a bulk request.
+ */
+enum JdRequestClass
+{
+	/**
+	 * Small operations, such as key-value and database accesses.
+	 */
+	JD_REQUEST_CLASS_METADATA,
+	/**
+	 * Object data that a client is waiting for.
+	 */
+	JD_REQUEST_CLASS_BULK,
+	/**
+	 * Object data that no client is waiting for, because the message's safety is J_SEMANTICS_SAFETY_NONE.
+	 */
+	JD_REQUEST_CLASS_BACKGROUND
+};
+
+typedef enum JdRequestClass JdRequestClass;
+
+/**
+ * Every n-th queued bulk request is taken from the background queue, so that it is not starved.
+ */
+#define JD_SCHEDULER_BACKGROUND_INTERVAL 4
+
+G_LOCK_DEFINE_STATIC(jd_scheduler);
+
+static GQueue jd_scheduler_bulk = G_QUEUE_INIT;
+static GQueue jd_scheduler_background = G_QUEUE_INIT;
+
+static guint jd_scheduler_bulk_running = 0;
+static guint jd_scheduler_bulk_limit = 0;
+static guint jd_scheduler_bulk_picks = 0;
+
+/**
+ * Creates a new request.
+ *
+ * \param connection A connection.
+ * \param message    A received message.
+ * \param ready_time The time the connection became readable.
+ *
+ * \return A new request. Should be freed with jd_request_free().
+ */
+JdRequest*
+jd_request_new (JdConnection* connection, JMessage* message, gint64 ready_time)
+{
+	JdRequest* request;
+
+	request = g_slice_new(JdRequest);
+	request->connection = connection;
+	request->message = j_message_ref(message);
+	request->ready_time = ready_time;
+	request->armed = FALSE;
+	request->bulk = FALSE;
+
+	return request;
+}
+
+void
+jd_request_free (JdRequest* request)
+{
+	j_message_unref(request->message);
+
+	g_slice_free(JdRequest, request);
+}
+
+static
+JdRequestClass
+jd_request_get_class (JdRequest* request)
+{
+	g_autoptr(JSemantics) semantics = NULL;
+
+	switch (j_message_get_type(request->message))
+	{
+		case J_MESSAGE_OBJECT_READ:
+		case J_MESSAGE_OBJECT_WRITE:
+			break;
+		case J_MESSAGE_NONE:
+		case J_MESSAGE_PING:
+		case J_MESSAGE_STATISTICS:
+		case J_MESSAGE_OBJECT_CREATE:
+		case J_MESSAGE_OBJECT_DELETE:
+		case J_MESSAGE_OBJECT_STATUS:
+		case J_MESSAGE_KV_PUT:
+		case J_MESSAGE_KV_DELETE:
+		case J_MESSAGE_KV_GET:
+		case J_MESSAGE_KV_GET_ALL:
+		case J_MESSAGE_KV_GET_BY_PREFIX:
+		case J_MESSAGE_DB_SCHEMA_CREATE:
+		case J_MESSAGE_DB_SCHEMA_GET:
+		case J_MESSAGE_DB_SCHEMA_DELETE:
+		case J_MESSAGE_DB_INSERT:
+		case J_MESSAGE_DB_UPDATE:
+		case J_MESSAGE_DB_DELETE:
+		case J_MESSAGE_DB_QUERY:
+		default:
+			return JD_REQUEST_CLASS_METADATA;
+	}
+
+	semantics = j_message_get_semantics(request->message);
+
+	if (j_semantics_get(semantics, J_SEMANTICS_SAFETY) == J_SEMANTICS_SAFETY_NONE)
+	{
+		return JD_REQUEST_CLASS_BACKGROUND;
+	}
+
+	return JD_REQUEST_CLASS_BULK;
+}
+
+/**
+ * Initializes the scheduler.
+ *
+ * \param threads        The number of workers.
+ * \param metadata_share The percentage of workers reserved for metadata requests, from 0 (none) to 100 (all but one).
+ */
+void
+jd_scheduler_init (guint32 threads, guint32 metadata_share)
+{
+	jd_scheduler_bulk_limit = threads - (threads * MIN(metadata_share, 100) / 100);
+	jd_scheduler_bulk_limit = MAX(jd_scheduler_bulk_limit, 1);
+}
+
+/**
+ * Returns the number of workers that may handle bulk requests at the same time.
+ *
+ * \return The number of workers.
+ */
+guint
+jd_scheduler_get_bulk_limit (void)
+{
+	return jd_scheduler_bulk_limit;
+}
+
+void
+jd_scheduler_fini (void)
+{
+	g_assert(g_queue_is_empty(&jd_scheduler_bulk));
+	g_assert(g_queue_is_empty(&jd_scheduler_background));
+}
+
+/**
+ * Submits a request.
+ *
+ * \param request A request.
+ *
+ * \return The request if it should be handled now, NULL if it has been queued.
+ */
+JdRequest*
+jd_scheduler_submit (JdRequest* request)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdRequestClass request_class;
+
+	request_class = jd_request_get_class(request);
+	request->bulk = (request_class != JD_REQUEST_CLASS_METADATA);
+
+	if (!request->bulk)
+	{
+		return request;
+	}
+
+	G_LOCK(jd_scheduler);
+
+	if (jd_scheduler_bulk_running < jd_scheduler_bulk_limit)
+	{
+		jd_scheduler_bulk_running++;
+	}
+	else
+	{
+		g_queue_push_tail((request_class == JD_REQUEST_CLASS_BULK) ? &jd_scheduler_bulk : &jd_scheduler_background, request);
+		request = NULL;
+	}
+
+	G_UNLOCK(jd_scheduler);
+
+	return request;
+}
+
+/**
+ * Completes a request and frees it.
+ *
+ * \param request A request.
+ *
+ * \return The next request the calling worker should handle, or NULL.
+ */
+JdRequest*
+jd_scheduler_complete (JdRequest* request)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdRequest* next = NULL;
+	gboolean bulk;
+
+	bulk = request->bulk;
+	jd_request_free(request);
+
+	if (!bulk)
+	{
+		return NULL;
+	}
+
+	G_LOCK(jd_scheduler);
+
+	/* The worker keeps its bulk slot if there is another queued request. */
+	jd_scheduler_bulk_picks++;
+
+	if (jd_scheduler_bulk_picks % JD_SCHEDULER_BACKGROUND_INTERVAL == 0 || g_queue_is_empty(&jd_scheduler_bulk))
+	{
+		next = g_queue_pop_head(&jd_scheduler_background);
+	}
+
+	if (next == NULL)
+	{
+		next = g_queue_pop_head(&jd_scheduler_bulk);
+	}
+
+	if (next == NULL)
+	{
+		jd_scheduler_bulk_running--;
+	}
+
+	G_UNLOCK(jd_scheduler);
+
+	return next;
+}
@@ -25,7 +25,12 @@
 #include <gio/gio.h>
 #include <gmodule.h>
 
+#include <errno.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <julea.h>
 
@@ -47,59 +52,608 @@ jd_signal (gpointer data)
 	return FALSE;
 }
 
-static
+/**
+ * The number of seconds a worker waits for a client while transferring data, so that stalled clients can not occupy workers indefinitely.
+ */
+#define JD_CONNECTION_TIMEOUT 60
+
+static GThreadPool* jd_thread_pool = NULL;
+static GThread* jd_epoll_thread = NULL;
+
+static gint jd_epoll_fd = -1;
+static gint jd_epoll_wakeup_fd = -1;
+
+static guint64 jd_memory_chunk_size = 0;
+static GPrivate jd_memory_chunk = G_PRIVATE_INIT((GDestroyNotify)j_memory_chunk_free);
+
+static gint jd_numa_workers = 0;
+static GPrivate jd_numa_bound = G_PRIVATE_INIT(NULL);
+
+/**
+ * The open connections, used to release those still registered when the server stops.
+ */
+static GHashTable* jd_connections = NULL;
+static GMutex jd_connections_mutex[1];
+
+JdConnection*
+jd_connection_ref (JdConnection* connection)
+{
+	g_atomic_int_inc(&(connection->ref_count));
+
+	return connection;
+}
+
+void
+jd_connection_unref (JdConnection* connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	if (!g_atomic_int_dec_and_test(&(connection->ref_count)))
+	{
+		return;
+	}
+
+	g_mutex_lock(jd_connections_mutex);
+	g_hash_table_remove(jd_connections, connection);
+	g_mutex_unlock(jd_connections_mutex);
+
+	jd_statistics_remove_connection(connection);
+
+	/* A request waiting for io_uring to stop receiving is discarded when the server stops. */
+	if (connection->held != NULL)
+	{
+		jd_request_free(connection->held);
+	}
+
+	if (connection->received != NULL)
+	{
+		g_byte_array_unref(connection->received);
+	}
+
+	j_message_reader_free(connection->reader);
+	j_statistics_free(connection->statistics);
+	g_mutex_clear(connection->send_mutex);
+	g_object_unref(connection->connection);
+
+	g_slice_free(JdConnection, connection);
+}
+
+/**
+ * Creates a connection and registers it, so that it is released when the server stops.
+ *
+ * \param connection A connection.
+ *
+ * \return A new connection, which is referenced by the event loop. Should be released with jd_connection_unref().
+ */
+JdConnection*
+jd_connection_new (GSocketConnection* connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdConnection* jd_connection;
+
+	j_helper_set_nodelay(connection, TRUE);
+
+	/* Messages are read without blocking, but the data following them and replies are transferred blocking. */
+	g_socket_set_timeout(g_socket_connection_get_socket(connection), JD_CONNECTION_TIMEOUT);
+
+	jd_connection = g_slice_new(JdConnection);
+	jd_connection->connection = g_object_ref(connection);
+	jd_connection->fd = g_socket_get_fd(g_socket_connection_get_socket(connection));
+	jd_connection->reader = j_message_reader_new(connection);
+	jd_connection->statistics = j_statistics_new(TRUE);
+	jd_connection->ready_time = 0;
+	jd_connection->received = NULL;
+	jd_connection->held = NULL;
+	jd_connection->receiving = FALSE;
+	jd_connection->busy = FALSE;
+	jd_connection->closed = FALSE;
+	jd_connection->ref_count = 1;
+	g_mutex_init(jd_connection->send_mutex);
+
+	g_mutex_lock(jd_connections_mutex);
+	g_hash_table_add(jd_connections, jd_connection);
+	g_mutex_unlock(jd_connections_mutex);
+
+	jd_statistics_add_connection(jd_connection);
+
+	return jd_connection;
+}
+
+/**
+ * Receives data following a message.
+ * Data that io_uring has already received together with the message is consumed first.
+ *
+ * \param connection A connection.
+ * \param data       A buffer.
+ * \param length     The number of bytes to receive.
+ *
+ * \return TRUE on success, FALSE if the data could not be received completely.
+ */
+gboolean
+jd_connection_receive (JdConnection* connection, gpointer data, gsize length)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GInputStream* input;
+	gsize nread = 0;
+
+	if (connection->received != NULL && connection->received->len > 0)
+	{
+		nread = MIN(length, connection->received->len);
+
+		memcpy(data, connection->received->data, nread);
+		g_byte_array_remove_range(connection->received, 0, nread);
+
+		if (nread == length)
+		{
+			return TRUE;
+		}
+
+		data = (gchar*)data + nread;
+		length -= nread;
+		nread = 0;
+	}
+
+	input = g_io_stream_get_input_stream(G_IO_STREAM(connection->connection));
+
+	return (g_input_stream_read_all(input, data, length, &nread, NULL, NULL) && nread == length);
+}
+
+/**
+ * Closes a connection that can not be used anymore, for example because a reply could only be sent partially.
+ * The connection is only shut down, it is removed once receiving the next message from it fails.
+ */
+void
+jd_connection_close (JdConnection* connection)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	shutdown(connection->fd, SHUT_RDWR);
+}
+
+/**
+ * Sends a reply.
+ * If the reply could not be sent, the connection is closed, the client would otherwise interpret the remainder of the reply as the next one.
+ */
 gboolean
-jd_on_run (GThreadedSocketService* service, GSocketConnection* connection, GObject* source_object, gpointer user_data)
+jd_connection_send (JdConnection* connection, JMessage* message)
 {
 	J_TRACE_FUNCTION(NULL);
 
+	gboolean ret;
+
+	g_mutex_lock(connection->send_mutex);
+	ret = jd_connection_send_locked(connection, message);
+	g_mutex_unlock(connection->send_mutex);
+
+	return ret;
+}
+
+/**
+ * Sends a reply, like jd_connection_send().
+ * Must be called with the connection's send mutex held, so that additional data can be sent after the reply.
+ */
+gboolean
+jd_connection_send_locked (JdConnection* connection, JMessage* message)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	gboolean ret;
+	gint64 start;
+
+	start = g_get_monotonic_time();
+	ret = j_message_send(message, connection->connection);
+	jd_statistics_send_add(g_get_monotonic_time() - start);
+
+	if (!ret)
+	{
+		jd_connection_close(connection);
+	}
+
+	return ret;
+}
+
+/**
+ * Sends additional data following a reply sent with jd_connection_send_locked().
+ * Must be called with the connection's send mutex held.
+ */
+gboolean
+jd_connection_write_locked (JdConnection* connection, gconstpointer data, gsize length)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	GOutputStream* output;
+	gboolean ret;
+	gint64 start;
+
+	output = g_io_stream_get_output_stream(G_IO_STREAM(connection->connection));
+
+	start = g_get_monotonic_time();
+	ret = g_output_stream_write_all(output, data, length, NULL, NULL, NULL);
+	jd_statistics_send_add(g_get_monotonic_time() - start);
+
+	if (!ret)
+	{
+		jd_connection_close(connection);
+	}
+
+	return ret;
+}
+
+/**
+ * Returns the calling worker's memory chunk.
+ * Memory chunks are only needed while a message is being handled, so there is one per worker instead of one per connection.
+ */
+static
+JMemoryChunk*
+jd_get_memory_chunk (void)
+{
 	JMemoryChunk* memory_chunk;
+
+	memory_chunk = g_private_get(&jd_memory_chunk);
+
+	if (G_UNLIKELY(memory_chunk == NULL))
+	{
+		memory_chunk = j_memory_chunk_new(jd_memory_chunk_size);
+		g_private_set(&jd_memory_chunk, memory_chunk);
+	}
+
+	return memory_chunk;
+}
+
+/**
+ * Binds the calling thread to one of the configured NUMA nodes, threads are distributed round-robin.
+ * Memory is placed on the node of the thread touching it first, so this has to happen before the thread's buffers are used.
+ */
+static
+void
+jd_numa_bind (void)
+{
+	guint32 count;
+	guint32 node;
+
+	count = j_configuration_get_numa_node_count(jd_configuration);
+
+	if (count == 0 || g_private_get(&jd_numa_bound) != NULL)
+	{
+		return;
+	}
+
+	g_private_set(&jd_numa_bound, GINT_TO_POINTER(TRUE));
+
+	node = j_configuration_get_numa_node(jd_configuration, (guint)g_atomic_int_add(&jd_numa_workers, 1) % count);
+
+	if (!j_helper_numa_bind(node))
+	{
+		g_warning("Could not bind thread to NUMA node %u.", node);
+	}
+}
+
+static
+gboolean
+jd_epoll_arm (JdConnection* connection, gint op)
+{
+	struct epoll_event event;
+
+	/* EPOLLONESHOT makes sure that only one worker at a time handles a connection. */
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = connection;
+
+	return (epoll_ctl(jd_epoll_fd, op, connection->fd, &event) == 0);
+}
+
+/**
+ * Checks whether a message has to be handled before the next message of the same connection can be read.
+ * This is the case for writes, whose data follows the message on the connection, and for messages without a reply, which clients do not wait for.
+ * Pings might also be followed by a shared memory segment, see j_message_offer_shared_memory().
+ */
+gboolean
+jd_message_is_ordered (JMessage* message)
+{
+	g_autoptr(JSemantics) semantics = NULL;
+	JMessageType type;
+
+	type = j_message_get_type(message);
+
+	if (type == J_MESSAGE_OBJECT_WRITE || type == J_MESSAGE_PING)
+	{
+		return TRUE;
+	}
+
+	semantics = j_message_get_semantics(message);
+
+	return (j_semantics_get(semantics, J_SEMANTICS_SAFETY) == J_SEMANTICS_SAFETY_NONE);
+}
+
+/**
+ * Handles a request and re-arms or closes its connection.
+ */
+static
+void
+jd_handle_request (JdRequest* request)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdConnection* connection = request->connection;
+	JMessageType type;
+	gint64 start;
+	gint64 send_time;
+
+	type = j_message_get_type(request->message);
+	start = g_get_monotonic_time();
+
+	/* The queue phase includes the time the request was queued by the scheduler. */
+	jd_statistics_record(type, JD_STATISTICS_PHASE_QUEUE, start - request->ready_time);
+	jd_statistics_send_reset();
+
+	jd_handle_message(request->message, connection, jd_get_memory_chunk(), jd_memory_chunk_size);
+
+	send_time = jd_statistics_send_get();
+	jd_statistics_record(type, JD_STATISTICS_PHASE_BACKEND, g_get_monotonic_time() - start - send_time);
+	jd_statistics_record(type, JD_STATISTICS_PHASE_SEND, send_time);
+
+	if (request->armed)
+	{
+		jd_connection_unref(connection);
+	}
+	else if (connection->received != NULL)
+	{
+		jd_io_uring_resume(connection);
+	}
+	else if (!jd_epoll_arm(connection, EPOLL_CTL_MOD))
+	{
+		epoll_ctl(jd_epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+		jd_connection_unref(connection);
+	}
+}
+
+/**
+ * Submits a request to the scheduler and handles it if a worker of its class is available.
+ * Must be called by a worker.
+ */
+void
+jd_dispatch_request (JdRequest* request)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	jd_numa_bind();
+
+	/* Queued requests are handled by workers finishing other requests of the same class. */
+	for (request = jd_scheduler_submit(request); request != NULL; request = jd_scheduler_complete(request))
+	{
+		jd_handle_request(request);
+	}
+}
+
+static
+void
+jd_on_message (gpointer data, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdConnection* connection = data;
 	g_autoptr(JMessage) message = NULL;
-	JStatistics* statistics;
-	guint64 memory_chunk_size;
+	JdRequest* request;
+	gint64 ready_time;
 
-	(void)service;
-	(void)source_object;
 	(void)user_data;
 
-	j_helper_set_nodelay(connection, TRUE);
+	jd_numa_bind();
 
-	statistics = j_statistics_new(TRUE);
-	memory_chunk_size = j_configuration_get_max_operation_size(jd_configuration);
-	memory_chunk = j_memory_chunk_new(memory_chunk_size);
+	/* The ready time has to be read before re-arming, the epoll thread might overwrite it afterwards. */
+	ready_time = connection->ready_time;
 
-	message = j_message_new(J_MESSAGE_NONE, 0);
+	if (!j_message_reader_read(connection->reader, &message))
+	{
+		epoll_ctl(jd_epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+		jd_connection_unref(connection);
+		return;
+	}
 
-	while (j_message_receive(message, connection))
+	if (message == NULL)
 	{
-		jd_handle_message(message, connection, memory_chunk, memory_chunk_size, statistics);
+		/* Only part of the message has arrived, the reader keeps it until the connection becomes readable again. */
+		if (!jd_epoll_arm(connection, EPOLL_CTL_MOD))
+		{
+			epoll_ctl(jd_epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+			jd_connection_unref(connection);
+		}
+
+		return;
 	}
 
+	request = jd_request_new(connection, message, ready_time);
+
+	if (!jd_message_is_ordered(message))
 	{
-		guint64 value;
+		/* Let other workers read the following messages while this one is handled. */
+		jd_connection_ref(connection);
 
-		g_mutex_lock(jd_statistics_mutex);
+		if (jd_epoll_arm(connection, EPOLL_CTL_MOD))
+		{
+			request->armed = TRUE;
+		}
+		else
+		{
+			jd_connection_unref(connection);
+		}
+	}
+
+	jd_dispatch_request(request);
+}
+
+static
+gpointer
+jd_epoll_loop (gpointer data)
+{
+	struct epoll_event events[64];
+
+	(void)data;
+
+	jd_numa_bind();
+
+	while (TRUE)
+	{
+		gint nevents;
 
-		value = j_statistics_get(statistics, J_STATISTICS_FILES_CREATED);
-		j_statistics_add(jd_statistics, J_STATISTICS_FILES_CREATED, value);
-		value = j_statistics_get(statistics, J_STATISTICS_FILES_DELETED);
-		j_statistics_add(jd_statistics, J_STATISTICS_FILES_DELETED, value);
-		value = j_statistics_get(statistics, J_STATISTICS_SYNC);
-		j_statistics_add(jd_statistics, J_STATISTICS_SYNC, value);
-		value = j_statistics_get(statistics, J_STATISTICS_BYTES_READ);
-		j_statistics_add(jd_statistics, J_STATISTICS_BYTES_READ, value);
-		value = j_statistics_get(statistics, J_STATISTICS_BYTES_WRITTEN);
-		j_statistics_add(jd_statistics, J_STATISTICS_BYTES_WRITTEN, value);
-		value = j_statistics_get(statistics, J_STATISTICS_BYTES_RECEIVED);
-		j_statistics_add(jd_statistics, J_STATISTICS_BYTES_RECEIVED, value);
-		value = j_statistics_get(statistics, J_STATISTICS_BYTES_SENT);
-		j_statistics_add(jd_statistics, J_STATISTICS_BYTES_SENT, value);
+		nevents = epoll_wait(jd_epoll_fd, events, G_N_ELEMENTS(events), -1);
 
-		g_mutex_unlock(jd_statistics_mutex);
+		if (nevents == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			g_critical("epoll_wait failed: %s", g_strerror(errno));
+			break;
+		}
+
+		for (gint i = 0; i < nevents; i++)
+		{
+			JdConnection* connection;
+
+			if (events[i].data.ptr == NULL)
+			{
+				/* The wakeup descriptor has been triggered by jd_epoll_stop(). */
+				return NULL;
+			}
+
+			connection = events[i].data.ptr;
+			connection->ready_time = g_get_monotonic_time();
+
+			g_thread_pool_push(jd_thread_pool, connection, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+static
+gboolean
+jd_epoll_start (guint32 threads)
+{
+	struct epoll_event event;
+
+	jd_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	jd_epoll_wakeup_fd = eventfd(0, EFD_CLOEXEC);
+
+	if (jd_epoll_fd == -1 || jd_epoll_wakeup_fd == -1)
+	{
+		return FALSE;
+	}
+
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+
+	if (epoll_ctl(jd_epoll_fd, EPOLL_CTL_ADD, jd_epoll_wakeup_fd, &event) == -1)
+	{
+		return FALSE;
 	}
 
-	j_memory_chunk_free(memory_chunk);
-	j_statistics_free(statistics);
+	jd_connections = g_hash_table_new(NULL, NULL);
+
+	jd_thread_pool = g_thread_pool_new(jd_on_message, NULL, threads, TRUE, NULL);
+	jd_epoll_thread = g_thread_new("julea-server-epoll", jd_epoll_loop, NULL);
+
+	return (jd_thread_pool != NULL && jd_io_uring_start(threads));
+}
+
+/**
+ * Stops the event loops and releases all connections.
+ * Once the workers have finished, every open connection is only referenced by the event loop driving it.
+ */
+static
+void
+jd_epoll_stop (void)
+{
+	GHashTableIter iter;
+	gpointer key;
+	g_autoptr(GPtrArray) connections = NULL;
+	guint64 value = 1;
+
+	if (jd_epoll_thread != NULL)
+	{
+		if (write(jd_epoll_wakeup_fd, &value, sizeof(value)) == sizeof(value))
+		{
+			g_thread_join(jd_epoll_thread);
+		}
+
+		jd_epoll_thread = NULL;
+	}
+
+	jd_io_uring_stop();
+
+	if (jd_thread_pool != NULL)
+	{
+		g_thread_pool_free(jd_thread_pool, FALSE, TRUE);
+		jd_thread_pool = NULL;
+	}
+
+	if (jd_connections != NULL)
+	{
+		connections = g_ptr_array_new();
+
+		/* The connections are collected first, releasing them removes them from the table. */
+		g_mutex_lock(jd_connections_mutex);
+		g_hash_table_iter_init(&iter, jd_connections);
+
+		while (g_hash_table_iter_next(&iter, &key, NULL))
+		{
+			g_ptr_array_add(connections, key);
+		}
+
+		g_hash_table_remove_all(jd_connections);
+		g_mutex_unlock(jd_connections_mutex);
+
+		for (guint i = 0; i < connections->len; i++)
+		{
+			JdConnection* connection = g_ptr_array_index(connections, i);
+
+			epoll_ctl(jd_epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+			jd_connection_close(connection);
+			jd_connection_unref(connection);
+		}
+
+		g_hash_table_unref(jd_connections);
+		jd_connections = NULL;
+	}
+
+	jd_io_uring_fini();
+
+	if (jd_epoll_wakeup_fd != -1)
+	{
+		close(jd_epoll_wakeup_fd);
+		jd_epoll_wakeup_fd = -1;
+	}
+
+	if (jd_epoll_fd != -1)
+	{
+		close(jd_epoll_fd);
+		jd_epoll_fd = -1;
+	}
+}
+
+static
+gboolean
+jd_on_incoming (GSocketService* service, GSocketConnection* connection, GObject* source_object, gpointer user_data)
+{
+	J_TRACE_FUNCTION(NULL);
+
+	JdConnection* jd_connection;
+
+	(void)service;
+	(void)source_object;
+	(void)user_data;
+
+	jd_connection = jd_connection_new(connection);
+
+	if (!jd_epoll_arm(jd_connection, EPOLL_CTL_ADD))
+	{
+		g_warning("Could not register connection: %s", g_strerror(errno));
+		jd_connection_unref(jd_connection);
+	}
 
 	return TRUE;
 }
@@ -157,7 +711,7 @@ int
 main (int argc, char** argv)
 {
 	gboolean opt_daemon = FALSE;
-	gint opt_port = 4711;
+	gint opt_port = 0;
 
 	JTrace* trace;
 	GError* error = NULL;
@@ -167,6 +721,7 @@ main (int argc, char** argv)
 	GModule* db_module = NULL;
 	g_autoptr(GOptionContext) context = NULL;
 	g_autoptr(GSocketService) socket_service = NULL;
+	g_autoptr(GSocketAddress) local_address = NULL;
 	gchar const* object_backend;
 	gchar const* object_component;
 	g_autofree gchar* object_path = NULL;
@@ -180,7 +735,7 @@ main (int argc, char** argv)
 
 	GOptionEntry entries[] = {
 		{ "daemon", 0, 0, G_OPTION_ARG_NONE, &opt_daemon, "Run as daemon", NULL },
-		{ "port", 0, 0, G_OPTION_ARG_INT, &opt_port, "Port to use", "4711" },
+		{ "port", 0, 0, G_OPTION_ARG_INT, &opt_port, "Port to use, overrides the configuration", "4711" },
 		{ NULL, 0, 0, 0, NULL, NULL, NULL }
 	};
 
@@ -205,11 +760,30 @@ main (int argc, char** argv)
 		return 1;
 	}
 
-	socket_service = g_threaded_socket_service_new(-1);
+	j_trace_init("julea-server");
+
+	trace = j_trace_enter(G_STRFUNC, NULL);
+
+	jd_configuration = j_configuration_new();
+
+	if (jd_configuration == NULL)
+	{
+		g_printerr("Could not read configuration.\n");
+		return 1;
+	}
+
+	if (opt_port == 0)
+	{
+		opt_port = j_configuration_get_port(jd_configuration);
+	}
+
+	socket_service = g_socket_service_new();
 
 	g_socket_listener_set_backlog(G_SOCKET_LISTENER(socket_service), 128);
 
-	if (!g_socket_listener_add_inet_port(G_SOCKET_LISTENER(socket_service), opt_port, NULL, &error))
+	/* With io_uring, TCP connections are accepted by the io_uring thread, so only local ones are left to the socket service. */
+	if (!(j_configuration_get_io_uring(jd_configuration) && jd_io_uring_init(opt_port))
+	    && !g_socket_listener_add_inet_port(G_SOCKET_LISTENER(socket_service), opt_port, NULL, &error))
 	{
 		if (error != NULL)
 		{
@@ -220,16 +794,13 @@ main (int argc, char** argv)
 		return 1;
 	}
 
-	j_trace_init("julea-server");
-
-	trace = j_trace_enter(G_STRFUNC, NULL);
-
-	jd_configuration = j_configuration_new();
+	local_address = j_helper_get_local_address(opt_port);
 
-	if (jd_configuration == NULL)
+	/* Clients on the same node connect locally, which allows them to share memory with the server. */
+	if (!g_socket_listener_add_address(G_SOCKET_LISTENER(socket_service), local_address, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error))
 	{
-		g_printerr("Could not read configuration.\n");
-		return 1;
+		/* Local clients fall back to TCP. */
+		g_clear_error(&error);
 	}
 
 	port_str = g_strdup_printf("%d", opt_port);
@@ -273,11 +844,28 @@ main (int argc, char** argv)
 		}
 	}
 
-	jd_statistics = j_statistics_new(FALSE);
-	g_mutex_init(jd_statistics_mutex);
+	jd_statistics_init();
+	jd_scheduler_init(j_configuration_get_server_threads(jd_configuration), j_configuration_get_metadata_share(jd_configuration));
+
+	if (jd_object_backend != NULL)
+	{
+		jd_object_cache_init(j_configuration_get_object_cache_size(jd_configuration));
+		/* Only the scheduler's limit of object writes can run at the same time, waiting for more of them would always run into the window. */
+		jd_group_commit_init(jd_scheduler_get_bulk_limit(), j_configuration_get_group_commit_window(jd_configuration));
+	}
+
+	jd_memory_chunk_size = j_configuration_get_max_operation_size(jd_configuration);
+	jd_splice_writes = j_configuration_get_splice_writes(jd_configuration);
+	jd_compression_threshold = j_configuration_get_compression_threshold(jd_configuration);
 
+	if (!jd_epoll_start(j_configuration_get_server_threads(jd_configuration)))
+	{
+		g_critical("Could not start event loop.");
+		return 1;
+	}
+
+	g_signal_connect(socket_service, "incoming", G_CALLBACK(jd_on_incoming), NULL);
 	g_socket_service_start(socket_service);
-	g_signal_connect(socket_service, "run", G_CALLBACK(jd_on_run), NULL);
 
 	main_loop = g_main_loop_new(NULL, FALSE);
 
@@ -289,8 +877,16 @@ main (int argc, char** argv)
 
 	g_socket_service_stop(socket_service);
 
-	g_mutex_clear(jd_statistics_mutex);
-	j_statistics_free(jd_statistics);
+	jd_epoll_stop();
+	jd_scheduler_fini();
+
+	if (jd_object_backend != NULL)
+	{
+		jd_group_commit_fini();
+		jd_object_cache_fini();
+	}
+
+	jd_statistics_fini();
 
 	if (jd_db_backend != NULL)
 	{
@@ -27,13 +27,192 @@
 #include <jmessage.h>
 #include <jstatistics.h>
 
+struct JdRequest;
+
+typedef struct JdRequest JdRequest;
+
+/**
+ * A client connection.
+ * Connections are registered with the epoll instance and handed to the worker pool whenever they become readable.
+ * While one worker handles a message, the connection might already be re-armed, so multiple messages can be in flight.
+ * If io_uring is enabled, TCP connections are driven by the io_uring thread instead, which receives their messages and hands them to the workers, see io-uring.c.
+ */
+struct JdConnection
+{
+	GSocketConnection* connection;
+	gint fd;
+
+	/**
+	 * Keeps a partially received message until the rest of it arrives.
+	 * Only used by the worker the connection has been handed to.
+	 */
+	JMessageReader* reader;
+
+	/**
+	 * Protects the output stream, replies of concurrent messages must not be interleaved.
+	 */
+	GMutex send_mutex[1];
+
+	JStatistics* statistics;
+
+	/**
+	 * The time the connection became readable, used to measure how long messages wait for a worker.
+	 */
+	gint64 ready_time;
+
+	/**
+	 * The data that has been received by io_uring but not consumed yet, NULL if the connection is watched using epoll.
+	 * While a worker handles a message whose data follows it, the worker owns this and consumes the data from it, see jd_connection_receive().
+	 */
+	GByteArray* received;
+
+	/**
+	 * A received message that has to be handled before the next one can be read, see jd_message_is_ordered().
+	 * It is held back until io_uring has stopped receiving, the worker would otherwise have to compete with it for the data.
+	 */
+	JdRequest* held;
+
+	/**
+	 * Whether a multishot receive is in flight.
+	 * Only used by the io_uring thread, like #busy and #closed.
+	 */
+	gboolean receiving;
+
+	/**
+	 * Whether a worker handles a message whose data follows it.
+	 */
+	gboolean busy;
+
+	/**
+	 * Whether the other side has closed the connection or receiving has failed.
+	 */
+	gboolean closed;
+
+	gint ref_count;
+};
+
+typedef struct JdConnection JdConnection;
+
+struct JdObjectHandle;
+
+typedef struct JdObjectHandle JdObjectHandle;
+
+/**
+ * A received message waiting to be handled.
+ */
+struct JdRequest
+{
+	JdConnection* connection;
+	JMessage* message;
+
+	/**
+	 * The time the connection became readable.
+	 */
+	gint64 ready_time;
+
+	/**
+	 * Whether the connection has been re-armed after receiving the message.
+	 */
+	gboolean armed;
+
+	/**
+	 * Whether the request occupies one of the workers available for bulk requests.
+	 */
+	gboolean bulk;
+};
+
+/**
+ * The phases of handling a message, latencies are recorded separately for each of them.
+ */
+enum JdStatisticsPhase
+{
+	/**
+	 * The time between a connection becoming readable and a worker receiving its message.
+	 */
+	JD_STATISTICS_PHASE_QUEUE,
+	/**
+	 * The time spent handling the message, excluding sending replies.
+	 */
+	JD_STATISTICS_PHASE_BACKEND,
+	/**
+	 * The time spent sending replies.
+	 */
+	JD_STATISTICS_PHASE_SEND,
+	JD_STATISTICS_PHASE_COUNT
+};
+
+typedef enum JdStatisticsPhase JdStatisticsPhase;
+
+/**
+ * The number of buckets per latency histogram.
+ */
+#define JD_STATISTICS_BUCKET_COUNT 32
+
 G_GNUC_INTERNAL JStatistics* jd_statistics;
 G_GNUC_INTERNAL GMutex jd_statistics_mutex[1];
 
+G_GNUC_INTERNAL gboolean jd_splice_writes;
+G_GNUC_INTERNAL guint32 jd_compression_threshold;
+
 G_GNUC_INTERNAL JBackend* jd_object_backend;
 G_GNUC_INTERNAL JBackend* jd_kv_backend;
 G_GNUC_INTERNAL JBackend* jd_db_backend;
 
-G_GNUC_INTERNAL gboolean jd_handle_message (JMessage*, GSocketConnection*, JMemoryChunk*, guint64, JStatistics*);
+G_GNUC_INTERNAL JdConnection* jd_connection_new (GSocketConnection*);
+G_GNUC_INTERNAL JdConnection* jd_connection_ref (JdConnection*);
+G_GNUC_INTERNAL void jd_connection_unref (JdConnection*);
+G_GNUC_INTERNAL gboolean jd_connection_receive (JdConnection*, gpointer, gsize);
+G_GNUC_INTERNAL void jd_connection_close (JdConnection*);
+G_GNUC_INTERNAL gboolean jd_connection_send (JdConnection*, JMessage*);
+G_GNUC_INTERNAL gboolean jd_connection_send_locked (JdConnection*, JMessage*);
+G_GNUC_INTERNAL gboolean jd_connection_write_locked (JdConnection*, gconstpointer, gsize);
+
+G_GNUC_INTERNAL void jd_statistics_init (void);
+G_GNUC_INTERNAL void jd_statistics_fini (void);
+
+G_GNUC_INTERNAL void jd_statistics_add_connection (JdConnection*);
+G_GNUC_INTERNAL void jd_statistics_remove_connection (JdConnection*);
+G_GNUC_INTERNAL JStatistics* jd_statistics_get_all (void);
+
+G_GNUC_INTERNAL void jd_statistics_record (JMessageType, JdStatisticsPhase, gint64);
+G_GNUC_INTERNAL void jd_statistics_send_reset (void);
+G_GNUC_INTERNAL void jd_statistics_send_add (gint64);
+G_GNUC_INTERNAL gint64 jd_statistics_send_get (void);
+G_GNUC_INTERNAL void jd_statistics_append_histograms (JMessage*);
+
+G_GNUC_INTERNAL void jd_object_cache_init (guint32);
+G_GNUC_INTERNAL void jd_object_cache_fini (void);
+
+G_GNUC_INTERNAL JdObjectHandle* jd_object_cache_open (gchar const*, gchar const*, gboolean, gpointer*);
+G_GNUC_INTERNAL void jd_object_cache_close (JdObjectHandle*);
+G_GNUC_INTERNAL gboolean jd_object_cache_delete (JdObjectHandle*);
+
+G_GNUC_INTERNAL JdRequest* jd_request_new (JdConnection*, JMessage*, gint64);
+G_GNUC_INTERNAL void jd_request_free (JdRequest*);
+
+G_GNUC_INTERNAL void jd_scheduler_init (guint32, guint32);
+G_GNUC_INTERNAL void jd_scheduler_fini (void);
+
+G_GNUC_INTERNAL guint jd_scheduler_get_bulk_limit (void);
+
+G_GNUC_INTERNAL JdRequest* jd_scheduler_submit (JdRequest*);
+G_GNUC_INTERNAL JdRequest* jd_scheduler_complete (JdRequest*);
+
+G_GNUC_INTERNAL void jd_group_commit_init (guint32, guint32);
+G_GNUC_INTERNAL void jd_group_commit_fini (void);
+
+G_GNUC_INTERNAL void jd_group_commit_sync (gpointer, JStatistics*);
+
+G_GNUC_INTERNAL gboolean jd_message_is_ordered (JMessage*);
+G_GNUC_INTERNAL void jd_dispatch_request (JdRequest*);
+
+G_GNUC_INTERNAL gboolean jd_io_uring_init (gint);
+G_GNUC_INTERNAL gboolean jd_io_uring_start (guint32);
+G_GNUC_INTERNAL void jd_io_uring_stop (void);
+G_GNUC_INTERNAL void jd_io_uring_fini (void);
+
+G_GNUC_INTERNAL void jd_io_uring_resume (JdConnection*);
+
+G_GNUC_INTERNAL gboolean jd_handle_message (JMessage*, JdConnection*, JMemoryChunk*, guint64);
 
 #endif
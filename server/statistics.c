@@ -0,0 +1,291 @@
+/*
+ * JULEA - Flexible storage framework
+ * Copyright (C) 2019 Michael Kuhn
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <julea-config.h>
+
+#include <glib.h>
+
+#include <julea.h>
+
+#include "server.h"
+
+/**
+ * The number of message types, see JMessageType.
+ * Messages of unknown types are recorded as J_MESSAGE_NONE, which is not used otherwise.
+ */
+#define JD_MESSAGE_TYPE_COUNT _J_MESSAGE_TYPE_COUNT
+
+/**
+ * Latency histograms of a worker.
+ * Each histogram has one bucket per power of two microseconds, the last bucket also counts all larger latencies.
+ * A worker is the only one updating its histograms, so no locking is needed.
+ */
+struct JdWorkerStatistics
+{
+	guint64 buckets[JD_MESSAGE_TYPE_COUNT][JD_STATISTICS_PHASE_COUNT][JD_STATISTICS_BUCKET_COUNT];
+
+	/**
+	 * The time spent sending replies for the current message.
+	 */
+	gint64 send_time;
+};
+
+typedef struct JdWorkerStatistics JdWorkerStatistics;
+
+static GPrivate jd_worker_statistics = G_PRIVATE_INIT(NULL);
+
+/**
+ * All workers' histograms, used to aggregate them.
+ * Workers only take the lock when they are created.
+ */
+static GPtrArray* jd_worker_statistics_all = NULL;
+static GMutex jd_worker_statistics_mutex[1];
+
+/**
+ * The open connections, used to include their counters in the server's statistics.
+ * Connections merge their counters into jd_statistics and remove themselves when they are closed.
+ */
+static GHashTable* jd_statistics_connections = NULL;
+
+static
+JdWorkerStatistics*
+jd_get_worker_statistics (void)
+{
+	JdWorkerStatistics* worker_statistics;
+
+	worker_statistics = g_private_get(&jd_worker_statistics);
+
+	if (G_UNLIKELY(worker_statistics == NULL))
+	{
+		worker_statistics = g_new0(JdWorkerStatistics, 1);
+		g_private_set(&jd_worker_statistics, worker_statistics);
+
+		g_mutex_lock(jd_worker_statistics_mutex);
+		g_ptr_array_add(jd_worker_statistics_all, worker_statistics);
+		g_mutex_unlock(jd_worker_statistics_mutex);
+	}
+
+	return worker_statistics;
+}
+
+void
+jd_statistics_init (void)
+{
+	jd_statistics = j_statistics_new(FALSE);
+	g_mutex_init(jd_statistics_mutex);
+	jd_statistics_connections = g_hash_table_new(NULL, NULL);
+
+	g_mutex_init(jd_worker_statistics_mutex);
+	jd_worker_statistics_all = g_ptr_array_new_with_free_func(g_free);
+}
+
+void
+jd_statistics_fini (void)
+{
+	g_ptr_array_unref(jd_worker_statistics_all);
+	jd_worker_statistics_all = NULL;
+	g_mutex_clear(jd_worker_statistics_mutex);
+
+	g_hash_table_unref(jd_statistics_connections);
+	jd_statistics_connections = NULL;
+	g_mutex_clear(jd_statistics_mutex);
+	j_statistics_free(jd_statistics);
+	jd_statistics = NULL;
+}
+
+void
+jd_statistics_add_connection (JdConnection* connection)
+{
+	g_mutex_lock(jd_statistics_mutex);
+	g_hash_table_add(jd_statistics_connections, connection);
+	g_mutex_unlock(jd_statistics_mutex);
+}
+
+static
+void
+jd_statistics_merge (JStatistics* statistics, JStatistics* other)
+{
+	static JStatisticsType const types[] = {
+		J_STATISTICS_FILES_CREATED,
+		J_STATISTICS_FILES_DELETED,
+		J_STATISTICS_FILES_STATED,
+		J_STATISTICS_SYNC,
+		J_STATISTICS_BYTES_READ,
+		J_STATISTICS_BYTES_WRITTEN,
+		J_STATISTICS_BYTES_RECEIVED,
+		J_STATISTICS_BYTES_SENT,
+		J_STATISTICS_BYTES_UNCOMPRESSED,
+		J_STATISTICS_BYTES_COMPRESSED
+	};
+
+	for (guint i = 0; i < G_N_ELEMENTS(types); i++)
+	{
+		j_statistics_add(statistics, types[i], j_statistics_get(other, types[i]));
+	}
+}
+
+void
+jd_statistics_remove_connection (JdConnection* connection)
+{
+	g_mutex_lock(jd_statistics_mutex);
+	g_hash_table_remove(jd_statistics_connections, connection);
+	jd_statistics_merge(jd_statistics, connection->statistics);
+	g_mutex_unlock(jd_statistics_mutex);
+}
+
+/**
+ * Returns the server's statistics, including those of all open connections.
+ *
+ * \return New statistics. Should be freed with j_statistics_free().
+ */
+JStatistics*
+jd_statistics_get_all (void)
+{
+	GHashTableIter iter;
+	JStatistics* statistics;
+	gpointer key;
+	guint64 uncompressed;
+	guint64 compressed;
+
+	statistics = j_statistics_new(FALSE);
+
+	/* Compression happens in the message layer, which only counts for the whole server. */
+	j_message_get_compression_statistics(&uncompressed, &compressed);
+	j_statistics_add(statistics, J_STATISTICS_BYTES_UNCOMPRESSED, uncompressed);
+	j_statistics_add(statistics, J_STATISTICS_BYTES_COMPRESSED, compressed);
+
+	g_mutex_lock(jd_statistics_mutex);
+
+	jd_statistics_merge(statistics, jd_statistics);
+
+	g_hash_table_iter_init(&iter, jd_statistics_connections);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		JdConnection* connection = key;
+
+		jd_statistics_merge(statistics, connection->statistics);
+	}
+
+	g_mutex_unlock(jd_statistics_mutex);
+
+	return statistics;
+}
+
+/**
+ * Records a latency in the calling worker's histograms.
+ *
+ * \param type     A message type.
+ * \param phase    A phase.
+ * \param duration A duration in microseconds.
+ */
+void
+jd_statistics_record (JMessageType type, JdStatisticsPhase phase, gint64 duration)
+{
+	JdWorkerStatistics* worker_statistics;
+	guint bucket;
+
+	g_return_if_fail(phase < JD_STATISTICS_PHASE_COUNT);
+
+	/* The type is read from the network, so it might be unknown. */
+	if ((guint)type >= JD_MESSAGE_TYPE_COUNT)
+	{
+		type = J_MESSAGE_NONE;
+	}
+
+	worker_statistics = jd_get_worker_statistics();
+
+	bucket = (duration > 0) ? g_bit_storage(duration) : 0;
+	bucket = MIN(bucket, JD_STATISTICS_BUCKET_COUNT - 1);
+
+	j_helper_atomic_add(&(worker_statistics->buckets[type][phase][bucket]), 1);
+}
+
+/**
+ * Starts measuring the time spent sending replies for a message.
+ */
+void
+jd_statistics_send_reset (void)
+{
+	jd_get_worker_statistics()->send_time = 0;
+}
+
+/**
+ * Adds to the time spent sending replies for the current message.
+ *
+ * \param duration A duration in microseconds.
+ */
+void
+jd_statistics_send_add (gint64 duration)
+{
+	jd_get_worker_statistics()->send_time += duration;
+}
+
+/**
+ * Returns the time spent sending replies for the current message.
+ *
+ * \return A duration in microseconds.
+ */
+gint64
+jd_statistics_send_get (void)
+{
+	return jd_get_worker_statistics()->send_time;
+}
+
+/**
+ * Appends the sum of all workers' histograms to a reply.
+ * The operation starts with the number of message types, phases and buckets, followed by the buckets.
+ *
+ * \param reply A reply.
+ */
+void
+jd_statistics_append_histograms (JMessage* reply)
+{
+	guint32 type_count = JD_MESSAGE_TYPE_COUNT;
+	guint32 phase_count = JD_STATISTICS_PHASE_COUNT;
+	guint32 bucket_count = JD_STATISTICS_BUCKET_COUNT;
+
+	j_message_add_operation(reply, 3 * sizeof(guint32) + JD_MESSAGE_TYPE_COUNT * JD_STATISTICS_PHASE_COUNT * JD_STATISTICS_BUCKET_COUNT * sizeof(guint64));
+	j_message_append_4(reply, &type_count);
+	j_message_append_4(reply, &phase_count);
+	j_message_append_4(reply, &bucket_count);
+
+	g_mutex_lock(jd_worker_statistics_mutex);
+
+	for (guint type = 0; type < JD_MESSAGE_TYPE_COUNT; type++)
+	{
+		for (guint phase = 0; phase < JD_STATISTICS_PHASE_COUNT; phase++)
+		{
+			for (guint bucket = 0; bucket < JD_STATISTICS_BUCKET_COUNT; bucket++)
+			{
+				guint64 value = 0;
+
+				for (guint i = 0; i < jd_worker_statistics_all->len; i++)
+				{
+					JdWorkerStatistics* worker_statistics = g_ptr_array_index(jd_worker_statistics_all, i);
+
+					value += worker_statistics->buckets[type][phase][bucket];
+				}
+
+				j_message_append_8(reply, &value);
+			}
+		}
+	}
+
+	g_mutex_unlock(jd_worker_statistics_mutex);
+}
@@ -28,6 +28,12 @@
 #include "test.h"
 
 static gint test_batch_flag;
+/* Independent groups of operations might be executed concurrently. */
+static gint test_batch_exec_count;
+
+static GMutex test_batch_barrier_mutex;
+static GCond test_batch_barrier_cond;
+static guint test_batch_barrier_count;
 
 static
 void
@@ -123,6 +129,222 @@ test_batch_execute_async (void)
 	_test_batch_execute(TRUE);
 }
 
+static
+gboolean
+test_batch_exec (JList* operations, JSemantics* semantics)
+{
+	(void)operations;
+	(void)semantics;
+
+	g_atomic_int_inc(&test_batch_exec_count);
+
+	return TRUE;
+}
+
+static
+gboolean
+test_batch_exec_other (JList* operations, JSemantics* semantics)
+{
+	(void)operations;
+	(void)semantics;
+
+	g_atomic_int_inc(&test_batch_exec_count);
+
+	return TRUE;
+}
+
+static
+void
+test_batch_add_operation (JBatch* batch, JOperationExecFunc exec_func, gchar const* resource)
+{
+	JOperation* operation;
+
+	operation = j_operation_new();
+	operation->key = "test";
+	/* Groups without data are not executed. */
+	operation->data = batch;
+	operation->resource = resource;
+	operation->exec_func = exec_func;
+
+	j_batch_add(batch, operation);
+}
+
+static
+void
+test_batch_execute_queued (void)
+{
+	guint const n = 10;
+
+	g_autoptr(JCompletionQueue) queue = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+	JBatch* batch;
+	guint completed = 0;
+
+	queue = j_completion_queue_new();
+	semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+
+	g_assert(j_completion_queue_poll(queue, NULL) == NULL);
+	g_assert(j_completion_queue_wait(queue, NULL) == NULL);
+
+	for (guint i = 0; i < n; i++)
+	{
+		g_autoptr(JCollection) collection = NULL;
+		g_autoptr(JItem) item = NULL;
+		g_autofree gchar* name = NULL;
+
+		batch = j_batch_new(semantics);
+
+		name = g_strdup_printf("test-queued-%u", i);
+		collection = j_collection_create(name, batch);
+		item = j_item_create(collection, "item", NULL, batch);
+		j_item_delete(item, batch);
+		j_collection_delete(collection, batch);
+
+		j_batch_execute_queued(batch, queue);
+
+		if (i == 0)
+		{
+			j_batch_wait(batch);
+			g_assert(j_batch_is_completed(batch));
+		}
+
+		j_batch_unref(batch);
+	}
+
+	while ((batch = j_completion_queue_wait(queue, NULL)) != NULL)
+	{
+		g_assert(j_batch_is_completed(batch));
+
+		j_batch_unref(batch);
+		completed++;
+	}
+
+	g_assert_cmpuint(completed, ==, n);
+
+	/* Executed batches that have not been returned are released together with their queue. */
+	batch = j_batch_new(semantics);
+	test_batch_add_operation(batch, test_batch_exec, "a");
+	j_batch_execute_queued(batch, queue);
+	j_batch_wait(batch);
+	g_assert(j_batch_is_completed(batch));
+	j_batch_unref(batch);
+}
+
+static
+guint
+_test_batch_execute_ordering (JSemanticsOrdering ordering, gchar const* const* resources)
+{
+	g_autoptr(JBatch) batch = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+
+	semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+	j_semantics_set(semantics, J_SEMANTICS_ORDERING, ordering);
+	batch = j_batch_new(semantics);
+
+	/* Operations alternate between two types, like creating and writing objects. */
+	for (guint i = 0; resources[i] != NULL; i++)
+	{
+		test_batch_add_operation(batch, (i % 2 == 0) ? test_batch_exec : test_batch_exec_other, resources[i]);
+	}
+
+	g_atomic_int_set(&test_batch_exec_count, 0);
+	j_batch_execute(batch);
+
+	return g_atomic_int_get(&test_batch_exec_count);
+}
+
+static
+void
+test_batch_execute_ordering (void)
+{
+	gchar const* const independent[] = { "a", "a", "b", "b", "c", "c", NULL };
+	gchar const* const dependent[] = { "a", "a", "a", "a", NULL };
+	gchar const* const parent[] = { "a", "a", "a/b", "a/b", NULL };
+	gchar const* const concurrent[] = { "a", "b", "c", "d", NULL };
+
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_STRICT, independent), ==, 6);
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_SEMI_RELAXED, independent), ==, 2);
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_RELAXED, independent), ==, 2);
+
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_RELAXED, dependent), ==, 4);
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_RELAXED, parent), ==, 4);
+
+	g_assert_cmpuint(_test_batch_execute_ordering(J_SEMANTICS_ORDERING_RELAXED, concurrent), ==, 2);
+}
+
+/**
+ * Waits until both groups of a batch have been started.
+ * This can only succeed if the groups are executed concurrently.
+ */
+static
+gboolean
+test_batch_barrier (void)
+{
+	gint64 end_time;
+	gboolean ret = TRUE;
+
+	end_time = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+
+	g_mutex_lock(&test_batch_barrier_mutex);
+
+	test_batch_barrier_count++;
+	g_cond_broadcast(&test_batch_barrier_cond);
+
+	while (test_batch_barrier_count < 2 && ret)
+	{
+		ret = g_cond_wait_until(&test_batch_barrier_cond, &test_batch_barrier_mutex, end_time);
+	}
+
+	g_mutex_unlock(&test_batch_barrier_mutex);
+
+	return ret;
+}
+
+static
+gboolean
+test_batch_exec_barrier (JList* operations, JSemantics* semantics)
+{
+	(void)operations;
+	(void)semantics;
+
+	return test_batch_barrier();
+}
+
+static
+gboolean
+test_batch_exec_barrier_other (JList* operations, JSemantics* semantics)
+{
+	(void)operations;
+	(void)semantics;
+
+	return test_batch_barrier();
+}
+
+static
+void
+test_batch_execute_concurrent (void)
+{
+	g_autoptr(JBatch) batch = NULL;
+	g_autoptr(JSemantics) semantics = NULL;
+	gboolean ret;
+
+	semantics = j_semantics_new(J_SEMANTICS_TEMPLATE_DEFAULT);
+	j_semantics_set(semantics, J_SEMANTICS_ORDERING, J_SEMANTICS_ORDERING_RELAXED);
+
+	test_batch_barrier_count = 0;
+
+	/* Both groups are independent, each one only returns once the other one has been started. */
+	batch = j_batch_new(semantics);
+	test_batch_add_operation(batch, test_batch_exec_barrier, "a");
+	test_batch_add_operation(batch, test_batch_exec_barrier_other, "b");
+	test_batch_add_operation(batch, test_batch_exec_barrier, "c");
+	test_batch_add_operation(batch, test_batch_exec_barrier_other, "d");
+
+	ret = j_batch_execute(batch);
+	g_assert(ret);
+	g_assert_cmpuint(test_batch_barrier_count, ==, 2);
+}
+
 void
 test_batch (void)
 {
@@ -130,4 +352,7 @@ test_batch (void)
 	g_test_add_func("/batch/semantics", test_batch_semantics);
 	g_test_add_func("/batch/execute", test_batch_execute);
 	g_test_add_func("/batch/execute_async", test_batch_execute_async);
+	g_test_add_func("/batch/execute_queued", test_batch_execute_queued);
+	g_test_add_func("/batch/execute_ordering", test_batch_execute_ordering);
+	g_test_add_func("/batch/execute_concurrent", test_batch_execute_concurrent);
 }
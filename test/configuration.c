@@ -63,6 +63,18 @@ test_configuration_new_for_data (void)
 
 	configuration = j_configuration_new_for_data(key_file);
 	g_assert(configuration != NULL);
+	g_assert_cmpuint(j_configuration_get_group_commit_window(configuration), ==, 200);
+	g_assert_cmpuint(j_configuration_get_metadata_share(configuration), ==, 25);
+	j_configuration_unref(configuration);
+
+	/* 0 is a valid setting that must not be replaced by the default. */
+	g_key_file_set_integer(key_file, "core", "group-commit-window", 0);
+	g_key_file_set_integer(key_file, "core", "metadata-share", 0);
+
+	configuration = j_configuration_new_for_data(key_file);
+	g_assert(configuration != NULL);
+	g_assert_cmpuint(j_configuration_get_group_commit_window(configuration), ==, 0);
+	g_assert_cmpuint(j_configuration_get_metadata_share(configuration), ==, 0);
 	j_configuration_unref(configuration);
 
 	g_key_file_free(key_file);
@@ -77,6 +89,7 @@ test_configuration_get (void)
 	gchar const* object_servers[] = { "localhost", "local.host", NULL };
 	gchar const* kv_servers[] = { "localhost", NULL };
 	gchar const* db_servers[] = { "localhost", "host.local", NULL };
+	gint numa_nodes[] = { 1, 0 };
 
 	key_file = g_key_file_new();
 	g_key_file_set_string_list(key_file, "servers", "object", object_servers, 2);
@@ -91,6 +104,14 @@ test_configuration_get (void)
 	g_key_file_set_string(key_file, "db", "backend", "null3");
 	g_key_file_set_string(key_file, "db", "component", "client");
 	g_key_file_set_string(key_file, "db", "path", "NULL3");
+	g_key_file_set_integer(key_file, "core", "server-threads", 42);
+	g_key_file_set_boolean(key_file, "core", "splice-writes", TRUE);
+	g_key_file_set_integer(key_file, "core", "object-cache-size", 23);
+	g_key_file_set_integer(key_file, "core", "group-commit-window", 500);
+	g_key_file_set_integer(key_file, "core", "metadata-share", 50);
+	g_key_file_set_integer_list(key_file, "core", "numa-nodes", numa_nodes, G_N_ELEMENTS(numa_nodes));
+	g_key_file_set_string(key_file, "core", "compression", "lz4");
+	g_key_file_set_integer(key_file, "core", "compression-threshold", 4096);
 
 	configuration = j_configuration_new_for_data(key_file);
 	g_assert(configuration != NULL);
@@ -118,6 +139,17 @@ test_configuration_get (void)
 	g_assert_cmpstr(j_configuration_get_backend_component(configuration, J_BACKEND_TYPE_DB), ==, "client");
 	g_assert_cmpstr(j_configuration_get_backend_path(configuration, J_BACKEND_TYPE_DB), ==, "NULL3");
 
+	g_assert_cmpuint(j_configuration_get_server_threads(configuration), ==, 42);
+	g_assert(j_configuration_get_splice_writes(configuration));
+	g_assert_cmpuint(j_configuration_get_object_cache_size(configuration), ==, 23);
+	g_assert_cmpuint(j_configuration_get_group_commit_window(configuration), ==, 500);
+	g_assert_cmpuint(j_configuration_get_metadata_share(configuration), ==, 50);
+	g_assert_cmpuint(j_configuration_get_numa_node_count(configuration), ==, 2);
+	g_assert_cmpuint(j_configuration_get_numa_node(configuration, 0), ==, 1);
+	g_assert_cmpuint(j_configuration_get_numa_node(configuration, 1), ==, 0);
+	g_assert_cmpstr(j_configuration_get_compression(configuration), ==, "lz4");
+	g_assert_cmpuint(j_configuration_get_compression_threshold(configuration), ==, 4096);
+
 	j_configuration_unref(configuration);
 
 	g_key_file_free(key_file);
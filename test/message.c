@@ -19,9 +19,12 @@
 #include <julea-config.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <julea.h>
 
@@ -157,6 +160,856 @@ test_message_write_read (void)
 	g_assert_cmpstr(dummy_str, ==, "42");
 }
 
+static
+void
+test_message_write_read_large (void)
+{
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(GInputStream) input = NULL;
+	gchar buffer[1024];
+	gboolean ret;
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+	input = g_memory_input_stream_new();
+
+	/* Messages are grown beyond the largest pooled buffer size and recycled afterwards. */
+	for (guint i = 0; i < 2; i++)
+	{
+		g_autoptr(JMessage) message = NULL;
+
+		message = j_message_new(J_MESSAGE_NONE, 0);
+
+		for (guint j = 0; j < 100; j++)
+		{
+			memset(buffer, j, sizeof(buffer));
+
+			j_message_add_operation(message, sizeof(buffer));
+			ret = j_message_append_n(message, buffer, sizeof(buffer));
+			g_assert(ret);
+		}
+
+		ret = j_message_write(message, output);
+		g_assert(ret);
+	}
+
+	g_memory_input_stream_add_data(
+		G_MEMORY_INPUT_STREAM(input),
+		g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output)),
+		g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output)),
+		NULL
+	);
+
+	for (guint i = 0; i < 2; i++)
+	{
+		g_autoptr(JMessage) message = NULL;
+
+		message = j_message_new(J_MESSAGE_NONE, 0);
+
+		ret = j_message_read(message, input);
+		g_assert(ret);
+		g_assert_cmpuint(j_message_get_count(message), ==, 100);
+
+		for (guint j = 0; j < 100; j++)
+		{
+			gchar const* data;
+
+			memset(buffer, j, sizeof(buffer));
+
+			data = j_message_get_n(message, sizeof(buffer));
+			g_assert(memcmp(data, buffer, sizeof(buffer)) == 0);
+		}
+	}
+}
+
+static
+void
+test_message_write_fd (void)
+{
+	g_autoptr(JMessage) message = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autofree gchar* path = NULL;
+	gchar const* data = "0123456789";
+	gchar const* written;
+	gboolean ret;
+	gsize length;
+	gint fd;
+
+	fd = g_file_open_tmp(NULL, &path, NULL);
+	g_assert_cmpint(fd, !=, -1);
+	g_assert_cmpint(write(fd, data, 10), ==, 10);
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+
+	message = j_message_new(J_MESSAGE_NONE, 0);
+	j_message_add_send_fd(message, fd, 2, 4);
+	/* The file is only 10 bytes long, missing data is filled with zeros */
+	j_message_add_send_fd(message, fd, 8, 4);
+
+	ret = j_message_write(message, output);
+	g_assert(ret);
+
+	written = g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output));
+	length = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output));
+
+	g_assert_cmpuint(length, >=, 8);
+	g_assert(memcmp(written + length - 8, "2345" "89\0\0", 8) == 0);
+
+	close(fd);
+	g_unlink(path);
+}
+
+static
+void
+test_message_receive_reply (void)
+{
+	g_autoptr(JMessage) message_1 = NULL;
+	g_autoptr(JMessage) message_2 = NULL;
+	g_autoptr(JMessage) reply_1 = NULL;
+	g_autoptr(JMessage) reply_2 = NULL;
+	g_autoptr(JMessage) reply_recv_1 = NULL;
+	g_autoptr(JMessage) reply_recv_2 = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(GInputStream) input = NULL;
+	g_autoptr(GIOStream) stream = NULL;
+	gboolean ret;
+	guint64 dummy_1 = 23;
+	guint64 dummy_2 = 42;
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+	input = g_memory_input_stream_new();
+	stream = g_simple_io_stream_new(input, output);
+
+	message_1 = j_message_new(J_MESSAGE_NONE, 0);
+	message_2 = j_message_new(J_MESSAGE_NONE, 0);
+
+	reply_1 = j_message_new_reply(message_1);
+	j_message_add_operation(reply_1, sizeof(guint64));
+	j_message_append_8(reply_1, &dummy_1);
+
+	reply_2 = j_message_new_reply(message_2);
+	j_message_add_operation(reply_2, sizeof(guint64));
+	j_message_append_8(reply_2, &dummy_2);
+
+	/* Replies arrive in reverse order */
+	ret = j_message_write(reply_2, output);
+	g_assert(ret);
+	ret = j_message_write(reply_1, output);
+	g_assert(ret);
+
+	g_memory_input_stream_add_data(
+		G_MEMORY_INPUT_STREAM(input),
+		g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output)),
+		g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output)),
+		NULL
+	);
+
+	reply_recv_1 = j_message_new_reply(message_1);
+	ret = j_message_receive(reply_recv_1, stream);
+	g_assert(ret);
+	g_assert_cmpuint(j_message_get_8(reply_recv_1), ==, 23);
+
+	reply_recv_2 = j_message_new_reply(message_2);
+	ret = j_message_receive(reply_recv_2, stream);
+	g_assert(ret);
+	g_assert_cmpuint(j_message_get_8(reply_recv_2), ==, 42);
+}
+
+static
+void
+test_message_receive_data (void)
+{
+	g_autoptr(JMessage) message = NULL;
+	g_autoptr(JMessage) reply = NULL;
+	g_autoptr(JMessage) reply_recv = NULL;
+	g_autoptr(GSocket) socket_send = NULL;
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_send = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	gchar const* data = "0123456789";
+	gchar buffer_1[4];
+	gchar buffer_2[6];
+	gboolean ret;
+	gint fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_send = g_socket_new_from_fd(fds[0], NULL);
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_send = g_socket_connection_factory_create_connection(socket_send);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	message = j_message_new(J_MESSAGE_NONE, 0);
+
+	reply = j_message_new_reply(message);
+	j_message_add_operation(reply, 0);
+	j_message_add_send(reply, data, 10);
+
+	ret = j_message_send(reply, connection_send);
+	g_assert(ret);
+
+	reply_recv = j_message_new_reply(message);
+	ret = j_message_receive(reply_recv, connection_recv);
+	g_assert(ret);
+
+	j_message_add_receive(reply_recv, buffer_1, sizeof(buffer_1));
+	j_message_add_receive(reply_recv, buffer_2, sizeof(buffer_2));
+
+	ret = j_message_receive_data(reply_recv, connection_recv);
+	g_assert(ret);
+
+	g_assert(memcmp(buffer_1, "0123", 4) == 0);
+	g_assert(memcmp(buffer_2, "456789", 6) == 0);
+}
+
+static
+void
+test_message_reader (void)
+{
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(JMessage) message_send = NULL;
+	g_autoptr(JMessage) message_recv = NULL;
+	JMessageReader* reader;
+	gchar const* data;
+	gsize length;
+	gboolean ret;
+	guint32 value = 42;
+	gint fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+
+	message_send = j_message_new(J_MESSAGE_KV_PUT, 0);
+	j_message_add_operation(message_send, 4);
+	j_message_append_string(message_send, "key");
+	j_message_append_4(message_send, &value);
+
+	ret = j_message_write(message_send, output);
+	g_assert(ret);
+
+	data = g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output));
+	length = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output));
+
+	reader = j_message_reader_new(connection_recv);
+
+	/* Nothing has arrived yet. */
+	ret = j_message_reader_read(reader, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv == NULL);
+
+	/* Only part of the header has arrived. */
+	g_assert_cmpint(write(fds[0], data, 3), ==, 3);
+
+	ret = j_message_reader_read(reader, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv == NULL);
+
+	g_assert_cmpint(write(fds[0], data + 3, length - 3), ==, (gssize)(length - 3));
+
+	ret = j_message_reader_read(reader, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv != NULL);
+
+	g_assert(j_message_get_type(message_recv) == J_MESSAGE_KV_PUT);
+	g_assert_cmpuint(j_message_get_count(message_recv), ==, 1);
+	g_assert_cmpstr(j_message_get_string(message_recv), ==, "key");
+	g_assert_cmpuint(j_message_get_4(message_recv), ==, 42);
+
+	close(fds[0]);
+
+	/* The connection has been closed. */
+	g_clear_pointer(&message_recv, j_message_unref);
+	ret = j_message_reader_read(reader, &message_recv);
+	g_assert(!ret);
+
+	j_message_reader_free(reader);
+}
+
+static
+void
+test_message_reader_feed (void)
+{
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(JMessage) message_send = NULL;
+	g_autoptr(JMessage) message_recv = NULL;
+	JMessageReader* reader;
+	gchar const* data;
+	gsize consumed;
+	gsize length;
+	gsize message_length;
+	gboolean ret;
+	guint32 value = 42;
+	gint fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+
+	message_send = j_message_new(J_MESSAGE_KV_PUT, 0);
+	j_message_add_operation(message_send, 4);
+	j_message_append_string(message_send, "key");
+	j_message_append_4(message_send, &value);
+
+	/* Two messages followed by data that belongs to neither of them. */
+	ret = j_message_write(message_send, output);
+	g_assert(ret);
+	message_length = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output));
+	ret = j_message_write(message_send, output);
+	g_assert(ret);
+	g_assert(g_output_stream_write_all(output, "x", 1, NULL, NULL, NULL));
+
+	data = g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output));
+	length = g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output));
+
+	reader = j_message_reader_new(connection_recv);
+
+	/* Only part of the header has been received. */
+	ret = j_message_reader_feed(reader, data, 3, &consumed, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv == NULL);
+	g_assert_cmpuint(consumed, ==, 3);
+
+	data += consumed;
+	length -= consumed;
+
+	ret = j_message_reader_feed(reader, data, length, &consumed, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv != NULL);
+	g_assert_cmpuint(consumed, ==, message_length - 3);
+
+	g_assert(j_message_get_type(message_recv) == J_MESSAGE_KV_PUT);
+	g_assert_cmpstr(j_message_get_string(message_recv), ==, "key");
+	g_assert_cmpuint(j_message_get_4(message_recv), ==, 42);
+
+	data += consumed;
+	length -= consumed;
+	g_clear_pointer(&message_recv, j_message_unref);
+
+	/* The second message is parsed completely, the trailing data is left over. */
+	ret = j_message_reader_feed(reader, data, length, &consumed, &message_recv);
+	g_assert(ret);
+	g_assert(message_recv != NULL);
+	g_assert_cmpuint(consumed, ==, length - 1);
+	g_assert_cmpuint(j_message_get_4(message_recv), ==, 42);
+	g_assert_cmpint(data[consumed], ==, 'x');
+
+	j_message_reader_free(reader);
+	close(fds[0]);
+}
+
+static
+void
+test_message_interning (void)
+{
+	g_autoptr(GSocket) socket_send = NULL;
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_send = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	gchar const* strings[] = { "namespace", "a", "\xff" "marker" };
+	gboolean ret;
+	gint fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_send = g_socket_new_from_fd(fds[0], NULL);
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_send = g_socket_connection_factory_create_connection(socket_send);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	j_message_enable_interning(connection_send);
+
+	/* The namespace is interned when it is sent for the first time and referenced afterwards, the other strings are sent as they are. */
+	for (guint i = 0; i < 3; i++)
+	{
+		g_autoptr(JMessage) message = NULL;
+		guint32 value = i;
+
+		message = j_message_new(J_MESSAGE_KV_PUT, 0);
+		j_message_add_operation(message, 4);
+
+		j_message_append_namespace(message, strings[0]);
+
+		for (guint j = 1; j < G_N_ELEMENTS(strings); j++)
+		{
+			j_message_append_string(message, strings[j]);
+		}
+
+		j_message_append_4(message, &value);
+
+		ret = j_message_send(message, connection_send);
+		g_assert(ret);
+	}
+
+	for (guint i = 0; i < 3; i++)
+	{
+		g_autoptr(JMessage) message = NULL;
+
+		message = j_message_new(J_MESSAGE_NONE, 0);
+
+		ret = j_message_receive(message, connection_recv);
+		g_assert(ret);
+
+		g_assert(j_message_get_type(message) == J_MESSAGE_KV_PUT);
+		g_assert_cmpuint(j_message_get_count(message), ==, 1);
+
+		for (guint j = 0; j < G_N_ELEMENTS(strings); j++)
+		{
+			g_assert_cmpstr(j_message_get_string(message), ==, strings[j]);
+		}
+
+		g_assert_cmpuint(j_message_get_4(message), ==, i);
+	}
+}
+
+static
+void
+test_message_compression (void)
+{
+	g_autoptr(JMessage) message = NULL;
+	g_autoptr(JMessage) message_recv = NULL;
+	g_autoptr(GSocket) socket_send = NULL;
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_send = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	g_autofree gchar* value = NULL;
+	JMessageCompression algorithm;
+	gchar const* value_recv;
+	gboolean ret;
+	gint fds[2];
+	gsize const length = 64 * 1024;
+	guint64 uncompressed;
+	guint64 compressed;
+
+	algorithm = j_message_compression_from_string("lz4");
+
+	if (algorithm == J_MESSAGE_COMPRESSION_NONE)
+	{
+		algorithm = j_message_compression_from_string("zstd");
+	}
+
+	if (algorithm == J_MESSAGE_COMPRESSION_NONE)
+	{
+		g_test_skip("No compression library available");
+		return;
+	}
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_send = g_socket_new_from_fd(fds[0], NULL);
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_send = g_socket_connection_factory_create_connection(socket_send);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	j_message_enable_compression(connection_send, algorithm, 1024);
+
+	value = g_malloc(length);
+	memset(value, 'x', length);
+
+	/* Data that compresses too well is sent uncompressed, see J_MESSAGE_COMPRESSION_RATIO_MAX. */
+	for (gsize i = 0; i < length; i += 16)
+	{
+		value[i] = g_test_rand_int_range('a', 'z' + 1);
+	}
+
+	message = j_message_new(J_MESSAGE_KV_PUT, length);
+	j_message_add_operation(message, length);
+	j_message_append_n(message, value, length);
+
+	/* The socket buffer is large enough for the compressed message. */
+	ret = j_message_send(message, connection_send);
+	g_assert(ret);
+
+	message_recv = j_message_new(J_MESSAGE_NONE, 0);
+	ret = j_message_receive(message_recv, connection_recv);
+	g_assert(ret);
+
+	g_assert(j_message_get_type(message_recv) == J_MESSAGE_KV_PUT);
+	value_recv = j_message_get_n(message_recv, length);
+	g_assert(memcmp(value_recv, value, length) == 0);
+
+	j_message_get_compression_statistics(&uncompressed, &compressed);
+	g_assert_cmpuint(compressed, <, uncompressed);
+}
+
+static
+void
+test_message_shared_memory (void)
+{
+	g_autoptr(JMessage) message = NULL;
+	g_autoptr(JMessage) message_recv = NULL;
+	g_autoptr(GSocket) socket_send = NULL;
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_send = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	g_autofree gchar* data = NULL;
+	g_autofree gchar* buffer = NULL;
+	gchar const* shared;
+	gboolean ret;
+	gint fds[2];
+	gsize const length = 3000;
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_send = g_socket_new_from_fd(fds[0], NULL);
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_send = g_socket_connection_factory_create_connection(socket_send);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	j_message_offer_shared_memory(connection_send, 4096);
+
+	if (!j_message_accept_shared_memory(connection_recv, 4096))
+	{
+		g_test_skip("Shared memory not supported");
+		return;
+	}
+
+	j_message_enable_shared_memory(connection_send);
+
+	message = j_message_new(J_MESSAGE_OBJECT_WRITE, 0);
+	j_message_add_operation(message, 0);
+	j_message_add_send(message, "0123456789", 10);
+
+	ret = j_message_send(message, connection_send);
+	g_assert(ret);
+
+	message_recv = j_message_new(J_MESSAGE_NONE, 0);
+	ret = j_message_receive(message_recv, connection_recv);
+	g_assert(ret);
+
+	shared = j_message_get_shared(message_recv, 4);
+	g_assert(shared != NULL);
+	g_assert(memcmp(shared, "0123", 4) == 0);
+
+	shared = j_message_get_shared(message_recv, 6);
+	g_assert(shared != NULL);
+	g_assert(memcmp(shared, "456789", 6) == 0);
+
+	data = g_malloc(2 * length);
+	buffer = g_malloc(2 * length);
+
+	for (gsize i = 0; i < 2 * length; i++)
+	{
+		data[i] = i % 251;
+	}
+
+	/* The second reply does not fit before the ring's end, the third one does not fit into the ring at all. */
+	for (guint i = 1; i <= 3; i++)
+	{
+		g_autoptr(JMessage) reply = NULL;
+		g_autoptr(JMessage) reply_recv = NULL;
+		gsize reply_length = (i < 3) ? length : 2 * length;
+
+		reply = j_message_new_reply(message);
+		j_message_add_operation(reply, 0);
+		j_message_add_send(reply, data, reply_length);
+
+		ret = j_message_send(reply, connection_recv);
+		g_assert(ret);
+
+		reply_recv = j_message_new_reply(message);
+		ret = j_message_receive(reply_recv, connection_send);
+		g_assert(ret);
+
+		memset(buffer, 0, 2 * length);
+		j_message_add_receive(reply_recv, buffer, reply_length);
+
+		ret = j_message_receive_data(reply_recv, connection_send);
+		g_assert(ret);
+
+		g_assert(memcmp(buffer, data, reply_length) == 0);
+	}
+}
+
+static
+void
+test_message_shared_memory_limit (void)
+{
+	g_autoptr(GSocket) socket_send = NULL;
+	g_autoptr(GSocket) socket_recv = NULL;
+	g_autoptr(GSocketConnection) connection_send = NULL;
+	g_autoptr(GSocketConnection) connection_recv = NULL;
+	gint fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_send = g_socket_new_from_fd(fds[0], NULL);
+	socket_recv = g_socket_new_from_fd(fds[1], NULL);
+	connection_send = g_socket_connection_factory_create_connection(socket_send);
+	connection_recv = g_socket_connection_factory_create_connection(socket_recv);
+
+	/* Segments larger than the receiver allows are rejected. */
+	j_message_offer_shared_memory(connection_send, 2 * 4096);
+	g_assert(!j_message_accept_shared_memory(connection_recv, 4096));
+}
+
+struct TestEngineRequest
+{
+	GMutex mutex;
+	GCond cond;
+	gchar buffer[10];
+	gboolean done;
+	gboolean success;
+};
+
+typedef struct TestEngineRequest TestEngineRequest;
+
+static
+gboolean
+test_message_engine_reply (JMessage* reply, gpointer data)
+{
+	TestEngineRequest* request = data;
+
+	g_assert_cmpuint(j_message_get_8(reply), ==, 42);
+	j_message_add_receive(reply, request->buffer, sizeof(request->buffer));
+
+	return TRUE;
+}
+
+static
+void
+test_message_engine_done (gboolean success, gpointer data)
+{
+	TestEngineRequest* request = data;
+
+	g_mutex_lock(&(request->mutex));
+	request->success = success;
+	request->done = TRUE;
+	g_cond_signal(&(request->cond));
+	g_mutex_unlock(&(request->mutex));
+}
+
+static
+void
+test_message_engine (void)
+{
+	g_autoptr(JMessage) message_1 = NULL;
+	g_autoptr(JMessage) message_2 = NULL;
+	g_autoptr(JMessage) message_3 = NULL;
+	g_autoptr(JMessage) message_recv = NULL;
+	g_autoptr(JMessage) reply_1 = NULL;
+	g_autoptr(JMessage) reply_2 = NULL;
+	g_autoptr(JMessage) reply_3 = NULL;
+	g_autoptr(JMessage) reply_recv_1 = NULL;
+	g_autoptr(JMessage) reply_recv_2 = NULL;
+	g_autoptr(GSocket) socket_server = NULL;
+	g_autoptr(GSocket) socket_client = NULL;
+	g_autoptr(GSocketConnection) connection_server = NULL;
+	g_autoptr(GSocketConnection) connection_client = NULL;
+	JMessageObjectReadReply read_reply;
+	TestEngineRequest request;
+	gchar buffer[10];
+	gboolean ret;
+	gint fds[2];
+	guint64 dummy = 23;
+	guint64 answer = 42;
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+
+	socket_server = g_socket_new_from_fd(fds[0], NULL);
+	socket_client = g_socket_new_from_fd(fds[1], NULL);
+	connection_server = g_socket_connection_factory_create_connection(socket_server);
+	connection_client = g_socket_connection_factory_create_connection(socket_client);
+
+	j_message_enable_engine(connection_client);
+
+	message_1 = j_message_new(J_MESSAGE_NONE, 0);
+	message_2 = j_message_new(J_MESSAGE_OBJECT_READ, 0);
+
+	reply_1 = j_message_new_reply(message_1);
+	j_message_add_operation(reply_1, sizeof(guint64));
+	j_message_append_8(reply_1, &dummy);
+
+	read_reply.bytes_read = 10;
+
+	reply_2 = j_message_new_reply(message_2);
+	j_message_add_operation(reply_2, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ_REPLY));
+	j_message_append_object_read_reply(reply_2, &read_reply);
+	j_message_add_send(reply_2, "0123456789", 10);
+
+	ret = j_message_send(reply_1, connection_server);
+	g_assert(ret);
+	ret = j_message_send(reply_2, connection_server);
+	g_assert(ret);
+
+	/* The second reply is requested first, the first one is kept by the engine. */
+	reply_recv_2 = j_message_new_reply(message_2);
+	ret = j_message_receive(reply_recv_2, connection_client);
+	g_assert(ret);
+
+	j_message_add_receive(reply_recv_2, buffer, sizeof(buffer));
+
+	ret = j_message_receive_data(reply_recv_2, connection_client);
+	g_assert(ret);
+	g_assert(memcmp(buffer, "0123456789", 10) == 0);
+
+	reply_recv_1 = j_message_new_reply(message_1);
+	ret = j_message_receive(reply_recv_1, connection_client);
+	g_assert(ret);
+	g_assert_cmpuint(j_message_get_8(reply_recv_1), ==, 23);
+
+	/* Replies to asynchronous requests are received into the buffers added by the reply function. */
+	g_mutex_init(&(request.mutex));
+	g_cond_init(&(request.cond));
+	request.done = FALSE;
+	request.success = FALSE;
+
+	message_3 = j_message_new(J_MESSAGE_NONE, 0);
+	j_message_send_async(message_3, connection_client, test_message_engine_reply, test_message_engine_done, &request);
+
+	message_recv = j_message_new(J_MESSAGE_NONE, 0);
+	ret = j_message_receive(message_recv, connection_server);
+	g_assert(ret);
+
+	reply_3 = j_message_new_reply(message_recv);
+	j_message_add_operation(reply_3, sizeof(guint64));
+	j_message_append_8(reply_3, &answer);
+	j_message_add_send(reply_3, "9876543210", 10);
+
+	ret = j_message_send(reply_3, connection_server);
+	g_assert(ret);
+
+	g_mutex_lock(&(request.mutex));
+
+	while (!request.done)
+	{
+		g_cond_wait(&(request.cond), &(request.mutex));
+	}
+
+	g_mutex_unlock(&(request.mutex));
+
+	g_assert(request.success);
+	g_assert(memcmp(request.buffer, "9876543210", 10) == 0);
+
+	g_cond_clear(&(request.cond));
+	g_mutex_clear(&(request.mutex));
+
+	/* Closing the connection fails the requests that are still waiting. */
+	g_socket_shutdown(socket_server, TRUE, TRUE, NULL);
+
+	ret = j_message_receive(reply_recv_1, connection_client);
+	g_assert(!ret);
+}
+
+static
+void
+test_message_layout (void)
+{
+	g_autoptr(JMessage) message_recv = NULL;
+	g_autoptr(JMessage) message_send = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(GInputStream) input = NULL;
+	g_autofree JMessageObjectRead* operations = NULL;
+	JMessageObjectRead operation;
+	gboolean ret;
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+	input = g_memory_input_stream_new();
+
+	message_send = j_message_new(J_MESSAGE_OBJECT_READ, 0);
+	message_recv = j_message_new(J_MESSAGE_NONE, 0);
+
+	for (guint i = 0; i < 2; i++)
+	{
+		operation.length = 42 + i;
+		operation.offset = G_MAXUINT64 - i;
+
+		j_message_add_operation(message_send, J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_OBJECT_READ));
+		ret = j_message_append_object_read(message_send, &operation);
+		g_assert(ret);
+	}
+
+	ret = j_message_write(message_send, output);
+	g_assert(ret);
+
+	g_memory_input_stream_add_data(
+		G_MEMORY_INPUT_STREAM(input),
+		g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output)),
+		g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output)),
+		NULL
+	);
+
+	ret = j_message_read(message_recv, input);
+	g_assert(ret);
+
+	/* A count that does not match the message must not be decoded. */
+	ret = j_message_get_object_read(message_recv, G_MAXUINT32, &operations);
+	g_assert(!ret);
+	g_assert(operations == NULL);
+
+	ret = j_message_get_object_read(message_recv, j_message_get_count(message_recv), &operations);
+	g_assert(ret);
+	g_assert_cmpuint(operations[0].length, ==, 42);
+	g_assert_cmpuint(operations[0].offset, ==, G_MAXUINT64);
+	g_assert_cmpuint(operations[1].length, ==, 43);
+	g_assert_cmpuint(operations[1].offset, ==, G_MAXUINT64 - 1);
+}
+
+static
+void
+test_message_layout_next (void)
+{
+	g_autoptr(JMessage) message_recv = NULL;
+	g_autoptr(JMessage) message_send = NULL;
+	g_autoptr(GOutputStream) output = NULL;
+	g_autoptr(GInputStream) input = NULL;
+	JMessageKVPut operation;
+	gchar const* key;
+	gboolean ret;
+
+	output = g_memory_output_stream_new(NULL, 0, g_realloc, g_free);
+	input = g_memory_input_stream_new();
+
+	message_send = j_message_new(J_MESSAGE_KV_PUT, 0);
+	message_recv = j_message_new(J_MESSAGE_NONE, 0);
+
+	operation.length = 3;
+
+	j_message_add_operation(message_send, 4 + J_MESSAGE_LAYOUT_SIZE(J_MESSAGE_LAYOUT_KV_PUT) + 3);
+	j_message_append_string(message_send, "key");
+	ret = j_message_append_kv_put(message_send, &operation);
+	g_assert(ret);
+	j_message_append_n(message_send, "abc", 3);
+
+	ret = j_message_write(message_send, output);
+	g_assert(ret);
+
+	g_memory_input_stream_add_data(
+		G_MEMORY_INPUT_STREAM(input),
+		g_memory_output_stream_get_data(G_MEMORY_OUTPUT_STREAM(output)),
+		g_memory_output_stream_get_data_size(G_MEMORY_OUTPUT_STREAM(output)),
+		NULL
+	);
+
+	ret = j_message_read(message_recv, input);
+	g_assert(ret);
+
+	key = j_message_get_string(message_recv);
+	g_assert_cmpstr(key, ==, "key");
+
+	operation.length = 0;
+	ret = j_message_next_kv_put(message_recv, &operation);
+	g_assert(ret);
+	g_assert_cmpuint(operation.length, ==, 3);
+
+	g_assert(j_message_can_get(message_recv, operation.length));
+	g_assert(memcmp(j_message_get_n(message_recv, operation.length), "abc", 3) == 0);
+
+	/* The message has been consumed completely. */
+	g_assert(!j_message_can_get(message_recv, 1));
+	ret = j_message_next_kv_put(message_recv, &operation);
+	g_assert(!ret);
+}
+
 static
 void
 test_message_semantics (void)
@@ -190,5 +1043,18 @@ test_message (void)
 	g_test_add_func("/message/header", test_message_header);
 	g_test_add_func("/message/append", test_message_append);
 	g_test_add_func("/message/write_read", test_message_write_read);
+	g_test_add_func("/message/write_read_large", test_message_write_read_large);
+	g_test_add_func("/message/write_fd", test_message_write_fd);
+	g_test_add_func("/message/receive_reply", test_message_receive_reply);
+	g_test_add_func("/message/receive_data", test_message_receive_data);
+	g_test_add_func("/message/reader", test_message_reader);
+	g_test_add_func("/message/reader_feed", test_message_reader_feed);
+	g_test_add_func("/message/interning", test_message_interning);
+	g_test_add_func("/message/compression", test_message_compression);
+	g_test_add_func("/message/shared_memory", test_message_shared_memory);
+	g_test_add_func("/message/shared_memory_limit", test_message_shared_memory_limit);
+	g_test_add_func("/message/engine", test_message_engine);
+	g_test_add_func("/message/layout", test_message_layout);
+	g_test_add_func("/message/layout_next", test_message_layout_next);
 	g_test_add_func("/message/semantics", test_message_semantics);
 }
@@ -40,9 +40,21 @@ static gchar const* opt_kv_path = NULL;
 static gchar const* opt_db_backend = NULL;
 static gchar const* opt_db_component = NULL;
 static gchar const* opt_db_path = NULL;
+static gint opt_port = 0;
 static gint64 opt_max_operation_size = 0;
 static gint opt_max_connections = 0;
+static gint opt_warm_up = 0;
+static gboolean opt_multiplex = FALSE;
 static gint64 opt_stripe_size = 0;
+static gint opt_server_threads = 0;
+static gboolean opt_splice_writes = FALSE;
+static gboolean opt_io_uring = FALSE;
+static gint opt_object_cache_size = 0;
+static gint opt_group_commit_window = 200;
+static gint opt_metadata_share = 25;
+static gchar const* opt_numa_nodes = NULL;
+static gchar const* opt_compression = NULL;
+static gint opt_compression_threshold = 0;
 
 static
 gchar**
@@ -106,8 +118,52 @@ write_config (gchar* path)
 	servers_db = string_split(opt_servers_db);
 
 	key_file = g_key_file_new();
+	g_key_file_set_integer(key_file, "core", "port", opt_port);
 	g_key_file_set_int64(key_file, "core", "max-operation-size", opt_stripe_size);
+	g_key_file_set_integer(key_file, "core", "server-threads", opt_server_threads);
+	g_key_file_set_boolean(key_file, "core", "splice-writes", opt_splice_writes);
+	g_key_file_set_boolean(key_file, "core", "io-uring", opt_io_uring);
+	g_key_file_set_integer(key_file, "core", "object-cache-size", opt_object_cache_size);
+	g_key_file_set_integer(key_file, "core", "group-commit-window", opt_group_commit_window);
+	g_key_file_set_integer(key_file, "core", "metadata-share", opt_metadata_share);
+
+	if (opt_numa_nodes != NULL)
+	{
+		g_auto(GStrv) numa_nodes_str = NULL;
+		g_autofree gint* numa_nodes = NULL;
+		guint numa_nodes_len;
+
+		numa_nodes_str = string_split(opt_numa_nodes);
+		numa_nodes_len = g_strv_length(numa_nodes_str);
+		numa_nodes = g_new(gint, numa_nodes_len);
+
+		for (guint i = 0; i < numa_nodes_len; i++)
+		{
+			gint64 numa_node;
+
+			/* The key file separates list entries with semicolons, so only accept plain numbers here. */
+			if (!g_ascii_string_to_signed(numa_nodes_str[i], 10, 0, G_MAXINT, &numa_node, NULL))
+			{
+				g_critical("Invalid NUMA node %s, nodes have to be separated by commas.", numa_nodes_str[i]);
+				return FALSE;
+			}
+
+			numa_nodes[i] = numa_node;
+		}
+
+		g_key_file_set_integer_list(key_file, "core", "numa-nodes", numa_nodes, numa_nodes_len);
+	}
+
+	if (opt_compression != NULL)
+	{
+		g_key_file_set_string(key_file, "core", "compression", opt_compression);
+	}
+
+	g_key_file_set_integer(key_file, "core", "compression-threshold", opt_compression_threshold);
+
 	g_key_file_set_integer(key_file, "clients", "max-connections", opt_max_connections);
+	g_key_file_set_integer(key_file, "clients", "warm-up", opt_warm_up);
+	g_key_file_set_boolean(key_file, "clients", "multiplex", opt_multiplex);
 	g_key_file_set_int64(key_file, "clients", "stripe-size", opt_stripe_size);
 	g_key_file_set_string_list(key_file, "servers", "object", (gchar const* const*)servers_object, g_strv_length(servers_object));
 	g_key_file_set_string_list(key_file, "servers", "kv", (gchar const* const*)servers_kv, g_strv_length(servers_kv));
@@ -166,9 +222,21 @@ main (gint argc, gchar** argv)
 		{ "db-backend", 0, 0, G_OPTION_ARG_STRING, &opt_db_backend, "Database backend to use", "sqlite|null|…" },
 		{ "db-component", 0, 0, G_OPTION_ARG_STRING, &opt_db_component, "Key-value component to use", "client|server" },
 		{ "db-path", 0, 0, G_OPTION_ARG_STRING, &opt_db_path, "Key-value path to use", "/path/to/storage" },
+		{ "port", 0, 0, G_OPTION_ARG_INT, &opt_port, "Port servers listen on", "4711" },
 		{ "max-operation-size", 0, 0, G_OPTION_ARG_INT64, &opt_max_operation_size, "Maximum size of an operation", "0" },
 		{ "max-connections", 0, 0, G_OPTION_ARG_INT, &opt_max_connections, "Maximum number of connections", "0" },
+		{ "warm-up", 0, 0, G_OPTION_ARG_INT, &opt_warm_up, "Number of connections to open to each server at startup", "0" },
+		{ "multiplex", 0, 0, G_OPTION_ARG_NONE, &opt_multiplex, "Share connections among client threads", NULL },
 		{ "stripe-size", 0, 0, G_OPTION_ARG_INT64, &opt_stripe_size, "Default stripe size", "0" },
+		{ "server-threads", 0, 0, G_OPTION_ARG_INT, &opt_server_threads, "Number of server worker threads", "0" },
+		{ "splice-writes", 0, 0, G_OPTION_ARG_NONE, &opt_splice_writes, "Splice written data into the object backend", NULL },
+		{ "io-uring", 0, 0, G_OPTION_ARG_NONE, &opt_io_uring, "Receive messages on the server using io_uring", NULL },
+		{ "object-cache-size", 0, 0, G_OPTION_ARG_INT, &opt_object_cache_size, "Number of objects kept open by the server", "0" },
+		{ "group-commit-window", 0, 0, G_OPTION_ARG_INT, &opt_group_commit_window, "Time in microseconds to collect concurrent syncs, 0 disables group commit", "200" },
+		{ "metadata-share", 0, 0, G_OPTION_ARG_INT, &opt_metadata_share, "Percentage of server threads reserved for metadata (0-100)", "25" },
+		{ "numa-nodes", 0, 0, G_OPTION_ARG_STRING, &opt_numa_nodes, "NUMA nodes to bind server threads to", "0,1,…" },
+		{ "compression", 0, 0, G_OPTION_ARG_STRING, &opt_compression, "Compression for message payloads", "none|lz4|zstd" },
+		{ "compression-threshold", 0, 0, G_OPTION_ARG_INT, &opt_compression_threshold, "Minimum size in bytes of payloads to compress", "0" },
 		{ NULL, 0, 0, 0, NULL, NULL, NULL }
 	};
 
@@ -191,8 +259,17 @@ main (gint argc, gchar** argv)
 	    || (opt_read && !opt_user && !opt_system)
 	    || (!opt_read && (opt_servers_object == NULL || opt_servers_kv == NULL || opt_servers_db == NULL || opt_object_backend == NULL || opt_object_component == NULL || opt_object_path == NULL || opt_kv_backend == NULL || opt_kv_component == NULL || opt_kv_path == NULL || opt_db_backend == NULL || opt_db_component == NULL || opt_db_path == NULL))
 	    || opt_max_operation_size < 0
+	    || opt_port < 0
+	    || opt_port > G_MAXUINT16
 	    || opt_max_connections < 0
+	    || opt_warm_up < 0
 	    || opt_stripe_size < 0
+	    || opt_server_threads < 0
+	    || opt_object_cache_size < 0
+	    || opt_group_commit_window < 0
+	    || opt_metadata_share < 0
+	    || opt_metadata_share > 100
+	    || opt_compression_threshold < 0
 	)
 	{
 		g_autofree gchar* help = NULL;
@@ -50,12 +50,141 @@ print_statistics (JStatistics* statistics)
 	g_print("  %s received\n", size_received);
 	g_print("  %s sent\n", size_sent);
 
+	if (j_statistics_get(statistics, J_STATISTICS_BYTES_COMPRESSED) > 0)
+	{
+		g_autofree gchar* size_uncompressed = NULL;
+		g_autofree gchar* size_compressed = NULL;
+
+		size_uncompressed = g_format_size(j_statistics_get(statistics, J_STATISTICS_BYTES_UNCOMPRESSED));
+		size_compressed = g_format_size(j_statistics_get(statistics, J_STATISTICS_BYTES_COMPRESSED));
+
+		g_print("  %s compressed to %s (ratio %.2f)\n", size_uncompressed, size_compressed, (gdouble)j_statistics_get(statistics, J_STATISTICS_BYTES_UNCOMPRESSED) / j_statistics_get(statistics, J_STATISTICS_BYTES_COMPRESSED));
+	}
+
 	g_free(size_read);
 	g_free(size_written);
 	g_free(size_received);
 	g_free(size_sent);
 }
 
+static
+gchar const*
+message_type_name (guint32 type)
+{
+	static gchar const* const names[] = {
+		"none",
+		"ping",
+		"statistics",
+		"object_create",
+		"object_delete",
+		"object_read",
+		"object_status",
+		"object_write",
+		"kv_put",
+		"kv_delete",
+		"kv_get",
+		"kv_get_all",
+		"kv_get_by_prefix",
+		"db_schema_create",
+		"db_schema_get",
+		"db_schema_delete",
+		"db_insert",
+		"db_update",
+		"db_delete",
+		"db_query"
+	};
+
+	return (type < G_N_ELEMENTS(names)) ? names[type] : "unknown";
+}
+
+/**
+ * Returns the upper bound of the bucket containing the given percentile.
+ * Bucket i contains latencies below 2^i microseconds.
+ */
+static
+guint64
+histogram_percentile (guint64 const* buckets, guint32 bucket_count, guint64 count, guint percentile)
+{
+	guint64 threshold;
+	guint64 sum = 0;
+
+	threshold = (count * percentile + 99) / 100;
+
+	for (guint32 i = 0; i < bucket_count; i++)
+	{
+		sum += buckets[i];
+
+		if (sum >= threshold)
+		{
+			return G_GUINT64_CONSTANT(1) << i;
+		}
+	}
+
+	return G_GUINT64_CONSTANT(1) << (bucket_count - 1);
+}
+
+static
+void
+print_histograms (JMessage* reply)
+{
+	static gchar const* const phase_names[] = { "queue", "backend", "send" };
+
+	guint32 type_count;
+	guint32 phase_count;
+	guint32 bucket_count;
+	g_autofree guint64* buckets = NULL;
+
+	type_count = j_message_get_4(reply);
+	phase_count = j_message_get_4(reply);
+	bucket_count = j_message_get_4(reply);
+
+	buckets = g_new(guint64, bucket_count);
+
+	g_print("  Latencies (p50/p99 in microseconds)\n");
+
+	for (guint32 type = 0; type < type_count; type++)
+	{
+		g_autoptr(GString) line = NULL;
+		gboolean used = FALSE;
+
+		line = g_string_new(NULL);
+		g_string_append_printf(line, "    %s:", message_type_name(type));
+
+		for (guint32 phase = 0; phase < phase_count; phase++)
+		{
+			guint64 count = 0;
+
+			for (guint32 i = 0; i < bucket_count; i++)
+			{
+				buckets[i] = j_message_get_8(reply);
+				count += buckets[i];
+			}
+
+			if (count == 0)
+			{
+				continue;
+			}
+
+			used = TRUE;
+
+			g_string_append_printf(line, " %s %" G_GUINT64_FORMAT "/%" G_GUINT64_FORMAT,
+				(phase < G_N_ELEMENTS(phase_names)) ? phase_names[phase] : "unknown",
+				histogram_percentile(buckets, bucket_count, count, 50),
+				histogram_percentile(buckets, bucket_count, count, 99));
+
+			if (phase == 0)
+			{
+				g_string_append_printf(line, " (%" G_GUINT64_FORMAT " messages)", count);
+			}
+		}
+
+		if (used)
+		{
+			g_print("%s\n", line->str);
+		}
+	}
+}
+
 int
 main (int argc, char** argv)
 {
@@ -122,9 +251,22 @@ main (int argc, char** argv)
 		j_statistics_add(statistics, J_STATISTICS_BYTES_SENT, value);
 		j_statistics_add(statistics_total, J_STATISTICS_BYTES_SENT, value);
 
+		value = j_message_get_8(reply);
+		j_statistics_add(statistics, J_STATISTICS_BYTES_UNCOMPRESSED, value);
+		j_statistics_add(statistics_total, J_STATISTICS_BYTES_UNCOMPRESSED, value);
+
+		value = j_message_get_8(reply);
+		j_statistics_add(statistics, J_STATISTICS_BYTES_COMPRESSED, value);
+		j_statistics_add(statistics_total, J_STATISTICS_BYTES_COMPRESSED, value);
+
 		g_print("Data server %d\n", i);
 		print_statistics(statistics);
 
+		if (j_message_get_count(reply) > 1)
+		{
+			print_histograms(reply);
+		}
+
 		if (i != j_configuration_get_server_count(configuration, J_BACKEND_TYPE_OBJECT) - 1)
 		{
 			g_print("\n");